@@ -0,0 +1,180 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <algorithm>
+
+#include "s3fs_logger.h"
+#include "adaptive_concurrency.h"
+
+//-------------------------------------------------------------------
+// Class AdaptiveConcurrency
+//-------------------------------------------------------------------
+int                     AdaptiveConcurrency::max_limit          = 0;    // default is disabled
+std::mutex              AdaptiveConcurrency::limit_lock;
+std::condition_variable AdaptiveConcurrency::limit_cond;
+double                  AdaptiveConcurrency::limit              = 1.0;
+int                     AdaptiveConcurrency::running            = 0;
+AdaptiveConcurrency::latency_stat AdaptiveConcurrency::get_latency;
+AdaptiveConcurrency::latency_stat AdaptiveConcurrency::head_latency;
+std::chrono::steady_clock::time_point AdaptiveConcurrency::last_decrease;
+
+//-------------------------------------------------------------------
+// Class methods for AdaptiveConcurrency
+//-------------------------------------------------------------------
+bool AdaptiveConcurrency::SetMaxLimit(int count)
+{
+    if(count < 0){
+        return false;
+    }
+    AdaptiveConcurrency::max_limit = count;
+    return true;
+}
+
+//
+// Sets the initial limit, this is called when the worker threads start.
+//
+void AdaptiveConcurrency::Initialize(int initial)
+{
+    const std::lock_guard<std::mutex> lock(AdaptiveConcurrency::limit_lock);
+
+    AdaptiveConcurrency::limit        = std::max(1, std::min(initial, AdaptiveConcurrency::max_limit));
+    AdaptiveConcurrency::get_latency  = latency_stat();
+    AdaptiveConcurrency::head_latency = latency_stat();
+
+    S3FS_PRN_INFO("The adaptive concurrency limit starts from %d(max %d).", static_cast<int>(AdaptiveConcurrency::limit), AdaptiveConcurrency::max_limit);
+}
+
+int AdaptiveConcurrency::GetLimit()
+{
+    const std::lock_guard<std::mutex> lock(AdaptiveConcurrency::limit_lock);
+    return static_cast<int>(AdaptiveConcurrency::limit);
+}
+
+//
+// Waits until the number of the running requests is under the limit.
+//
+void AdaptiveConcurrency::Acquire()
+{
+    if(!AdaptiveConcurrency::IsEnabled()){
+        return;
+    }
+    std::unique_lock<std::mutex> lock(AdaptiveConcurrency::limit_lock);
+    AdaptiveConcurrency::limit_cond.wait(lock, []() NO_THREAD_SAFETY_ANALYSIS { return AdaptiveConcurrency::running < static_cast<int>(AdaptiveConcurrency::limit); });
+    ++AdaptiveConcurrency::running;
+}
+
+void AdaptiveConcurrency::Release()
+{
+    if(!AdaptiveConcurrency::IsEnabled()){
+        return;
+    }
+    {
+        const std::lock_guard<std::mutex> lock(AdaptiveConcurrency::limit_lock);
+        --AdaptiveConcurrency::running;
+    }
+    AdaptiveConcurrency::limit_cond.notify_one();
+}
+
+void AdaptiveConcurrency::SetLimitHasLock(double newlimit, const char* reason)
+{
+    newlimit = std::max(1.0, std::min(newlimit, static_cast<double>(AdaptiveConcurrency::max_limit)));
+
+    int oldcount = static_cast<int>(AdaptiveConcurrency::limit);
+    AdaptiveConcurrency::limit = newlimit;
+    if(oldcount != static_cast<int>(newlimit)){
+        S3FS_PRN_INFO("The adaptive concurrency limit is changed from %d to %d(%s, running=%d).", oldcount, static_cast<int>(newlimit), reason, AdaptiveConcurrency::running);
+    }
+}
+
+//
+// Decreases the limit at most once in DECREASE_INTERVAL, because many
+// requests which are running at the same time get the same signal.
+//
+void AdaptiveConcurrency::DecreaseHasLock(const char* reason)
+{
+    auto now = std::chrono::steady_clock::now();
+    if(now - AdaptiveConcurrency::last_decrease < DECREASE_INTERVAL){
+        return;
+    }
+    AdaptiveConcurrency::last_decrease = now;
+    SetLimitHasLock(AdaptiveConcurrency::limit * DECREASE_RATIO, reason);
+}
+
+//
+// Adds the sample to the EWMA of the latency, and returns true if the
+// EWMA is inflated over its baseline.
+//
+bool AdaptiveConcurrency::UpdateLatency(latency_stat& stat, long first_byte_ms)
+{
+    if(0.0 == stat.ewma){
+        stat.ewma = static_cast<double>(first_byte_ms);
+    }else{
+        stat.ewma += LATENCY_EWMA_ALPHA * (static_cast<double>(first_byte_ms) - stat.ewma);
+    }
+    if(0.0 == stat.window_min || stat.ewma < stat.window_min){
+        stat.window_min = stat.ewma;
+    }
+    if(LATENCY_WINDOW <= ++stat.samples){
+        stat.baseline   = stat.window_min;
+        stat.window_min = 0.0;
+        stat.samples    = 0;
+    }
+    return (0.0 < stat.baseline && stat.baseline * LATENCY_TOLERANCE < stat.ewma);
+}
+
+void AdaptiveConcurrency::NotifySuccess(bool is_head, long first_byte_ms)
+{
+    if(!AdaptiveConcurrency::IsEnabled()){
+        return;
+    }
+    bool increased = false;
+    {
+        const std::lock_guard<std::mutex> lock(AdaptiveConcurrency::limit_lock);
+
+        if(UpdateLatency((is_head ? AdaptiveConcurrency::head_latency : AdaptiveConcurrency::get_latency), first_byte_ms)){
+            DecreaseHasLock("latency inflation");
+        }else if(static_cast<int>(AdaptiveConcurrency::limit) < AdaptiveConcurrency::max_limit && static_cast<int>(AdaptiveConcurrency::limit) <= AdaptiveConcurrency::running){
+            // increase only when the limit is used up
+            SetLimitHasLock(AdaptiveConcurrency::limit + 1.0 / AdaptiveConcurrency::limit, "success");
+            increased = true;
+        }
+    }
+    if(increased){
+        AdaptiveConcurrency::limit_cond.notify_all();
+    }
+}
+
+void AdaptiveConcurrency::NotifyThrottle()
+{
+    if(!AdaptiveConcurrency::IsEnabled()){
+        return;
+    }
+    const std::lock_guard<std::mutex> lock(AdaptiveConcurrency::limit_lock);
+    DecreaseHasLock("throttled");
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
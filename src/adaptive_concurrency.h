@@ -0,0 +1,106 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef S3FS_ADAPTIVE_CONCURRENCY_H_
+#define S3FS_ADAPTIVE_CONCURRENCY_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+#include "common.h"
+
+//----------------------------------------------
+// class AdaptiveConcurrency
+//----------------------------------------------
+// This class limits the number of the requests which are transferred by
+// S3fsCurl::RequestPerform at the same time, and changes the limit by
+// AIMD(Additive Increase / Multiplicative Decrease).
+//
+// - The limit is increased by 1 for every "limit" successful requests
+//   while the time to the first byte is not inflated.
+// - The limit is decreased by DECREASE_RATIO when the server throttles
+//   the requests(HTTP response code 429 or 503), or when the average time
+//   to the first byte is over LATENCY_TOLERANCE times its baseline.
+//
+// The average time to the first byte is the EWMA for each type of the
+// requests(GET and HEAD), because their latency is very different. The
+// baseline is the minimum of the EWMA in the previous window, so that
+// a few fast responses do not make the baseline too low.
+//
+// The limit moves between 1 and max_limit(adaptive_concurrency option),
+// and starts from max_thread_count. The requests in the curl multi
+// interface are not counted, S3fsCurlMulti limits its streams to the
+// current limit instead.
+//
+class AdaptiveConcurrency
+{
+    private:
+        static constexpr double DECREASE_RATIO     = 0.75;
+        static constexpr double LATENCY_TOLERANCE  = 2.0;
+        static constexpr double LATENCY_EWMA_ALPHA = 0.1;
+        static constexpr int    LATENCY_WINDOW     = 256;       // the number of samples for the baseline
+        static constexpr std::chrono::milliseconds DECREASE_INTERVAL{1000};
+
+        struct latency_stat
+        {
+            double ewma       = 0.0;
+            double baseline   = 0.0;        // minimum of the EWMA in the previous window
+            double window_min = 0.0;        // minimum of the EWMA in the current window(0 means no sample)
+            int    samples    = 0;
+        };
+
+        static int                     max_limit;       // 0 means disabled
+        static std::mutex              limit_lock;
+        static std::condition_variable limit_cond;
+        static double                  limit GUARDED_BY(limit_lock);
+        static int                     running GUARDED_BY(limit_lock);
+        static latency_stat            get_latency GUARDED_BY(limit_lock);
+        static latency_stat            head_latency GUARDED_BY(limit_lock);
+        static std::chrono::steady_clock::time_point last_decrease GUARDED_BY(limit_lock);
+
+    private:
+        static bool UpdateLatency(latency_stat& stat, long first_byte_ms);
+        static void DecreaseHasLock(const char* reason) REQUIRES(limit_lock);
+        static void SetLimitHasLock(double newlimit, const char* reason) REQUIRES(limit_lock);
+
+    public:
+        static bool SetMaxLimit(int count);
+        static int GetMaxLimit() { return AdaptiveConcurrency::max_limit; }
+        static bool IsEnabled() { return (0 < AdaptiveConcurrency::max_limit); }
+        static void Initialize(int initial);
+        static int GetLimit();
+
+        static void Acquire();
+        static void Release();
+        static void NotifySuccess(bool is_head, long first_byte_ms);
+        static void NotifyThrottle();
+};
+
+#endif // S3FS_ADAPTIVE_CONCURRENCY_H_
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
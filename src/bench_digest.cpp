@@ -0,0 +1,157 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+#include "checksum_util.h"
+#include "s3fs_auth.h"
+#include "s3fs_logger.h"
+#include "string_util.h"
+#include "test_util.h"
+
+//-------------------------------------------------------------------
+// Make synthetic part file
+//-------------------------------------------------------------------
+static int make_part_file(off_t size)
+{
+    char path[] = "/tmp/s3fs_bench_digest.XXXXXX";
+    int  fd     = mkstemp(path);
+    if(-1 == fd){
+        fprintf(stderr, "failed to create temporary file\n");
+        std::exit(1);
+    }
+    unlink(path);
+
+    std::string block(1024 * 1024, '\0');
+    for(size_t pos = 0; pos < block.size(); ++pos){
+        block[pos] = static_cast<char>((pos * 7 + 3) % 251);
+    }
+    for(off_t total = 0; total < size; total += static_cast<off_t>(block.size())){
+        if(static_cast<ssize_t>(block.size()) != pwrite(fd, block.data(), block.size(), total)){
+            fprintf(stderr, "failed to write temporary file\n");
+            std::exit(1);
+        }
+    }
+    return fd;
+}
+
+//-------------------------------------------------------------------
+// Benchmark
+//-------------------------------------------------------------------
+template<typename Func>
+static double measure_msec(int loop, Func func)
+{
+    auto start = std::chrono::steady_clock::now();
+    for(int cnt = 0; cnt < loop; ++cnt){
+        if(!func()){
+            fprintf(stderr, "failed to compute digest\n");
+            std::exit(1);
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()) / 1000.0 / loop;
+}
+
+// The read loop of the previous implementation(512 bytes per pread)
+static bool read_by_small_block(int fd, off_t size)
+{
+    std::array<char, 512> buf;
+    for(off_t total = 0; total < size; total += static_cast<off_t>(buf.size())){
+        if(pread(fd, buf.data(), buf.size(), total) <= 0){
+            return false;
+        }
+    }
+    return true;
+}
+
+static void bench_digest(off_t size, int loop)
+{
+    int fd = make_part_file(size);
+
+    // same result
+    md5_t    md5;
+    md5_t    md5_both;
+    sha256_t sha256;
+    sha256_t sha256_both;
+    ASSERT_TRUE(s3fs_md5_fd(fd, 0, size, &md5));
+    ASSERT_TRUE(s3fs_sha256_fd(fd, 0, size, &sha256));
+    ASSERT_TRUE(s3fs_md5_sha256_fd(fd, 0, size, &md5_both, &sha256_both));
+    ASSERT_EQUALS(s3fs_hex_lower(md5.data(), md5.size()), s3fs_hex_lower(md5_both.data(), md5_both.size()));
+    ASSERT_EQUALS(s3fs_hex_lower(sha256.data(), sha256.size()), s3fs_hex_lower(sha256_both.data(), sha256_both.size()));
+
+    double small_read_msec = measure_msec(loop, [&](){ return read_by_small_block(fd, size); });
+    double large_read_msec = measure_msec(loop, [&](){ return s3fs_read_fd_blocks(fd, 0, size, [](const unsigned char*, size_t){ return true; }); });
+    double two_pass_msec   = measure_msec(loop, [&](){ return s3fs_md5_fd(fd, 0, size, &md5) && s3fs_sha256_fd(fd, 0, size, &sha256); });
+    double one_pass_msec   = measure_msec(loop, [&](){ return s3fs_md5_sha256_fd(fd, 0, size, &md5_both, &sha256_both); });
+    std::string checksum;
+    double crc32c_msec     = measure_msec(loop, [&](){ return s3fs_checksum_fd(checksum_type_t::CRC32C, fd, 0, size, checksum); });
+    double crc64nvme_msec  = measure_msec(loop, [&](){ return s3fs_checksum_fd(checksum_type_t::CRC64NVME, fd, 0, size, checksum); });
+
+    // [NOTE]
+    // The previous implementation read the part twice(MD5 and SHA256) by
+    // 512 bytes blocks, so the difference of the read loops is added twice.
+    //
+    double previous_msec = two_pass_msec + 2 * (small_read_msec - large_read_msec);
+
+    printf("%4lld MB part : read 512B %8.2f ms, read %zuKB %8.2f ms\n", static_cast<long long>(size / (1024 * 1024)), small_read_msec, DIGEST_READ_SIZE / 1024, large_read_msec);
+    printf("%4lld MB part : md5+sha256 previous(2 pass, 512B) %8.2f ms, 2 pass %8.2f ms, 1 pass %8.2f ms\n", static_cast<long long>(size / (1024 * 1024)), previous_msec, two_pass_msec, one_pass_msec);
+    printf("%4lld MB part : crc32c %8.2f ms, crc64nvme %8.2f ms(%s)\n", static_cast<long long>(size / (1024 * 1024)), crc32c_msec, crc64nvme_msec, s3fs_crc_impl_name());
+
+    close(fd);
+}
+
+int main(int argc, const char *argv[])
+{
+    S3fsLog singletonLog;
+    S3fsLog::SetLogLevel(S3fsLog::Level::CRIT);
+
+    int loop = 5;
+    if(1 < argc){
+        loop = std::atoi(argv[1]);
+        if(loop <= 0){
+            fprintf(stderr, "usage: %s [loop count]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(!s3fs_init_global_ssl()){
+        fprintf(stderr, "could not initialize the crypt library\n");
+        return 1;
+    }
+
+    bench_digest(8 * 1024 * 1024, loop);
+    bench_digest(64 * 1024 * 1024, loop);
+
+    s3fs_destroy_global_ssl();
+    return 0;
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -0,0 +1,197 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "common.h"
+#include "curl_util.h"
+#include "s3fs_logger.h"
+#include "s3fs_xml.h"
+#include "s3objlist.h"
+#include "string_util.h"
+#include "test_util.h"
+
+//-------------------------------------------------------------------
+// Dummy functions which are implemented in s3fs.cpp
+//-------------------------------------------------------------------
+bool get_object_sse_type(const char* /*path*/, sse_type_t& ssetype, std::string& ssevalue)
+{
+    ssetype = sse_type_t::SSE_DISABLE;
+    ssevalue.clear();
+    return true;
+}
+
+int put_headers(const char* /*path*/, const headers_t& /*meta*/, bool /*is_copy*/, bool /*use_st_size*/)
+{
+    return -EIO;
+}
+
+//-------------------------------------------------------------------
+// Make synthetic ListBucketResult
+//-------------------------------------------------------------------
+static std::string make_list_bucket_result(int contents, int cprefixes, bool has_xmlns, bool has_cr = false)
+{
+    std::string xml;
+    char        buff[512];
+
+    xml += R"(<?xml version="1.0" encoding="UTF-8"?>)";
+    xml += (has_xmlns ? R"(<ListBucketResult xmlns="http://s3.amazonaws.com/doc/2006-03-01/">)" : "<ListBucketResult>");
+    xml += "<Name>bucket</Name><Prefix>dir/</Prefix><KeyCount>" + std::to_string(contents + cprefixes) + "</KeyCount>";
+    xml += "<MaxKeys>1000</MaxKeys><Delimiter>/</Delimiter><IsTruncated>true</IsTruncated>";
+    xml += "<NextContinuationToken>1ueGcxLPRx1Tr/XYExHnhbYLgveDs2J/wm36Hy4vbOwM=</NextContinuationToken>";
+
+    for(int cnt = 0; cnt < contents; ++cnt){
+        snprintf(buff, sizeof(buff),
+            "<Contents><Key>dir/file-%08d&amp;name%s</Key><LastModified>2024-01-02T03:04:05.000Z</LastModified>"
+            "<ETag>&quot;%032x&quot;</ETag><Size>%d</Size><StorageClass>STANDARD</StorageClass></Contents>",
+            cnt, ((has_cr && 0 == (cnt % 10)) ? "\r%" : ""), cnt, cnt * 16);
+        xml += buff;
+    }
+    for(int cnt = 0; cnt < cprefixes; ++cnt){
+        snprintf(buff, sizeof(buff), "<CommonPrefixes><Prefix>dir/subdir-%08d/</Prefix></CommonPrefixes>", cnt);
+        xml += buff;
+    }
+    xml += "</ListBucketResult>";
+    return xml;
+}
+
+//-------------------------------------------------------------------
+// Parsers
+//-------------------------------------------------------------------
+// The previous implementation: DOM and XPath
+static bool parse_by_dom(const std::string& body, S3ObjList& head, bool& truncated)
+{
+    std::string encbody = get_encoded_cr_code(body.c_str());
+
+    unique_ptr_xmlDoc doc(xmlReadMemory(encbody.c_str(), static_cast<int>(encbody.size()), "", nullptr, S3FS_XML_PARSE_FLAGS), xmlFreeDoc);
+    if(nullptr == doc){
+        return false;
+    }
+    if(0 != append_objects_from_xml("/dir", doc.get(), head)){
+        return false;
+    }
+    truncated = is_truncated(doc.get());
+    get_next_continuation_token(doc.get());
+    return true;
+}
+
+static bool parse_by_stream(const std::string& body, S3ObjList& head, bool& truncated)
+{
+    std::string next_continuation_token;
+    std::string next_marker;
+    return (0 == parse_list_bucket_result("/dir", body, head, truncated, next_continuation_token, next_marker));
+}
+
+//-------------------------------------------------------------------
+// Benchmark
+//-------------------------------------------------------------------
+static void check_same_result(const std::string& body)
+{
+    S3ObjList dom_head;
+    S3ObjList stream_head;
+    bool      dom_truncated    = false;
+    bool      stream_truncated = false;
+
+    ASSERT_TRUE(parse_by_dom(body, dom_head, dom_truncated));
+    ASSERT_TRUE(parse_by_stream(body, stream_head, stream_truncated));
+    ASSERT_EQUALS(dom_truncated, stream_truncated);
+
+    s3obj_list_t dom_names;
+    s3obj_list_t stream_names;
+    dom_head.GetNameList(dom_names, false, false);
+    stream_head.GetNameList(stream_names, false, false);
+    ASSERT_EQUALS(dom_names.size(), stream_names.size());
+
+    for(auto iter1 = dom_names.cbegin(), iter2 = stream_names.cbegin(); iter1 != dom_names.cend(); ++iter1, ++iter2){
+        ASSERT_EQUALS(*iter1, *iter2);
+        ASSERT_EQUALS(dom_head.GetETag(iter1->c_str()), stream_head.GetETag(iter2->c_str()));
+        ASSERT_EQUALS(dom_head.GetSize(iter1->c_str()), stream_head.GetSize(iter2->c_str()));
+        ASSERT_EQUALS(dom_head.GetLastModified(iter1->c_str()), stream_head.GetLastModified(iter2->c_str()));
+        ASSERT_EQUALS(dom_head.IsDir(iter1->c_str()), stream_head.IsDir(iter2->c_str()));
+    }
+    ASSERT_EQUALS(dom_head.GetCommonPrefixes().size(), stream_head.GetCommonPrefixes().size());
+}
+
+template<typename Func>
+static double measure_usec(const std::string& body, int loop, Func func)
+{
+    auto start = std::chrono::steady_clock::now();
+    for(int cnt = 0; cnt < loop; ++cnt){
+        S3ObjList head;
+        bool      truncated = false;
+        if(!func(body, head, truncated)){
+            fprintf(stderr, "failed to parse\n");
+            std::exit(1);
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()) / loop;
+}
+
+static void bench_list_parse(const char* name, const std::string& body, int loop)
+{
+    check_same_result(body);
+
+    double dom_usec    = measure_usec(body, loop, parse_by_dom);
+    double stream_usec = measure_usec(body, loop, parse_by_stream);
+
+    printf("%-28s : %8zu bytes, dom %10.1f us/page, stream %10.1f us/page\n", name, body.size(), dom_usec, stream_usec);
+}
+
+int main(int argc, const char *argv[])
+{
+    S3fsLog singletonLog;
+    S3fsLog::SetLogLevel(S3fsLog::Level::CRIT);
+
+    int loop = 100;
+    if(1 < argc){
+        loop = std::atoi(argv[1]);
+        if(loop <= 0){
+            fprintf(stderr, "usage: %s [loop count]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    bench_list_parse("1000 contents",              make_list_bucket_result(1000, 0, true),  loop);
+    bench_list_parse("1000 common prefixes",       make_list_bucket_result(10, 990, true),  loop);
+    bench_list_parse("1000 contents(raw CR)",      make_list_bucket_result(1000, 0, true, true), loop);
+
+    // [NOTE]
+    // The name space url is cached in GetXmlNsUrl, so the XML without name
+    // space is tested with noxmlns option as same as actual use.
+    //
+    noxmlns = true;
+    bench_list_parse("1000 contents(noxmlns)",     make_list_bucket_result(1000, 0, false), loop);
+
+    return 0;
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
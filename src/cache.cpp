@@ -32,6 +32,10 @@
 //-------------------------------------------------------------------
 std::mutex      StatCache::stat_cache_lock;
 
+// The immutable caches are evicted by 1/STAT_CACHE_EVICT_RATIO of the
+// maximum size at once.
+static constexpr unsigned long STAT_CACHE_EVICT_RATIO = 10;
+
 //-------------------------------------------------------------------
 // Constructor/Destructor
 //-------------------------------------------------------------------
@@ -61,6 +65,18 @@ bool StatCache::GetStat(const std::string& key, struct stat* pstbuf, headers_t*
     // find key(path) in cache
     auto pStatCache = pMountPointDir->Find(key, petag);
     if(!pStatCache){
+        // [NOTE]
+        // If the path is not in the cached listing of its directory, it
+        // does not exist, so it is treated as same as a negative cache.
+        // This avoids HEAD requests and negative cache entries for the
+        // paths which are looked up in the listed directories.
+        //
+        if(StatCacheNode::IsEnabledNegativeCache(key) && pMountPointDir->IsNotListed(key)){
+            if(ptype){
+                *ptype = objtype_t::NEGATIVE;
+            }
+            S3FS_PRN_DBG("Hit negative stat cache by listing [path=%s]", key.c_str());
+        }
         return false;
     }
 
@@ -164,6 +180,36 @@ bool StatCache::AddStat(const std::string& key, const struct stat& stbuf, objtyp
     return AddStatHasLock(key, &stbuf, nullptr, type, notruncate);
 }
 
+// [NOTE]
+// Adds the stat made from ListObjects data(without HEAD request).
+// Only the ETag is kept as meta for checking with the ETag in the object
+// list, and the cache is marked as listed.
+// When the caller needs meta headers, this cache will not hit and a HEAD
+// request will be sent.
+//
+bool StatCache::AddListedStat(const std::string& key, const struct stat& stbuf, const std::string& etag, objtype_t type)
+{
+    if(GetCacheSize() < 1){
+        return true;
+    }
+    const std::lock_guard<std::mutex> lock(StatCache::stat_cache_lock);
+
+    headers_t meta;
+    if(!etag.empty()){
+        meta["ETag"] = etag;
+    }
+    if(!AddStatHasLock(key, &stbuf, &meta, type, false)){
+        return false;
+    }
+
+    auto pStatCache = pMountPointDir->Find(key);
+    if(!pStatCache || !pStatCache->SetListed(true)){
+        S3FS_PRN_DBG("failed to set listed flag to stat cache entry[path=%s]", key.c_str());
+        return false;
+    }
+    return true;
+}
+
 bool StatCache::AddS3ObjList(std::string key, const S3ObjList& list)
 {
     const std::lock_guard<std::mutex> lock(StatCache::stat_cache_lock);
@@ -277,13 +323,29 @@ void StatCache::ClearNoTruncateFlag(const std::string& key)
 // will never be deleted.
 // This behavior means that no truncation will occur and caches will
 // accumulate until one of the caches expires.
+// The immutable caches(immutable option and the immutable rules of
+// stat_cache_policy_file) are never expired, so they are evicted in
+// least recently used order when the cache is over the maximum size.
 //
 bool StatCache::TruncateCacheHasLock(bool check_only_oversize_case)
 {
     if(check_only_oversize_case && StatCacheNode::GetCacheCount() <= GetCacheSize()){
         return false;
     }
-    if(!pMountPointDir->TruncateCache()){
+    bool result = pMountPointDir->TruncateCache();
+
+    // [NOTE]
+    // The immutable caches are evicted by the cache size instead of the
+    // expire time. They are evicted down to the low-water mark, so that
+    // the tree is not walked again for each of the following additions.
+    //
+    if(StatCacheNode::GetCacheCount() > GetCacheSize()){
+        unsigned long lowwater = GetCacheSize() - (GetCacheSize() / STAT_CACHE_EVICT_RATIO);
+        if(0 < pMountPointDir->EvictImmutableCache(StatCacheNode::GetCacheCount() - lowwater)){
+            result = true;
+        }
+    }
+    if(!result){
         S3FS_PRN_DBG("could not truncate any cache[current size=%lu, maximum size=%lu]", StatCacheNode::GetCacheCount(), GetCacheSize());
         return false;
     }
@@ -413,10 +475,11 @@ bool StatCache::AddSymlink(const std::string& key, const struct stat& stbuf, con
 //
 // [NOTE]
 // Add the file names under "dir" to the list.
-// However, if the same file name exists in the list, it will not be added.
+// However, if the same file name exists in the list(or in pexclude), it
+// will not be added.
 // "dir" must be terminated with a '/'.
 //
-bool StatCache::RawGetChildStats(const std::string& dir, s3obj_list_t* plist, s3obj_type_map_t* pobjmap)
+bool StatCache::RawGetChildStats(const std::string& dir, s3obj_list_t* plist, s3obj_type_map_t* pobjmap, const S3ObjList* pexclude)
 {
     if(dir.empty()){
         return false;
@@ -447,6 +510,9 @@ bool StatCache::RawGetChildStats(const std::string& dir, s3obj_list_t* plist, s3
 
     // merge list
     for(auto iter = childmap.cbegin(); iter != childmap.cend(); ++iter){
+        if(pexclude && pexclude->HasNormalizedName(iter->first)){
+            continue;
+        }
         if(plist){
             if(plist->cend() == std::find(plist->cbegin(), plist->cend(), iter->first)){
                plist->push_back(iter->first);
@@ -463,12 +529,12 @@ bool StatCache::RawGetChildStats(const std::string& dir, s3obj_list_t* plist, s3
 
 bool StatCache::GetChildStatList(const std::string& dir, s3obj_list_t& list)
 {
-    return RawGetChildStats(dir, &list, nullptr);
+    return RawGetChildStats(dir, &list, nullptr, nullptr);
 }
 
-bool StatCache::GetChildStatMap(const std::string& dir, s3obj_type_map_t& objmap)
+bool StatCache::GetChildStatMap(const std::string& dir, s3obj_type_map_t& objmap, const S3ObjList* pexclude)
 {
-    return RawGetChildStats(dir, nullptr, &objmap);
+    return RawGetChildStats(dir, nullptr, &objmap, pexclude);
 }
 
 void StatCache::Dump(bool detail)
@@ -58,7 +58,7 @@ class StatCache
         bool AddStatHasLock(const std::string& key, const struct stat* pstbuf, const headers_t* pmeta, objtype_t type, bool notruncate) REQUIRES(StatCache::stat_cache_lock);
         bool TruncateCacheHasLock(bool check_only_oversize_case = true) REQUIRES(StatCache::stat_cache_lock);
         bool DelStatHasLock(const std::string& key) REQUIRES(StatCache::stat_cache_lock);
-        bool RawGetChildStats(const std::string& dir, s3obj_list_t* plist, s3obj_type_map_t* pobjmap);
+        bool RawGetChildStats(const std::string& dir, s3obj_list_t* plist, s3obj_type_map_t* pobjmap, const S3ObjList* pexclude);
 
     public:
         StatCache(const StatCache&) = delete;
@@ -108,6 +108,7 @@ class StatCache
         // Add stat cache
         bool AddStat(const std::string& key, const struct stat& stbuf, const headers_t& meta, objtype_t type, bool notruncate = false);
         bool AddStat(const std::string& key, const struct stat& stbuf, objtype_t type, bool notruncate = false);
+        bool AddListedStat(const std::string& key, const struct stat& stbuf, const std::string& etag, objtype_t type);
         bool AddNegativeStat(const std::string& key);
         bool AddS3ObjList(std::string key, const S3ObjList& list);
 
@@ -126,7 +127,7 @@ class StatCache
 
         // Get List/Map
         bool GetChildStatList(const std::string& dir, s3obj_list_t& list);
-        bool GetChildStatMap(const std::string& dir, s3obj_type_map_t& objmap);
+        bool GetChildStatMap(const std::string& dir, s3obj_type_map_t& objmap, const S3ObjList* pexclude = nullptr);
 
         // For debugging
         void Dump(bool detail);
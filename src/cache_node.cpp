@@ -18,6 +18,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <algorithm>
 #include <iomanip>
 #include <sstream>
 
@@ -97,6 +98,7 @@ bool            StatCacheNode::EnableExpireTime                = true;
 bool            StatCacheNode::IsExpireIntervalType            = false;
 time_t          StatCacheNode::ExpireTime                      = 15 * 60;
 bool            StatCacheNode::UseNegativeCache                = true;
+bool            StatCacheNode::IsImmutableCache                = false;
 std::mutex      StatCacheNode::cache_lock;
 unsigned long   StatCacheNode::DisableCheckingExpire           = 0L;
 struct timespec StatCacheNode::DisableExpireDate               = {0, 0};
@@ -163,6 +165,22 @@ bool StatCacheNode::SetNegativeCache(bool flag)
     return old;
 }
 
+bool StatCacheNode::SetImmutable(bool flag)
+{
+    bool old = IsImmutableCache;
+    IsImmutableCache = flag;
+    return old;
+}
+
+bool StatCacheNode::IsEnabledNegativeCache(const std::string& strpath)
+{
+    const stat_cache_policy* ppolicy = StatCachePolicy::get()->Find(strpath);
+    if(ppolicy && ppolicy->negative){
+        return *ppolicy->negative;
+    }
+    return StatCacheNode::IsEnabledNegativeCache();
+}
+
 bool StatCacheNode::NeedExpireCheckHasLock(const struct timespec& ts)
 {
     if(!StatCacheNode::IsEnableExpireTime()){
@@ -233,6 +251,7 @@ StatCacheNode::StatCacheNode(const char* path, objtype_t type) : cache_type(type
 
     // Set now time.
     SetCurrentTime(cache_date);
+    access_date = cache_date;
 
     StatCacheNode::IncrementCacheCount(objtype_t::UNKNOWN);
 }
@@ -339,6 +358,15 @@ bool StatCacheNode::RemoveChild(const std::string& strpath)
     return RemoveChildHasLock(strpath);
 }
 
+bool StatCacheNode::ResetS3ObjListHasLock()
+{
+    // [NOTE]
+    // This base class (and all types other than Directory) do not have
+    // an S3ObjList, so there is nothing to do.
+    //
+    return true;
+}
+
 bool StatCacheNode::isRemovableHasLock() const
 {
     return true;
@@ -399,6 +427,7 @@ bool StatCacheNode::UpdateHasLock(const struct stat* pstat, const headers_t* pme
 
     if(pmeta){
         has_meta = true;
+        listed   = false;
 
         // copy only some keys
         meta.clear();
@@ -417,6 +446,7 @@ bool StatCacheNode::UpdateHasLock(const struct stat* pstat, const headers_t* pme
         }
     }else if(clear_meta){
         has_meta = false;
+        listed   = false;
         meta.clear();
     }
     return true;
@@ -454,6 +484,7 @@ bool StatCacheNode::UpdateHasLock()
 {
     hit_count = 0;              // Reset hit count
     SetCurrentTime(cache_date); // Set now time.
+    access_date = cache_date;
     return true;
 }
 
@@ -524,6 +555,22 @@ bool StatCacheNode::Set(const struct stat& stbuf, const headers_t& meta, bool is
     return SetHasLock(stbuf, meta, is_notruncate);
 }
 
+// [NOTE]
+// Marks this cache as made from ListObjects data.
+// This must be called after the stat and ETag(as meta) have been set,
+// because setting the meta headers will clear this flag.
+//
+bool StatCacheNode::SetListed(bool is_listed)
+{
+    std::lock_guard<std::mutex> lock(StatCacheNode::cache_lock);
+
+    if(fullpath.empty()){
+        return false;
+    }
+    listed = is_listed;
+    return true;
+}
+
 bool StatCacheNode::CheckETagValueHasLock(const char* petagval) const
 {
     if(!petagval || 0 == strlen(petagval)){
@@ -578,13 +625,32 @@ std::shared_ptr<StatCacheNode> StatCacheNode::Find(const std::string& strpath, c
     return FindHasLock(strpath, petagval, needTruncate);
 }
 
+bool StatCacheNode::IsNotListedHasLock(const std::string& strpath)
+{
+    // [NOTE]
+    // This base class (and all types other than Directory) do not have
+    // an S3ObjList, so it can not be determined.
+    //
+    return false;
+}
+
+bool StatCacheNode::IsNotListed(const std::string& strpath)
+{
+    std::lock_guard<std::mutex> lock(StatCacheNode::cache_lock);
+    return IsNotListedHasLock(strpath);
+}
+
 bool StatCacheNode::GetHasLock(headers_t* pmeta, struct stat* pst)
 {
     if(fullpath.empty()){
         return false;
     }
     if(pmeta){
-        if(!has_meta){
+        // [NOTE]
+        // The listed cache has only ETag in meta, it is not treated as
+        // meta headers, and the caller will get meta by HEAD request.
+        //
+        if(!has_meta || listed){
             return false;
         }
         *pmeta = meta;
@@ -599,6 +665,7 @@ bool StatCacheNode::GetHasLock(headers_t* pmeta, struct stat* pst)
         SetCurrentTime(cache_date);
     }
     ++hit_count;
+    SetCurrentTime(access_date);
 
     return true;
 }
@@ -656,6 +723,12 @@ objtype_t StatCacheNode::GetType() const
     return GetTypeHasLock();
 }
 
+bool StatCacheNode::IsListed() const
+{
+    std::lock_guard<std::mutex> lock(StatCacheNode::cache_lock);
+    return IsListedHasLock();
+}
+
 const std::string& StatCacheNode::GetPathHasLock() const
 {
     return fullpath;
@@ -671,6 +744,11 @@ bool StatCacheNode::HasMetaHasLock() const
     return has_meta;
 }
 
+bool StatCacheNode::IsListedHasLock() const
+{
+    return listed;
+}
+
 bool StatCacheNode::GetNoTruncateHasLock() const
 {
     return notruncate;
@@ -679,6 +757,7 @@ bool StatCacheNode::GetNoTruncateHasLock() const
 unsigned long StatCacheNode::IncrementHitCount()
 {
     std::lock_guard<std::mutex> lock(StatCacheNode::cache_lock);
+    SetCurrentTime(access_date);
     return ++hit_count;
 }
 
@@ -692,6 +771,7 @@ std::optional<std::string> StatCacheNode::GetExtraHasLock()
         SetCurrentTime(cache_date);
     }
     ++hit_count;
+    SetCurrentTime(access_date);
 
     return extvalue;
 }
@@ -735,14 +815,48 @@ bool StatCacheNode::GetS3ObjList(S3ObjList& list)
         SetCurrentTime(cache_date);
     }
     ++hit_count;
+    SetCurrentTime(access_date);
 
     return true;
 }
 
+//
+// Returns the rule in stat_cache_policy_file for this path.
+//
+// [NOTE]
+// The root node is created before the options are parsed, so the rule is
+// looked up at the first call instead of in the constructor.
+//
+const stat_cache_policy* StatCacheNode::GetPolicyHasLock() const
+{
+    if(!is_policy_resolved){
+        ppolicy            = StatCachePolicy::get()->Find(fullpath);
+        is_policy_resolved = true;
+    }
+    return ppolicy;
+}
+
+bool StatCacheNode::IsImmutableHasLock() const
+{
+    const stat_cache_policy* ppolicy = GetPolicyHasLock();
+    return ((StatCacheNode::IsImmutable() || (ppolicy && ppolicy->immutable)) && !isNegativeHasLock());
+}
+
 bool StatCacheNode::IsExpireStatCacheTimeHasLock() const
 {
+    time_t expire = StatCacheNode::GetExpireTime();
+
+    if(IsImmutableHasLock()){
+        // immutable object is never expired(but it is evicted by the cache size)
+        return false;
+    }
+    const stat_cache_policy* ppolicy = GetPolicyHasLock();
+    if(ppolicy && ppolicy->expire){
+        expire = *ppolicy->expire;
+    }
+
     if(NeedExpireCheckHasLock(cache_date)){
-        if(IsExpireStatCacheTime(cache_date, StatCacheNode::GetExpireTime())){
+        if(IsExpireStatCacheTime(cache_date, expire)){
             // this cache is expired
             return true;
         }
@@ -793,6 +907,13 @@ bool StatCacheNode::TruncateCache()
     return TruncateCacheHasLock();
 }
 
+void StatCacheNode::GetImmutableLeavesHasLock(statcache_leaves_t& leaves) const
+{
+    if(!notruncate && !isDirectoryHasLock() && IsImmutableHasLock()){
+        leaves.emplace_back(access_date, fullpath);
+    }
+}
+
 void StatCacheNode::DumpElementHasLock(const std::string& indent, std::ostringstream& oss) const
 {
     oss << indent << "fullpath   = " << fullpath                          << std::endl;
@@ -816,6 +937,7 @@ void StatCacheNode::DumpElementHasLock(const std::string& indent, std::ostringst
     oss << indent << "}"                                                  << std::endl;
 
     oss << indent << "has_meta   = " << (has_meta ? "true" : "false")     << std::endl;
+    oss << indent << "listed     = " << (listed ? "true" : "false")       << std::endl;
     oss << indent << "meta       = {"                                     << std::endl;
     for(auto iter = meta.cbegin(); iter != meta.cend(); ++iter){
         if(lower(iter->first) == "x-amz-meta-mode"){
@@ -902,11 +1024,18 @@ bool DirStatCache::ClearHasLock()
 
 bool DirStatCache::ClearS3ObjListHasLock()
 {
-    s3obj     = S3ObjList();    // Hope using default move assignment operator
-    has_s3obj = false;
+    s3obj           = S3ObjList();    // Hope using default move assignment operator
+    has_s3obj       = false;
+    is_s3obj_intact = false;
     return true;
 }
 
+bool DirStatCache::ResetS3ObjListHasLock()
+{
+    std::lock_guard<std::mutex> dircachelock(dir_cache_lock);
+    return ClearS3ObjListHasLock();
+}
+
 bool DirStatCache::RemoveChildHasLock(const std::string& strpath)
 {
     if(strpath.empty()){
@@ -955,7 +1084,8 @@ bool DirStatCache::RemoveChildHasLock(const std::string& strpath)
                 children.erase(iter);
             }else{
                 // if it is a directory type, first clear the data.
-                if(!iter->second->UpdateHasLock(nullptr, nullptr, true) || !iter->second->UpdateHasLock(false) || !iter->second->UpdateHasLock()){
+                // (the listing is also cleared, because the directory may be re-created.)
+                if(!iter->second->UpdateHasLock(nullptr, nullptr, true) || !iter->second->UpdateHasLock(false) || !iter->second->ResetS3ObjListHasLock() || !iter->second->UpdateHasLock()){
                     result = false;
                 }
             }
@@ -972,12 +1102,54 @@ bool DirStatCache::RemoveChildInS3ObjListHasLock(const std::string& strChildLeaf
     if(!has_s3obj){
         return true;
     }
+    // [NOTE]
+    // The removed child may exist(ex. it is only removed from the cache),
+    // so the listing is no longer used for negative lookups.
+    //
+    is_s3obj_intact = false;
+
     if(!s3obj.Remove(strChildLeaf) || !UpdateHasLock()){
         return false;
     }
     return true;
 }
 
+//
+// Removes only the stat cache node of the child object.
+//
+// [NOTE]
+// Unlike RemoveChildHasLock, the child is not removed from the listing of
+// its parent directory, because the object still exists. This is used to
+// evict the immutable caches, whose directories are never expired, so the
+// evicted child would otherwise never be listed again.
+//
+bool DirStatCache::EvictChildHasLock(const std::string& strpath)
+{
+    std::string strLeafName;
+    bool        hasNestedChildren = false;
+    if(!GetChildLeafNameHasLock(strpath, strLeafName, hasNestedChildren)){
+        return false;
+    }
+
+    std::lock_guard<std::mutex> dircachelock(dir_cache_lock);
+    auto iter = children.find(strLeafName);
+    if(iter == children.cend()){
+        return false;
+    }
+    if(hasNestedChildren){
+        std::shared_ptr<DirStatCache> pDirCache = ConvertStatCacheObject<DirStatCache>(iter->second);
+        if(!pDirCache){
+            return false;
+        }
+        return pDirCache->EvictChildHasLock(strpath);
+    }
+    if(iter->second->isDirectoryHasLock()){
+        return false;
+    }
+    children.erase(iter);
+    return true;
+}
+
 bool DirStatCache::isRemovableHasLock() const
 {
     if(HasStatHasLock() || HasMetaHasLock()){
@@ -1136,6 +1308,10 @@ bool DirStatCache::AddHasLock(const std::string& strpath, const struct stat* pst
             // add as a child
             children[strLeafName] = std::move(pstatcache);
 
+            if(has_s3obj && !s3obj.HasName(strLeafName)){
+                ClearS3ObjListHasLock();        // always true
+            }
+
         }else{
             // create and add as a direct child
             std::shared_ptr<StatCacheNode> pstatcache;
@@ -1146,7 +1322,7 @@ bool DirStatCache::AddHasLock(const std::string& strpath, const struct stat* pst
             }else if(objtype_t::SYMLINK == type){
                 pstatcache = std::make_shared<SymlinkStatCache>(strpath.c_str());
             }else if(objtype_t::NEGATIVE == type){
-                if(!StatCacheNode::IsEnabledNegativeCache()){
+                if(!StatCacheNode::IsEnabledNegativeCache(strpath)){
                     // Negative cache is invalid.
                     // This method does not add it and returns true.
                     //
@@ -1231,8 +1407,9 @@ bool DirStatCache::AddS3ObjListHasLock(const std::string& strpath, const S3ObjLi
             return false;
         }
         // Set
-        s3obj     = list;
-        has_s3obj = true;
+        s3obj           = list;
+        has_s3obj       = true;
+        is_s3obj_intact = true;
 
     }else if(strpath.substr(0, GetPathHasLock().size()) != GetPathHasLock()){
         // The path does not include the path of this object.
@@ -1296,6 +1473,48 @@ bool DirStatCache::GetS3ObjListHasLock(S3ObjList& list) const
     return true;
 }
 
+//
+// Check whether the path does not exist according to the cached listing
+//
+// [NOTE]
+// If the directory of the path(or the nearest cached parent directory)
+// has the listing which is not expired, and the path is not in it, the
+// path does not exist.
+// A child object which is added to the cache later is always in the
+// listing, because adding it clears the listing if it is not in it.
+// The listing which a child has been removed from is not used, since the
+// child may still exist.
+//
+bool DirStatCache::IsNotListedHasLock(const std::string& strpath)
+{
+    // Checks whether the path of this object is included(the path itself is not checked)
+    if(strpath.size() <= GetPathHasLock().size() || strpath.compare(0, GetPathHasLock().size(), GetPathHasLock()) != 0){
+        return false;
+    }
+
+    // make key(leaf name without slash) for children map
+    std::string strLeafName;
+    bool        hasNestedChildren = false;
+    if(!GetChildLeafNameHasLock(strpath, strLeafName, hasNestedChildren)){
+        return false;
+    }
+    bool isExpired = (!GetNoTruncateHasLock() && IsExpireStatCacheTimeHasLock());
+
+    std::lock_guard<std::mutex> dircachelock(dir_cache_lock);
+    if(hasNestedChildren){
+        auto iter = children.find(strLeafName);
+        if(iter != children.cend()){
+            // search in found child
+            return iter->second->IsNotListedHasLock(strpath);
+        }
+    }
+    // If the path is under the child directory which is not listed, it does not exist either.
+    if(!has_s3obj || !is_s3obj_intact || isExpired){
+        return false;
+    }
+    return !s3obj.HasName(strLeafName);
+}
+
 std::shared_ptr<StatCacheNode> DirStatCache::FindHasLock(const std::string& strpath, const char* petagval, bool& needTruncate)
 {
     needTruncate = false;
@@ -1474,6 +1693,46 @@ bool DirStatCache::TruncateCacheHasLock()
     return isTruncated;
 }
 
+void DirStatCache::GetImmutableLeavesHasLock(statcache_leaves_t& leaves) const
+{
+    std::lock_guard<std::mutex> dircachelock(dir_cache_lock);
+    for(auto iter = children.cbegin(); iter != children.cend(); ++iter){
+        iter->second->GetImmutableLeavesHasLock(leaves);
+    }
+}
+
+//
+// Evicts the least recently used immutable caches under this directory.
+//
+// [NOTE]
+// The immutable caches are never expired, so they are not removed by
+// TruncateCache. They are removed from the oldest access time by this
+// method when the cache is still over the maximum size.
+// The directories are not evicted, their number is small compared to the
+// files. The evicted files are kept in the listing of their directory.
+//
+unsigned long DirStatCache::EvictImmutableCache(unsigned long count)
+{
+    std::lock_guard<std::mutex> lock(StatCacheNode::cache_lock);
+
+    statcache_leaves_t leaves;
+    GetImmutableLeavesHasLock(leaves);
+    if(leaves.empty() || 0 == count){
+        return 0;
+    }
+    count = std::min(count, static_cast<unsigned long>(leaves.size()));
+    std::partial_sort(leaves.begin(), leaves.begin() + static_cast<std::ptrdiff_t>(count), leaves.end(), [](const statcache_leaves_t::value_type& lhs, const statcache_leaves_t::value_type& rhs){ return (0 > CompareStatCacheTime(lhs.first, rhs.first)); });
+
+    unsigned long evicted = 0;
+    for(auto iter = leaves.cbegin(); iter != leaves.cbegin() + static_cast<std::ptrdiff_t>(count); ++iter){
+        if(EvictChildHasLock(iter->second)){
+            S3FS_PRN_DBG("Evict immutable stat cache [path=%s]", iter->second.c_str());
+            ++evicted;
+        }
+    }
+    return evicted;
+}
+
 bool DirStatCache::GetChildLeafNameHasLock(const std::string& strpath, std::string& strLeafName, bool& hasNestedChildren)
 {
     if(strpath.size() < GetPathHasLock().size()){
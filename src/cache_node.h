@@ -25,7 +25,11 @@
 #include <memory>
 #include <mutex>
 #include <optional>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "cache_policy.h"
 #include "common.h"
 #include "metaheader.h"
 #include "s3objlist.h"
@@ -51,6 +55,9 @@ constexpr int stat_counter_pos(objtype_t type)
     }
 }
 
+// pairs of the last access time and the path of the evictable caches
+using statcache_leaves_t = std::vector<std::pair<struct timespec, std::string>>;
+
 //-------------------------------------------------------------------
 // Base Class : StatCacheNode
 //-------------------------------------------------------------------
@@ -79,6 +86,7 @@ class StatCacheNode : public std::enable_shared_from_this<StatCacheNode>
         static bool             IsExpireIntervalType;                                      // if this flag is true, cache data is updated at last access time.
         static time_t           ExpireTime;
         static bool             UseNegativeCache;
+        static bool             IsImmutableCache;                                          // if this flag is true, stat cache(not negative cache) is never expired.
         static std::mutex       cache_lock;                                                // for internal data
         static unsigned long    DisableCheckingExpire GUARDED_BY(cache_lock);              // If greater than 0, it disables the expiration check, which allows disabling checks during processing.
         static struct timespec  DisableExpireDate GUARDED_BY(cache_lock);                  // Data registered after this time will not be truncated(if 0 < DisableCheckingExpire)
@@ -88,13 +96,17 @@ class StatCacheNode : public std::enable_shared_from_this<StatCacheNode>
         std::string             fullpath   GUARDED_BY(StatCacheNode::cache_lock);          // full path(This value is set only when the object is created)
         unsigned long           hit_count  GUARDED_BY(StatCacheNode::cache_lock) = 0L;     // hit count
         struct timespec         cache_date GUARDED_BY(StatCacheNode::cache_lock) = {0, 0}; // registration/renewal time
+        struct timespec         access_date GUARDED_BY(StatCacheNode::cache_lock) = {0, 0};// last access time(for evicting immutable caches)
         bool                    notruncate GUARDED_BY(StatCacheNode::cache_lock) = false;  // If true, not remove automatically at checking truncate.
         bool                    has_stat   GUARDED_BY(StatCacheNode::cache_lock) = false;  // valid stat information flag (for case only path registration and no stat information)
         struct stat             stbuf      GUARDED_BY(StatCacheNode::cache_lock) = {};     // stat data
         bool                    has_meta   GUARDED_BY(StatCacheNode::cache_lock) = false;  // valid meta headers information flag (for case only path registration and no meta headers)
         headers_t               meta       GUARDED_BY(StatCacheNode::cache_lock);          // meta list
+        bool                    listed     GUARDED_BY(StatCacheNode::cache_lock) = false;  // stat is made from ListObjects data, meta has only ETag(not full meta headers)
         bool                    has_extval GUARDED_BY(StatCacheNode::cache_lock) = false;  // valid extra value flag
         std::string             extvalue   GUARDED_BY(StatCacheNode::cache_lock);          // extra value for key(ex. used for symlink)
+        mutable bool            is_policy_resolved GUARDED_BY(StatCacheNode::cache_lock) = false;          // ppolicy is looked up(see. GetPolicyHasLock)
+        mutable const stat_cache_policy* ppolicy   GUARDED_BY(StatCacheNode::cache_lock) = nullptr;        // rule in stat_cache_policy_file(nullptr means no rule)
 
     protected:
         static void IncrementCacheCount(objtype_t type);
@@ -113,6 +125,7 @@ class StatCacheNode : public std::enable_shared_from_this<StatCacheNode>
         virtual bool ClearDataHasLock() REQUIRES(StatCacheNode::cache_lock);
         virtual bool ClearHasLock() REQUIRES(StatCacheNode::cache_lock);
         virtual bool RemoveChildHasLock(const std::string& strpath) REQUIRES(StatCacheNode::cache_lock);
+        virtual bool ResetS3ObjListHasLock() REQUIRES(StatCacheNode::cache_lock);
         virtual bool isRemovableHasLock() const REQUIRES(StatCacheNode::cache_lock);
 
         // Add
@@ -133,6 +146,7 @@ class StatCacheNode : public std::enable_shared_from_this<StatCacheNode>
         const std::string& GetPathHasLock() const REQUIRES(StatCacheNode::cache_lock);
         bool HasStatHasLock() const REQUIRES(StatCacheNode::cache_lock);
         bool HasMetaHasLock() const REQUIRES(StatCacheNode::cache_lock);
+        bool IsListedHasLock() const REQUIRES(StatCacheNode::cache_lock);
         bool GetNoTruncateHasLock() const REQUIRES(StatCacheNode::cache_lock);
         virtual bool GetHasLock(headers_t* pmeta, struct stat* pst) REQUIRES(StatCacheNode::cache_lock);
         virtual std::optional<std::string> GetExtraHasLock() REQUIRES(StatCacheNode::cache_lock);
@@ -142,8 +156,12 @@ class StatCacheNode : public std::enable_shared_from_this<StatCacheNode>
         // Find
         virtual bool CheckETagValueHasLock(const char* petagval) const REQUIRES(StatCacheNode::cache_lock);
         virtual std::shared_ptr<StatCacheNode> FindHasLock(const std::string& strpath, const char* petagval, bool& needTruncate) REQUIRES(StatCacheNode::cache_lock);
+        virtual bool IsNotListedHasLock(const std::string& strpath) REQUIRES(StatCacheNode::cache_lock);
 
         // Cache out
+        const stat_cache_policy* GetPolicyHasLock() const REQUIRES(StatCacheNode::cache_lock);
+        bool IsImmutableHasLock() const REQUIRES(StatCacheNode::cache_lock);
+        virtual void GetImmutableLeavesHasLock(statcache_leaves_t& leaves) const REQUIRES(StatCacheNode::cache_lock);
         bool IsExpireStatCacheTimeHasLock() const REQUIRES(StatCacheNode::cache_lock);
         virtual bool IsExpiredHasLock() const REQUIRES(StatCacheNode::cache_lock);
         virtual bool TruncateCacheHasLock() REQUIRES(StatCacheNode::cache_lock);
@@ -162,6 +180,9 @@ class StatCacheNode : public std::enable_shared_from_this<StatCacheNode>
         static bool EnableNegativeCache() { return SetNegativeCache(true); }
         static bool DisableNegativeCache() { return SetNegativeCache(false); }
         static bool IsEnabledNegativeCache() { return UseNegativeCache; }
+        static bool IsEnabledNegativeCache(const std::string& strpath);
+        static bool SetImmutable(bool flag);
+        static bool IsImmutable() { return IsImmutableCache; }
         static bool PreventExpireCheck();
         static bool ResumeExpireCheck();
 
@@ -197,6 +218,7 @@ class StatCacheNode : public std::enable_shared_from_this<StatCacheNode>
         bool Update(bool is_notruncate);
         bool Update(const std::string& extvalue);
         bool Set(const struct stat& stbuf, const headers_t& meta, bool is_notruncate);
+        bool SetListed(bool is_listed);
 
         // Get
         std::string Get() const;
@@ -205,6 +227,7 @@ class StatCacheNode : public std::enable_shared_from_this<StatCacheNode>
         bool Get(headers_t& get_meta);
         bool Get(struct stat& st);
         objtype_t GetType() const;
+        bool IsListed() const;
         struct timespec GetDate() const;
         unsigned long GetHitCount() const;
         unsigned long IncrementHitCount();
@@ -214,6 +237,7 @@ class StatCacheNode : public std::enable_shared_from_this<StatCacheNode>
 
         // Find
         std::shared_ptr<StatCacheNode> Find(const std::string& strpath, const char* petagval = nullptr);
+        bool IsNotListed(const std::string& strpath);
 
         // Cache out
         bool IsExpired() const;
@@ -259,13 +283,16 @@ class DirStatCache : public StatCacheNode
         objtype_t       dir_cache_type  GUARDED_BY(dir_cache_lock) = objtype_t::UNKNOWN;    // [NOTE] backup for use in destructors only
         statcache_map_t children        GUARDED_BY(dir_cache_lock);
         bool            has_s3obj       GUARDED_BY(dir_cache_lock) = false;
+        bool            is_s3obj_intact GUARDED_BY(dir_cache_lock) = false;    // no child has been removed from s3obj since it was set
         S3ObjList       s3obj           GUARDED_BY(dir_cache_lock);
 
     protected:
         bool ClearHasLock() override REQUIRES(StatCacheNode::cache_lock);
         bool ClearS3ObjListHasLock() REQUIRES(dir_cache_lock);
         bool RemoveChildHasLock(const std::string& strpath) override REQUIRES(StatCacheNode::cache_lock);
+        bool ResetS3ObjListHasLock() override REQUIRES(StatCacheNode::cache_lock);
         bool RemoveChildInS3ObjListHasLock(const std::string& strChildLeaf) REQUIRES(StatCacheNode::cache_lock, dir_cache_lock);
+        bool EvictChildHasLock(const std::string& strpath) REQUIRES(StatCacheNode::cache_lock);
         bool isRemovableHasLock() const override REQUIRES(StatCacheNode::cache_lock);
         bool HasExistedChildHasLock() const REQUIRES(StatCacheNode::cache_lock, dir_cache_lock);
 
@@ -276,11 +303,13 @@ class DirStatCache : public StatCacheNode
         bool GetS3ObjListHasLock(S3ObjList& list) const override REQUIRES(StatCacheNode::cache_lock);
 
         std::shared_ptr<StatCacheNode> FindHasLock(const std::string& strpath, const char* petagval, bool& needTruncate) override REQUIRES(StatCacheNode::cache_lock);
+        bool IsNotListedHasLock(const std::string& strpath) override REQUIRES(StatCacheNode::cache_lock);
 
         bool NeedTruncateProcessing() const;
         bool IsExpiredHasLock() const override REQUIRES(StatCacheNode::cache_lock);
 
         bool TruncateCacheHasLock() override REQUIRES(StatCacheNode::cache_lock);
+        void GetImmutableLeavesHasLock(statcache_leaves_t& leaves) const override REQUIRES(StatCacheNode::cache_lock);
 
         bool GetChildLeafNameHasLock(const std::string& strpath, std::string& strLeafName, bool& hasNestedChildren) REQUIRES(StatCacheNode::cache_lock);
 
@@ -294,6 +323,8 @@ class DirStatCache : public StatCacheNode
         DirStatCache(DirStatCache&&) = delete;
         DirStatCache& operator=(const DirStatCache&) = delete;
         DirStatCache& operator=(DirStatCache&&) = delete;
+
+        unsigned long EvictImmutableCache(unsigned long count);
 };
 
 //-------------------------------------------------------------------
@@ -0,0 +1,281 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <fnmatch.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <strings.h>
+#include <utility>
+
+#include "cache_policy.h"
+#include "s3fs_logger.h"
+#include "string_util.h"
+
+//-------------------------------------------------------------------
+// Utility functions
+//-------------------------------------------------------------------
+static bool is_glob_component(const std::string& component)
+{
+    return (std::string::npos != component.find_first_of("*?["));
+}
+
+static std::vector<std::string> split_path_components(const std::string& path)
+{
+    std::vector<std::string> components;
+    std::string::size_type   start = 0;
+    while(start < path.size()){
+        std::string::size_type pos = path.find('/', start);
+        if(std::string::npos == pos){
+            pos = path.size();
+        }
+        if(start < pos){
+            components.push_back(path.substr(start, pos - start));
+        }
+        start = pos + 1;
+    }
+    return components;
+}
+
+static bool parse_policy_option(const std::string& option, stat_cache_policy& policy)
+{
+    if(0 == strcasecmp(option.c_str(), "immutable")){
+        policy.immutable = true;
+    }else if(is_prefix(option.c_str(), "expire=")){
+        off_t expire = 0;
+        if(!s3fs_strtoofft(&expire, option.c_str() + strlen("expire="), /*base=*/ 10) || expire < 0){
+            S3FS_PRN_ERR("file format error: %s has wrong expire value(%s).", policy.pattern.c_str(), option.c_str());
+            return false;
+        }
+        policy.expire = static_cast<time_t>(expire);
+    }else if(0 == strcasecmp(option.c_str(), "negative=yes")){
+        policy.negative = true;
+    }else if(0 == strcasecmp(option.c_str(), "negative=no")){
+        policy.negative = false;
+    }else{
+        S3FS_PRN_ERR("file format error: %s has unknown option(%s).", policy.pattern.c_str(), option.c_str());
+        return false;
+    }
+    return true;
+}
+
+//-------------------------------------------------------------------
+// Class StatCachePolicy method
+//-------------------------------------------------------------------
+//
+// The format of the file is as follows:
+//
+//   # <path prefix or glob>   <options(separated by spaces or commas)>
+//   /releases                 immutable
+//   /data/dt=*                expire=86400,negative=no
+//   /data/hot                 expire=5
+//
+bool StatCachePolicy::Load(const char* file)
+{
+    if(!file){
+        S3FS_PRN_WARN("file is nullptr.");
+        return false;
+    }
+    Unload();
+
+    std::ifstream PF(file);
+    if(!PF.good()){
+        S3FS_PRN_WARN("Could not open file(%s).", file);
+        return false;
+    }
+
+    // read file
+    std::string line;
+    while(getline(PF, line)){
+        line = trim(line);
+        if(line.empty()){
+            continue;
+        }
+        if('#' == line[0]){
+            continue;
+        }
+
+        // load a line
+        std::istringstream ss(line);
+        auto               ppolicy = std::make_unique<stat_cache_policy>();
+        ss >> ppolicy->pattern;
+        if('/' != ppolicy->pattern[0]){
+            S3FS_PRN_ERR("file format error: %s is not started with '/'.", ppolicy->pattern.c_str());
+            Unload();
+            return false;
+        }
+
+        std::string options;
+        bool        has_option = false;
+        while(ss >> options){
+            std::istringstream optss(options);
+            std::string        option;
+            while(getline(optss, option, ',')){
+                if(option.empty()){
+                    continue;
+                }
+                if(!parse_policy_option(option, *ppolicy)){
+                    Unload();
+                    return false;
+                }
+                has_option = true;
+            }
+        }
+        if(!has_option){
+            S3FS_PRN_ERR("file format error: %s does not have any option.", ppolicy->pattern.c_str());
+            Unload();
+            return false;
+        }
+
+        if(!AddPolicy(std::move(ppolicy))){
+            Unload();
+            return false;
+        }
+    }
+    return true;
+}
+
+void StatCachePolicy::Unload()
+{
+    root.literals.clear();
+    root.globs.clear();
+    root.ppolicy = nullptr;
+
+    policies.clear();
+}
+
+bool StatCachePolicy::AddPolicy(std::unique_ptr<stat_cache_policy> ppolicy)
+{
+    policy_node* pnode = &root;
+    for(const auto& component: split_path_components(ppolicy->pattern)){
+        if(is_glob_component(component)){
+            auto iter = pnode->globs.begin();
+            for(; iter != pnode->globs.end(); ++iter){
+                if(iter->first == component){
+                    break;
+                }
+            }
+            if(iter == pnode->globs.end()){
+                pnode->globs.emplace_back(component, std::make_unique<policy_node>());
+                pnode = pnode->globs.back().second.get();
+            }else{
+                pnode = iter->second.get();
+            }
+        }else{
+            auto& pchild = pnode->literals[component];
+            if(!pchild){
+                pchild = std::make_unique<policy_node>();
+            }
+            pnode = pchild.get();
+        }
+    }
+    if(pnode->ppolicy){
+        S3FS_PRN_ERR("file format error: %s is specified more than once.", ppolicy->pattern.c_str());
+        return false;
+    }
+    pnode->ppolicy = ppolicy.get();
+    policies.push_back(std::move(ppolicy));
+
+    return true;
+}
+
+//
+// Returns the deepest node which has a policy, and its depth.
+//
+const StatCachePolicy::policy_node* StatCachePolicy::FindNode(const policy_node* pnode, const std::vector<std::string>& components, size_t pos, size_t& depth)
+{
+    const policy_node* pfound = nullptr;
+    if(pnode->ppolicy){
+        pfound = pnode;
+        depth  = pos;
+    }
+    if(components.size() <= pos){
+        return pfound;
+    }
+
+    // literal component takes precedence at same depth
+    size_t subdepth = 0;
+    auto   iter     = pnode->literals.find(components[pos]);
+    if(iter != pnode->literals.cend()){
+        const policy_node* psub = FindNode(iter->second.get(), components, pos + 1, subdepth);
+        if(psub && (!pfound || depth < subdepth)){
+            pfound = psub;
+            depth  = subdepth;
+        }
+    }
+    for(const auto& glob: pnode->globs){
+        if(0 != fnmatch(glob.first.c_str(), components[pos].c_str(), 0)){
+            continue;
+        }
+        const policy_node* psub = FindNode(glob.second.get(), components, pos + 1, subdepth);
+        if(psub && (!pfound || depth < subdepth)){
+            pfound = psub;
+            depth  = subdepth;
+        }
+    }
+    return pfound;
+}
+
+const stat_cache_policy* StatCachePolicy::Find(const std::string& path) const
+{
+    if(policies.empty()){
+        return nullptr;
+    }
+    size_t             depth = 0;
+    const policy_node* pnode = FindNode(&root, split_path_components(path), 0, depth);
+
+    return (pnode ? pnode->ppolicy : nullptr);
+}
+
+void StatCachePolicy::Dump() const
+{
+    if(!S3fsLog::IsS3fsLogDbg()){
+        return;
+    }
+    std::ostringstream ssdbg;
+    ssdbg << "Stat cache policies(" << policies.size() << ") {";
+    for(const auto& ppolicy: policies){
+        ssdbg << std::endl << "  {pattern=" << ppolicy->pattern;
+        if(ppolicy->expire){
+            ssdbg << ", expire=" << *ppolicy->expire;
+        }
+        if(ppolicy->negative){
+            ssdbg << ", negative=" << (*ppolicy->negative ? "yes" : "no");
+        }
+        if(ppolicy->immutable){
+            ssdbg << ", immutable";
+        }
+        ssdbg << "}";
+    }
+    ssdbg << std::endl << "}";
+
+    S3FS_PRN_DBG("%s", ssdbg.str().c_str());
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -0,0 +1,110 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef S3FS_CACHE_POLICY_H_
+#define S3FS_CACHE_POLICY_H_
+
+#include <ctime>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+//----------------------------------------------
+// Structure / Typedef
+//----------------------------------------------
+struct stat_cache_policy
+{
+    std::string           pattern;                // path prefix or glob(for display)
+    std::optional<time_t> expire;                 // nullopt means using stat_cache_expire
+    std::optional<bool>   negative;               // nullopt means using enable/disable_negative_cache
+    bool                  immutable = false;      // if true, the stat cache(not negative cache) is never expired
+};
+
+//----------------------------------------------
+// Class StatCachePolicy
+//----------------------------------------------
+// This class loads the rules from the file specified by the
+// stat_cache_policy_file option, and looks up the rule for a path.
+//
+// The rules are stored in a tree of path components, so the lookup
+// costs only the depth of the path and not the number of the rules.
+// Each component of the rule path can be a glob pattern(fnmatch), and
+// a rule is applied to the path and all paths under it. If multiple
+// rules match, the deepest one is used, and a literal component takes
+// precedence over a glob component at the same depth.
+//
+// [NOTE]
+// The rules are loaded only while parsing options, so the lookup does
+// not need any locking.
+//
+class StatCachePolicy
+{
+    private:
+        struct policy_node
+        {
+            std::map<std::string, std::unique_ptr<policy_node>>              literals;
+            std::vector<std::pair<std::string, std::unique_ptr<policy_node>>> globs;
+            const stat_cache_policy*                                         ppolicy = nullptr;
+        };
+
+        std::vector<std::unique_ptr<stat_cache_policy>> policies;
+        policy_node                                     root;
+
+    protected:
+        StatCachePolicy() = default;
+        ~StatCachePolicy() = default;
+
+        static const policy_node* FindNode(const policy_node* pnode, const std::vector<std::string>& components, size_t pos, size_t& depth);
+        bool AddPolicy(std::unique_ptr<stat_cache_policy> ppolicy);
+
+    public:
+        StatCachePolicy(const StatCachePolicy&) = delete;
+        StatCachePolicy(StatCachePolicy&&) = delete;
+        StatCachePolicy& operator=(const StatCachePolicy&) = delete;
+        StatCachePolicy& operator=(StatCachePolicy&&) = delete;
+
+        // Reference singleton
+        static StatCachePolicy* get()
+        {
+            static StatCachePolicy singleton;
+            return &singleton;
+        }
+
+        bool Load(const char* file);
+        void Unload();
+
+        bool IsEmpty() const { return policies.empty(); }
+        const stat_cache_policy* Find(const std::string& path) const;
+        void Dump() const;
+};
+
+#endif // S3FS_CACHE_POLICY_H_
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
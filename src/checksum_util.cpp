@@ -0,0 +1,399 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <array>
+#include <cstring>
+#include <strings.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define S3FS_CRC_X86_64 1
+#include <immintrin.h>
+#endif
+
+#include "checksum_util.h"
+#include "s3fs_auth.h"
+#include "string_util.h"
+
+//-------------------------------------------------------------------
+// Symbols
+//-------------------------------------------------------------------
+static constexpr uint32_t CRC32C_POLY_REFLECTED    = 0x82F63B78U;
+static constexpr uint64_t CRC64NVME_POLY           = 0xAD93D23594C93659ULL;
+static constexpr uint64_t CRC64NVME_POLY_REFLECTED = 0x9A6C9329AC4BC9B5ULL;
+
+//-------------------------------------------------------------------
+// Portable implementations(slicing-by-8)
+//-------------------------------------------------------------------
+template<typename T>
+struct crc_tables
+{
+    std::array<std::array<T, 256>, 8> table;
+
+    explicit crc_tables(T poly_reflected)
+    {
+        for(size_t cnt = 0; cnt < 256; ++cnt){
+            T crc = static_cast<T>(cnt);
+            for(int bit = 0; bit < 8; ++bit){
+                crc = (crc & 1) ? ((crc >> 1) ^ poly_reflected) : (crc >> 1);
+            }
+            table[0][cnt] = crc;
+        }
+        for(size_t cnt = 0; cnt < 256; ++cnt){
+            for(size_t slice = 1; slice < table.size(); ++slice){
+                T prev             = table[slice - 1][cnt];
+                table[slice][cnt]  = (prev >> 8) ^ table[0][prev & 0xff];
+            }
+        }
+    }
+};
+
+static const crc_tables<uint32_t>& get_crc32c_tables()
+{
+    static const crc_tables<uint32_t> tables(CRC32C_POLY_REFLECTED);
+    return tables;
+}
+
+static const crc_tables<uint64_t>& get_crc64nvme_tables()
+{
+    static const crc_tables<uint64_t> tables(CRC64NVME_POLY_REFLECTED);
+    return tables;
+}
+
+//
+// Processes the data with the register value(not inverted).
+//
+template<typename T>
+static T crc_update_sw(const crc_tables<T>& tables, T crc, const unsigned char* data, size_t length)
+{
+    const auto& table = tables.table;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    for(; 8 <= length; data += 8, length -= 8){
+        uint64_t value;
+        memcpy(&value, data, sizeof(value));
+        value ^= crc;
+        crc = table[7][value & 0xff]         ^ table[6][(value >> 8) & 0xff]  ^
+              table[5][(value >> 16) & 0xff] ^ table[4][(value >> 24) & 0xff] ^
+              table[3][(value >> 32) & 0xff] ^ table[2][(value >> 40) & 0xff] ^
+              table[1][(value >> 48) & 0xff] ^ table[0][value >> 56];
+    }
+#endif
+    for(; 0 < length; ++data, --length){
+        crc = table[0][(crc ^ *data) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+uint32_t s3fs_crc32c_sw(uint32_t crc, const unsigned char* data, size_t length)
+{
+    return ~crc_update_sw<uint32_t>(get_crc32c_tables(), ~crc, data, length);
+}
+
+uint64_t s3fs_crc64nvme_sw(uint64_t crc, const unsigned char* data, size_t length)
+{
+    return ~crc_update_sw<uint64_t>(get_crc64nvme_tables(), ~crc, data, length);
+}
+
+//-------------------------------------------------------------------
+// x86_64 implementations
+//-------------------------------------------------------------------
+#ifdef S3FS_CRC_X86_64
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const unsigned char* data, size_t length)
+{
+    uint64_t value = ~crc & 0xFFFFFFFFU;
+
+    for(; 0 < length && 0 != (reinterpret_cast<uintptr_t>(data) & 7); ++data, --length){
+        value = _mm_crc32_u8(static_cast<uint32_t>(value), *data);
+    }
+    for(; 8 <= length; data += 8, length -= 8){
+        uint64_t block;
+        memcpy(&block, data, sizeof(block));
+        value = _mm_crc32_u64(value, block);
+    }
+    for(; 0 < length; ++data, --length){
+        value = _mm_crc32_u8(static_cast<uint32_t>(value), *data);
+    }
+    return ~static_cast<uint32_t>(value);
+}
+
+//
+// [NOTE]
+// The CRC64 is computed by folding the 128 bits accumulators with the
+// carry-less multiplication. For the folding distance d bits, the upper
+// half(H) and lower half(L) of the polynomial are multiplied by
+// x^(64+d) mod P and x^d mod P. Because the product of the bit reflected
+// values is shifted by one bit, the constants are x^(63+d) and x^(d-1)
+// in the reflected order.
+// The last 128 bits are reduced by the table.
+//
+static uint64_t crc64nvme_xpow_reflected(unsigned int exponent)
+{
+    uint64_t value = 1;
+    for(unsigned int cnt = 0; cnt < exponent; ++cnt){
+        bool carry = 0 != (value >> 63);
+        value <<= 1;
+        if(carry){
+            value ^= CRC64NVME_POLY;
+        }
+    }
+    uint64_t reflected = 0;
+    for(int bit = 0; bit < 64; ++bit){
+        if(0 != (value & (1ULL << bit))){
+            reflected |= 1ULL << (63 - bit);
+        }
+    }
+    return reflected;
+}
+
+struct crc64nvme_fold_keys
+{
+    uint64_t k128_hi;
+    uint64_t k128_lo;
+    uint64_t k512_hi;
+    uint64_t k512_lo;
+
+    crc64nvme_fold_keys() :
+        k128_hi(crc64nvme_xpow_reflected(63 + 128)), k128_lo(crc64nvme_xpow_reflected(128 - 1)),
+        k512_hi(crc64nvme_xpow_reflected(63 + 512)), k512_lo(crc64nvme_xpow_reflected(512 - 1))
+    {
+    }
+};
+
+__attribute__((target("pclmul,sse2")))
+static inline __m128i crc64nvme_fold(__m128i acc, __m128i keys, __m128i next)
+{
+    __m128i hi = _mm_clmulepi64_si128(acc, keys, 0x00);
+    __m128i lo = _mm_clmulepi64_si128(acc, keys, 0x11);
+    return _mm_xor_si128(_mm_xor_si128(hi, lo), next);
+}
+
+__attribute__((target("pclmul,sse2")))
+static uint64_t crc64nvme_pclmul(uint64_t crc, const unsigned char* data, size_t length)
+{
+    static const crc64nvme_fold_keys keys;
+
+    uint64_t value = ~crc;
+    if(64 <= length){
+        const __m128i keys128 = _mm_set_epi64x(static_cast<long long>(keys.k128_lo), static_cast<long long>(keys.k128_hi));
+        const __m128i keys512 = _mm_set_epi64x(static_cast<long long>(keys.k512_lo), static_cast<long long>(keys.k512_hi));
+
+        __m128i acc0 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)), _mm_set_epi64x(0, static_cast<long long>(value)));
+        __m128i acc1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16));
+        __m128i acc2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 32));
+        __m128i acc3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 48));
+        data   += 64;
+        length -= 64;
+
+        for(; 64 <= length; data += 64, length -= 64){
+            acc0 = crc64nvme_fold(acc0, keys512, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)));
+            acc1 = crc64nvme_fold(acc1, keys512, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16)));
+            acc2 = crc64nvme_fold(acc2, keys512, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 32)));
+            acc3 = crc64nvme_fold(acc3, keys512, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 48)));
+        }
+        acc1 = crc64nvme_fold(acc0, keys128, acc1);
+        acc2 = crc64nvme_fold(acc1, keys128, acc2);
+        acc3 = crc64nvme_fold(acc2, keys128, acc3);
+
+        for(; 16 <= length; data += 16, length -= 16){
+            acc3 = crc64nvme_fold(acc3, keys128, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)));
+        }
+
+        unsigned char rest[16];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rest), acc3);
+        value = crc_update_sw<uint64_t>(get_crc64nvme_tables(), 0, rest, sizeof(rest));
+    }
+    return ~crc_update_sw<uint64_t>(get_crc64nvme_tables(), value, data, length);
+}
+
+#endif // S3FS_CRC_X86_64
+
+//-------------------------------------------------------------------
+// Dispatch
+//-------------------------------------------------------------------
+using crc32c_func_t    = uint32_t (*)(uint32_t, const unsigned char*, size_t);
+using crc64nvme_func_t = uint64_t (*)(uint64_t, const unsigned char*, size_t);
+
+static crc32c_func_t select_crc32c()
+{
+#ifdef S3FS_CRC_X86_64
+    if(__builtin_cpu_supports("sse4.2")){
+        return crc32c_sse42;
+    }
+#endif
+    return s3fs_crc32c_sw;
+}
+
+static crc64nvme_func_t select_crc64nvme()
+{
+#ifdef S3FS_CRC_X86_64
+    if(__builtin_cpu_supports("pclmul")){
+        return crc64nvme_pclmul;
+    }
+#endif
+    return s3fs_crc64nvme_sw;
+}
+
+uint32_t s3fs_crc32c(uint32_t crc, const unsigned char* data, size_t length)
+{
+    static const crc32c_func_t func = select_crc32c();
+    return func(crc, data, length);
+}
+
+uint64_t s3fs_crc64nvme(uint64_t crc, const unsigned char* data, size_t length)
+{
+    static const crc64nvme_func_t func = select_crc64nvme();
+    return func(crc, data, length);
+}
+
+const char* s3fs_crc_impl_name()
+{
+#ifdef S3FS_CRC_X86_64
+    bool is_sse42  = __builtin_cpu_supports("sse4.2");
+    bool is_pclmul = __builtin_cpu_supports("pclmul");
+    if(is_sse42 && is_pclmul){
+        return "crc32c:sse4.2, crc64nvme:pclmul";
+    }else if(is_sse42){
+        return "crc32c:sse4.2, crc64nvme:table";
+    }else if(is_pclmul){
+        return "crc32c:table, crc64nvme:pclmul";
+    }
+#endif
+    return "crc32c:table, crc64nvme:table";
+}
+
+//-------------------------------------------------------------------
+// Utility functions
+//-------------------------------------------------------------------
+bool parse_checksum_type(const char* value, checksum_type_t& type)
+{
+    if(!value){
+        return false;
+    }
+    if(0 == strcasecmp(value, "crc32c")){
+        type = checksum_type_t::CRC32C;
+    }else if(0 == strcasecmp(value, "crc64nvme")){
+        type = checksum_type_t::CRC64NVME;
+    }else if(0 == strcasecmp(value, "none")){
+        type = checksum_type_t::NONE;
+    }else{
+        return false;
+    }
+    return true;
+}
+
+const char* get_checksum_algorithm(checksum_type_t type)
+{
+    switch(type){
+        case checksum_type_t::CRC32C:
+            return "CRC32C";
+        case checksum_type_t::CRC64NVME:
+            return "CRC64NVME";
+        case checksum_type_t::NONE:
+            break;
+    }
+    return "";
+}
+
+std::string get_checksum_header_name(checksum_type_t type)
+{
+    if(checksum_type_t::NONE == type){
+        return "";
+    }
+    return "x-amz-checksum-" + lower(get_checksum_algorithm(type));
+}
+
+std::string get_checksum_xml_tag(checksum_type_t type)
+{
+    if(checksum_type_t::NONE == type){
+        return "";
+    }
+    return std::string("Checksum") + get_checksum_algorithm(type);
+}
+
+//
+// Finds the full object checksum of the supported algorithms in the response
+// headers. The checksum of the multipart object which is not full object type
+// has "-<part count>" suffix, it is not the checksum of the object data.
+//
+checksum_type_t find_checksum_header(const headers_t& headers, std::string& value)
+{
+    for(checksum_type_t type : {checksum_type_t::CRC64NVME, checksum_type_t::CRC32C}){
+        auto iter = headers.find(get_checksum_header_name(type));
+        if(iter == headers.cend() || iter->second.empty() || std::string::npos != iter->second.find('-')){
+            continue;
+        }
+        value = iter->second;
+        return type;
+    }
+    return checksum_type_t::NONE;
+}
+
+//-------------------------------------------------------------------
+// Class ChecksumCalculator
+//-------------------------------------------------------------------
+void ChecksumCalculator::Update(const unsigned char* data, size_t length)
+{
+    if(checksum_type_t::CRC32C == type){
+        crc = s3fs_crc32c(static_cast<uint32_t>(crc), data, length);
+    }else if(checksum_type_t::CRC64NVME == type){
+        crc = s3fs_crc64nvme(crc, data, length);
+    }
+}
+
+std::string ChecksumCalculator::GetBase64() const
+{
+    size_t length;
+    if(checksum_type_t::CRC32C == type){
+        length = 4;
+    }else if(checksum_type_t::CRC64NVME == type){
+        length = 8;
+    }else{
+        return "";
+    }
+
+    // big endian
+    unsigned char bytes[8];
+    for(size_t pos = 0; pos < length; ++pos){
+        bytes[pos] = static_cast<unsigned char>(crc >> (8 * (length - 1 - pos)));
+    }
+    return s3fs_base64(bytes, length);
+}
+
+bool s3fs_checksum_fd(checksum_type_t type, int fd, off_t start, off_t size, std::string& base64)
+{
+    ChecksumCalculator calculator;
+    calculator.Reset(type);
+    if(!s3fs_read_fd_blocks(fd, start, size, [&](const unsigned char* data, size_t length){ calculator.Update(data, length); return true; })){
+        return false;
+    }
+    base64 = calculator.GetBase64();
+    return true;
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -0,0 +1,95 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef S3FS_CHECKSUM_UTIL_H_
+#define S3FS_CHECKSUM_UTIL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+
+#include "metaheader.h"
+
+//----------------------------------------------
+// Typedefs
+//----------------------------------------------
+//
+// The additional checksum algorithms(x-amz-checksum-*)
+//
+enum class checksum_type_t : uint8_t {
+    NONE = 0,
+    CRC32C,
+    CRC64NVME
+};
+
+//----------------------------------------------
+// Functions
+//----------------------------------------------
+//
+// The crc argument is the result of the previous call(0 for the first call)
+// as same as crc32 of zlib.
+//
+uint32_t s3fs_crc32c(uint32_t crc, const unsigned char* data, size_t length);
+uint64_t s3fs_crc64nvme(uint64_t crc, const unsigned char* data, size_t length);
+
+// portable implementations(for test)
+uint32_t s3fs_crc32c_sw(uint32_t crc, const unsigned char* data, size_t length);
+uint64_t s3fs_crc64nvme_sw(uint64_t crc, const unsigned char* data, size_t length);
+
+const char* s3fs_crc_impl_name();
+
+bool parse_checksum_type(const char* value, checksum_type_t& type);
+const char* get_checksum_algorithm(checksum_type_t type);
+std::string get_checksum_header_name(checksum_type_t type);
+std::string get_checksum_xml_tag(checksum_type_t type);
+checksum_type_t find_checksum_header(const headers_t& headers, std::string& value);
+
+//----------------------------------------------
+// class ChecksumCalculator
+//----------------------------------------------
+// Computes the additional checksum incrementally, the value is base64 of
+// the big endian CRC as same as x-amz-checksum-* headers.
+//
+class ChecksumCalculator
+{
+    private:
+        checksum_type_t type = checksum_type_t::NONE;
+        uint64_t        crc  = 0;
+
+    public:
+        void Reset(checksum_type_t newtype) { type = newtype; crc = 0; }
+        checksum_type_t GetType() const { return type; }
+        void Update(const unsigned char* data, size_t length);
+        std::string GetBase64() const;
+};
+
+bool s3fs_checksum_fd(checksum_type_t type, int fd, off_t start, off_t size, std::string& base64);
+
+#endif // S3FS_CHECKSUM_UTIL_H_
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -18,9 +18,15 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <algorithm>
+#include <cerrno>
+#include <memory>
 #include <string>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "s3fs_auth.h"
+#include "s3fs_logger.h"
 #include "string_util.h"
 
 //-------------------------------------------------------------------
@@ -36,6 +42,56 @@ std::string s3fs_get_content_md5(int fd)
     return s3fs_base64(md5.data(), md5.size());
 }
 
+//
+// Reads the range of the file by large blocks and passes each block to func.
+// If size is -1, the whole file is read.
+//
+// [NOTE]
+// The digests of a part are updated by the same block in one pass, so the
+// part is read only once with a few system calls.
+//
+bool s3fs_read_fd_blocks(int fd, off_t start, off_t size, const digest_update_func& func)
+{
+    if(-1 == fd){
+        S3FS_PRN_DBG("invalid file descriptor");
+        return false;
+    }
+    if(-1 == size){
+        struct stat st;
+        if(-1 == fstat(fd, &st)){
+            S3FS_PRN_ERR("fstat error(%d)", errno);
+            return false;
+        }
+        size = st.st_size;
+    }
+    if(size <= 0){
+        return true;
+    }
+
+    size_t                           bufsize = static_cast<size_t>(std::min(size, static_cast<off_t>(DIGEST_READ_SIZE)));
+    std::unique_ptr<unsigned char[]> buf(new unsigned char[bufsize]);
+
+    ssize_t bytes;
+    for(off_t total = 0; total < size; total += bytes){
+        bytes = pread(fd, buf.get(), static_cast<size_t>(std::min(static_cast<off_t>(bufsize), (size - total))), start + total);
+        if(0 == bytes){
+            // end of file
+            break;
+        }else if(-1 == bytes){
+            if(EINTR == errno){
+                bytes = 0;
+                continue;
+            }
+            S3FS_PRN_ERR("file read error(%d)", errno);
+            return false;
+        }
+        if(!func(buf.get(), static_cast<size_t>(bytes))){
+            return false;
+        }
+    }
+    return true;
+}
+
 std::string s3fs_sha256_hex_fd(int fd, off_t start, off_t size)
 {
     sha256_t sha256;
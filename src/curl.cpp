@@ -20,6 +20,7 @@
 
 #include <algorithm>
 #include <cerrno>
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
 #include <ctime>
@@ -33,13 +34,17 @@
 
 #include "common.h"
 #include "s3fs_logger.h"
+#include "adaptive_concurrency.h"
 #include "curl.h"
+#include "curl_hedge.h"
+#include "curl_ratelimit.h"
 #include "curl_share.h"
 #include "curl_util.h"
 #include "s3fs_auth.h"
 #include "s3fs_cred.h"
 #include "s3fs_util.h"
 #include "string_util.h"
+#include "threadpoolman.h"
 #include "addhead.h"
 #include "s3fs_xml.h"
 
@@ -112,6 +117,7 @@ sseckeylist_t    S3fsCurl::sseckeys;
 std::string      S3fsCurl::ssekmsid;
 sse_type_t       S3fsCurl::ssetype             = sse_type_t::SSE_DISABLE;
 bool             S3fsCurl::is_content_md5      = false;
+checksum_type_t  S3fsCurl::checksum_type       = checksum_type_t::NONE;
 bool             S3fsCurl::is_verbose          = false;
 bool             S3fsCurl::is_dump_body        = false;
 S3fsCred*        S3fsCurl::ps3fscred           = nullptr;
@@ -125,9 +131,6 @@ std::string      S3fsCurl::client_key_password;
 
 std::atomic<bool> S3fsCurl::curl_warnings_once(false);
 
-// protected by curl_handles_lock
-std::map<const CURL*, curlprogress> S3fsCurl::curl_progress;
-
 std::string      S3fsCurl::curl_ca_bundle;
 mimes_t          S3fsCurl::mimeTypes;
 std::string      S3fsCurl::userAgent;
@@ -142,6 +145,7 @@ std::string      S3fsCurl::proxy_url;
 bool             S3fsCurl::proxy_http          = false;
 std::string      S3fsCurl::proxy_userpwd;
 long             S3fsCurl::ipresolve_type      = CURL_IPRESOLVE_WHATEVER;
+bool             S3fsCurl::is_http2            = false;
 
 //-------------------------------------------------------------------
 // Class methods for S3fsCurl
@@ -204,15 +208,19 @@ bool S3fsCurl::DestroyCryptMutex()
 }
 
 // homegrown timeout mechanism
-int S3fsCurl::CurlProgress(void *clientp, double dltotal, double dlnow, double ultotal, double ulnow)
+//
+// [NOTE]
+// This is called many times per second for every transfer, and the progress
+// is only accessed by the thread which performs the request(the worker
+// thread or the thread of the curl multi handle), so no lock is needed.
+//
+int S3fsCurl::CurlProgress(void *clientp, curlprogress_t dltotal, curlprogress_t dlnow, curlprogress_t ultotal, curlprogress_t ulnow)
 {
-    CURL*      curl = static_cast<CURL*>(clientp);
-    time_t     now = time(nullptr);
-
-    const std::lock_guard<std::mutex> lock(S3fsCurl::curl_handles_lock);
+    auto*         s3fscurl = static_cast<S3fsCurl*>(clientp);
+    curlprogress& value    = s3fscurl->progress;
+    time_t        now      = time(nullptr);
 
     // any progress?
-    auto& value = S3fsCurl::curl_progress[curl];
     if(value.dl_progress != dlnow || value.ul_progress != ulnow){
         // yes!
         value = {now, dlnow, ulnow};
@@ -520,9 +528,29 @@ size_t S3fsCurl::UploadReadCallback(void* ptr, size_t size, size_t nmemb, void*
     pCurl->partdata.startpos += totalread;
     pCurl->partdata.size     -= totalread;
 
+    S3fsRateLimiter::Upload(totalread, pCurl->IsPriorityRequest());
+
     return totalread;
 }
 
+//
+// Reads the file which is set by CURLOPT_READDATA(CURLOPT_INFILE), this is
+// the same as the default read callback of libcurl except for counting the
+// upload bytes.
+//
+size_t S3fsCurl::FileReadCallback(void* ptr, size_t size, size_t nmemb, void* userp)
+{
+    auto*  file      = static_cast<FILE*>(userp);
+    size_t readbytes = fread(ptr, size, nmemb, file);
+    if(0 == readbytes && ferror(file)){
+        S3FS_PRN_ERR("read file error(%d).", errno);
+        return CURL_READFUNC_ABORT;
+    }
+    S3fsRateLimiter::Upload(readbytes * size, S3fsForeground::IsForeground());
+
+    return readbytes * size;
+}
+
 size_t S3fsCurl::DownloadWriteCallback(void* ptr, size_t size, size_t nmemb, void* userp)
 {
     auto* pCurl = static_cast<S3fsCurl*>(userp);
@@ -539,6 +567,32 @@ size_t S3fsCurl::DownloadWriteCallback(void* ptr, size_t size, size_t nmemb, voi
         pCurl->bodydata.append(static_cast<const char*>(ptr), std::min(size * nmemb, GET_OBJECT_RESPONSE_LIMIT - pCurl->bodydata.size()));
     }
 
+    // [NOTE]
+    // The body of the error response is not written to the file, because
+    // the hedged request for the same range may be writing the object data
+    // to the same area.
+    //
+    long responseCode = S3FSCURL_RESPONSECODE_NOTSET;
+    if(CURLE_OK == curl_easy_getinfo(pCurl->hCurl.get(), CURLINFO_RESPONSE_CODE, &responseCode) && (responseCode < 200 || 300 <= responseCode)){
+        return size * nmemb;
+    }
+
+    // [NOTE]
+    // The request for verifying the checksum does not have Range header,
+    // so the response is the whole object even if its size has changed.
+    // Such request is aborted here, and it is retried as the range request
+    // without verifying(see RemakeHandle).
+    //
+    if(pCurl->is_verify_checksum && pCurl->partdata.startpos == pCurl->b_partdata_startpos){
+        auto  iter   = pCurl->responseHeaders.find("Content-Length");
+        off_t length = -1;
+        if(iter != pCurl->responseHeaders.cend() && s3fs_strtoofft(&length, iter->second.c_str(), /*base=*/ 10) && length != pCurl->b_partdata_size){
+            S3FS_PRN_WARN("The size of the object(%s) has changed(%lld to %lld), so retry without verifying the checksum.", pCurl->path.c_str(), static_cast<long long>(pCurl->b_partdata_size), static_cast<long long>(length));
+            pCurl->is_verify_fallback = true;
+            return 0;
+        }
+    }
+
     // write size
     ssize_t copysize = (size * nmemb) < static_cast<size_t>(pCurl->partdata.size) ? (size * nmemb) : static_cast<size_t>(pCurl->partdata.size);
     ssize_t writebytes;
@@ -556,9 +610,19 @@ size_t S3fsCurl::DownloadWriteCallback(void* ptr, size_t size, size_t nmemb, voi
             return 0;
         }
     }
+    if(pCurl->is_verify_checksum){
+        // the response headers are received before the body(also at retrying)
+        if(pCurl->partdata.startpos == pCurl->b_partdata_startpos){
+            std::string value;
+            pCurl->download_checksum.Reset(find_checksum_header(pCurl->responseHeaders, value));
+        }
+        pCurl->download_checksum.Update(static_cast<const unsigned char*>(ptr), static_cast<size_t>(totalwrite));
+    }
     pCurl->partdata.startpos += totalwrite;
     pCurl->partdata.size     -= totalwrite;
 
+    S3fsRateLimiter::Download(totalwrite, pCurl->IsPriorityRequest());
+
     return totalwrite;
 }
 
@@ -1215,6 +1279,15 @@ bool S3fsCurl::PreGetObjectRequestSetCurlOpts(S3fsCurl* s3fscurl)
     if(CURLE_OK != curl_easy_setopt(s3fscurl->hCurl, CURLOPT_WRITEDATA, reinterpret_cast<void*>(s3fscurl))){
         return false;
     }
+    if(s3fscurl->is_verify_checksum){
+        // for x-amz-checksum-* headers
+        if(CURLE_OK != curl_easy_setopt(s3fscurl->hCurl, CURLOPT_HEADERDATA, reinterpret_cast<void*>(&s3fscurl->responseHeaders))){
+            return false;
+        }
+        if(CURLE_OK != curl_easy_setopt(s3fscurl->hCurl, CURLOPT_HEADERFUNCTION, HeaderCallback)){
+            return false;
+        }
+    }
     if(!S3fsCurl::AddUserAgent(s3fscurl->hCurl)){                            // put User-Agent
         return false;
     }
@@ -1365,7 +1438,7 @@ int S3fsCurl::RawCurlDebugFunc(const CURL* hcurl, curl_infotype type, char* data
 S3fsCurl::S3fsCurl(bool ahbe) :
     type(REQTYPE::UNSET), requestHeaders(nullptr),
     LastResponseCode(S3FSCURL_RESPONSECODE_NOTSET), postdata(nullptr), postdata_remaining(0), is_use_ahbe(ahbe),
-    retry_count(0), b_postdata(nullptr), b_postdata_remaining(0), b_partdata_startpos(0), b_partdata_size(0),
+    retry_wait_ms(0), progress{0, -1, -1}, is_verify_checksum(false), is_verify_fallback(false), is_hedge(false), retry_prev_wait_ms(0), b_postdata(nullptr), b_postdata_remaining(0), b_partdata_startpos(0), b_partdata_size(0),
     fpLazySetup(nullptr), curlCode(CURLE_OK)
 {
     if(!S3fsCurl::ps3fscred){
@@ -1400,15 +1473,33 @@ bool S3fsCurl::ResetHandle()
     if(CURLE_OK != curl_easy_setopt(hCurl, S3FS_CURLOPT_XFERINFOFUNCTION, S3fsCurl::CurlProgress)){
         return false;
     }
-    if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_PROGRESSDATA, hCurl.get())){
+    if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_PROGRESSDATA, this)){
         return false;
     }
     // curl_easy_setopt(hCurl, CURLOPT_FORBID_REUSE, 1);
     if(CURLE_OK != curl_easy_setopt(hCurl, S3FS_CURLOPT_TCP_KEEPALIVE, 1) && !run_once){
         S3FS_PRN_WARN("The CURLOPT_TCP_KEEPALIVE option could not be set. For maximize performance you need to enable this option and you should use libcurl 7.25.0 or later.");
     }
-    if(CURLE_OK != curl_easy_setopt(hCurl, S3FS_CURLOPT_SSL_ENABLE_ALPN, 0) && !run_once){
-        S3FS_PRN_WARN("The CURLOPT_SSL_ENABLE_ALPN option could not be unset. S3 server does not support ALPN, then this option should be disabled to maximize performance. you need to use libcurl 7.36.0 or later.");
+    if(S3fsCurl::is_http2){
+        // [NOTE]
+        // HTTP/2 is negotiated by ALPN, and falls back to HTTP/1.1 if the
+        // server does not support it. PIPEWAIT makes the request wait for
+        // the connection in progress to multiplex on it instead of opening
+        // a new connection.
+        //
+        if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_HTTP_VERSION, S3FS_CURL_HTTP_VERSION_2TLS) && !run_once){
+            S3FS_PRN_WARN("The CURLOPT_HTTP_VERSION option could not be set to HTTP/2. You need to use libcurl 7.47.0 or later which is built with HTTP/2 support.");
+        }
+        if(CURLE_OK != curl_easy_setopt(hCurl, S3FS_CURLOPT_SSL_ENABLE_ALPN, 1) && !run_once){
+            S3FS_PRN_WARN("The CURLOPT_SSL_ENABLE_ALPN option could not be set. HTTP/2 needs ALPN, then you need to use libcurl 7.36.0 or later.");
+        }
+        if(CURLE_OK != curl_easy_setopt(hCurl, S3FS_CURLOPT_PIPEWAIT, 1) && !run_once){
+            S3FS_PRN_WARN("The CURLOPT_PIPEWAIT option could not be set. For maximize multiplexing you need to enable this option and you should use libcurl 7.43.0 or later.");
+        }
+    }else{
+        if(CURLE_OK != curl_easy_setopt(hCurl, S3FS_CURLOPT_SSL_ENABLE_ALPN, 0) && !run_once){
+            S3FS_PRN_WARN("The CURLOPT_SSL_ENABLE_ALPN option could not be unset. S3 server does not support ALPN, then this option should be disabled to maximize performance. you need to use libcurl 7.36.0 or later.");
+        }
     }
     if(CURLE_OK != curl_easy_setopt(hCurl, S3FS_CURLOPT_KEEP_SENDING_ON_ERROR, 1) && !run_once){
         S3FS_PRN_WARN("The S3FS_CURLOPT_KEEP_SENDING_ON_ERROR option could not be set. For maximize performance you need to enable this option and you should use libcurl 7.51.0 or later.");
@@ -1501,7 +1592,7 @@ bool S3fsCurl::ResetHandle()
         }
     }
 
-    S3fsCurl::curl_progress[hCurl.get()] = {time(nullptr), -1, -1};
+    progress = {time(nullptr), -1, -1};
 
     return true;
 }
@@ -1554,7 +1645,6 @@ bool S3fsCurl::DestroyCurlHandleHasLock(bool clear_internal_data)
     }
 
     if(hCurl){
-        S3fsCurl::curl_progress.erase(hCurl.get());
         hCurl.reset();
     }else{
         return false;
@@ -1580,7 +1670,13 @@ bool S3fsCurl::ClearInternalData()
     headdata.clear();
     postdata             = nullptr;
     postdata_remaining   = 0;
-    retry_count          = 0;
+    retry_wait_ms        = 0;
+    retry_prev_wait_ms   = 0;
+    payload_sha256.clear();
+    payload_checksum.clear();
+    is_verify_checksum   = false;
+    is_verify_fallback   = false;
+    download_checksum.Reset(checksum_type_t::NONE);
     b_infile.reset();
     b_postdata           = nullptr;
     b_postdata_remaining = 0;
@@ -1735,6 +1831,9 @@ bool S3fsCurl::RemakeHandle()
                 if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_INFILE, b_infile.get())){
                     return false;
                 }
+                if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_READFUNCTION, S3fsCurl::FileReadCallback)){
+                    return false;
+                }
             }else{
                 if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_INFILESIZE, 0)){
                     return false;
@@ -1752,6 +1851,26 @@ bool S3fsCurl::RemakeHandle()
             if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_WRITEDATA, reinterpret_cast<void*>(this))){
                 return false;
             }
+            if(is_verify_fallback){
+                // the object size has changed, so download the range without verifying
+                std::string range = "bytes=";
+                range             += std::to_string(b_partdata_startpos);
+                range             += "-";
+                range             += std::to_string(b_partdata_startpos + b_partdata_size - 1);
+                requestHeaders     = curl_slist_remove(requestHeaders, "x-amz-checksum-mode");
+                requestHeaders     = curl_slist_sort_insert(requestHeaders, "Range", range.c_str());
+                is_verify_checksum = false;
+                is_verify_fallback = false;
+            }
+            if(is_verify_checksum){
+                responseHeaders.clear();
+                if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_HEADERDATA, reinterpret_cast<void*>(&responseHeaders))){
+                    return false;
+                }
+                if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_HEADERFUNCTION, HeaderCallback)){
+                    return false;
+                }
+            }
             break;
 
         case REQTYPE::CHKBUCKET:
@@ -1945,304 +2064,369 @@ bool S3fsCurl::RemakeHandle()
 }
 
 //
-// Sleep Method with Exponential Backoff and Jitter
+// Decides the wait before retrying with Exponential Backoff and Jitter.
+// Returns false if the request should not be retried, because of the
+// retry count or the retry budget.
 //
 // [NOTE]
 // The primary objective of this process is to prevent secondary server
 // failures caused by spikes in simultaneous retries.
+// This method does not wait, the caller waits for retry_wait_ms(with
+// ThreadPoolMan::RetryWait, or parks the request on the timer of
+// S3fsCurlMulti) before retrying.
 //
-void S3fsCurl::WaitBeforeRetry()
+bool S3fsCurl::ScheduleRetry(retry_class rclass, int retrycnt)
 {
-    unsigned int sleep_time = 2 << retry_count;
-    sleep(sleep_time + static_cast<unsigned int>(random()) % sleep_time);
-    retry_count++;
+    if(S3fsCurl::retries <= (retrycnt + 1)){
+        return false;
+    }
+    if(!S3fsRetryPolicy::AcquireRetry()){
+        return false;
+    }
+    retry_wait_ms      = S3fsRetryPolicy::NextWaitMs(rclass, retry_prev_wait_ms);
+    retry_prev_wait_ms = retry_wait_ms;
+
+    S3FS_PRN_INFO3("Retry the request after %ld ms.", retry_wait_ms);
+    return true;
 }
 
 //
-// returns curl return code
+// The foreground requests which the user is waiting for, and the requests
+// for the credentials have priority in the rate limits. The hedged
+// requests are not prioritized, because they are sent in addition to
+// the original requests.
 //
-int S3fsCurl::RequestPerform(bool dontAddAuthHeaders /*=false*/)
+bool S3fsCurl::IsPriorityRequest() const
 {
-    if(S3fsLog::IsS3fsLogDbg()){
-        char* ptr_url = nullptr;
-        curl_easy_getinfo(hCurl, CURLINFO_EFFECTIVE_URL, &ptr_url);
-        S3FS_PRN_DBG("connecting to URL %s", SAFESTRPTR(ptr_url));
+    if(REQTYPE::IAMCRED == type || REQTYPE::IAMROLE == type){
+        return true;
     }
+    return (S3fsForeground::IsForeground() && !is_hedge);
+}
 
-    LastResponseCode  = S3FSCURL_RESPONSECODE_NOTSET;
-    long responseCode = S3FSCURL_RESPONSECODE_NOTSET;
-    int result        = S3FSCURL_PERFORM_RESULT_NOTSET;
-
-    // 1 attempt + retries...
-    for(int retrycnt = 0; S3FSCURL_PERFORM_RESULT_NOTSET == result && retrycnt < S3fsCurl::retries; ++retrycnt){
-        // Reset response code
-        responseCode = S3FSCURL_RESPONSECODE_NOTSET;
+//
+// Prepares the request headers for each attempt of the request.
+//
+bool S3fsCurl::PreparePerform(bool dontAddAuthHeaders)
+{
+    // Wait for the request rate limit
+    S3fsRateLimiter::Request(IsPriorityRequest());
 
-        // Insert headers
-        if(!dontAddAuthHeaders) {
-            if(!insertAuthHeaders()){
-                return -EIO;
-            }
+    // Insert headers
+    if(!dontAddAuthHeaders) {
+        if(!insertAuthHeaders()){
+            return false;
         }
+    }
 
-        if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_HTTPHEADER, requestHeaders)){
-            S3FS_PRN_ERR("Failed to call curl_easy_setopt, returned NOT CURLE_OK.");
-            return -EIO;
-        }
+    if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_HTTPHEADER, requestHeaders)){
+        S3FS_PRN_ERR("Failed to call curl_easy_setopt, returned NOT CURLE_OK.");
+        return false;
+    }
+    return true;
+}
 
-        // Requests
-        if(CURLE_OK != (curlCode = curl_easy_perform(hCurl.get()))){
-            S3FS_PRN_ERR("CURL ERROR(%d) : %s", curlCode, curl_easy_strerror(curlCode));
-        }
+//
+// Checks the curl return code and the HTTP response code of an attempt.
+// Returns S3FSCURL_PERFORM_RESULT_NOTSET if the request should be retried.
+//
+int S3fsCurl::CheckPerformResult(int retrycnt, long& responseCode)
+{
+    int result    = S3FSCURL_PERFORM_RESULT_NOTSET;
+    retry_wait_ms = 0;
+
+    switch(curlCode){
+        case CURLE_OK:
+            // Need to look at the HTTP response code
+            if(0 != curl_easy_getinfo(hCurl, CURLINFO_RESPONSE_CODE, &responseCode)){
+                S3FS_PRN_ERR("curl_easy_getinfo failed while trying to retrieve HTTP response code");
+                responseCode = S3FSCURL_RESPONSECODE_FATAL_ERROR;
+                result       = -EIO;
+                break;
+            }
+            if(responseCode >= 200 && responseCode < 300){
+                S3FS_PRN_INFO3("HTTP response code %ld", responseCode);
+                result = 0;
+                break;
+            }
 
-        // Check result
-        switch(curlCode){
-            case CURLE_OK:
-                // Need to look at the HTTP response code
-                if(0 != curl_easy_getinfo(hCurl, CURLINFO_RESPONSE_CODE, &responseCode)){
-                    S3FS_PRN_ERR("curl_easy_getinfo failed while trying to retrieve HTTP response code");
-                    responseCode = S3FSCURL_RESPONSECODE_FATAL_ERROR;
-                    result       = -EIO;
-                    break;
+            {
+                // Try to parse more specific AWS error code otherwise fall back to HTTP error code.
+                if(auto value = simple_parse_xml(bodydata.c_str(), bodydata.size(), "Code")){
+                    // TODO: other error codes
+                    if(*value == "EntityTooLarge"){
+                        result = -EFBIG;
+                        break;
+                    }else if(*value == "InvalidObjectState"){
+                        result = -EREMOTE;
+                        break;
+                    }else if(*value == "KeyTooLongError"){
+                        result = -ENAMETOOLONG;
+                        break;
+                    }
                 }
-                if(responseCode >= 200 && responseCode < 300){
-                    S3FS_PRN_INFO3("HTTP response code %ld", responseCode);
-                    result = 0;
+            }
+
+            // Service response codes which are >= 300 && < 500
+            switch(responseCode){
+                case 301:
+                case 307:
+                    S3FS_PRN_ERR("HTTP response code 301(Moved Permanently: also happens when bucket's region is incorrect), returning EIO. Body Text: %s", bodydata.c_str());
+                    S3FS_PRN_ERR("The options of url and region may be useful for solving, please try to use both options.");
+                    result = -EIO;
                     break;
-                }
 
-                {
-                    // Try to parse more specific AWS error code otherwise fall back to HTTP error code.
-                    if(auto value = simple_parse_xml(bodydata.c_str(), bodydata.size(), "Code")){
-                        // TODO: other error codes
-                        if(*value == "EntityTooLarge"){
-                            result = -EFBIG;
-                            break;
-                        }else if(*value == "InvalidObjectState"){
-                            result = -EREMOTE;
-                            break;
-                        }else if(*value == "KeyTooLongError"){
-                            result = -ENAMETOOLONG;
-                            break;
+                case 400:
+                    if(op == "HEAD"){
+                        if(path.size() > 1024){
+                            S3FS_PRN_ERR("HEAD HTTP response code %ld with path longer than 1024, returning ENAMETOOLONG.", responseCode);
+                            return -ENAMETOOLONG;
                         }
+                        S3FS_PRN_ERR("HEAD HTTP response code %ld, returning EPERM.", responseCode);
+                        result = -EPERM;
+                    }else{
+                        S3FS_PRN_ERR("HTTP response code %ld, returning EIO. Body Text: %s", responseCode, bodydata.c_str());
+                        result = -EIO;
                     }
-                }
+                    break;
 
-                // Service response codes which are >= 300 && < 500
-                switch(responseCode){
-                    case 301:
-                    case 307:
-                        S3FS_PRN_ERR("HTTP response code 301(Moved Permanently: also happens when bucket's region is incorrect), returning EIO. Body Text: %s", bodydata.c_str());
-                        S3FS_PRN_ERR("The options of url and region may be useful for solving, please try to use both options.");
-                        result = -EIO;
-                        break;
+                case 403:
+                    S3FS_PRN_ERR("HTTP response code %ld, returning EPERM. Body Text: %s", responseCode, bodydata.c_str());
+                    result = -EPERM;
+                    break;
 
-                    case 400:
-                        if(op == "HEAD"){
-                            if(path.size() > 1024){
-                                S3FS_PRN_ERR("HEAD HTTP response code %ld with path longer than 1024, returning ENAMETOOLONG.", responseCode);
-                                return -ENAMETOOLONG;
-                            }
-                            S3FS_PRN_ERR("HEAD HTTP response code %ld, returning EPERM.", responseCode);
-                            result = -EPERM;
-                        }else{
-                            S3FS_PRN_ERR("HTTP response code %ld, returning EIO. Body Text: %s", responseCode, bodydata.c_str());
-                            result = -EIO;
-                        }
-                        break;
+                case 404:
+                    S3FS_PRN_INFO3("HTTP response code 404 was returned, returning ENOENT");
+                    S3FS_PRN_DBG("Body Text: %s", bodydata.c_str());
+                    result = -ENOENT;
+                    break;
 
-                    case 403:
-                        S3FS_PRN_ERR("HTTP response code %ld, returning EPERM. Body Text: %s", responseCode, bodydata.c_str());
-                        result = -EPERM;
-                        break;
+                case 416:
+                    S3FS_PRN_INFO3("HTTP response code 416 was returned, returning EIO");
+                    result = -EIO;
+                    break;
 
-                    case 404:
-                        S3FS_PRN_INFO3("HTTP response code 404 was returned, returning ENOENT");
+                case 429:
+                    if(ScheduleRetry(retry_class::THROTTLE, retrycnt)){
+                        S3FS_PRN_INFO3("HTTP response code 429 was returned, slowing down");
                         S3FS_PRN_DBG("Body Text: %s", bodydata.c_str());
-                        result = -ENOENT;
-                        break;
+                    }else{
+                        S3FS_PRN_INFO3("HTTP response code 429 was returned, returning EAGAIN");
+                        result = -EAGAIN;
+                    }
+                    break;
 
-                    case 416:
-                        S3FS_PRN_INFO3("HTTP response code 416 was returned, returning EIO");
+                case 500:
+                    // [NOTE]
+                    // The 500 error message occurs when the server is unable to process the request at
+                    // that time, and may be resolved by retrying the request.
+                    //
+                    if(ScheduleRetry(retry_class::SERVER, retrycnt)){
+                        S3FS_PRN_INFO3("HTTP response code 500 was returned, slowing down");
+                        S3FS_PRN_DBG("Body Text: %s", bodydata.c_str());
+                    }else{
+                        S3FS_PRN_INFO3("HTTP response code 500 was returned, returning EIO");
                         result = -EIO;
-                        break;
-
-                    case 429:
-                        if((retrycnt + 1) < S3fsCurl::retries){
-                            S3FS_PRN_INFO3("HTTP response code 429 was returned, slowing down");
-                            S3FS_PRN_DBG("Body Text: %s", bodydata.c_str());
-                            WaitBeforeRetry();
-                        }else{
-                            S3FS_PRN_INFO3("HTTP response code 429 was returned, returning EAGAIN");
-                            result = -EAGAIN;
-                        }
-                        break;
+                    }
+                    break;
 
-                    case 500:
-                        // [NOTE]
-                        // The 500 error message occurs when the server is unable to process the request at
-                        // that time, and may be resolved by retrying the request.
-                        //
-                        if((retrycnt + 1) < S3fsCurl::retries){
-                            S3FS_PRN_INFO3("HTTP response code 500 was returned, slowing down");
-                            S3FS_PRN_DBG("Body Text: %s", bodydata.c_str());
-                            WaitBeforeRetry();
-                        }else{
-                            S3FS_PRN_INFO3("HTTP response code 500 was returned, returning EIO");
-                            result = -EIO;
-                        }
-                        break;
+                case 501:
+                    S3FS_PRN_INFO3("HTTP response code 501 was returned, returning ENOTSUP");
+                    S3FS_PRN_DBG("Body Text: %s", bodydata.c_str());
+                    result = -ENOTSUP;
+                    break;
 
-                    case 501:
-                        S3FS_PRN_INFO3("HTTP response code 501 was returned, returning ENOTSUP");
+                case 502:
+                    if(ScheduleRetry(retry_class::SERVER, retrycnt)){
+                        S3FS_PRN_INFO3("HTTP response code 502 was returned, slowing down");
                         S3FS_PRN_DBG("Body Text: %s", bodydata.c_str());
-                        result = -ENOTSUP;
-                        break;
-
-                    case 502:
-                        if((retrycnt + 1) < S3fsCurl::retries){
-                            S3FS_PRN_INFO3("HTTP response code 502 was returned, slowing down");
-                            S3FS_PRN_DBG("Body Text: %s", bodydata.c_str());
-                            WaitBeforeRetry();
-                        }else{
-                            S3FS_PRN_INFO3("HTTP response code 502 was returned, returning EWOULDBLOCK");
-                            result = -EWOULDBLOCK;
-                        }
-                        break;
+                    }else{
+                        S3FS_PRN_INFO3("HTTP response code 502 was returned, returning EWOULDBLOCK");
+                        result = -EWOULDBLOCK;
+                    }
+                    break;
 
-                    case 503:
-                        if((retrycnt + 1) < S3fsCurl::retries){
-                            S3FS_PRN_INFO3("HTTP response code 503 was returned, slowing down");
-                            S3FS_PRN_DBG("Body Text: %s", bodydata.c_str());
-                            WaitBeforeRetry();
-                        }else{
-                            S3FS_PRN_INFO3("HTTP response code 503 was returned, returning EAGAIN");
-                            result = -EAGAIN;
-                        }
-                        break;
+                case 503:
+                    if(ScheduleRetry(retry_class::THROTTLE, retrycnt)){
+                        S3FS_PRN_INFO3("HTTP response code 503 was returned, slowing down");
+                        S3FS_PRN_DBG("Body Text: %s", bodydata.c_str());
+                    }else{
+                        S3FS_PRN_INFO3("HTTP response code 503 was returned, returning EAGAIN");
+                        result = -EAGAIN;
+                    }
+                    break;
 
-                    case 504:
-                        if((retrycnt + 1) < S3fsCurl::retries){
-                            S3FS_PRN_INFO3("HTTP response code 504 was returned, slowing down");
-                            S3FS_PRN_DBG("Body Text: %s", bodydata.c_str());
-                            WaitBeforeRetry();
-                        }else{
-                            S3FS_PRN_INFO3("HTTP response code 504 was returned, returning ETIMEDOUT");
-                            result = -ETIMEDOUT;
-                        }
-                        break;
+                case 504:
+                    if(ScheduleRetry(retry_class::SERVER, retrycnt)){
+                        S3FS_PRN_INFO3("HTTP response code 504 was returned, slowing down");
+                        S3FS_PRN_DBG("Body Text: %s", bodydata.c_str());
+                    }else{
+                        S3FS_PRN_INFO3("HTTP response code 504 was returned, returning ETIMEDOUT");
+                        result = -ETIMEDOUT;
+                    }
+                    break;
 
-                    default:
-                        S3FS_PRN_ERR("HTTP response code %ld, returning EIO. Body Text: %s", responseCode, bodydata.c_str());
-                        result = -EIO;
-                        break;
-                }
-                break;
+                default:
+                    S3FS_PRN_ERR("HTTP response code %ld, returning EIO. Body Text: %s", responseCode, bodydata.c_str());
+                    result = -EIO;
+                    break;
+            }
+            break;
 
-            case CURLE_WRITE_ERROR:
-                sleep(2);
-                break;
+        case CURLE_WRITE_ERROR:
+        case CURLE_OPERATION_TIMEDOUT:
+        case CURLE_COULDNT_RESOLVE_HOST:
+        case CURLE_COULDNT_CONNECT:
+        case CURLE_GOT_NOTHING:
+        case CURLE_ABORTED_BY_CALLBACK:
+        case CURLE_PARTIAL_FILE:
+        case CURLE_SEND_ERROR:
+        case CURLE_RECV_ERROR:
+        case CURLE_SSL_CONNECT_ERROR:
+            if(CURLE_ABORTED_BY_CALLBACK == curlCode){
+                progress = {time(nullptr), -1, -1};
+            }
+            if(!ScheduleRetry(retry_class::NETWORK, retrycnt)){
+                S3FS_PRN_ERR("CURL ERROR(%d) is not retried any more, giving up.", curlCode);
+                result = -EIO;
+            }
+            break;
 
-            case CURLE_OPERATION_TIMEDOUT:
-                sleep(2);
-                break;
+        case CURLE_SSL_CERTPROBLEM:
+            result = -EIO;
+            break;
 
-            case CURLE_COULDNT_RESOLVE_HOST:
-                sleep(2);
-                break;
+        case CURLE_SSL_CACERT:              // = CURLE_SSL_PEER_CERTIFICATE
+            // try to locate cert, if successful, then set the
+            // option and continue
+            if(S3fsCurl::curl_ca_bundle.empty()){
+                if(!S3fsCurl::LocateBundle()){
+                    S3FS_PRN_ERR("could not get CURL_CA_BUNDLE.");
+                    result = -EIO;
+                }
+                // retry with CAINFO
+            }else{
+                S3FS_PRN_ERR("curlCode: %d  msg: %s", curlCode, curl_easy_strerror(curlCode));
+                result = -EIO;
+            }
+            break;
 
-            case CURLE_COULDNT_CONNECT:
-                sleep(4);
-                break;
+#ifdef CURLE_PEER_FAILED_VERIFICATION
+        case CURLE_PEER_FAILED_VERIFICATION:
+            first_pos = S3fsCred::GetBucket().find_first_of('.');
+            if(first_pos != std::string::npos){
+                S3FS_PRN_INFO("curl returned a CURL_PEER_FAILED_VERIFICATION error");
+                S3FS_PRN_INFO("security issue found: buckets with periods in their name are incompatible with http");
+                S3FS_PRN_INFO("This check can be over-ridden by using the -o ssl_verify_hostname=0");
+                S3FS_PRN_INFO("The certificate will still be checked but the hostname will not be verified.");
+                S3FS_PRN_INFO("A more secure method would be to use a bucket name without periods.");
+            }else{
+                S3FS_PRN_INFO("my_curl_easy_perform: curlCode: %d -- %s", curlCode, curl_easy_strerror(curlCode));
+            }
+            result = -EIO;
+            break;
+#endif
 
-            case CURLE_GOT_NOTHING:
-                sleep(4);
-                break;
+        // This should be invalid since curl option HTTP FAILONERROR is now off
+        case CURLE_HTTP_RETURNED_ERROR:
+            if(0 != curl_easy_getinfo(hCurl, CURLINFO_RESPONSE_CODE, &responseCode)){
+                result = -EIO;
+            }else{
+                S3FS_PRN_INFO3("HTTP response code =%ld", responseCode);
 
-            case CURLE_ABORTED_BY_CALLBACK:
-                sleep(4);
-                {
-                    const std::lock_guard<std::mutex> lock(S3fsCurl::curl_handles_lock);
-                    S3fsCurl::curl_progress[hCurl.get()] = {time(nullptr), -1, -1};
+                // Let's try to retrieve the
+                if(404 == responseCode){
+                    result = -ENOENT;
+                }else if(500 > responseCode){
+                    result = -EIO;
                 }
-                break;
+            }
+            break;
 
-            case CURLE_PARTIAL_FILE:
-                sleep(4);
-                break;
+        // Unknown CURL return code
+        default:
+            result = -EIO;
+            break;
+    } // switch
 
-            case CURLE_SEND_ERROR:
-                sleep(2);
-                break;
+    if(429 == responseCode || 503 == responseCode){
+        AdaptiveConcurrency::NotifyThrottle();
+    }
+    return result;
+}
 
-            case CURLE_RECV_ERROR:
-                sleep(2);
-                break;
+//
+// Sets the last response code and returns the result of the request.
+//
+int S3fsCurl::FinishPerform(int result, long responseCode)
+{
+    // set last response code
+    if(S3FSCURL_RESPONSECODE_NOTSET == responseCode){
+        LastResponseCode = S3FSCURL_RESPONSECODE_FATAL_ERROR;
+    }else{
+        LastResponseCode = responseCode;
+    }
 
-            case CURLE_SSL_CONNECT_ERROR:
-                sleep(2);
-                break;
+    if(S3FSCURL_PERFORM_RESULT_NOTSET == result){
+        S3FS_PRN_ERR("### giving up");
+        result = -EIO;
+    }else if(0 == result){
+        S3fsRetryPolicy::NotifySuccess();
+
+        // the time to the first byte for the delay of hedged requests and
+        // the adaptive concurrency
+        double starttransfer = 0.0;
+        if((S3fsHedgePolicy::IsEnabled() || AdaptiveConcurrency::IsEnabled()) && (REQTYPE::GET == type || REQTYPE::HEAD == type) && CURLE_OK == curl_easy_getinfo(hCurl, CURLINFO_STARTTRANSFER_TIME, &starttransfer)){
+            if(S3fsHedgePolicy::IsEnabled()){
+                S3fsHedgePolicy::AddSample((REQTYPE::HEAD == type ? hedge_req_t::HEAD : hedge_req_t::GET), static_cast<long>(starttransfer * 1000));
+            }
+            AdaptiveConcurrency::NotifySuccess(REQTYPE::HEAD == type, static_cast<long>(starttransfer * 1000));
+        }
+    }
+    return result;
+}
 
-            case CURLE_SSL_CERTPROBLEM:
-                result = -EIO;
-                break;
+//
+// returns curl return code
+//
+int S3fsCurl::RequestPerform(bool dontAddAuthHeaders /*=false*/)
+{
+    if(S3fsLog::IsS3fsLogDbg()){
+        char* ptr_url = nullptr;
+        curl_easy_getinfo(hCurl, CURLINFO_EFFECTIVE_URL, &ptr_url);
+        S3FS_PRN_DBG("connecting to URL %s", SAFESTRPTR(ptr_url));
+    }
 
-            case CURLE_SSL_CACERT:              // = CURLE_SSL_PEER_CERTIFICATE
-                // try to locate cert, if successful, then set the
-                // option and continue
-                if(S3fsCurl::curl_ca_bundle.empty()){
-                    if(!S3fsCurl::LocateBundle()){
-                        S3FS_PRN_ERR("could not get CURL_CA_BUNDLE.");
-                        result = -EIO;
-                    }
-                    // retry with CAINFO
-                }else{
-                    S3FS_PRN_ERR("curlCode: %d  msg: %s", curlCode, curl_easy_strerror(curlCode));
-                    result = -EIO;
-                }
-                break;
+    LastResponseCode  = S3FSCURL_RESPONSECODE_NOTSET;
+    long responseCode = S3FSCURL_RESPONSECODE_NOTSET;
+    int result        = S3FSCURL_PERFORM_RESULT_NOTSET;
 
-#ifdef CURLE_PEER_FAILED_VERIFICATION
-            case CURLE_PEER_FAILED_VERIFICATION:
-                first_pos = S3fsCred::GetBucket().find_first_of('.');
-                if(first_pos != std::string::npos){
-                    S3FS_PRN_INFO("curl returned a CURL_PEER_FAILED_VERIFICATION error");
-                    S3FS_PRN_INFO("security issue found: buckets with periods in their name are incompatible with http");
-                    S3FS_PRN_INFO("This check can be over-ridden by using the -o ssl_verify_hostname=0");
-                    S3FS_PRN_INFO("The certificate will still be checked but the hostname will not be verified.");
-                    S3FS_PRN_INFO("A more secure method would be to use a bucket name without periods.");
-                }else{
-                    S3FS_PRN_INFO("my_curl_easy_perform: curlCode: %d -- %s", curlCode, curl_easy_strerror(curlCode));
-                }
-                result = -EIO;
-                break;
-#endif
+    // 1 attempt + retries...
+    for(int retrycnt = 0; S3FSCURL_PERFORM_RESULT_NOTSET == result && retrycnt < S3fsCurl::retries; ++retrycnt){
+        // Reset response code
+        responseCode = S3FSCURL_RESPONSECODE_NOTSET;
 
-            // This should be invalid since curl option HTTP FAILONERROR is now off
-            case CURLE_HTTP_RETURNED_ERROR:
-                if(0 != curl_easy_getinfo(hCurl, CURLINFO_RESPONSE_CODE, &responseCode)){
-                    result = -EIO;
-                }else{
-                    S3FS_PRN_INFO3("HTTP response code =%ld", responseCode);
+        if(!PreparePerform(dontAddAuthHeaders)){
+            return -EIO;
+        }
 
-                    // Let's try to retrieve the
-                    if(404 == responseCode){
-                        result = -ENOENT;
-                    }else if(500 > responseCode){
-                        result = -EIO;
-                    }
-                }
-                break;
+        // Requests
+        AdaptiveConcurrency::Acquire();
+        curlCode = curl_easy_perform(hCurl.get());
+        AdaptiveConcurrency::Release();
+        if(CURLE_OK != curlCode){
+            S3FS_PRN_ERR("CURL ERROR(%d) : %s", curlCode, curl_easy_strerror(curlCode));
+        }
 
-            // Unknown CURL return code
-            default:
-                result = -EIO;
-                break;
-        } // switch
+        // Check result
+        result = CheckPerformResult(retrycnt, responseCode);
 
         if(S3FSCURL_PERFORM_RESULT_NOTSET == result){
             S3FS_PRN_INFO("Communication error(%d time): Retry up to the limit.", retrycnt);
 
+            if(0 < retry_wait_ms){
+                ThreadPoolMan::RetryWait(retry_wait_ms);
+            }
             if(!RemakeHandle()){
                 S3FS_PRN_INFO("Failed to reset handle and internal data for retrying.");
                 result = -EIO;
@@ -2251,18 +2435,7 @@ int S3fsCurl::RequestPerform(bool dontAddAuthHeaders /*=false*/)
         }
     } // for
 
-    // set last response code
-    if(S3FSCURL_RESPONSECODE_NOTSET == responseCode){
-        LastResponseCode = S3FSCURL_RESPONSECODE_FATAL_ERROR;
-    }else{
-        LastResponseCode = responseCode;
-    }
-
-    if(S3FSCURL_PERFORM_RESULT_NOTSET == result){
-        S3FS_PRN_ERR("### giving up");
-        result = -EIO;
-    }
-    return result;
+    return FinishPerform(result, responseCode);
 }
 
 //
@@ -2304,56 +2477,62 @@ std::string S3fsCurl::CalcSignatureV2(const std::string& method, const std::stri
 
 std::string S3fsCurl::CalcSignature(const std::string& method, const std::string& canonical_uri, const std::string& query_string, const std::string& strdate, const std::string& payload_hash, const std::string& date8601, const std::string& secret_access_key, const std::string& access_token)
 {
-    std::string StringCQ, StringToSign;
-    std::string uriencode;
-
     if(!access_token.empty()){
         requestHeaders = curl_slist_sort_insert(requestHeaders, "x-amz-security-token", access_token.c_str());
     }
 
-    uriencode = urlEncodePath(canonical_uri);
-    StringCQ  = method + "\n";
-    if(method == "HEAD" || method == "PUT" || method == "DELETE"){
-        StringCQ += uriencode + "\n";
+    // [NOTE]
+    // The canonical request and the string to sign are built in sign_buffer,
+    // it keeps the capacity for the next request(and the retries) of this
+    // object.
+    //
+    std::string uriencode = urlEncodePath(canonical_uri);
+    sign_buffer.clear();
+    sign_buffer += method;
+    sign_buffer += '\n';
+    if(method == "HEAD" || method == "PUT" || method == "DELETE" || method == "POST"){
+        sign_buffer += uriencode;
+        sign_buffer += '\n';
     }else if(method == "GET" && uriencode.empty()){
-        StringCQ +="/\n";
+        sign_buffer += "/\n";
     }else if(method == "GET" && is_prefix(uriencode.c_str(), "/")){
-        StringCQ += uriencode +"\n";
+        sign_buffer += uriencode;
+        sign_buffer += '\n';
     }else if(method == "GET" && !is_prefix(uriencode.c_str(), "/")){
-        StringCQ += "/\n" + urlEncodeQuery(canonical_uri) +"\n";
-    }else if(method == "POST"){
-        StringCQ += uriencode + "\n";
-    }
-    StringCQ += urlEncodeQuery(query_string) + "\n";
-    StringCQ += get_canonical_headers(requestHeaders) + "\n";
-    StringCQ += get_sorted_header_keys(requestHeaders) + "\n";
-    StringCQ += payload_hash;
+        sign_buffer += "/\n";
+        sign_buffer += urlEncodeQuery(canonical_uri);
+        sign_buffer += '\n';
+    }
+    sign_buffer += urlEncodeQuery(query_string);
+    sign_buffer += '\n';
+    append_canonical_headers(sign_buffer, requestHeaders);
+    sign_buffer += '\n';
+    append_sorted_header_keys(sign_buffer, requestHeaders);
+    sign_buffer += '\n';
+    sign_buffer += payload_hash;
 
-    std::string   kSecret = "AWS4" + secret_access_key;
-    unsigned int  kDate_len,kRegion_len, kService_len, kSigning_len = 0;
-
-    std::unique_ptr<unsigned char[]> kDate = s3fs_HMAC256(kSecret.c_str(), kSecret.size(), reinterpret_cast<const unsigned char*>(strdate.data()), strdate.size(), &kDate_len);
-    std::unique_ptr<unsigned char[]> kRegion = s3fs_HMAC256(kDate.get(), kDate_len, reinterpret_cast<const unsigned char*>(region.c_str()), region.size(), &kRegion_len);
-    std::unique_ptr<unsigned char[]> kService = s3fs_HMAC256(kRegion.get(), kRegion_len, reinterpret_cast<const unsigned char*>("s3"), sizeof("s3") - 1, &kService_len);
-    std::unique_ptr<unsigned char[]> kSigning = s3fs_HMAC256(kService.get(), kService_len, reinterpret_cast<const unsigned char*>("aws4_request"), sizeof("aws4_request") - 1, &kSigning_len);
-
-    const auto* cRequest     = reinterpret_cast<const unsigned char*>(StringCQ.c_str());
-    size_t               cRequest_len = StringCQ.size();
     sha256_t sRequest;
-    if(!s3fs_sha256(cRequest, cRequest_len, &sRequest)){
+    if(!s3fs_sha256(reinterpret_cast<const unsigned char*>(sign_buffer.data()), sign_buffer.size(), &sRequest)){
         return "";  // TODO: better return value
     }
 
-    StringToSign  = "AWS4-HMAC-SHA256\n";
-    StringToSign += date8601 + "\n";
-    StringToSign += strdate + "/" + region + "/s3/aws4_request\n";
-    StringToSign += s3fs_hex_lower(sRequest.data(), sRequest.size());
+    sha256_t kSigning;
+    if(!get_sigv4_signing_key(secret_access_key, strdate, region, "s3", kSigning)){
+        return "";
+    }
 
-    const auto* cscope     = reinterpret_cast<const unsigned char*>(StringToSign.c_str());
-    size_t               cscope_len = StringToSign.size();
-    unsigned int         md_len     = 0;
+    sign_buffer.clear();
+    sign_buffer += "AWS4-HMAC-SHA256\n";
+    sign_buffer += date8601;
+    sign_buffer += '\n';
+    sign_buffer += strdate;
+    sign_buffer += '/';
+    sign_buffer += region;
+    sign_buffer += "/s3/aws4_request\n";
+    sign_buffer += s3fs_hex_lower(sRequest.data(), sRequest.size());
 
-    std::unique_ptr<unsigned char[]> md = s3fs_HMAC256(kSigning.get(), kSigning_len, cscope, cscope_len, &md_len);
+    unsigned int md_len = 0;
+    std::unique_ptr<unsigned char[]> md = s3fs_HMAC256(kSigning.data(), kSigning.size(), reinterpret_cast<const unsigned char*>(sign_buffer.data()), sign_buffer.size(), &md_len);
 
     return s3fs_hex_lower(md.get(), md_len);
 }
@@ -2397,8 +2576,10 @@ bool S3fsCurl::insertV4Headers(const std::string& access_key_id, const std::stri
         case REQTYPE::PUT:
             if(GetUnsignedPayload()){
                 payload_hash = "UNSIGNED-PAYLOAD";
+            }else if(!payload_sha256.empty()){
+                payload_hash = payload_sha256;
             }else{
-                payload_hash = s3fs_sha256_hex_fd(b_infile == nullptr ? -1 : fileno(b_infile.get()), 0, -1);
+                payload_hash = payload_sha256 = s3fs_sha256_hex_fd(b_infile == nullptr ? -1 : fileno(b_infile.get()), 0, -1);
             }
             break;
 
@@ -2416,8 +2597,10 @@ bool S3fsCurl::insertV4Headers(const std::string& access_key_id, const std::stri
         case REQTYPE::UPLOADMULTIPOST:
             if(GetUnsignedPayload()){
                 payload_hash = "UNSIGNED-PAYLOAD";
+            }else if(!payload_sha256.empty()){
+                payload_hash = payload_sha256;
             }else{
-                payload_hash = s3fs_sha256_hex_fd(partdata.fd, partdata.startpos, partdata.size);
+                payload_hash = payload_sha256 = s3fs_sha256_hex_fd(partdata.fd, partdata.startpos, partdata.size);
             }
             break;
         default:
@@ -2487,6 +2670,42 @@ void S3fsCurl::insertIBMIAMHeaders(const std::string& access_key_id, const std::
     }
 }
 
+//
+// Compares the additional checksum of the downloaded object with the value
+// in the response header, the object without the checksum is not verified.
+//
+bool S3fsCurl::VerifyDownloadChecksum()
+{
+    if(!is_verify_checksum){
+        return true;
+    }
+    std::string     value;
+    checksum_type_t type = find_checksum_header(responseHeaders, value);
+    if(checksum_type_t::NONE == type){
+        S3FS_PRN_DBG("The object(%s) does not have the checksum to verify.", path.c_str());
+        return true;
+    }
+    if(0 != partdata.size || type != download_checksum.GetType()){
+        S3FS_PRN_ERR("Could not verify %s checksum of the object(%s), the response is not whole object.", get_checksum_algorithm(type), path.c_str());
+        return false;
+    }
+    std::string computed = download_checksum.GetBase64();
+    if(computed != value){
+        S3FS_PRN_ERR("%s checksum of the object(%s) is mismatched(expected=%s, computed=%s).", get_checksum_algorithm(type), path.c_str(), value.c_str(), computed.c_str());
+        return false;
+    }
+    S3FS_PRN_INFO3("%s checksum of the object(%s) is verified.", get_checksum_algorithm(type), path.c_str());
+    return true;
+}
+
+//
+// Returns true if the payload of PUT and UploadPart is signed by its SHA256.
+//
+bool S3fsCurl::IsSignedPayloadHash() const
+{
+    return (!S3fsCurl::ps3fscred->IsIBMIAMAuth() && S3fsCurl::signature_type != signature_type_t::V2_ONLY && !GetUnsignedPayload());
+}
+
 bool S3fsCurl::insertAuthHeaders()
 {
     std::string access_key_id;
@@ -2866,6 +3085,12 @@ int S3fsCurl::HeadRequest(const char* tpath, headers_t& meta)
     }
 
     // file exists in s3
+    GetHeadResponseMeta(meta);
+    return 0;
+}
+
+void S3fsCurl::GetHeadResponseMeta(headers_t& meta) const
+{
     // fixme: clean this up.
     meta.clear();
     for(auto iter = responseHeaders.cbegin(); iter != responseHeaders.cend(); ++iter){
@@ -2879,7 +3104,6 @@ int S3fsCurl::HeadRequest(const char* tpath, headers_t& meta)
             meta[iter->first] = value;
         }
     }
-    return 0;
 }
 
 int S3fsCurl::PutHeadRequest(const char* tpath, const headers_t& meta, bool is_copy)
@@ -3028,18 +3252,33 @@ int S3fsCurl::PutRequest(const char* tpath, headers_t& meta, int fd)
     bodydata.clear();
 
     // Make request headers
-    if(S3fsCurl::is_content_md5){
-        std::string strMD5;
+    payload_sha256.clear();
+    if(S3fsCurl::is_content_md5 || checksum_type_t::NONE != S3fsCurl::checksum_type){
+        std::string strMD5 = EMPTY_MD5_BASE64_HASH;
         if(-1 != fd){
-            strMD5 = s3fs_get_content_md5(fd);
-            if(strMD5.empty()){
-                S3FS_PRN_ERR("Failed to make MD5.");
+            // compute the additional checksum and the payload hash for signing in the same pass
+            md5_t              md5raw;
+            sha256_t           sha256raw;
+            bool               need_sha256 = IsSignedPayloadHash();
+            ChecksumCalculator calculator;
+            calculator.Reset(S3fsCurl::checksum_type);
+            if(!s3fs_md5_sha256_fd(fd, 0, -1, (S3fsCurl::is_content_md5 ? &md5raw : nullptr), (need_sha256 ? &sha256raw : nullptr), [&](const unsigned char* data, size_t length){ calculator.Update(data, length); return true; })){
+                S3FS_PRN_ERR("Failed to make MD5 or %s checksum.", get_checksum_algorithm(S3fsCurl::checksum_type));
                 return -EIO;
             }
-        }else{
-            strMD5 = EMPTY_MD5_BASE64_HASH;
+            if(S3fsCurl::is_content_md5){
+                strMD5 = s3fs_base64(md5raw.data(), md5raw.size());
+            }
+            if(need_sha256){
+                payload_sha256 = s3fs_hex_lower(sha256raw.data(), sha256raw.size());
+            }
+            if(checksum_type_t::NONE != S3fsCurl::checksum_type){
+                requestHeaders = curl_slist_sort_insert(requestHeaders, get_checksum_header_name(S3fsCurl::checksum_type).c_str(), calculator.GetBase64().c_str());
+            }
+        }
+        if(S3fsCurl::is_content_md5){
+            requestHeaders = curl_slist_sort_insert(requestHeaders, "Content-MD5", strMD5.c_str());
         }
-        requestHeaders = curl_slist_sort_insert(requestHeaders, "Content-MD5", strMD5.c_str());
     }
 
     std::string contype = S3fsCurl::LookupMimeType(tpath);
@@ -3105,6 +3344,9 @@ int S3fsCurl::PutRequest(const char* tpath, headers_t& meta, int fd)
         if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_INFILE, b_infile.get())){
             return -EIO;
         }
+        if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_READFUNCTION, S3fsCurl::FileReadCallback)){
+            return -EIO;
+        }
     }else{
         if(CURLE_OK != curl_easy_setopt(hCurl, CURLOPT_INFILESIZE, 0)){             // Content-Length: 0
             return -EIO;
@@ -3122,7 +3364,7 @@ int S3fsCurl::PutRequest(const char* tpath, headers_t& meta, int fd)
     return result;
 }
 
-int S3fsCurl::PreGetObjectRequest(const char* tpath, int fd, off_t start, off_t size, sse_type_t ssetype, const std::string& ssevalue)
+int S3fsCurl::PreGetObjectRequest(const char* tpath, int fd, off_t start, off_t size, sse_type_t ssetype, const std::string& ssevalue, bool is_whole_object)
 {
     S3FS_PRN_INFO3("[tpath=%s][start=%lld][size=%lld]", SAFESTRPTR(tpath), static_cast<long long>(start), static_cast<long long>(size));
 
@@ -3139,7 +3381,16 @@ int S3fsCurl::PreGetObjectRequest(const char* tpath, int fd, off_t start, off_t
     requestHeaders  = nullptr;
     responseHeaders.clear();
 
-    if(0 < size){
+    // [NOTE]
+    // The checksum of the object is returned only for the request without
+    // the range, so the whole object is requested without Range header.
+    //
+    is_verify_checksum = (checksum_type_t::NONE != S3fsCurl::checksum_type && is_whole_object && 0 == start);
+    is_verify_fallback = false;
+    download_checksum.Reset(checksum_type_t::NONE);
+    if(is_verify_checksum){
+        requestHeaders = curl_slist_sort_insert(requestHeaders, "x-amz-checksum-mode", "ENABLED");
+    }else if(0 < size){
         std::string range = "bytes=";
         range       += std::to_string(start);
         range       += "-";
@@ -3173,7 +3424,24 @@ int S3fsCurl::PreGetObjectRequest(const char* tpath, int fd, off_t start, off_t
     return 0;
 }
 
-int S3fsCurl::GetObjectRequest(const char* tpath, int fd, off_t start, off_t size, sse_type_t ssetype, const std::string& ssevalue)
+//
+// Adds If-Match header to the request which is made by Pre*Request method,
+// so that the request fails with 412 if the object has been replaced.
+//
+bool S3fsCurl::AddIfMatchHeader(const std::string& etag)
+{
+    if(etag.empty()){
+        return false;
+    }
+    if('"' == etag.front()){
+        requestHeaders = curl_slist_sort_insert(requestHeaders, "If-Match", etag.c_str());
+    }else{
+        requestHeaders = curl_slist_sort_insert(requestHeaders, "If-Match", ("\"" + etag + "\"").c_str());
+    }
+    return true;
+}
+
+int S3fsCurl::GetObjectRequest(const char* tpath, int fd, off_t start, off_t size, sse_type_t ssetype, const std::string& ssevalue, bool is_whole_object)
 {
     int result;
 
@@ -3183,7 +3451,7 @@ int S3fsCurl::GetObjectRequest(const char* tpath, int fd, off_t start, off_t siz
         return -EINVAL;
     }
 
-    if(0 != (result = PreGetObjectRequest(tpath, fd, start, size, ssetype, ssevalue))){
+    if(0 != (result = PreGetObjectRequest(tpath, fd, start, size, ssetype, ssevalue, is_whole_object))){
         return result;
     }
     if(!fpLazySetup || !fpLazySetup(this)){
@@ -3194,6 +3462,9 @@ int S3fsCurl::GetObjectRequest(const char* tpath, int fd, off_t start, off_t siz
     S3FS_PRN_INFO3("downloading... [path=%s][fd=%d]", tpath, fd);
 
     result = RequestPerform();
+    if(0 == result && !VerifyDownloadChecksum()){
+        result = -EIO;
+    }
     partdata.clear();
 
     return result;
@@ -3402,6 +3673,14 @@ int S3fsCurl::PreMultipartUploadRequest(const char* tpath, const headers_t& meta
         // set additional header by ahbe conf
         requestHeaders = AdditionalHeader::get()->AddHeader(requestHeaders, tpath);
     }
+    // [NOTE]
+    // The CRC checksums of the parts are combined by the server into the
+    // checksum of the whole object with the FULL_OBJECT type.
+    //
+    if(checksum_type_t::NONE != S3fsCurl::checksum_type){
+        requestHeaders = curl_slist_sort_insert(requestHeaders, "x-amz-checksum-algorithm", get_checksum_algorithm(S3fsCurl::checksum_type));
+        requestHeaders = curl_slist_sort_insert(requestHeaders, "x-amz-checksum-type", "FULL_OBJECT");
+    }
 
     requestHeaders = curl_slist_sort_insert(requestHeaders, "Accept", nullptr);
     requestHeaders = curl_slist_sort_insert(requestHeaders, "Content-Type", contype.c_str());
@@ -3525,6 +3804,10 @@ int S3fsCurl::MultipartUploadComplete(const char* tpath, const std::string& uplo
         postContent += "<Part>\n";
         postContent += "  <PartNumber>" + std::to_string(it->part_num) + "</PartNumber>\n";
         postContent += "  <ETag>" + it->etag + "</ETag>\n";
+        if(checksum_type_t::NONE != S3fsCurl::checksum_type && !it->checksum.empty()){
+            std::string tag = get_checksum_xml_tag(S3fsCurl::checksum_type);
+            postContent += "  <" + tag + ">" + it->checksum + "</" + tag + ">\n";
+        }
         postContent += "</Part>\n";
     }
     postContent += "</CompleteMultipartUpload>\n";
@@ -3726,17 +4009,32 @@ int S3fsCurl::MultipartUploadContentPartSetup(const char* tpath, int part_num, c
     }
 
     requestHeaders = nullptr;
-
-    // make md5 and file pointer
-    if(S3fsCurl::is_content_md5){
-        md5_t md5raw;
-        if(!s3fs_md5_fd(partdata.fd, partdata.startpos, partdata.size, &md5raw)){
-            S3FS_PRN_ERR("Could not make md5 for file(part %d)", part_num);
+    payload_sha256.clear();
+
+    // make md5 and the additional checksum(and the payload hash for signing in the same pass) and file pointer
+    payload_checksum.clear();
+    if(S3fsCurl::is_content_md5 || checksum_type_t::NONE != S3fsCurl::checksum_type){
+        md5_t              md5raw;
+        sha256_t           sha256raw;
+        bool               need_sha256 = IsSignedPayloadHash();
+        ChecksumCalculator calculator;
+        calculator.Reset(S3fsCurl::checksum_type);
+        if(!s3fs_md5_sha256_fd(partdata.fd, partdata.startpos, partdata.size, (S3fsCurl::is_content_md5 ? &md5raw : nullptr), (need_sha256 ? &sha256raw : nullptr), [&](const unsigned char* data, size_t length){ calculator.Update(data, length); return true; })){
+            S3FS_PRN_ERR("Could not make md5 or %s checksum for file(part %d)", get_checksum_algorithm(S3fsCurl::checksum_type), part_num);
             return -EIO;
         }
-        partdata.etag = s3fs_hex_lower(md5raw.data(), md5raw.size());
-        std::string md5base64 = s3fs_base64(md5raw.data(), md5raw.size());
-        requestHeaders = curl_slist_sort_insert(requestHeaders, "Content-MD5", md5base64.c_str());
+        if(need_sha256){
+            payload_sha256 = s3fs_hex_lower(sha256raw.data(), sha256raw.size());
+        }
+        if(S3fsCurl::is_content_md5){
+            partdata.etag = s3fs_hex_lower(md5raw.data(), md5raw.size());
+            std::string md5base64 = s3fs_base64(md5raw.data(), md5raw.size());
+            requestHeaders = curl_slist_sort_insert(requestHeaders, "Content-MD5", md5base64.c_str());
+        }
+        if(checksum_type_t::NONE != S3fsCurl::checksum_type){
+            payload_checksum = calculator.GetBase64();
+            requestHeaders   = curl_slist_sort_insert(requestHeaders, get_checksum_header_name(S3fsCurl::checksum_type).c_str(), payload_checksum.c_str());
+        }
     }
 
     // make request
@@ -3867,8 +4165,9 @@ bool S3fsCurl::MultipartUploadContentPartComplete()
             return false;
         }
     }
-    partdata.petag->etag = etag;
-    partdata.uploaded    = true;
+    partdata.petag->etag     = etag;
+    partdata.petag->checksum = payload_checksum;
+    partdata.uploaded        = true;
 
     return true;
 }
@@ -3878,6 +4177,9 @@ bool S3fsCurl::MultipartUploadCopyPartComplete()
     auto etag = simple_parse_xml(bodydata.c_str(), bodydata.size(), "ETag");
     partdata.uploaded = etag.has_value();
     partdata.petag->etag = peeloff(std::move(etag).value_or(""));
+    if(checksum_type_t::NONE != S3fsCurl::checksum_type){
+        partdata.petag->checksum = simple_parse_xml(bodydata.c_str(), bodydata.size(), get_checksum_xml_tag(S3fsCurl::checksum_type).c_str()).value_or("");
+    }
 
     return true;
 }
@@ -30,7 +30,9 @@
 #include <optional>
 #include <string>
 
+#include "checksum_util.h"
 #include "common.h"
+#include "curl_retry.h"
 #include "metaheader.h"
 #include "s3fs_util.h"
 #include "types.h"
@@ -43,6 +45,10 @@
 //  CURLOPT_TCP_KEEPALIVE           7.25.0 and later
 //  CURLOPT_SSL_ENABLE_ALPN         7.36.0 and later
 //  CURLOPT_KEEP_SENDING_ON_ERROR   7.51.0 and later
+//  CURLOPT_PIPEWAIT                7.43.0 and later
+//  CURL_HTTP_VERSION_2TLS          7.47.0 and later
+//  CURL_LOCK_DATA_CONNECT          7.57.0 and later
+//  CURLMOPT_MAX_CONCURRENT_STREAMS 7.67.0 and later
 //
 // s3fs uses these, if you build s3fs with the old libcurl,
 // substitute the following symbols to avoid errors.
@@ -68,13 +74,47 @@
     #define   S3FS_CURLOPT_KEEP_SENDING_ON_ERROR  static_cast<CURLoption>(245)
 #endif
 
+#if defined(HAVE_CURLOPT_PIPEWAIT) && (HAVE_CURLOPT_PIPEWAIT == 1)
+    #define   S3FS_CURLOPT_PIPEWAIT               CURLOPT_PIPEWAIT
+#else
+    #define   S3FS_CURLOPT_PIPEWAIT               static_cast<CURLoption>(237)
+#endif
+
+#if defined(HAVE_CURL_HTTP_VERSION_2TLS) && (HAVE_CURL_HTTP_VERSION_2TLS == 1)
+    #define   S3FS_CURL_HTTP_VERSION_2TLS         CURL_HTTP_VERSION_2TLS
+#else
+    #define   S3FS_CURL_HTTP_VERSION_2TLS         4L
+#endif
+
+#if defined(HAVE_CURL_LOCK_DATA_CONNECT) && (HAVE_CURL_LOCK_DATA_CONNECT == 1)
+    #define   S3FS_CURL_LOCK_DATA_CONNECT         CURL_LOCK_DATA_CONNECT
+#else
+    #define   S3FS_CURL_LOCK_DATA_CONNECT         static_cast<curl_lock_data>(5)
+#endif
+
+#if defined(HAVE_CURLMOPT_MAX_CONCURRENT_STREAMS) && (HAVE_CURLMOPT_MAX_CONCURRENT_STREAMS == 1)
+    #define   S3FS_CURLMOPT_MAX_CONCURRENT_STREAMS  CURLMOPT_MAX_CONCURRENT_STREAMS
+#else
+    #define   S3FS_CURLMOPT_MAX_CONCURRENT_STREAMS  static_cast<CURLMoption>(16)
+#endif
+
 //----------------------------------------------
 // Structure / Typedefs
 //----------------------------------------------
+// [NOTE]
+// CURLOPT_XFERINFOFUNCTION passes the progress by integers, but the older
+// CURLOPT_PROGRESSFUNCTION passes it by doubles.
+//
+#if LIBCURL_VERSION_NUM >= 0x073100
+using curlprogress_t = curl_off_t;
+#else
+using curlprogress_t = double;
+#endif
+
 struct curlprogress {
-    time_t time;
-    double dl_progress;
-    double ul_progress;
+    time_t         time;
+    curlprogress_t dl_progress;
+    curlprogress_t ul_progress;
 };
 using CurlUniquePtr = std::unique_ptr<CURL, decltype(&curl_easy_cleanup)>;
 
@@ -94,6 +134,12 @@ using sseckeylist_t = std::vector<sseckeymap_t>;
 //
 class S3fsCurl
 {
+    // [NOTE]
+    // As an exception, declare friends to perform the prepared requests
+    // with the curl multi interface in S3fsCurlMulti.
+    //
+    friend class S3fsCurlMulti;
+
     private:
         enum class REQTYPE : int8_t {
             UNSET  = -1,
@@ -136,6 +182,7 @@ class S3fsCurl
         static std::string      ssekmsid;
         static sse_type_t       ssetype;
         static bool             is_content_md5;
+        static checksum_type_t  checksum_type;     // additional checksum(x-amz-checksum-*) for uploading
         static bool             is_verbose;
         static bool             is_dump_body;
         static S3fsCred*        ps3fscred;
@@ -145,7 +192,6 @@ class S3fsCurl
         static std::string      client_priv_key;
         static std::string      client_priv_key_type;
         static std::string      client_key_password;
-        static std::map<const CURL*, curlprogress> curl_progress;
         static std::string      curl_ca_bundle;
         static mimes_t          mimeTypes;
         static std::string      userAgent;
@@ -161,6 +207,7 @@ class S3fsCurl
         static bool             proxy_http;
         static std::string      proxy_userpwd;     // load from file(<username>:<passphrase>)
         static long             ipresolve_type;    // this value is a libcurl symbol.
+        static bool             is_http2;
 
         // variables
         CurlUniquePtr        hCurl PT_GUARDED_BY(curl_handles_lock) = {nullptr, curl_easy_cleanup};
@@ -176,7 +223,16 @@ class S3fsCurl
         off_t                postdata_remaining;   // use by post method and read callback function.
         filepart             partdata;             // use by multipart upload/get object callback
         bool                 is_use_ahbe;          // additional header by extension
-        int                  retry_count;          // retry count, this is used only sleep time before retrying
+        long                 retry_wait_ms;        // wait before the next retry(0 means retrying immediately)
+        curlprogress         progress;             // only accessed by the thread which performs the request
+        std::string          sign_buffer;          // reused for the canonical request and the string to sign
+        std::string          payload_sha256;       // the payload hash for signing, which is computed with Content-MD5 or at the first attempt
+        std::string          payload_checksum;     // the additional checksum(base64) of the uploading part
+        bool                 is_verify_checksum;   // verify the additional checksum of the downloaded object
+        bool                 is_verify_fallback;   // retry the download as the range request without verifying
+        bool                 is_hedge;             // hedged request(duplicate) in S3fsCurlMulti
+        ChecksumCalculator   download_checksum;    // the additional checksum of the downloading object
+        long                 retry_prev_wait_ms;   // previous wait for the jitter of the next wait
         std::unique_ptr<FILE, decltype(&s3fs_fclose)> b_infile = {nullptr, &s3fs_fclose};  // backup for retrying
         const unsigned char* b_postdata;           // backup for retrying
         off_t                b_postdata_remaining; // backup for retrying
@@ -207,7 +263,7 @@ class S3fsCurl
         static bool DestroyGlobalCurl();
         static bool InitCryptMutex();
         static bool DestroyCryptMutex();
-        static int CurlProgress(void *clientp, double dltotal, double dlnow, double ultotal, double ulnow);
+        static int CurlProgress(void *clientp, curlprogress_t dltotal, curlprogress_t dlnow, curlprogress_t ultotal, curlprogress_t ulnow);
         static std::string extractURI(const std::string& url);
 
         static bool LocateBundle();
@@ -215,6 +271,7 @@ class S3fsCurl
         static size_t WriteMemoryCallback(void *ptr, size_t blockSize, size_t numBlocks, void *data);
         static size_t ReadCallback(void *ptr, size_t size, size_t nmemb, void *userp);
         static size_t UploadReadCallback(void *ptr, size_t size, size_t nmemb, void *userp);
+        static size_t FileReadCallback(void *ptr, size_t size, size_t nmemb, void *userp);
         static size_t DownloadWriteCallback(void* ptr, size_t size, size_t nmemb, void* userp);
 
         // lazy functions for set curl options
@@ -236,17 +293,19 @@ class S3fsCurl
         // methods
         bool ResetHandle() REQUIRES(S3fsCurl::curl_handles_lock);
         bool RemakeHandle();
-        void WaitBeforeRetry();
+        bool ScheduleRetry(retry_class rclass, int retrycnt);
+        bool IsPriorityRequest() const;
+        bool PreparePerform(bool dontAddAuthHeaders);
+        int CheckPerformResult(int retrycnt, long& responseCode);
+        int FinishPerform(int result, long responseCode);
         bool ClearInternalData();
         bool insertV4Headers(const std::string& access_key_id, const std::string& secret_access_key, const std::string& access_token);
         void insertV2Headers(const std::string& access_key_id, const std::string& secret_access_key, const std::string& access_token);
         void insertIBMIAMHeaders(const std::string& access_key_id, const std::string& access_token);
+        bool IsSignedPayloadHash() const;
+        bool VerifyDownloadChecksum();
         bool insertAuthHeaders();
         bool AddSseRequestHead(sse_type_t ssetype, std::string ssevalue, bool is_copy);
-        bool PreHeadRequest(const char* tpath, size_t ssekey_pos = SIZE_MAX);
-        bool PreHeadRequest(const std::string& tpath, size_t ssekey_pos = SIZE_MAX) {
-            return PreHeadRequest(tpath.c_str(), ssekey_pos);
-        }
         std::string CalcSignatureV2(const std::string& method, const std::string& strMD5, const std::string& content_type, const std::string& date, const std::string& resource, const std::string& secret_access_key, const std::string& access_token);
         std::string CalcSignature(const std::string& method, const std::string& canonical_uri, const std::string& query_string, const std::string& strdate, const std::string& payload_hash, const std::string& date8601, const std::string& secret_access_key, const std::string& access_token);
         int MultipartUploadContentPartSetup(const char* tpath, int part_num, const std::string& upload_id);
@@ -293,6 +352,8 @@ class S3fsCurl
         static std::optional<std::string> GetSseKeyMd5(size_t pos);
         static size_t GetSseKeyCount();
         static bool SetContentMd5(bool flag);
+        static checksum_type_t SetChecksumType(checksum_type_t type) { checksum_type_t old = S3fsCurl::checksum_type; S3fsCurl::checksum_type = type; return old; }
+        static checksum_type_t GetChecksumType() { return S3fsCurl::checksum_type; }
         static bool SetVerbose(bool flag);
         static bool GetVerbose() { return S3fsCurl::is_verbose; }
         static bool SetDumpBody(bool flag);
@@ -319,6 +380,8 @@ class S3fsCurl
         static bool SetProxy(const char* url);
         static bool SetProxyUserPwd(const char* userpwd);
         static bool SetIPResolveType(const char* value);
+        static bool SetHttp2(bool flag) { bool old_flag = S3fsCurl::is_http2; S3fsCurl::is_http2 = flag; return old_flag; }
+        static bool IsHttp2() { return S3fsCurl::is_http2; }
 
         // methods
         bool CreateCurlHandle(bool remake = false);
@@ -333,10 +396,16 @@ class S3fsCurl
         int DeleteRequest(const char* tpath);
         int GetIAMv2ApiToken(const char* token_url, int token_ttl, const char* token_ttl_hdr, std::string& response);
         int HeadRequest(const char* tpath, headers_t& meta);
+        void GetHeadResponseMeta(headers_t& meta) const;
         int PutHeadRequest(const char* tpath, const headers_t& meta, bool is_copy);
         int PutRequest(const char* tpath, headers_t& meta, int fd);
-        int PreGetObjectRequest(const char* tpath, int fd, off_t start, off_t size, sse_type_t ssetype, const std::string& ssevalue);
-        int GetObjectRequest(const char* tpath, int fd, off_t start, off_t size, sse_type_t ssetype, const std::string& ssevalue);
+        int PreGetObjectRequest(const char* tpath, int fd, off_t start, off_t size, sse_type_t ssetype, const std::string& ssevalue, bool is_whole_object = false);
+        bool AddIfMatchHeader(const std::string& etag);
+        bool PreHeadRequest(const char* tpath, size_t ssekey_pos = SIZE_MAX);
+        bool PreHeadRequest(const std::string& tpath, size_t ssekey_pos = SIZE_MAX) {
+            return PreHeadRequest(tpath.c_str(), ssekey_pos);
+        }
+        int GetObjectRequest(const char* tpath, int fd, off_t start, off_t size, sse_type_t ssetype, const std::string& ssevalue, bool is_whole_object = false);
         int CheckBucket(const char* check_path, bool compat_dir, bool force_no_sse);
         int ListBucketRequest(const char* tpath, const char* query);
         int PreMultipartUploadRequest(const char* tpath, const headers_t& meta, std::string& upload_id);
@@ -354,6 +423,7 @@ class S3fsCurl
         const std::string& GetOp() const { return op; }
         const headers_t* GetResponseHeaders() const { return &responseHeaders; }
         const std::string& GetBodyData() const { return bodydata; }
+        void SwapBodyData(std::string& body) { bodydata.swap(body); }
         const std::string& GetHeadData() const { return headdata; }
         CURLcode GetCurlCode() const { return curlCode; }
         long GetLastResponseCode() const { return LastResponseCode; }
@@ -0,0 +1,126 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <algorithm>
+
+#include "s3fs_logger.h"
+#include "curl_hedge.h"
+
+//-------------------------------------------------------------------
+// Class S3fsHedgePolicy
+//-------------------------------------------------------------------
+int               S3fsHedgePolicy::percentile     = 0;      // default is disabled
+int               S3fsHedgePolicy::budget_percent = 5;
+std::atomic<long> S3fsHedgePolicy::budget_tokens(0);
+std::atomic<long> S3fsHedgePolicy::delay_ms[static_cast<int>(hedge_req_t::MAX)] = {{-1}, {-1}};
+std::mutex        S3fsHedgePolicy::samples_lock;
+S3fsHedgePolicy::hedge_samples S3fsHedgePolicy::samples[static_cast<int>(hedge_req_t::MAX)];
+
+//-------------------------------------------------------------------
+// Class methods for S3fsHedgePolicy
+//-------------------------------------------------------------------
+bool S3fsHedgePolicy::SetPercentile(int value)
+{
+    if(value < 0 || 100 <= value){
+        return false;
+    }
+    S3fsHedgePolicy::percentile = value;
+    return true;
+}
+
+bool S3fsHedgePolicy::SetBudget(int percent)
+{
+    if(percent < 0 || 100 < percent){
+        return false;
+    }
+    S3fsHedgePolicy::budget_percent = percent;
+    return true;
+}
+
+//
+// Adds the time to the first byte of a successful request.
+//
+void S3fsHedgePolicy::AddSample(hedge_req_t rtype, long first_byte_ms)
+{
+    const std::lock_guard<std::mutex> lock(S3fsHedgePolicy::samples_lock);
+
+    hedge_samples& typesamples = S3fsHedgePolicy::samples[static_cast<int>(rtype)];
+    if(typesamples.samples.size() < MAX_SAMPLES){
+        typesamples.samples.push_back(first_byte_ms);
+    }else{
+        typesamples.samples[typesamples.pos] = first_byte_ms;
+        typesamples.pos = (typesamples.pos + 1) % MAX_SAMPLES;
+    }
+    if(0 == (++typesamples.added % UPDATE_SAMPLES)){
+        UpdateDelayHasLock(rtype);
+    }
+}
+
+void S3fsHedgePolicy::UpdateDelayHasLock(hedge_req_t rtype)
+{
+    const hedge_samples& typesamples = S3fsHedgePolicy::samples[static_cast<int>(rtype)];
+    if(typesamples.samples.size() < MIN_SAMPLES){
+        return;
+    }
+    std::vector<long> sorted(typesamples.samples);
+    auto              nth = sorted.begin() + static_cast<std::vector<long>::difference_type>((sorted.size() - 1) * S3fsHedgePolicy::percentile / 100);
+    std::nth_element(sorted.begin(), nth, sorted.end());
+
+    S3fsHedgePolicy::delay_ms[static_cast<int>(rtype)] = std::max(1L, *nth);
+    S3FS_PRN_DBG("The delay of hedged %s request is updated to %ld ms(p%d).", (hedge_req_t::HEAD == rtype ? "HEAD" : "GET"), static_cast<long>(S3fsHedgePolicy::delay_ms[static_cast<int>(rtype)]), S3fsHedgePolicy::percentile);
+}
+
+//
+// Adds the percentage of a token to the budget for a request which can
+// be hedged.
+//
+void S3fsHedgePolicy::NotifyRequest()
+{
+    long tokens = S3fsHedgePolicy::budget_tokens.load();
+    while(tokens < BUDGET_BURST * TOKEN_UNIT){
+        if(S3fsHedgePolicy::budget_tokens.compare_exchange_weak(tokens, std::min(tokens + S3fsHedgePolicy::budget_percent, BUDGET_BURST * TOKEN_UNIT))){
+            break;
+        }
+    }
+}
+
+//
+// Returns true if a hedged request can be sent within the budget.
+//
+bool S3fsHedgePolicy::AcquireHedge()
+{
+    long tokens = S3fsHedgePolicy::budget_tokens.load();
+    do{
+        if(tokens < TOKEN_UNIT){
+            return false;
+        }
+    }while(!S3fsHedgePolicy::budget_tokens.compare_exchange_weak(tokens, tokens - TOKEN_UNIT));
+
+    return true;
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -0,0 +1,106 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef S3FS_CURL_HEDGE_H_
+#define S3FS_CURL_HEDGE_H_
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "common.h"
+
+//----------------------------------------------
+// Structure / Typedefs
+//----------------------------------------------
+// The type of the requests, the delay is estimated for each type
+//
+enum class hedge_req_t : int {
+    GET = 0,
+    HEAD,
+    MAX
+};
+
+//----------------------------------------------
+// class S3fsHedgePolicy
+//----------------------------------------------
+// This class decides when a hedged(duplicated) request is sent for a
+// GET or HEAD request which has not received the first byte yet.
+//
+// The delay is the percentile(hedge_percentile option) of the time to
+// the first byte of the recent successful requests, so only the requests
+// in the tail of the latency are hedged. The GET and HEAD requests have
+// their own samples and delays, because the time to the first byte of a
+// GET request includes reading the object on the server.
+// The number of the hedged requests is limited by a token bucket. Each
+// request which can be hedged adds the percentage(hedge_budget option)
+// of a token, and each hedged request takes a token. The bucket holds
+// up to BUDGET_BURST tokens, so the limit follows the recent requests
+// instead of all requests since the start.
+//
+class S3fsHedgePolicy
+{
+    private:
+        struct hedge_samples
+        {
+            std::vector<long> samples;
+            size_t            pos   = 0;
+            size_t            added = 0;
+        };
+
+        static constexpr size_t MAX_SAMPLES    = 1024;   // the number of recent samples
+        static constexpr size_t MIN_SAMPLES    = 64;     // do not hedge until the samples are enough
+        static constexpr size_t UPDATE_SAMPLES = 64;     // the interval to update the delay
+        static constexpr long   TOKEN_UNIT     = 100;    // a token in the budget(in percent)
+        static constexpr long   BUDGET_BURST   = 10;     // the maximum tokens in the budget
+
+        static int                 percentile;            // 0 means disabled
+        static int                 budget_percent;
+        static std::atomic<long>   budget_tokens;         // in percent of a token
+        static std::atomic<long>   delay_ms[static_cast<int>(hedge_req_t::MAX)];    // -1 means not enough samples
+        static std::mutex          samples_lock;
+        static hedge_samples       samples[static_cast<int>(hedge_req_t::MAX)] GUARDED_BY(samples_lock);
+
+    private:
+        static void UpdateDelayHasLock(hedge_req_t rtype) REQUIRES(samples_lock);
+
+    public:
+        static bool SetPercentile(int value);
+        static int GetPercentile() { return S3fsHedgePolicy::percentile; }
+        static bool IsEnabled() { return (0 < S3fsHedgePolicy::percentile); }
+        static bool SetBudget(int percent);
+        static int GetBudget() { return S3fsHedgePolicy::budget_percent; }
+
+        static void AddSample(hedge_req_t rtype, long first_byte_ms);
+        static long GetDelayMs(hedge_req_t rtype) { return S3fsHedgePolicy::delay_ms[static_cast<int>(rtype)]; }
+        static void NotifyRequest();
+        static bool AcquireHedge();
+};
+
+#endif // S3FS_CURL_HEDGE_H_
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -0,0 +1,584 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <poll.h>
+#include <utility>
+
+#include "s3fs_logger.h"
+#include "adaptive_concurrency.h"
+#include "curl_hedge.h"
+#include "curl_multi.h"
+#include "string_util.h"
+
+//-------------------------------------------------------------------
+// Symbols
+//-------------------------------------------------------------------
+static constexpr int CURL_MULTI_WAIT_TIMEOUT_MS = 1000;  // maximum timeout for waiting any activity on the sockets
+
+//-------------------------------------------------------------------
+// Utility functions
+//-------------------------------------------------------------------
+//
+// Returns true if the failure of a request might not happen to the
+// other request of the hedged pair, that is a communication error or a
+// response code which is retried.
+// The other error responses(403, 404, 412, etc) are the answers for both
+// requests.
+//
+static bool is_transient_failure(CURLcode code, int result, long responseCode)
+{
+    if(CURLE_OK != code || S3fsCurl::S3FSCURL_PERFORM_RESULT_NOTSET == result || S3fsCurl::S3FSCURL_RESPONSECODE_FATAL_ERROR == responseCode){
+        return true;
+    }
+    return (429 == responseCode || 500 == responseCode || 502 == responseCode || 503 == responseCode || 504 == responseCode);
+}
+
+//-------------------------------------------------------------------
+// Class S3fsCurlMulti
+//-------------------------------------------------------------------
+int  S3fsCurlMulti::max_streams            = 0;     // default is not using curl multi interface
+long S3fsCurlMulti::max_concurrent_streams = 100;   // same as libcurl default
+
+//-------------------------------------------------------------------
+// Class methods for S3fsCurlMulti
+//-------------------------------------------------------------------
+int S3fsCurlMulti::SetMaxStreams(int count)
+{
+    int old = S3fsCurlMulti::max_streams;
+    S3fsCurlMulti::max_streams = count;
+    return old;
+}
+
+long S3fsCurlMulti::SetMaxConcurrentStreams(long count)
+{
+    long old = S3fsCurlMulti::max_concurrent_streams;
+    S3fsCurlMulti::max_concurrent_streams = count;
+    return old;
+}
+
+//
+// Keeps the sockets to wait and their events which libcurl wants.
+//
+int S3fsCurlMulti::SocketCallback(CURL* /*hCurl*/, curl_socket_t sockfd, int what, void* userp, void* /*socketp*/)
+{
+    auto* pcurlmulti = static_cast<S3fsCurlMulti*>(userp);
+    if(CURL_POLL_REMOVE == what){
+        pcurlmulti->sockets.erase(sockfd);
+    }else{
+        pcurlmulti->sockets[sockfd] = what;
+    }
+    return 0;
+}
+
+//
+// Keeps the time when libcurl wants to be called for its timeout.
+// The timer is not repeated, and -1 means deleting the timer.
+//
+int S3fsCurlMulti::TimerCallback(CURLM* /*hMulti*/, long timeout_ms, void* userp)
+{
+    auto* pcurlmulti = static_cast<S3fsCurlMulti*>(userp);
+    if(timeout_ms < 0){
+        pcurlmulti->curl_timeout.reset();
+    }else{
+        pcurlmulti->curl_timeout = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    }
+    return 0;
+}
+
+//-------------------------------------------------------------------
+// Methods for S3fsCurlMulti
+//-------------------------------------------------------------------
+S3fsCurlMulti::S3fsCurlMulti() : hMulti(curl_multi_init(), curl_multi_cleanup)
+{
+    if(hMulti){
+        if(CURLM_OK != curl_multi_setopt(hMulti.get(), CURLMOPT_SOCKETFUNCTION, S3fsCurlMulti::SocketCallback) ||
+           CURLM_OK != curl_multi_setopt(hMulti.get(), CURLMOPT_SOCKETDATA, this) ||
+           CURLM_OK != curl_multi_setopt(hMulti.get(), CURLMOPT_TIMERFUNCTION, S3fsCurlMulti::TimerCallback) ||
+           CURLM_OK != curl_multi_setopt(hMulti.get(), CURLMOPT_TIMERDATA, this))
+        {
+            S3FS_PRN_ERR("Failed to set the socket and timer callbacks to curl multi handle.");
+            hMulti.reset();
+        }
+    }
+    if(hMulti && S3fsCurl::IsHttp2()){
+        CURLMcode mcode;
+        if(CURLM_OK != (mcode = curl_multi_setopt(hMulti.get(), CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX))){
+            S3FS_PRN_WARN("Failed to set CURLMOPT_PIPELINING to curl multi handle: %s", curl_multi_strerror(mcode));
+        }
+        if(CURLM_OK != (mcode = curl_multi_setopt(hMulti.get(), S3FS_CURLMOPT_MAX_CONCURRENT_STREAMS, S3fsCurlMulti::max_concurrent_streams))){
+            S3FS_PRN_WARN("Failed to set CURLMOPT_MAX_CONCURRENT_STREAMS to curl multi handle, you need to use libcurl 7.67.0 or later: %s", curl_multi_strerror(mcode));
+        }
+    }
+}
+
+S3fsCurlMulti::~S3fsCurlMulti()
+{
+    RemoveAllRequests();
+}
+
+void S3fsCurlMulti::RemoveAllRequests()
+{
+    if(hMulti){
+        for(const auto& iter: inflight){
+            curl_multi_remove_handle(hMulti.get(), const_cast<CURL*>(iter.first));
+        }
+    }
+    inflight.clear();
+    for(auto& request: requests){
+        request.hedge.reset();
+    }
+    parked.clear();
+}
+
+bool S3fsCurlMulti::SetupRequest(S3fsCurl* s3fscurl)
+{
+    if(!s3fscurl->fpLazySetup || !s3fscurl->fpLazySetup(s3fscurl)){
+        S3FS_PRN_ERR("Failed to lazy setup for the request(%s).", s3fscurl->GetPath().c_str());
+        return false;
+    }
+    s3fscurl->LastResponseCode = S3fsCurl::S3FSCURL_RESPONSECODE_NOTSET;
+    return true;
+}
+
+//
+// Adds the request which is made by Pre*Request method of S3fsCurl.
+// The curl options are set by its lazy setup function here.
+// If fpHedge is set, the request can be hedged by the request which is
+// made by it.
+//
+bool S3fsCurlMulti::Add(std::unique_ptr<S3fsCurl> s3fscurl, s3fscurl_hedge_factory fpHedge)
+{
+    if(!s3fscurl){
+        return false;
+    }
+    S3fsCurl* ps3fscurl = s3fscurl.get();
+    return AddRequest(ps3fscurl, std::move(s3fscurl), std::move(fpHedge));
+}
+
+//
+// Adds the request which is owned by the caller(e.g. the S3fsCurl object
+// of the worker thread). The caller must keep it until Clear is called
+// or this object is destroyed.
+//
+bool S3fsCurlMulti::Add(S3fsCurl& s3fscurl, s3fscurl_hedge_factory fpHedge)
+{
+    return AddRequest(&s3fscurl, nullptr, std::move(fpHedge));
+}
+
+bool S3fsCurlMulti::AddRequest(S3fsCurl* s3fscurl, std::unique_ptr<S3fsCurl> owner, s3fscurl_hedge_factory fpHedge)
+{
+    if(!SetupRequest(s3fscurl)){
+        return false;
+    }
+
+    multi_request request;
+    request.owner      = std::move(owner);
+    request.s3fscurl   = s3fscurl;
+    request.hedge_type = (S3fsCurl::REQTYPE::HEAD == s3fscurl->type ? hedge_req_t::HEAD : hedge_req_t::GET);
+    request.fpHedge    = std::move(fpHedge);
+    requests.push_back(std::move(request));
+
+    return true;
+}
+
+//
+// Removes all requests, so that this object can be used for the next
+// requests with the connections which are kept by the curl multi handle.
+//
+void S3fsCurlMulti::Clear()
+{
+    RemoveAllRequests();
+    requests.clear();
+}
+
+//
+// Replaces the request with its hedged request.
+// The original request is destroyed if this object owns it.
+//
+void S3fsCurlMulti::AdoptHedge(multi_request& request)
+{
+    request.owner    = std::move(request.hedge);
+    request.s3fscurl = request.owner.get();
+}
+
+bool S3fsCurlMulti::StartHandle(S3fsCurl* s3fscurl, multi_request& request)
+{
+    CURL* hCurl = s3fscurl->hCurl.get();
+
+    if(S3fsLog::IsS3fsLogDbg()){
+        char* ptr_url = nullptr;
+        curl_easy_getinfo(hCurl, CURLINFO_EFFECTIVE_URL, &ptr_url);
+        S3FS_PRN_DBG("connecting to URL %s", SAFESTRPTR(ptr_url));
+    }
+
+    if(!s3fscurl->PreparePerform(false)){
+        return false;
+    }
+    CURLMcode mcode;
+    if(CURLM_OK != (mcode = curl_multi_add_handle(hMulti.get(), hCurl))){
+        S3FS_PRN_ERR("Failed to add the request(%s) to curl multi handle: %s", s3fscurl->GetPath().c_str(), curl_multi_strerror(mcode));
+        return false;
+    }
+    inflight[hCurl] = &request;
+
+    return true;
+}
+
+bool S3fsCurlMulti::StartRequest(multi_request& request)
+{
+    if(request.fpHedge && S3fsHedgePolicy::IsEnabled()){
+        S3fsHedgePolicy::NotifyRequest();
+    }
+    request.started = std::chrono::steady_clock::now();
+    return StartHandle(request.s3fscurl, request);
+}
+
+//
+// Sends the hedged requests for the requests which have not received
+// the first byte after the delay.
+//
+void S3fsCurlMulti::StartHedgeRequests()
+{
+    if(!S3fsHedgePolicy::IsEnabled()){
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+
+    std::vector<multi_request*> candidates;
+    for(const auto& iter: inflight){
+        multi_request* prequest = iter.second;
+        long           delay_ms = S3fsHedgePolicy::GetDelayMs(prequest->hedge_type);
+        if(prequest->fpHedge && !prequest->is_hedged && 0 <= delay_ms && (now - prequest->started) >= std::chrono::milliseconds(delay_ms)){
+            candidates.push_back(prequest);
+        }
+    }
+
+    for(multi_request* prequest: candidates){
+        prequest->is_hedged = true;
+
+        double starttransfer = 0.0;
+        if(CURLE_OK != curl_easy_getinfo(prequest->s3fscurl->hCurl.get(), CURLINFO_STARTTRANSFER_TIME, &starttransfer) || 0.0 < starttransfer){
+            // already received the first byte
+            continue;
+        }
+        if(!S3fsHedgePolicy::AcquireHedge()){
+            continue;
+        }
+
+        std::unique_ptr<S3fsCurl> hedge = prequest->fpHedge();
+        if(!hedge || !SetupRequest(hedge.get())){
+            S3FS_PRN_WARN("Failed to make the hedged request for %s, but continue...", prequest->s3fscurl->GetPath().c_str());
+            continue;
+        }
+        S3FS_PRN_INFO3("Send the hedged request for %s after %ld ms.", prequest->s3fscurl->GetPath().c_str(), S3fsHedgePolicy::GetDelayMs(prequest->hedge_type));
+
+        hedge->is_hedge  = true;
+        S3fsCurl* phedge = hedge.get();
+        prequest->hedge  = std::move(hedge);
+        if(!StartHandle(phedge, *prequest)){
+            prequest->hedge.reset();
+        }
+    }
+}
+
+//
+// Handles a finished curl handle of the request.
+// If the request has the hedged request, the first response is used and
+// the other request is cancelled. But if the request failed by the
+// communication error or the response code which is retried, the other
+// request is left to run.
+//
+void S3fsCurlMulti::FinishHandle(multi_request& request, CURL* hCurl, CURLcode code)
+{
+    S3fsCurl* s3fscurl = ((request.hedge && request.hedge->hCurl.get() == hCurl) ? request.hedge.get() : request.s3fscurl);
+
+    s3fscurl->curlCode = code;
+    if(CURLE_OK != code){
+        S3FS_PRN_ERR("CURL ERROR(%d) : %s", code, curl_easy_strerror(code));
+    }
+    long responseCode = S3fsCurl::S3FSCURL_RESPONSECODE_NOTSET;
+    int  result       = s3fscurl->CheckPerformResult(request.retrycnt, responseCode);
+
+    if(request.hedge){
+        bool  is_hedge = (request.hedge.get() == s3fscurl);
+        CURL* hOther   = (is_hedge ? request.s3fscurl->hCurl.get() : request.hedge->hCurl.get());
+
+        if(0 != result && is_transient_failure(code, result, responseCode) && 0 < inflight.count(hOther)){
+            S3FS_PRN_INFO("The request for %s failed(%d), but the other request is running.", request.s3fscurl->GetPath().c_str(), result);
+            if(!is_hedge){
+                AdoptHedge(request);
+            }
+            request.hedge.reset();
+            return;
+        }
+
+        // cancel the other
+        if(0 < inflight.erase(hOther)){
+            curl_multi_remove_handle(hMulti.get(), hOther);
+        }
+        if(is_hedge){
+            S3FS_PRN_INFO3("The hedged request for %s finished first.", request.s3fscurl->GetPath().c_str());
+            AdoptHedge(request);
+        }
+        request.hedge.reset();
+    }
+    CompleteRequest(request, result, responseCode);
+}
+
+//
+// Completes the request with the result of S3fsCurl::CheckPerformResult
+// as same as S3fsCurl::RequestPerform, and starts it again if it should
+// be retried.
+//
+void S3fsCurlMulti::CompleteRequest(multi_request& request, int result, long responseCode)
+{
+    S3fsCurl* s3fscurl = request.s3fscurl;
+
+    if(S3fsCurl::S3FSCURL_PERFORM_RESULT_NOTSET == result && ++request.retrycnt < S3fsCurl::retries){
+        S3FS_PRN_INFO("Communication error(%d time): Retry up to the limit.", request.retrycnt - 1);
+
+        if(!s3fscurl->RemakeHandle()){
+            S3FS_PRN_INFO("Failed to reset handle and internal data for retrying.");
+            result = -EIO;
+        }else if(0 < s3fscurl->retry_wait_ms){
+            parked.emplace(std::chrono::steady_clock::now() + std::chrono::milliseconds(s3fscurl->retry_wait_ms), &request);
+            return;
+        }else if(StartRequest(request)){
+            return;
+        }else{
+            result = -EIO;
+        }
+    }
+    request.result = s3fscurl->FinishPerform(result, responseCode);
+}
+
+//
+// Starts the parked requests whose wait for retrying has expired.
+//
+void S3fsCurlMulti::StartParkedRequests()
+{
+    auto now = std::chrono::steady_clock::now();
+    while(!parked.empty() && parked.begin()->first <= now){
+        multi_request* prequest = parked.begin()->second;
+        parked.erase(parked.begin());
+
+        if(!StartRequest(*prequest)){
+            prequest->result = prequest->s3fscurl->FinishPerform(-EIO, S3fsCurl::S3FSCURL_RESPONSECODE_NOTSET);
+        }
+    }
+}
+
+//
+// Returns the timeout for waiting, which is not over the first parked
+// request to be started.
+//
+int S3fsCurlMulti::GetWaitTimeoutMs() const
+{
+    auto now     = std::chrono::steady_clock::now();
+    auto timeout = now + std::chrono::milliseconds(CURL_MULTI_WAIT_TIMEOUT_MS);
+    if(!parked.empty()){
+        timeout = std::min(timeout, parked.begin()->first);
+    }
+    if(curl_timeout){
+        timeout = std::min(timeout, *curl_timeout);
+    }
+
+    // the time to send the hedged request
+    if(S3fsHedgePolicy::IsEnabled()){
+        for(const auto& iter: inflight){
+            long delay_ms = S3fsHedgePolicy::GetDelayMs(iter.second->hedge_type);
+            if(iter.second->fpHedge && !iter.second->is_hedged && 0 <= delay_ms){
+                timeout = std::min(timeout, iter.second->started + std::chrono::milliseconds(delay_ms));
+            }
+        }
+    }
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(timeout - now).count();
+    return static_cast<int>(std::max<decltype(wait)>(0, wait));
+}
+
+//
+// Lets libcurl handle the events of the socket, or its timeout if the
+// socket is CURL_SOCKET_TIMEOUT.
+//
+bool S3fsCurlMulti::SocketAction(curl_socket_t sockfd, int events)
+{
+    int       running = 0;
+    CURLMcode mcode;
+    if(CURLM_OK != (mcode = curl_multi_socket_action(hMulti.get(), sockfd, events, &running))){
+        S3FS_PRN_ERR("Failed to perform curl multi handle: %s", curl_multi_strerror(mcode));
+        return false;
+    }
+    return true;
+}
+
+//
+// Waits until any socket is ready or any timeout is expired, and lets
+// libcurl transfer the data on the ready sockets or handle its timeout.
+//
+bool S3fsCurlMulti::WaitSockets()
+{
+    std::vector<struct pollfd> fds;
+    fds.reserve(sockets.size());
+    for(const auto& iter: sockets){
+        struct pollfd fd = {};
+        fd.fd            = iter.first;
+        fd.events        = static_cast<short>(((iter.second & CURL_POLL_IN) ? POLLIN : 0) | ((iter.second & CURL_POLL_OUT) ? POLLOUT : 0));
+        fds.push_back(fd);
+    }
+
+    int nready = poll(fds.data(), fds.size(), GetWaitTimeoutMs());
+    if(-1 == nready){
+        if(EINTR != errno){
+            S3FS_PRN_ERR("Failed to wait the sockets of curl multi handle(errno=%d).", errno);
+            return false;
+        }
+        nready = 0;
+    }
+
+    for(const auto& fd: fds){
+        if(nready <= 0){
+            break;
+        }
+        if(0 == fd.revents){
+            continue;
+        }
+        --nready;
+
+        // [NOTE]
+        // The socket may have been closed by the action for the other socket.
+        if(0 == sockets.count(fd.fd)){
+            continue;
+        }
+        int events = 0;
+        if(0 != (fd.revents & (POLLIN | POLLHUP))){
+            events |= CURL_CSELECT_IN;
+        }
+        if(0 != (fd.revents & POLLOUT)){
+            events |= CURL_CSELECT_OUT;
+        }
+        if(0 != (fd.revents & (POLLERR | POLLNVAL))){
+            events |= CURL_CSELECT_ERR;
+        }
+        if(!SocketAction(fd.fd, events)){
+            return false;
+        }
+    }
+
+    if(curl_timeout && *curl_timeout <= std::chrono::steady_clock::now()){
+        curl_timeout.reset();
+        if(!SocketAction(CURL_SOCKET_TIMEOUT, 0)){
+            return false;
+        }
+    }
+    return true;
+}
+
+//
+// Returns the number of the streams which can be transferred at the same
+// time. If the adaptive concurrency is enabled, the streams are limited
+// to its current limit too.
+//
+int S3fsCurlMulti::GetStreamLimit()
+{
+    int limit = std::max(1, S3fsCurlMulti::max_streams);
+    if(AdaptiveConcurrency::IsEnabled()){
+        limit = std::min(limit, AdaptiveConcurrency::GetLimit());
+    }
+    return limit;
+}
+
+//
+// Performs all added requests, and returns the first error if any.
+//
+int S3fsCurlMulti::Perform()
+{
+    if(!hMulti){
+        S3FS_PRN_ERR("Curl multi handle is not initialized.");
+        return -EIO;
+    }
+
+    int    result = 0;
+    size_t next   = 0;
+    while(next < requests.size() || !inflight.empty() || !parked.empty()){
+        // start parked requests to retry
+        StartParkedRequests();
+
+        // start requests up to max streams(including parked requests)
+        while(next < requests.size() && (inflight.size() + parked.size()) < static_cast<size_t>(S3fsCurlMulti::GetStreamLimit())){
+            multi_request& request = requests[next++];
+            if(!StartRequest(request)){
+                request.result = request.s3fscurl->FinishPerform(-EIO, S3fsCurl::S3FSCURL_RESPONSECODE_NOTSET);
+            }
+        }
+
+        // transfer on the ready sockets(or only wait for retrying)
+        if(!inflight.empty() || !parked.empty()){
+            if(!WaitSockets()){
+                RemoveAllRequests();
+                return -EIO;
+            }
+        }
+
+        // check finished requests
+        CURLMsg* msg;
+        int      remaining_msgs = 0;
+        while(nullptr != (msg = curl_multi_info_read(hMulti.get(), &remaining_msgs))){
+            if(CURLMSG_DONE != msg->msg){
+                continue;
+            }
+            auto iter = inflight.find(msg->easy_handle);
+            if(iter == inflight.end()){
+                S3FS_PRN_WARN("Unknown curl handle is finished in curl multi handle.");
+                curl_multi_remove_handle(hMulti.get(), msg->easy_handle);
+                continue;
+            }
+            multi_request* prequest = iter->second;
+            CURL*          hCurl    = msg->easy_handle;
+            CURLcode       code     = msg->data.result;
+            inflight.erase(iter);
+            curl_multi_remove_handle(hMulti.get(), hCurl);
+
+            FinishHandle(*prequest, hCurl, code);
+        }
+
+        // send hedged requests for slow requests
+        StartHedgeRequests();
+    }
+
+    // keep first error
+    for(const auto& request: requests){
+        if(0 != request.result){
+            result = request.result;
+            break;
+        }
+    }
+    return result;
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
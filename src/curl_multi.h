@@ -0,0 +1,144 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef S3FS_CURL_MULTI_H_
+#define S3FS_CURL_MULTI_H_
+
+#include <chrono>
+#include <curl/curl.h>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "curl.h"
+#include "curl_hedge.h"
+
+//----------------------------------------------
+// Structure / Typedefs
+//----------------------------------------------
+using CurlMultiPtr = std::unique_ptr<CURLM, decltype(&curl_multi_cleanup)>;
+
+// Makes a same request as the original for hedging
+using s3fscurl_hedge_factory = std::function<std::unique_ptr<S3fsCurl>()>;
+
+//----------------------------------------------
+// class S3fsCurlMulti
+//----------------------------------------------
+// This class performs many prepared requests at the same time from the
+// calling thread with the curl multi interface.
+// Each request is an S3fsCurl object which is made by Pre*Request method,
+// and it is retried in the same way as S3fsCurl::RequestPerform.
+// The request waiting for retrying is parked on the timer queue, so the
+// other requests are transferred while waiting.
+// If the hedged request is enabled and the request has the factory,
+// the same request is sent again when the first byte is not received
+// after the delay of S3fsHedgePolicy, and the first response is used
+// and the other request is cancelled.
+// Up to max_streams requests are transferred at the same time, so one
+// thread can keep many streams without a thread for each request.
+// The transfers are driven by the readiness of their sockets, which are
+// told by the socket callback of libcurl and waited with poll().
+// If HTTP/2 is enabled, the streams are multiplexed on the connections
+// up to max_concurrent_streams streams per connection.
+// Currently this is used only for the range GET requests of parallel
+// downloads and the part uploads of multipart uploads(curl_multi_streams
+// option). The HEAD, PUT, list, delete, copy and the other requests are
+// still sent by a worker thread for each request with
+// S3fsCurl::RequestPerform.
+//
+class S3fsCurlMulti
+{
+    private:
+        struct multi_request
+        {
+            std::unique_ptr<S3fsCurl> owner;                // the request owned by this object(nullptr if the caller owns it)
+            S3fsCurl*                 s3fscurl = nullptr;
+            hedge_req_t               hedge_type = hedge_req_t::GET;
+            int                       retrycnt = 0;
+            int                       result   = S3fsCurl::S3FSCURL_PERFORM_RESULT_NOTSET;
+            s3fscurl_hedge_factory    fpHedge;
+            std::unique_ptr<S3fsCurl> hedge;                // hedged request in flight
+            bool                      is_hedged = false;    // already hedged(or not need to hedge)
+            std::chrono::steady_clock::time_point started;
+        };
+
+        static int                          max_streams;
+        static long                         max_concurrent_streams;
+
+        CurlMultiPtr                        hMulti = {nullptr, curl_multi_cleanup};
+        std::vector<multi_request>          requests;
+        std::map<const CURL*, multi_request*> inflight;
+        std::multimap<std::chrono::steady_clock::time_point, multi_request*> parked;   // timer queue for retrying
+        std::map<curl_socket_t, int>        sockets;        // sockets to wait and their CURL_POLL_* events
+        std::optional<std::chrono::steady_clock::time_point> curl_timeout;   // timeout requested by libcurl
+
+    private:
+        static int SocketCallback(CURL* hCurl, curl_socket_t sockfd, int what, void* userp, void* socketp);
+        static int TimerCallback(CURLM* hMulti, long timeout_ms, void* userp);
+        static bool SetupRequest(S3fsCurl* s3fscurl);
+        static void AdoptHedge(multi_request& request);
+        bool AddRequest(S3fsCurl* s3fscurl, std::unique_ptr<S3fsCurl> owner, s3fscurl_hedge_factory fpHedge);
+        static int GetStreamLimit();
+        bool StartHandle(S3fsCurl* s3fscurl, multi_request& request);
+        bool StartRequest(multi_request& request);
+        void StartHedgeRequests();
+        void FinishHandle(multi_request& request, CURL* hCurl, CURLcode code);
+        void CompleteRequest(multi_request& request, int result, long responseCode);
+        void RemoveAllRequests();
+        void StartParkedRequests();
+        int GetWaitTimeoutMs() const;
+        bool SocketAction(curl_socket_t sockfd, int events);
+        bool WaitSockets();
+
+    public:
+        static int SetMaxStreams(int count);
+        static int GetMaxStreams() { return S3fsCurlMulti::max_streams; }
+        static bool IsEnabled() { return (0 < S3fsCurlMulti::max_streams); }
+        static long SetMaxConcurrentStreams(long count);
+        static long GetMaxConcurrentStreams() { return S3fsCurlMulti::max_concurrent_streams; }
+
+        // constructor/destructor
+        S3fsCurlMulti();
+        ~S3fsCurlMulti();
+        S3fsCurlMulti(const S3fsCurlMulti&) = delete;
+        S3fsCurlMulti(S3fsCurlMulti&&) = delete;
+        S3fsCurlMulti& operator=(const S3fsCurlMulti&) = delete;
+        S3fsCurlMulti& operator=(S3fsCurlMulti&&) = delete;
+
+        bool Add(std::unique_ptr<S3fsCurl> s3fscurl, s3fscurl_hedge_factory fpHedge = nullptr);
+        bool Add(S3fsCurl& s3fscurl, s3fscurl_hedge_factory fpHedge = nullptr);
+        int Perform();
+        void Clear();
+        const S3fsCurl* GetRequest(size_t pos) const { return (pos < requests.size() ? requests[pos].s3fscurl : nullptr); }
+        S3fsCurl* GetRequest(size_t pos) { return (pos < requests.size() ? requests[pos].s3fscurl : nullptr); }
+};
+
+#endif // S3FS_CURL_MULTI_H_
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -0,0 +1,101 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+
+#include "curl_ratelimit.h"
+
+//-------------------------------------------------------------------
+// Class TokenBucket
+//-------------------------------------------------------------------
+TokenBucket::TokenBucket(clock_func_t clock, sleep_func_t sleep) : clock_func(std::move(clock)), sleep_func(std::move(sleep))
+{
+}
+
+void TokenBucket::DefaultSleep(std::chrono::duration<double> wait)
+{
+    std::this_thread::sleep_for(wait);
+}
+
+void TokenBucket::SetRate(double value)
+{
+    const std::lock_guard<std::mutex> lock(bucket_lock);
+    rate      = std::max(0.0, value);
+    tokens    = rate;
+    last_fill = clock_func();
+}
+
+void TokenBucket::FillHasLock(std::chrono::steady_clock::time_point now)
+{
+    std::chrono::duration<double> elapsed = now - last_fill;
+    last_fill = now;
+    tokens    = std::min(rate, tokens + elapsed.count() * rate);
+}
+
+//
+// [NOTE]
+// The priority caller does not wait for the debt up to one second of the
+// rate, and the others wait for the debt including it. So the priority
+// callers are served first, but the rate is kept even if all callers are
+// priority callers.
+//
+void TokenBucket::Consume(double amount, bool is_priority)
+{
+    std::chrono::duration<double> wait{0.0};
+    {
+        const std::lock_guard<std::mutex> lock(bucket_lock);
+        if(0.0 >= rate){
+            return;
+        }
+        FillHasLock(clock_func());
+
+        tokens -= amount;
+        double debt = (is_priority ? -(tokens + rate) : -tokens);
+        if(0.0 < debt){
+            wait = std::chrono::duration<double>(debt / rate);
+        }
+    }
+    if(0.0 < wait.count()){
+        sleep_func(wait);
+    }
+}
+
+//-------------------------------------------------------------------
+// Class S3fsRateLimiter
+//-------------------------------------------------------------------
+TokenBucket S3fsRateLimiter::upload_bucket;
+TokenBucket S3fsRateLimiter::download_bucket;
+TokenBucket S3fsRateLimiter::request_bucket;
+
+//-------------------------------------------------------------------
+// Class S3fsForeground
+//-------------------------------------------------------------------
+thread_local bool S3fsForeground::is_foreground = false;
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
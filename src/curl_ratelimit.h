@@ -0,0 +1,146 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef S3FS_CURL_RATELIMIT_H_
+#define S3FS_CURL_RATELIMIT_H_
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+
+#include "common.h"
+
+//----------------------------------------------
+// class TokenBucket
+//----------------------------------------------
+// The bucket is filled with "rate" tokens per second up to "rate"(one
+// second of burst).
+// Consume() takes the tokens even if the bucket does not have enough
+// tokens, and sleeps until the debt is paid off. So the callers are
+// served in the order of calling without a queue.
+// The priority caller only sleeps for the debt over one second of the
+// rate, so it goes ahead of the other callers which wait for all debt.
+// The clock and the sleep function can be replaced(for the tests which
+// run on the simulated time).
+//
+class TokenBucket
+{
+    public:
+        typedef std::function<std::chrono::steady_clock::time_point()>   clock_func_t;
+        typedef std::function<void(std::chrono::duration<double>)>      sleep_func_t;
+
+    private:
+        const clock_func_t  clock_func;
+        const sleep_func_t  sleep_func;
+
+        std::mutex  bucket_lock;
+        double      rate GUARDED_BY(bucket_lock) = 0.0;     // 0 means unlimited
+        double      tokens GUARDED_BY(bucket_lock) = 0.0;
+        std::chrono::steady_clock::time_point last_fill GUARDED_BY(bucket_lock);
+
+    private:
+        void FillHasLock(std::chrono::steady_clock::time_point now) REQUIRES(bucket_lock);
+
+    private:
+        static void DefaultSleep(std::chrono::duration<double> wait);
+
+    public:
+        explicit TokenBucket(clock_func_t clock = std::chrono::steady_clock::now, sleep_func_t sleep = TokenBucket::DefaultSleep);
+
+        void SetRate(double value);
+
+        void Consume(double amount, bool is_priority = false);
+};
+
+//----------------------------------------------
+// class S3fsRateLimiter
+//----------------------------------------------
+// This class limits the upload and download bandwidth and the number of
+// requests per second of this mount.
+//
+// - The upload bytes are counted in the read callbacks of the object data
+//   and the download bytes are counted in the write callback of the object
+//   data, so the requests for the metadata(list, head, etc) are not
+//   limited by the bandwidth.
+// - The requests are counted when they are sent(including the retries).
+// - The foreground requests(see S3fsForeground) and the requests for the
+//   credentials are the priority callers of the buckets, they take the
+//   tokens ahead of the other requests.
+//
+class S3fsRateLimiter
+{
+    private:
+        static TokenBucket upload_bucket;       // bytes per second
+        static TokenBucket download_bucket;     // bytes per second
+        static TokenBucket request_bucket;      // requests per second
+
+    public:
+        static void SetUploadRate(off_t bytes) { S3fsRateLimiter::upload_bucket.SetRate(static_cast<double>(bytes)); }
+        static void SetDownloadRate(off_t bytes) { S3fsRateLimiter::download_bucket.SetRate(static_cast<double>(bytes)); }
+        static void SetRequestRate(int count) { S3fsRateLimiter::request_bucket.SetRate(static_cast<double>(count)); }
+
+        static void Upload(size_t bytes, bool is_priority) { S3fsRateLimiter::upload_bucket.Consume(static_cast<double>(bytes), is_priority); }
+        static void Download(size_t bytes, bool is_priority) { S3fsRateLimiter::download_bucket.Consume(static_cast<double>(bytes), is_priority); }
+        static void Request(bool is_priority) { S3fsRateLimiter::request_bucket.Consume(1.0, is_priority); }
+};
+
+//----------------------------------------------
+// class S3fsForeground
+//----------------------------------------------
+// Marks the requests which are sent by the current thread as foreground
+// requests, which the user is waiting for in FUSE operations. The flag
+// is passed to the worker threads with the instructions of ThreadPoolMan.
+// The foreground requests have priority in S3fsRateLimiter, the others
+// (directory prefetch, hedged requests, etc) are background requests.
+//
+class S3fsForeground
+{
+    private:
+        static thread_local bool is_foreground;
+
+        bool prev_foreground;
+
+    public:
+        static bool IsForeground() { return S3fsForeground::is_foreground; }
+
+        explicit S3fsForeground(bool foreground = true) : prev_foreground(S3fsForeground::is_foreground)
+        {
+            S3fsForeground::is_foreground = foreground;
+        }
+        ~S3fsForeground()
+        {
+            S3fsForeground::is_foreground = prev_foreground;
+        }
+        S3fsForeground(const S3fsForeground&) = delete;
+        S3fsForeground(S3fsForeground&&) = delete;
+        S3fsForeground& operator=(const S3fsForeground&) = delete;
+        S3fsForeground& operator=(S3fsForeground&&) = delete;
+};
+
+#endif // S3FS_CURL_RATELIMIT_H_
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -0,0 +1,183 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+
+#include "s3fs_logger.h"
+#include "curl_retry.h"
+#include "string_util.h"
+
+//-------------------------------------------------------------------
+// Class S3fsRetryPolicy
+//-------------------------------------------------------------------
+retry_backoff S3fsRetryPolicy::backoffs[static_cast<int>(retry_class::MAX)] = {
+    {200, 20000},       // THROTTLE
+    {100, 10000},       // SERVER
+    {100,  5000}        // NETWORK
+};
+long              S3fsRetryPolicy::budget_capacity = 500;
+std::atomic<long> S3fsRetryPolicy::budget_tokens(500);
+std::atomic<long> S3fsRetryPolicy::budget_refill_ms(S3fsRetryPolicy::NowMs());
+
+//-------------------------------------------------------------------
+// Class methods for S3fsRetryPolicy
+//-------------------------------------------------------------------
+long S3fsRetryPolicy::NowMs()
+{
+    return static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+//
+// Adds the tokens for the elapsed time since the last refill.
+//
+// [NOTE]
+// Only the thread which updates budget_refill_ms adds the tokens, the
+// remainder of the elapsed time is carried over to the next refill.
+//
+void S3fsRetryPolicy::RefillBudget()
+{
+    long capacity  = S3fsRetryPolicy::budget_capacity;
+    long now_ms    = S3fsRetryPolicy::NowMs();
+    long refill_ms = S3fsRetryPolicy::budget_refill_ms.load();
+    long gain      = (now_ms - refill_ms) * capacity / (BUDGET_REFILL_SEC * 1000);
+    if(gain <= 0){
+        return;
+    }
+    long next_ms = refill_ms + gain * (BUDGET_REFILL_SEC * 1000) / capacity;
+    if(capacity <= gain){
+        next_ms = now_ms;
+    }
+    if(!S3fsRetryPolicy::budget_refill_ms.compare_exchange_strong(refill_ms, next_ms)){
+        return;
+    }
+    long tokens = S3fsRetryPolicy::budget_tokens.load();
+    while(tokens < capacity){
+        if(S3fsRetryPolicy::budget_tokens.compare_exchange_weak(tokens, std::min(tokens + gain, capacity))){
+            break;
+        }
+    }
+}
+
+//
+// The value format is "<base ms>:<cap ms>"
+//
+bool S3fsRetryPolicy::SetBackoff(retry_class rclass, const char* value)
+{
+    if(!value || retry_class::MAX == rclass){
+        return false;
+    }
+    std::string            strvalue(value);
+    std::string::size_type pos = strvalue.find(':');
+    if(std::string::npos == pos){
+        S3FS_PRN_ERR("The backoff value(%s) is not \"<base ms>:<cap ms>\" format.", value);
+        return false;
+    }
+
+    off_t base_ms = 0;
+    off_t cap_ms  = 0;
+    if(!s3fs_strtoofft(&base_ms, strvalue.substr(0, pos).c_str(), /*base=*/ 10) || !s3fs_strtoofft(&cap_ms, strvalue.substr(pos + 1).c_str(), /*base=*/ 10)){
+        S3FS_PRN_ERR("The backoff value(%s) has wrong number.", value);
+        return false;
+    }
+    if(base_ms <= 0 || cap_ms < base_ms){
+        S3FS_PRN_ERR("The backoff value(%s) must be 0 < base ms <= cap ms.", value);
+        return false;
+    }
+    S3fsRetryPolicy::backoffs[static_cast<int>(rclass)] = {static_cast<long>(base_ms), static_cast<long>(cap_ms)};
+
+    return true;
+}
+
+//
+// If capacity is 0, the retry budget is disabled.
+//
+long S3fsRetryPolicy::SetBudget(long capacity)
+{
+    long old = S3fsRetryPolicy::budget_capacity;
+    S3fsRetryPolicy::budget_capacity = capacity;
+    S3fsRetryPolicy::budget_tokens   = capacity;
+    S3fsRetryPolicy::budget_refill_ms = S3fsRetryPolicy::NowMs();
+    return old;
+}
+
+//
+// Returns the wait before the next retry with decorrelated jitter.
+// prev_wait_ms is the previous wait of the request, 0 means the first
+// retry.
+//
+long S3fsRetryPolicy::NextWaitMs(retry_class rclass, long prev_wait_ms)
+{
+    const retry_backoff& backoff = S3fsRetryPolicy::GetBackoff(rclass);
+
+    long upper = std::max(backoff.base_ms, prev_wait_ms) * 3;
+    long wait  = backoff.base_ms + (random() % (upper - backoff.base_ms + 1));
+
+    return std::min(backoff.cap_ms, wait);
+}
+
+//
+// Takes tokens for a retry from the retry budget.
+// Returns false if the budget runs out.
+//
+bool S3fsRetryPolicy::AcquireRetry()
+{
+    if(0 == S3fsRetryPolicy::budget_capacity){
+        return true;
+    }
+    S3fsRetryPolicy::RefillBudget();
+
+    long tokens = S3fsRetryPolicy::budget_tokens.load();
+    do{
+        if(tokens < RETRY_COST){
+            S3FS_PRN_WARN("The retry budget runs out, so do not retry the request.");
+            return false;
+        }
+    }while(!S3fsRetryPolicy::budget_tokens.compare_exchange_weak(tokens, tokens - RETRY_COST));
+
+    return true;
+}
+
+//
+// Returns a token to the retry budget for a successful request.
+//
+void S3fsRetryPolicy::NotifySuccess()
+{
+    if(0 == S3fsRetryPolicy::budget_capacity){
+        return;
+    }
+    long tokens = S3fsRetryPolicy::budget_tokens.load();
+    while(tokens < S3fsRetryPolicy::budget_capacity){
+        if(S3fsRetryPolicy::budget_tokens.compare_exchange_weak(tokens, std::min(tokens + SUCCESS_GAIN, S3fsRetryPolicy::budget_capacity))){
+            break;
+        }
+    }
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
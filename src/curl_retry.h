@@ -0,0 +1,97 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef S3FS_CURL_RETRY_H_
+#define S3FS_CURL_RETRY_H_
+
+#include <atomic>
+
+//----------------------------------------------
+// Structure / Typedefs
+//----------------------------------------------
+// The class of the error for choosing the backoff of retrying
+//
+enum class retry_class : int {
+    THROTTLE = 0,       // 429, 503(SlowDown)
+    SERVER,             // 500, 502, 504
+    NETWORK,            // curl errors(connect, timeout, reset, etc)
+    MAX
+};
+
+struct retry_backoff
+{
+    long base_ms;       // the minimum wait
+    long cap_ms;        // the maximum wait
+};
+
+//----------------------------------------------
+// class S3fsRetryPolicy
+//----------------------------------------------
+// This class decides the wait before retrying a request and whether the
+// request can be retried.
+//
+// The wait is the exponential backoff with decorrelated jitter:
+//   wait = min(cap, random_between(base, previous wait * 3))
+// so that many requests which failed at the same time do not retry at
+// the same time.
+//
+// The retry budget is a token bucket shared by all requests. Each retry
+// takes RETRY_COST tokens and each successful request returns a token.
+// When the server keeps failing, the budget runs out and the requests
+// fail fast instead of piling up the retries. The budget is also refilled
+// over time(the whole capacity in BUDGET_REFILL_SEC seconds), so that the
+// retries are enabled again after an outage even if no request succeeds.
+//
+class S3fsRetryPolicy
+{
+    private:
+        static constexpr long RETRY_COST        = 5;
+        static constexpr long SUCCESS_GAIN      = 1;
+        static constexpr long BUDGET_REFILL_SEC = 10;
+
+        static retry_backoff     backoffs[static_cast<int>(retry_class::MAX)];
+        static long              budget_capacity;
+        static std::atomic<long> budget_tokens;
+        static std::atomic<long> budget_refill_ms;
+
+        static long NowMs();
+        static void RefillBudget();
+
+    public:
+        static bool SetBackoff(retry_class rclass, const char* value);
+        static const retry_backoff& GetBackoff(retry_class rclass) { return S3fsRetryPolicy::backoffs[static_cast<int>(rclass)]; }
+        static long SetBudget(long capacity);
+        static long GetBudget() { return S3fsRetryPolicy::budget_capacity; }
+
+        static long NextWaitMs(retry_class rclass, long prev_wait_ms);
+        static bool AcquireRetry();
+        static void NotifySuccess();
+};
+
+#endif // S3FS_CURL_RETRY_H_
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
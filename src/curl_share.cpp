@@ -19,6 +19,7 @@
  */
 
 #include "s3fs_logger.h"
+#include "curl.h"
 #include "curl_share.h"
 
 //-------------------------------------------------------------------
@@ -26,6 +27,7 @@
 //-------------------------------------------------------------------
 bool                                     S3fsCurlShare::is_dns_cache = true;    // default
 bool                                     S3fsCurlShare::is_ssl_cache = true;    // default
+bool                                     S3fsCurlShare::is_conn_cache = false;  // default
 std::mutex                               S3fsCurlShare::curl_share_lock;
 std::map<std::thread::id, CurlSharePtr>  S3fsCurlShare::ShareHandles;
 std::map<std::thread::id, ShareLocksPtr> S3fsCurlShare::ShareLocks;
@@ -47,6 +49,13 @@ bool S3fsCurlShare::SetSslSessionCache(bool isCache)
     return old;
 }
 
+bool S3fsCurlShare::SetConnectionCache(bool isCache)
+{
+    bool old = S3fsCurlShare::is_conn_cache;
+    S3fsCurlShare::is_conn_cache = isCache;
+    return old;
+}
+
 void S3fsCurlShare::LockCurlShare(CURL* handle, curl_lock_data nLockData, curl_lock_access laccess, void* useptr)
 {
     auto* pLocks  = static_cast<curl_share_locks*>(useptr);
@@ -55,6 +64,8 @@ void S3fsCurlShare::LockCurlShare(CURL* handle, curl_lock_data nLockData, curl_l
         pLocks->lock_dns.lock();
     }else if(CURL_LOCK_DATA_SSL_SESSION == nLockData){
         pLocks->lock_session.lock();
+    }else if(S3FS_CURL_LOCK_DATA_CONNECT == nLockData){
+        pLocks->lock_connect.lock();
     }
 }
 
@@ -66,6 +77,8 @@ void S3fsCurlShare::UnlockCurlShare(CURL* handle, curl_lock_data nLockData, void
         pLocks->lock_dns.unlock();
     }else if(CURL_LOCK_DATA_SSL_SESSION == nLockData){
         pLocks->lock_session.unlock();
+    }else if(S3FS_CURL_LOCK_DATA_CONNECT == nLockData){
+        pLocks->lock_connect.unlock();
     }
 }
 
@@ -138,6 +151,23 @@ bool S3fsCurlShare::InitializeCurlShare(const CurlSharePtr& hShare, const ShareL
             S3FS_PRN_WARN("curl_share_setopt(SSL SESSION) returns %d(%s), but continue without shared ssl session data.", nSHCode, curl_share_strerror(nSHCode));
         }
     }
+    // [NOTE]
+    // The share handle is created for each thread, so the connections
+    // are reused only by the requests of the same thread. libcurl does
+    // not support using a shared connection from multiple concurrent
+    // threads, but it keeps the connections(and HTTP/2 connections)
+    // alive across the curl handles which are re-created for each
+    // request by the thread.
+    //
+    if(S3fsCurlShare::is_conn_cache){
+        nSHCode = curl_share_setopt(hShare.get(), CURLSHOPT_SHARE, S3FS_CURL_LOCK_DATA_CONNECT);
+        if(CURLSHE_OK != nSHCode && CURLSHE_BAD_OPTION != nSHCode && CURLSHE_NOT_BUILT_IN != nSHCode){
+            S3FS_PRN_ERR("curl_share_setopt(CONNECT) returns %d(%s)", nSHCode, curl_share_strerror(nSHCode));
+            return false;
+        }else if(CURLSHE_BAD_OPTION == nSHCode || CURLSHE_NOT_BUILT_IN == nSHCode){
+            S3FS_PRN_WARN("curl_share_setopt(CONNECT) returns %d(%s), but continue without shared connection cache.", nSHCode, curl_share_strerror(nSHCode));
+        }
+    }
 
     return true;
 }
@@ -154,7 +184,7 @@ S3fsCurlShare::S3fsCurlShare() : ThreadId(std::this_thread::get_id())
 
 void S3fsCurlShare::DestroyCurlShareHandle()
 {
-    if(!S3fsCurlShare::is_dns_cache && !S3fsCurlShare::is_ssl_cache){
+    if(!S3fsCurlShare::IsShareEnabled()){
         // Any curl share handle does not exist
         return;
     }
@@ -180,7 +210,7 @@ void S3fsCurlShare::DestroyCurlShareHandle()
 
 CURLSH* S3fsCurlShare::GetCurlShareHandle()
 {
-    if(!S3fsCurlShare::is_dns_cache && !S3fsCurlShare::is_ssl_cache){
+    if(!S3fsCurlShare::IsShareEnabled()){
         // Any curl share handle does not exist
         return nullptr;
     }
@@ -35,6 +35,7 @@
 struct curl_share_locks {
     std::mutex lock_dns;
     std::mutex lock_session;
+    std::mutex lock_connect;
 };
 
 using CurlSharePtr = std::unique_ptr<CURLSH, decltype(&curl_share_cleanup)>;
@@ -48,6 +49,7 @@ class S3fsCurlShare
     private:
         static bool                                     is_dns_cache;
         static bool                                     is_ssl_cache;
+        static bool                                     is_conn_cache;
         static std::mutex                               curl_share_lock;
         static std::map<std::thread::id, CurlSharePtr>  ShareHandles GUARDED_BY(curl_share_lock);
         static std::map<std::thread::id, ShareLocksPtr> ShareLocks GUARDED_BY(curl_share_lock);
@@ -59,12 +61,15 @@ class S3fsCurlShare
         static void UnlockCurlShare(CURL* handle, curl_lock_data nLockData, void* useptr) NO_THREAD_SAFETY_ANALYSIS;
         static bool InitializeCurlShare(const CurlSharePtr& hShare, const ShareLocksPtr& ShareLock) REQUIRES(curl_share_lock);
 
+        static bool IsShareEnabled() { return (S3fsCurlShare::is_dns_cache || S3fsCurlShare::is_ssl_cache || S3fsCurlShare::is_conn_cache); }
+
         void DestroyCurlShareHandle();
         CURLSH* GetCurlShareHandle();
 
     public:
         static bool SetDnsCache(bool isCache);
         static bool SetSslSessionCache(bool isCache);
+        static bool SetConnectionCache(bool isCache);
         static bool SetCurlShareHandle(CURL* hCurl);
         static bool DestroyCurlShareHandleForThread();
 
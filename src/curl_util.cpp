@@ -18,9 +18,13 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <cctype>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <curl/curl.h>
+#include <memory>
+#include <mutex>
 #include <string>
 
 #include "common.h"
@@ -35,6 +39,46 @@ using namespace std::string_literals;
 //-------------------------------------------------------------------
 // Utility Functions
 //-------------------------------------------------------------------
+//
+// Compares the key with the key part(before ':') of the header data by
+// ignoring case, this is same as strcasecmp without copying the key part.
+//
+static int compare_header_key(const std::string& key, const char* data)
+{
+    for(size_t pos = 0; ; ++pos){
+        int ch1 = (pos < key.size() ? tolower(static_cast<unsigned char>(key[pos])) : 0);
+        int ch2 = ('\0' != data[pos] && ':' != data[pos] ? tolower(static_cast<unsigned char>(data[pos])) : 0);
+        if(ch1 != ch2 || 0 == ch1){
+            return ch1 - ch2;
+        }
+    }
+}
+
+static bool is_header_space(char ch)
+{
+    return ('\0' != ch && nullptr != strchr(SPACES, ch));
+}
+
+//
+// Trims the range [*start, *end) by SPACES.
+//
+static void trim_header_range(const char** start, const char** end)
+{
+    while(*start < *end && is_header_space(**start)){
+        ++(*start);
+    }
+    while(*start < *end && is_header_space(*(*end - 1))){
+        --(*end);
+    }
+}
+
+static void append_lower(std::string& out, const char* start, const char* end)
+{
+    for(; start < end; ++start){
+        out += static_cast<char>(tolower(static_cast<unsigned char>(*start)));
+    }
+}
+
 //
 // curl_slist_sort_insert
 // This function is like curl_slist_append function, but this adds data by a-sorting.
@@ -57,13 +101,7 @@ struct curl_slist* curl_slist_sort_insert(struct curl_slist* list, const char* k
 
     struct curl_slist **p = &list;
     for(;*p; p = &(*p)->next){
-        std::string strcur = (*p)->data;
-        size_t pos;
-        if(std::string::npos != (pos = strcur.find(':', 0))){
-            strcur.erase(pos);
-        }
-
-        int result = strcasecmp(strkey.c_str(), strcur.c_str());
+        int result = compare_header_key(strkey, (*p)->data);
         if(0 == result){
             free((*p)->data);
             (*p)->data = data;
@@ -97,13 +135,7 @@ struct curl_slist* curl_slist_remove(struct curl_slist* list, const char* key)
     std::string strkey = trim(key);
     struct curl_slist **p = &list;
     while(*p){
-        std::string strcur = (*p)->data;
-        size_t pos;
-        if(std::string::npos != (pos = strcur.find(':', 0))){
-            strcur.erase(pos);
-        }
-
-        int result = strcasecmp(strkey.c_str(), strcur.c_str());
+        int result = compare_header_key(strkey, (*p)->data);
         if(0 == result){
             free((*p)->data);
             struct curl_slist *tmp = *p;
@@ -120,28 +152,36 @@ struct curl_slist* curl_slist_remove(struct curl_slist* list, const char* key)
 std::string get_sorted_header_keys(const struct curl_slist* list)
 {
     std::string sorted_headers;
+    append_sorted_header_keys(sorted_headers, list);
+    return sorted_headers;
+}
 
-    if(!list){
-        return sorted_headers;
-    }
-
+//
+// Appends the sorted header keys to out without the temporary strings.
+//
+void append_sorted_header_keys(std::string& out, const struct curl_slist* list)
+{
+    bool is_first = true;
     for( ; list; list = list->next){
-        std::string strkey = list->data;
-        size_t pos;
-        if(std::string::npos != (pos = strkey.find(':', 0))){
-            if(std::string::npos == strkey.find_first_not_of(SPACES, pos + 1)){
+        const char* key_end = strchr(list->data, ':');
+        if(key_end){
+            const char* value = key_end + 1;
+            while(is_header_space(*value)){
+                ++value;
+            }
+            if('\0' == *value){
                 // skip empty-value headers (as they are discarded by libcurl)
                 continue;
             }
-            strkey.erase(pos);
+        }else{
+            key_end = list->data + strlen(list->data);
         }
-        if(!sorted_headers.empty()){
-            sorted_headers += ";";
+        if(!is_first){
+            out += ';';
         }
-        sorted_headers += lower(std::move(strkey));
+        is_first = false;
+        append_lower(out, list->data, key_end);
     }
-
-    return sorted_headers;
 }
 
 std::string get_header_value(const struct curl_slist* list, const std::string &key)
@@ -166,35 +206,112 @@ std::string get_header_value(const struct curl_slist* list, const std::string &k
 std::string get_canonical_headers(const struct curl_slist* list, bool only_amz)
 {
     std::string canonical_headers;
+    append_canonical_headers(canonical_headers, list, only_amz);
+    return canonical_headers;
+}
 
+//
+// Appends the canonical headers to out without the temporary strings.
+//
+void append_canonical_headers(std::string& out, const struct curl_slist* list, bool only_amz)
+{
     if(!list){
-        canonical_headers = "\n";
-        return canonical_headers;
+        out += '\n';
+        return;
     }
 
     for( ; list; list = list->next){
-        std::string strhead = list->data;
-        size_t pos;
-        if(std::string::npos != (pos = strhead.find(':', 0))){
-            std::string strkey = trim(lower(strhead.substr(0, pos)));
-            std::string strval = trim(strhead.substr(pos + 1));
-            if (strval.empty()) {
+        const char* start = list->data;
+        const char* colon = strchr(start, ':');
+        const char* end   = (colon ? colon : start + strlen(start));
+        trim_header_range(&start, &end);
+
+        const char* value_start = nullptr;
+        const char* value_end   = nullptr;
+        if(colon){
+            value_start = colon + 1;
+            value_end   = colon + strlen(colon);
+            trim_header_range(&value_start, &value_end);
+            if(value_start == value_end){
                 // skip empty-value headers (as they are discarded by libcurl)
                 continue;
             }
-            strhead = std::move(strkey);
-            strhead += ":";
-            strhead += strval;
-        }else{
-            strhead = trim(lower(std::move(strhead)));
         }
-        if(only_amz && strhead.substr(0, 5) != "x-amz"){
+        if(only_amz && (end - start < 5 || 0 != strncasecmp(start, "x-amz", 5))){
             continue;
         }
-        canonical_headers += strhead;
-        canonical_headers += "\n";
+        append_lower(out, start, end);
+        if(colon){
+            out += ':';
+            out.append(value_start, value_end - value_start);
+        }
+        out += '\n';
     }
-    return canonical_headers;
+}
+
+//
+// Derives the signing key of AWS Signature Version 4.
+//
+bool make_sigv4_signing_key(const std::string& secret_access_key, const std::string& strdate, const std::string& region, const std::string& service, sha256_t& signing_key)
+{
+    std::string   kSecret = "AWS4" + secret_access_key;
+    unsigned int  kDate_len, kRegion_len, kService_len, kSigning_len = 0;
+
+    std::unique_ptr<unsigned char[]> kDate = s3fs_HMAC256(kSecret.c_str(), kSecret.size(), reinterpret_cast<const unsigned char*>(strdate.data()), strdate.size(), &kDate_len);
+    if(!kDate){
+        return false;
+    }
+    std::unique_ptr<unsigned char[]> kRegion = s3fs_HMAC256(kDate.get(), kDate_len, reinterpret_cast<const unsigned char*>(region.data()), region.size(), &kRegion_len);
+    if(!kRegion){
+        return false;
+    }
+    std::unique_ptr<unsigned char[]> kService = s3fs_HMAC256(kRegion.get(), kRegion_len, reinterpret_cast<const unsigned char*>(service.data()), service.size(), &kService_len);
+    if(!kService){
+        return false;
+    }
+    std::unique_ptr<unsigned char[]> kSigning = s3fs_HMAC256(kService.get(), kService_len, reinterpret_cast<const unsigned char*>("aws4_request"), sizeof("aws4_request") - 1, &kSigning_len);
+    if(!kSigning || signing_key.size() != kSigning_len){
+        return false;
+    }
+    memcpy(signing_key.data(), kSigning.get(), signing_key.size());
+    return true;
+}
+
+//
+// Returns the signing key from the cache.
+//
+// [NOTE]
+// The signing key only changes when the date(or the credentials) changes,
+// so the last key is cached instead of deriving it by four HMACs for each
+// request.
+//
+bool get_sigv4_signing_key(const std::string& secret_access_key, const std::string& strdate, const std::string& region, const std::string& service, sha256_t& signing_key)
+{
+    static std::mutex  cache_lock;
+    static std::string cache_secret;
+    static std::string cache_date;
+    static std::string cache_region;
+    static std::string cache_service;
+    static sha256_t    cache_key;
+
+    {
+        const std::lock_guard<std::mutex> lock(cache_lock);
+        if(!cache_date.empty() && cache_date == strdate && cache_region == region && cache_service == service && cache_secret == secret_access_key){
+            signing_key = cache_key;
+            return true;
+        }
+    }
+    if(!make_sigv4_signing_key(secret_access_key, strdate, region, service, signing_key)){
+        return false;
+    }
+
+    const std::lock_guard<std::mutex> lock(cache_lock);
+    cache_secret  = secret_access_key;
+    cache_date    = strdate;
+    cache_region  = region;
+    cache_service = service;
+    cache_key     = signing_key;
+    return true;
 }
 
 // function for using global values
@@ -26,6 +26,7 @@
 #include <optional>
 #include <string>
 #include "metaheader.h"
+#include "s3fs_auth.h"
 
 enum class sse_type_t : uint8_t;
 
@@ -36,6 +37,10 @@ struct curl_slist* curl_slist_sort_insert(struct curl_slist* list, const char* k
 struct curl_slist* curl_slist_remove(struct curl_slist* list, const char* key);
 std::string get_sorted_header_keys(const struct curl_slist* list);
 std::string get_canonical_headers(const struct curl_slist* list, bool only_amz = false);
+void append_sorted_header_keys(std::string& out, const struct curl_slist* list);
+void append_canonical_headers(std::string& out, const struct curl_slist* list, bool only_amz = false);
+bool make_sigv4_signing_key(const std::string& secret_access_key, const std::string& strdate, const std::string& region, const std::string& service, sha256_t& signing_key);
+bool get_sigv4_signing_key(const std::string& secret_access_key, const std::string& strdate, const std::string& region, const std::string& service, sha256_t& signing_key);
 std::string get_header_value(const struct curl_slist* list, const std::string &key);
 bool MakeUrlResource(const char* realpath, std::string& resourcepath, std::string& url);
 std::string prepare_url(const char* url);
@@ -0,0 +1,283 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cerrno>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "curl_ratelimit.h"
+#include "dirprefetch.h"
+#include "s3fs_logger.h"
+#include "threadpoolman.h"
+
+//------------------------------------------------
+// DirPrefetcher class variables
+//------------------------------------------------
+int DirPrefetcher::max_depth = 0;               // default(disabled)
+int DirPrefetcher::max_queue = 1000;            // default
+std::mutex DirPrefetcher::shutdown_lock;
+
+//------------------------------------------------
+// DirPrefetcher class methods
+//------------------------------------------------
+bool DirPrefetcher::Initialize(dirprefetch_func func)
+{
+    if(!DirPrefetcher::IsEnabled()){
+        return true;
+    }
+    if(ThreadPoolMan::GetWorkerCount() < 2){
+        S3FS_PRN_WARN("Directory prefetch is disabled, because it needs two or more threads in the thread pool(%d).", ThreadPoolMan::GetWorkerCount());
+        DirPrefetcher::max_depth = 0;
+        return true;
+    }
+
+    const std::lock_guard<std::mutex> lock(DirPrefetcher::shutdown_lock);
+    auto& singleton = DirPrefetcher::Slot();
+    if(singleton){
+        S3FS_PRN_CRIT("Already singleton for Directory Prefetcher exists.");
+        return false;
+    }
+    if(!func){
+        S3FS_PRN_CRIT("Prefetch function is not specified.");
+        return false;
+    }
+    singleton = std::make_unique<DirPrefetcher>(func);
+    return true;
+}
+
+//
+// [NOTE]
+// The singleton is taken out of the slot under the lock, and destroyed
+// after unlocking, because the destructor waits for the running
+// instruction.
+//
+void DirPrefetcher::Destroy()
+{
+    std::unique_ptr<DirPrefetcher> prefetcher;
+    {
+        const std::lock_guard<std::mutex> lock(DirPrefetcher::shutdown_lock);
+        prefetcher = std::move(DirPrefetcher::Slot());
+    }
+    prefetcher.reset();
+}
+
+bool DirPrefetcher::SetMaxDepth(int depth)
+{
+    if(depth < 0){
+        S3FS_PRN_ERR("Prefetch depth(%d) must not be negative number.", depth);
+        return false;
+    }
+    DirPrefetcher::max_depth = depth;
+    return true;
+}
+
+bool DirPrefetcher::SetMaxQueue(int count)
+{
+    if(count <= 0){
+        S3FS_PRN_ERR("Prefetch directory count(%d) must be positive number.", count);
+        return false;
+    }
+    DirPrefetcher::max_queue = count;
+    return true;
+}
+
+//
+// Called after readdir lists the path, subdirs is the sub directory paths
+// in the path.
+//
+void DirPrefetcher::Request(const std::string& path, const s3obj_list_t& subdirs)
+{
+    const std::lock_guard<std::mutex> lock(DirPrefetcher::shutdown_lock);
+
+    auto& singleton = DirPrefetcher::Slot();
+    if(!singleton){
+        return;
+    }
+    singleton->Push(path, subdirs, 1);
+
+    if(!singleton->Submit()){
+        S3FS_PRN_WARN("failed to start directory prefetch for sub directories of %s, but continue...", path.c_str());
+    }
+}
+
+//
+// Thread worker of ThreadPoolMan
+//
+// [NOTE]
+// This lists the directories until the queue is empty, and then the next
+// instruction is started by Request.
+//
+void* DirPrefetcher::PrefetchThreadWorker(S3fsCurl& s3fscurl, void* arg)
+{
+    auto* pprefetcher = static_cast<DirPrefetcher*>(arg);
+    if(!pprefetcher){
+        return reinterpret_cast<void*>(-EIO);
+    }
+    S3FS_PRN_INFO3("Start directory prefetch.");
+
+    std::string path;
+    int         depth = 0;
+    while(pprefetcher->Pop(path, depth)){
+        // prefetch
+        s3obj_list_t subdirs;
+        int          result;
+        if(0 != (result = pprefetcher->pfunc(path, subdirs))){
+            S3FS_PRN_INFO("failed to prefetch directory(%s) with error(%d), but continue...", path.c_str(), result);
+            continue;
+        }
+        if(depth < DirPrefetcher::max_depth){
+            pprefetcher->Push(path, subdirs, depth + 1);
+        }
+    }
+    S3FS_PRN_INFO3("Exit directory prefetch.");
+    return nullptr;
+}
+
+//------------------------------------------------
+// DirPrefetcher methods
+//------------------------------------------------
+DirPrefetcher::DirPrefetcher(dirprefetch_func func) : pfunc(func), prefetch_sem(0), last_access(std::chrono::steady_clock::now())
+{
+}
+
+DirPrefetcher::~DirPrefetcher()
+{
+    bool is_wait;
+    {
+        const std::lock_guard<std::mutex> lock(prefetch_lock);
+        is_exit      = true;
+        is_wait      = is_submitted;
+        is_submitted = false;
+    }
+
+    // wait for the instruction finishing
+    if(is_wait){
+        prefetch_sem.acquire();
+    }
+}
+
+//
+// Starts the instruction if it is not running and there are directories
+// waiting for prefetching.
+//
+// [NOTE]
+// If the previous instruction has finished, its semaphore is acquired
+// here. The semaphore is released right after the instruction returns,
+// so this does not wait for long.
+// The instruction is a background request even if this is called from
+// readdir.
+//
+bool DirPrefetcher::Submit()
+{
+    const std::lock_guard<std::mutex> lock(prefetch_lock);
+
+    if(is_exit || is_running || prefetch_queue.empty()){
+        return true;
+    }
+    if(is_submitted){
+        prefetch_sem.acquire();
+        is_submitted = false;
+    }
+
+    thpoolman_param  ppoolparam;
+    ppoolparam.args  = this;
+    ppoolparam.psem  = &prefetch_sem;
+    ppoolparam.pfunc = DirPrefetcher::PrefetchThreadWorker;
+
+    const S3fsForeground background(false);
+    if(!ThreadPoolMan::Instruct(ppoolparam)){
+        S3FS_PRN_ERR("failed to setup Directory Prefetch Thread Worker");
+        return false;
+    }
+    is_running   = true;
+    is_submitted = true;
+    return true;
+}
+
+//
+// Gets the next directory to prefetch.
+//
+// [NOTE]
+// If readdir has not been called for a while(the tree walk has finished
+// or stopped), the waiting directories are discarded.
+// When this returns false, the instruction finishes.
+//
+bool DirPrefetcher::Pop(std::string& path, int& depth)
+{
+    const std::lock_guard<std::mutex> lock(prefetch_lock);
+
+    if(is_exit || prefetch_queue.empty()){
+        is_running = false;
+        return false;
+    }
+    if(DirPrefetcher::idle_timeout < (std::chrono::steady_clock::now() - last_access)){
+        S3FS_PRN_INFO3("Discard %zu directories waiting for prefetch, because readdir has not been called for a while.", prefetch_queue.size());
+        prefetch_queue.clear();
+        is_running = false;
+        return false;
+    }
+    path  = prefetch_queue.front().first;
+    depth = prefetch_queue.front().second;
+    prefetch_queue.pop_front();
+    return true;
+}
+
+//
+// Adds the sub directories to the front of the queue.
+//
+// [NOTE]
+// The tree walkers walk the tree in depth first order, so the newest sub
+// directories are prefetched first in the order of names.
+// The directories over the queue size(the far ones from the walker) are
+// discarded.
+// The access time is updated by every readdir, even if the directory does
+// not have any sub directory.
+//
+void DirPrefetcher::Push(const std::string& parent, const s3obj_list_t& subdirs, int depth)
+{
+    const std::lock_guard<std::mutex> lock(prefetch_lock);
+
+    if(1 == depth){
+        // called from readdir
+        last_access = std::chrono::steady_clock::now();
+    }
+    if(subdirs.empty()){
+        return;
+    }
+    for(auto iter = subdirs.crbegin(); iter != subdirs.crend(); ++iter){
+        prefetch_queue.emplace_front(*iter, depth);
+    }
+    while(static_cast<size_t>(DirPrefetcher::max_queue) < prefetch_queue.size()){
+        prefetch_queue.pop_back();
+    }
+    S3FS_PRN_DBG("Add %zu sub directories of %s to prefetch queue(depth=%d, waiting=%zu).", subdirs.size(), parent.c_str(), depth, prefetch_queue.size());
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -0,0 +1,122 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef S3FS_DIRPREFETCH_H_
+#define S3FS_DIRPREFETCH_H_
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "common.h"
+#include "psemaphore.h"
+#include "s3objlist.h"
+
+//------------------------------------------------
+// Typedefs for functions and structures
+//------------------------------------------------
+class S3fsCurl;
+
+//
+// Prototype function
+//
+// [NOTE]
+// This function lists the directory path(without terminating slash) and
+// caches it, then sets the sub directory paths under it to subdirs.
+//
+using dirprefetch_func = int (*)(const std::string& path, s3obj_list_t& subdirs);
+
+using dirprefetch_queue_t = std::deque<std::pair<std::string, int>>;   // path and depth
+
+//------------------------------------------------
+// Class DirPrefetcher
+//------------------------------------------------
+// This class lists the sub directories of the directory listed by readdir
+// in the background, so that the tree walker(find, du, rsync, etc) hits
+// the cache for the next directories.
+// The prefetch is stopped when readdir is not called for a while.
+//
+// [NOTE]
+// The directories are listed by an instruction of ThreadPoolMan, and only
+// one instruction runs at a time, so the prefetch uses one worker thread
+// and the others are left for the requests it sends.
+// The slot of the singleton is guarded by shutdown_lock, so Request never
+// touches the object which is being destroyed, and the destructor waits
+// for the running instruction.
+//
+class DirPrefetcher
+{
+    private:
+        static int            max_depth;                // 0 means disabled
+        static int            max_queue;                // max count of directories waiting for prefetching
+        static constexpr std::chrono::seconds idle_timeout{10};
+        static std::mutex     shutdown_lock;
+
+        dirprefetch_func      pfunc;
+        Semaphore             prefetch_sem;             // released when the instruction finishes
+
+        std::mutex            prefetch_lock;
+        bool                  is_exit GUARDED_BY(prefetch_lock) = false;
+        bool                  is_running GUARDED_BY(prefetch_lock) = false;     // the instruction is prefetching
+        bool                  is_submitted GUARDED_BY(prefetch_lock) = false;   // the semaphore of the instruction is not acquired yet
+        dirprefetch_queue_t   prefetch_queue GUARDED_BY(prefetch_lock);
+        std::chrono::steady_clock::time_point last_access GUARDED_BY(prefetch_lock);
+
+    private:
+        static std::unique_ptr<DirPrefetcher>& Slot() REQUIRES(DirPrefetcher::shutdown_lock)
+        {
+            static std::unique_ptr<DirPrefetcher> singleton;
+            return singleton;
+        }
+        static void* PrefetchThreadWorker(S3fsCurl& s3fscurl, void* arg);
+
+        bool Pop(std::string& path, int& depth);
+        void Push(const std::string& parent, const s3obj_list_t& subdirs, int depth);
+        bool Submit();
+
+    public:
+        explicit DirPrefetcher(dirprefetch_func func);
+        ~DirPrefetcher();
+        DirPrefetcher(const DirPrefetcher&) = delete;
+        DirPrefetcher(DirPrefetcher&&) = delete;
+        DirPrefetcher& operator=(const DirPrefetcher&) = delete;
+        DirPrefetcher& operator=(DirPrefetcher&&) = delete;
+
+        static bool Initialize(dirprefetch_func func);
+        static void Destroy();
+        static bool SetMaxDepth(int depth);
+        static bool SetMaxQueue(int count);
+        static bool IsEnabled() { return (0 < DirPrefetcher::max_depth); }
+        static void Request(const std::string& path, const s3obj_list_t& subdirs);
+};
+
+#endif // S3FS_DIRPREFETCH_H_
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -967,11 +967,12 @@ int FdEntity::Load(off_t start, off_t size, bool is_modified_flag)
             // download
             if(S3fsCurl::GetMultipartSize() <= need_load_size && !nomultipart){
                 // parallel request
-                result = parallel_get_object_request(path, physical_fd, iter->offset, need_load_size);
+                auto etag = orgmeta.find("ETag");
+                result    = parallel_get_object_request(path, physical_fd, iter->offset, need_load_size, (orgmeta.cend() != etag ? etag->second : std::string()));
             }else{
                 // single request
                 if(0 < need_load_size){
-                    result = get_object_request(path, physical_fd, iter->offset, need_load_size);
+                    result = get_object_request(path, physical_fd, iter->offset, need_load_size, (0 == iter->offset && size_orgmeta == need_load_size));
                 }else{
                     result = 0;
                 }
@@ -189,40 +189,6 @@ bool s3fs_md5(const unsigned char* data, size_t datalen, md5_t* result)
     return true;
 }
 
-bool s3fs_md5_fd(int fd, off_t start, off_t size, md5_t* result)
-{
-    struct md5_ctx ctx_md5;
-    off_t          bytes;
-
-    if(-1 == size){
-        struct stat st;
-        if(-1 == fstat(fd, &st)){
-            return false;
-        }
-        size = st.st_size;
-    }
-
-    md5_init(&ctx_md5);
-
-    for(off_t total = 0; total < size; total += bytes){
-        std::array<char, 512> buf;
-        bytes = std::min(static_cast<off_t>(buf.size()), (size - total));
-        bytes = pread(fd, buf.data(), bytes, start + total);
-        if(0 == bytes){
-            // end of file
-            break;
-        }else if(-1 == bytes){
-            // error
-            S3FS_PRN_ERR("file read error(%d)", errno);
-            return false;
-        }
-        md5_update(&ctx_md5, bytes, reinterpret_cast<const uint8_t*>(buf.data()));
-    }
-    md5_digest(&ctx_md5, result->size(), result->data());
-
-    return true;
-}
-
 #else // USE_GNUTLS_NETTLE
 
 bool s3fs_md5(const unsigned char* data, size_t datalen, md5_t* digest)
@@ -250,46 +216,6 @@ bool s3fs_md5(const unsigned char* data, size_t datalen, md5_t* digest)
     return true;
 }
 
-bool s3fs_md5_fd(int fd, off_t start, off_t size, md5_t* result)
-{
-    gcry_md_hd_t ctx_md5;
-    gcry_error_t err;
-    off_t bytes;
-
-    if(-1 == size){
-        struct stat st;
-        if(-1 == fstat(fd, &st)){
-            return false;
-        }
-        size = st.st_size;
-    }
-
-    if(GPG_ERR_NO_ERROR != (err = gcry_md_open(&ctx_md5, GCRY_MD_MD5, 0))){
-        S3FS_PRN_ERR("MD5 context creation failure: %s/%s", gcry_strsource(err), gcry_strerror(err));
-        return false;
-    }
-
-    for(off_t total = 0; total < size; total += bytes){
-        std::array<char, 512> buf;
-        bytes = std::min(static_cast<off_t>(buf.size()), (size - total));
-        bytes = pread(fd, buf.data(), bytes, start + total);
-        if(0 == bytes){
-            // end of file
-            break;
-        }else if(-1 == bytes){
-            // error
-            S3FS_PRN_ERR("file read error(%d)", errno);
-            gcry_md_close(ctx_md5);
-            return false;
-        }
-        gcry_md_write(ctx_md5, buf.data(), bytes);
-    }
-    memcpy(result->data(), gcry_md_read(ctx_md5, 0), result->size());
-    gcry_md_close(ctx_md5);
-
-    return true;
-}
-
 #endif // USE_GNUTLS_NETTLE
 
 //-------------------------------------------------------------------
@@ -306,32 +232,6 @@ bool s3fs_sha256(const unsigned char* data, size_t datalen, sha256_t* digest)
     return true;
 }
 
-bool s3fs_sha256_fd(int fd, off_t start, off_t size, sha256_t* result)
-{
-    struct sha256_ctx ctx_sha256;
-    off_t             bytes;
-
-    sha256_init(&ctx_sha256);
-
-    for(off_t total = 0; total < size; total += bytes){
-        std::array<char, 512> buf;
-        bytes = std::min(static_cast<off_t>(buf.size()), (size - total));
-        bytes = pread(fd, buf.data(), bytes, start + total);
-        if(0 == bytes){
-            // end of file
-            break;
-        }else if(-1 == bytes){
-            // error
-            S3FS_PRN_ERR("file read error(%d)", errno);
-            return false;
-        }
-        sha256_update(&ctx_sha256, bytes, reinterpret_cast<const uint8_t*>(buf.data()));
-    }
-    sha256_digest(&ctx_sha256, result->size(), result->data());
-
-    return true;
-}
-
 #else // USE_GNUTLS_NETTLE
 
 bool s3fs_sha256(const unsigned char* data, size_t datalen, sha256_t* digest)
@@ -349,48 +249,90 @@ bool s3fs_sha256(const unsigned char* data, size_t datalen, sha256_t* digest)
     return true;
 }
 
-bool s3fs_sha256_fd(int fd, off_t start, off_t size, sha256_t* result)
+#endif // USE_GNUTLS_NETTLE
+
+//-------------------------------------------------------------------
+// Utility Function for MD5 and SHA256 of file
+//-------------------------------------------------------------------
+#ifdef USE_GNUTLS_NETTLE
+bool s3fs_md5_sha256_fd(int fd, off_t start, off_t size, md5_t* md5, sha256_t* sha256, const digest_update_func& extra_func)
 {
-    gcry_md_hd_t   ctx_sha256;
-    gcry_error_t   err;
-    off_t          bytes;
+    struct md5_ctx    ctx_md5;
+    struct sha256_ctx ctx_sha256;
 
-    if(-1 == size){
-        struct stat st;
-        if(-1 == fstat(fd, &st)){
-            return false;
+    if(md5){
+        md5_init(&ctx_md5);
+    }
+    if(sha256){
+        sha256_init(&ctx_sha256);
+    }
+    bool result = s3fs_read_fd_blocks(fd, start, size, [&](const unsigned char* data, size_t length){
+        if(md5){
+            md5_update(&ctx_md5, length, data);
+        }
+        if(sha256){
+            sha256_update(&ctx_sha256, length, data);
         }
-        size = st.st_size;
+        return (!extra_func || extra_func(data, length));
+    });
+    if(!result){
+        return false;
+    }
+    if(md5){
+        md5_digest(&ctx_md5, md5->size(), md5->data());
+    }
+    if(sha256){
+        sha256_digest(&ctx_sha256, sha256->size(), sha256->data());
     }
+    return true;
+}
 
-    if(GPG_ERR_NO_ERROR != (err = gcry_md_open(&ctx_sha256, GCRY_MD_SHA256, 0))){
-        S3FS_PRN_ERR("SHA256 context creation failure: %s/%s", gcry_strsource(err), gcry_strerror(err));
+#else // USE_GNUTLS_NETTLE
+
+bool s3fs_md5_sha256_fd(int fd, off_t start, off_t size, md5_t* md5, sha256_t* sha256, const digest_update_func& extra_func)
+{
+    gcry_md_hd_t ctx;
+    gcry_error_t err;
+
+    // [NOTE]
+    // One handle computes all enabled algorithms at the same time.
+    if(GPG_ERR_NO_ERROR != (err = gcry_md_open(&ctx, 0, 0))){
+        S3FS_PRN_ERR("digest context creation failure: %s/%s", gcry_strsource(err), gcry_strerror(err));
+        return false;
+    }
+    if((md5 && GPG_ERR_NO_ERROR != (err = gcry_md_enable(ctx, GCRY_MD_MD5))) || (sha256 && GPG_ERR_NO_ERROR != (err = gcry_md_enable(ctx, GCRY_MD_SHA256)))){
+        S3FS_PRN_ERR("digest algorithm enabling failure: %s/%s", gcry_strsource(err), gcry_strerror(err));
+        gcry_md_close(ctx);
         return false;
     }
 
-    for(off_t total = 0; total < size; total += bytes){
-        std::array<char, 512> buf;
-        bytes = std::min(static_cast<off_t>(buf.size()), (size - total));
-        bytes = pread(fd, buf.data(), bytes, start + total);
-        if(0 == bytes){
-            // end of file
-            break;
-        }else if(-1 == bytes){
-            // error
-            S3FS_PRN_ERR("file read error(%d)", errno);
-            gcry_md_close(ctx_sha256);
-            return false;
-        }
-        gcry_md_write(ctx_sha256, buf.data(), bytes);
+    bool result = s3fs_read_fd_blocks(fd, start, size, [&](const unsigned char* data, size_t length){
+        gcry_md_write(ctx, data, length);
+        return (!extra_func || extra_func(data, length));
+    });
+    if(result && md5){
+        memcpy(md5->data(), gcry_md_read(ctx, GCRY_MD_MD5), md5->size());
     }
-    memcpy(result->data(), gcry_md_read(ctx_sha256, 0), result->size());
-    gcry_md_close(ctx_sha256);
+    if(result && sha256){
+        memcpy(sha256->data(), gcry_md_read(ctx, GCRY_MD_SHA256), sha256->size());
+    }
+    gcry_md_close(ctx);
 
-    return true;
+    return result;
 }
 
 #endif // USE_GNUTLS_NETTLE
 
+bool s3fs_md5_fd(int fd, off_t start, off_t size, md5_t* result)
+{
+    return s3fs_md5_sha256_fd(fd, start, size, result, nullptr);
+}
+
+bool s3fs_sha256_fd(int fd, off_t start, off_t size, sha256_t* result)
+{
+    return s3fs_md5_sha256_fd(fd, start, size, nullptr, result);
+}
+
 /*
 * Local variables:
 * tab-width: 4
@@ -0,0 +1,98 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include "headflight.h"
+#include "s3fs_logger.h"
+
+//-------------------------------------------------------------------
+// Class HeadFlight
+//-------------------------------------------------------------------
+std::mutex              HeadFlight::flights_lock;
+std::condition_variable HeadFlight::flights_cond;
+HeadFlight::flights_t   HeadFlight::flights;
+
+HeadFlight::HeadFlight(const std::string& strpath) : path(strpath)
+{
+    const std::lock_guard<std::mutex> lock(HeadFlight::flights_lock);
+
+    auto iter = HeadFlight::flights.find(path);
+    if(HeadFlight::flights.cend() != iter){
+        pflight = iter->second;
+    }else{
+        pflight   = std::make_shared<flight_t>();
+        is_leader = true;
+        HeadFlight::flights[path] = pflight;
+    }
+}
+
+HeadFlight::~HeadFlight()
+{
+    if(is_leader){
+        headers_t meta;
+        Finish(-EIO, meta);
+    }
+}
+
+//
+// Wait for the request of the leader, and returns its result and headers
+//
+int HeadFlight::Wait(headers_t& meta)
+{
+    if(is_leader){
+        S3FS_PRN_ERR("The leader of the head request for %s could not wait.", path.c_str());
+        return -EIO;
+    }
+    std::unique_lock<std::mutex> lock(HeadFlight::flights_lock);
+    HeadFlight::flights_cond.wait(lock, [this]{ return pflight->done; });
+
+    S3FS_PRN_INFO3("Shared the result(%d) of the head request for %s", pflight->result, path.c_str());
+    meta = pflight->meta;
+    return pflight->result;
+}
+
+//
+// Set the result of the leader, and wake up the followers
+//
+void HeadFlight::Finish(int result, const headers_t& meta)
+{
+    if(!is_leader){
+        return;
+    }
+    {
+        const std::lock_guard<std::mutex> lock(HeadFlight::flights_lock);
+
+        pflight->done   = true;
+        pflight->result = result;
+        pflight->meta   = meta;
+        HeadFlight::flights.erase(path);
+    }
+    is_leader = false;
+    HeadFlight::flights_cond.notify_all();
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
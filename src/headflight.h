@@ -0,0 +1,92 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef S3FS_HEADFLIGHT_H_
+#define S3FS_HEADFLIGHT_H_
+
+#include <cerrno>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "common.h"
+#include "metaheader.h"
+
+//------------------------------------------------
+// Class HeadFlight
+//------------------------------------------------
+// This class coalesces the HEAD requests for the same path which are sent
+// at the same time.
+// The first request for the path becomes the leader and sends the request,
+// and the following requests for the path wait for the leader and share
+// its result(including not found) and headers instead of sending their
+// own requests.
+//
+// [NOTE]
+// The leader must call Finish() with the result. If it is not called, the
+// destructor finishes with -EIO so that the followers are not blocked.
+// The leader is always a thread which is sending the request, so the
+// followers never wait for a request which is not started yet.
+//
+class HeadFlight
+{
+    private:
+        struct flight_t
+        {
+            bool      done   = false;
+            int       result = -EIO;
+            headers_t meta;
+        };
+        using flights_t = std::map<std::string, std::shared_ptr<flight_t>>;
+
+        static std::mutex              flights_lock;
+        static std::condition_variable flights_cond;
+        static flights_t               flights GUARDED_BY(flights_lock);
+
+        std::string               path;
+        std::shared_ptr<flight_t> pflight;
+        bool                      is_leader = false;
+
+    public:
+        explicit HeadFlight(const std::string& strpath);
+        ~HeadFlight();
+        HeadFlight(const HeadFlight&) = delete;
+        HeadFlight(HeadFlight&&) = delete;
+        HeadFlight& operator=(const HeadFlight&) = delete;
+        HeadFlight& operator=(HeadFlight&&) = delete;
+
+        bool IsLeader() const { return is_leader; }
+        int Wait(headers_t& meta);
+        void Finish(int result, const headers_t& meta);
+};
+
+#endif // S3FS_HEADFLIGHT_H_
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -158,43 +158,6 @@ bool s3fs_md5(const unsigned char* data, size_t datalen, md5_t* result)
     return true;
 }
 
-bool s3fs_md5_fd(int fd, off_t start, off_t size, md5_t* result)
-{
-    PK11Context*   md5ctx;
-    off_t          bytes;
-    unsigned int   md5outlen;
-
-    if(-1 == size){
-        struct stat st;
-        if(-1 == fstat(fd, &st)){
-            return false;
-        }
-        size = st.st_size;
-    }
-
-    md5ctx = PK11_CreateDigestContext(SEC_OID_MD5);
-
-    for(off_t total = 0; total < size; total += bytes){
-        std::array<unsigned char, 512> buf;
-        bytes = std::min(static_cast<off_t>(buf.size()), (size - total));
-        bytes = pread(fd, buf.data(), bytes, start + total);
-        if(0 == bytes){
-            // end of file
-            break;
-        }else if(-1 == bytes){
-            // error
-            S3FS_PRN_ERR("file read error(%d)", errno);
-            PK11_DestroyContext(md5ctx, PR_TRUE);
-            return false;
-        }
-        PK11_DigestOp(md5ctx, buf.data(), bytes);
-    }
-    PK11_DigestFinal(md5ctx, result->data(), &md5outlen, result->size());
-    PK11_DestroyContext(md5ctx, PR_TRUE);
-
-    return true;
-}
-
 //-------------------------------------------------------------------
 // Utility Function for SHA256
 //-------------------------------------------------------------------
@@ -211,41 +174,48 @@ bool s3fs_sha256(const unsigned char* data, size_t datalen, sha256_t* digest)
     return true;
 }
 
-bool s3fs_sha256_fd(int fd, off_t start, off_t size, sha256_t* result)
+//-------------------------------------------------------------------
+// Utility Function for MD5 and SHA256 of file
+//-------------------------------------------------------------------
+bool s3fs_md5_sha256_fd(int fd, off_t start, off_t size, md5_t* md5, sha256_t* sha256, const digest_update_func& extra_func)
 {
-    PK11Context*   sha256ctx;
-    off_t          bytes;
-    unsigned int   sha256outlen;
+    PK11Context* md5ctx    = (md5    ? PK11_CreateDigestContext(SEC_OID_MD5)    : nullptr);
+    PK11Context* sha256ctx = (sha256 ? PK11_CreateDigestContext(SEC_OID_SHA256) : nullptr);
 
-    if(-1 == size){
-        struct stat st;
-        if(-1 == fstat(fd, &st)){
-            return false;
+    bool result = s3fs_read_fd_blocks(fd, start, size, [&](const unsigned char* data, size_t length){
+        if(md5ctx){
+            PK11_DigestOp(md5ctx, data, length);
         }
-        size = st.st_size;
-    }
-
-    sha256ctx = PK11_CreateDigestContext(SEC_OID_SHA256);
+        if(sha256ctx){
+            PK11_DigestOp(sha256ctx, data, length);
+        }
+        return (!extra_func || extra_func(data, length));
+    });
 
-    for(off_t total = 0; total < size; total += bytes){
-        std::array<unsigned char, 512> buf;
-        bytes = std::min(static_cast<off_t>(buf.size()), (size - total));
-        bytes = pread(fd, buf.data(), bytes, start + total);
-        if(0 == bytes){
-            // end of file
-            break;
-        }else if(-1 == bytes){
-            // error
-            S3FS_PRN_ERR("file read error(%d)", errno);
-            PK11_DestroyContext(sha256ctx, PR_TRUE);
-            return false;
+    unsigned int outlen;
+    if(md5ctx){
+        if(result){
+            PK11_DigestFinal(md5ctx, md5->data(), &outlen, md5->size());
         }
-        PK11_DigestOp(sha256ctx, buf.data(), bytes);
+        PK11_DestroyContext(md5ctx, PR_TRUE);
     }
-    PK11_DigestFinal(sha256ctx, result->data(), &sha256outlen, result->size());
-    PK11_DestroyContext(sha256ctx, PR_TRUE);
+    if(sha256ctx){
+        if(result){
+            PK11_DigestFinal(sha256ctx, sha256->data(), &outlen, sha256->size());
+        }
+        PK11_DestroyContext(sha256ctx, PR_TRUE);
+    }
+    return result;
+}
 
-    return true;
+bool s3fs_md5_fd(int fd, off_t start, off_t size, md5_t* result)
+{
+    return s3fs_md5_sha256_fd(fd, start, size, result, nullptr);
+}
+
+bool s3fs_sha256_fd(int fd, off_t start, off_t size, sha256_t* result)
+{
+    return s3fs_md5_sha256_fd(fd, start, size, nullptr, result);
 }
 
 /*
@@ -128,56 +128,62 @@ static bool s3fs_digest(const EVP_MD* md, const unsigned char* data, size_t data
 }
 
 //-------------------------------------------------------------------
-// Compute a message digest over a file descriptor using the EVP API.
-// The algorithm (e.g. EVP_md5(), EVP_sha256()) is selected by the caller.
+// Compute the message digests over a file descriptor using the EVP API.
+// MD5 and/or SHA256 are computed in one pass, nullptr skips the digest.
 //-------------------------------------------------------------------
-static bool s3fs_digest_fd(const EVP_MD* md, int fd, off_t start, off_t size, unsigned char* out)
-{
-    if(-1 == fd){
-        S3FS_PRN_DBG("invalid file descriptor");
-        return false;
-    }
-    if(-1 == size){
-        struct stat st;
-        if(-1 == fstat(fd, &st)){
-            S3FS_PRN_ERR("fstat error(%d)", errno);
-            return false;
-        }
-        size = st.st_size;
-    }
+using evp_md_ctx_ptr = std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)>;
 
-    std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> mdctx(EVP_MD_CTX_new(), EVP_MD_CTX_free);
+static evp_md_ctx_ptr s3fs_digest_init(const EVP_MD* md)
+{
+    evp_md_ctx_ptr mdctx(EVP_MD_CTX_new(), EVP_MD_CTX_free);
     if(!mdctx){
         S3FS_PRN_ERR("EVP_MD_CTX_new failed: %s", ERR_reason_error_string(ERR_get_error()));
-        return false;
+        return evp_md_ctx_ptr(nullptr, EVP_MD_CTX_free);
     }
     if(EVP_DigestInit_ex(mdctx.get(), md, nullptr) != 1){
         S3FS_PRN_ERR("EVP_DigestInit_ex failed: %s", ERR_reason_error_string(ERR_get_error()));
+        return evp_md_ctx_ptr(nullptr, EVP_MD_CTX_free);
+    }
+    return mdctx;
+}
+
+static bool s3fs_digest_final(EVP_MD_CTX* mdctx, unsigned char* out)
+{
+    if(EVP_DigestFinal_ex(mdctx, out, nullptr) != 1){
+        S3FS_PRN_ERR("EVP_DigestFinal_ex failed: %s", ERR_reason_error_string(ERR_get_error()));
         return false;
     }
+    return true;
+}
 
-    off_t bytes;
-    for(off_t total = 0; total < size; total += bytes){
-        std::array<char, 512> buf;
-        bytes = std::min(static_cast<off_t>(buf.size()), (size - total));
-        bytes = pread(fd, buf.data(), bytes, start + total);
-        if(0 == bytes){
-            break;
-        }else if(-1 == bytes){
-            S3FS_PRN_ERR("file read error(%d)", errno);
-            return false;
-        }
-        if(EVP_DigestUpdate(mdctx.get(), buf.data(), bytes) != 1){
+bool s3fs_md5_sha256_fd(int fd, off_t start, off_t size, md5_t* md5, sha256_t* sha256, const digest_update_func& extra_func)
+{
+    evp_md_ctx_ptr md5ctx(nullptr, EVP_MD_CTX_free);
+    evp_md_ctx_ptr sha256ctx(nullptr, EVP_MD_CTX_free);
+    if(md5 && !(md5ctx = s3fs_digest_init(EVP_md5()))){
+        return false;
+    }
+    if(sha256 && !(sha256ctx = s3fs_digest_init(EVP_sha256()))){
+        return false;
+    }
+
+    bool result = s3fs_read_fd_blocks(fd, start, size, [&](const unsigned char* data, size_t length){
+        if((md5ctx && EVP_DigestUpdate(md5ctx.get(), data, length) != 1) || (sha256ctx && EVP_DigestUpdate(sha256ctx.get(), data, length) != 1)){
             S3FS_PRN_ERR("EVP_DigestUpdate failed: %s", ERR_reason_error_string(ERR_get_error()));
             return false;
         }
+        return (!extra_func || extra_func(data, length));
+    });
+    if(!result){
+        return false;
     }
 
-    if(EVP_DigestFinal_ex(mdctx.get(), out, nullptr) != 1){
-        S3FS_PRN_ERR("EVP_DigestFinal_ex failed: %s", ERR_reason_error_string(ERR_get_error()));
+    if(md5ctx && !s3fs_digest_final(md5ctx.get(), md5->data())){
+        return false;
+    }
+    if(sha256ctx && !s3fs_digest_final(sha256ctx.get(), sha256->data())){
         return false;
     }
-
     return true;
 }
 
@@ -191,7 +197,7 @@ bool s3fs_md5(const unsigned char* data, size_t datalen, md5_t* digest)
 
 bool s3fs_md5_fd(int fd, off_t start, off_t size, md5_t* result)
 {
-    return s3fs_digest_fd(EVP_md5(), fd, start, size, result->data());
+    return s3fs_md5_sha256_fd(fd, start, size, result, nullptr);
 }
 
 //-------------------------------------------------------------------
@@ -204,7 +210,7 @@ bool s3fs_sha256(const unsigned char* data, size_t datalen, sha256_t* digest)
 
 bool s3fs_sha256_fd(int fd, off_t start, off_t size, sha256_t* result)
 {
-    return s3fs_digest_fd(EVP_sha256(), fd, start, size, result->data());
+    return s3fs_md5_sha256_fd(fd, start, size, nullptr, result);
 }
 
 /*
@@ -24,12 +24,14 @@
 #include <cstdio>
 #include <cstdlib>
 #include <limits>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <string>
 #include <unistd.h>
 #include <utility>
+#include <vector>
 #include <dirent.h>  // NOLINT(misc-include-cleaner)
 #include <sys/types.h>
 #include <getopt.h>  // NOLINT(misc-include-cleaner)
@@ -45,10 +47,17 @@
 #include "fdcache_auto.h"
 #include "fdcache_stat.h"
 #include "curl.h"
+#include "adaptive_concurrency.h"
+#include "curl_ratelimit.h"
+#include "curl_hedge.h"
+#include "curl_multi.h"
+#include "curl_retry.h"
 #include "curl_share.h"
 #include "curl_util.h"
 #include "s3objlist.h"
 #include "cache.h"
+#include "cache_policy.h"
+#include "dirprefetch.h"
 #include "addhead.h"
 #include "sighandlers.h"
 #include "s3fs_xml.h"
@@ -60,6 +69,7 @@
 #include "s3fs_threadreqs.h"
 #include "mpu_util.h"
 #include "threadpoolman.h"
+#include "filetimes.h"
 
 //-------------------------------------------------------------------
 // Symbols
@@ -68,6 +78,8 @@
 #define ENOATTR                   ENODATA
 #endif
 
+static constexpr double IMMUTABLE_KERNEL_TIMEOUT = 24 * 60 * 60;   // entry/attr timeout(seconds) of the kernel in immutable mode
+
 //-------------------------------------------------------------------
 // Static variables
 //-------------------------------------------------------------------
@@ -101,6 +113,12 @@ static bool use_wtf8              = false;
 static off_t fake_diskfree_size   = -1; // default is not set(-1)
 static bool update_parent_dir_stat= false;  // default not updating parent directory stats
 static bool use_hard_remove       = false;  // default hides open files as .fuse_hidden instead of removing them
+static bool is_immutable          = false;  // default revalidates the stats and leaves the kernel caches at defaults
+static bool use_list_only_stat    = false;  // default makes stats of listed objects by HEAD requests
+static bool use_readdirplus       = false;  // default does not fill the stats for readdirplus
+static bool use_streaming_readdir = false;  // default lists all objects in the directory before filling
+static int list_parallel_count     = 1;      // default lists the pages of objects sequentially
+static int bulk_list_max_keys      = 0;      // default does not list the tree without delimiter
 static fsblkcnt_t bucket_block_count;                       // advertised block count of the bucket
 static unsigned long s3fs_block_size = 16 * 1024 * 1024;    // s3fs block size is 16MB
 
@@ -114,8 +132,10 @@ static int check_object_access(const char* path, int mask, struct stat* pstbuf);
 static int check_object_owner(const char* path, struct stat* pstbuf);
 static int check_parent_object_access(const char* path, int mask);
 static int get_local_fent(AutoFdEntity& autoent, FdEntity **entity, const char* path, int flags = O_RDONLY, bool is_load = false);
-static int readdir_multi_head(const std::string& strpath, const S3ObjList& head, void* buf, fuse_fill_dir_t filler);
+static int readdir_multi_head(const std::string& strpath, const S3ObjList& head, const s3obj_view_list_t& headviews, void* buf, fuse_fill_dir_t filler, bool is_plus);
+static int list_bucket_page(const char* path, S3ObjList& head, const char* delimiter, bool check_content_only, struct list_bucket_state& list_state);
 static int list_bucket(const char* path, S3ObjList& head, const char* delimiter, bool check_content_only = false);
+static int check_directory_objects(const std::string& path, headers_t& meta, objtype_t& ObjType, std::string& objpath);
 static int directory_empty(const char* path);
 static int rename_large_object(const char* from, const char* to);
 static int create_file_object(const char* path, mode_t mode, uid_t uid, gid_t gid, struct stat* pstbuf = nullptr);
@@ -142,6 +162,12 @@ static int print_umount_message(const std::string& mp, bool force) __attribute__
 //-------------------------------------------------------------------
 // fuse interface functions
 //-------------------------------------------------------------------
+// [NOTE]
+// The operations which read the objects and the attributes(getattr,
+// readdir, read, etc) mark their requests as the foreground requests by
+// S3fsForeground, so that they have priority over the background requests
+// in the rate limits.
+//
 static int s3fs_getattr(const char* path, struct stat* stbuf, struct fuse_file_info* info);
 static int s3fs_readlink(const char* path, char* buf, size_t size);
 static int s3fs_mknod(const char* path, mode_t mode, dev_t rdev);
@@ -167,6 +193,7 @@ static int s3fs_flush(const char* path, struct fuse_file_info* fi);
 static int s3fs_fsync(const char* path, int datasync, struct fuse_file_info* fi);
 static int s3fs_release(const char* path, struct fuse_file_info* fi);
 static int s3fs_opendir(const char* path, struct fuse_file_info* fi);
+static int s3fs_releasedir(const char* path, struct fuse_file_info* fi);
 static int s3fs_readdir(const char* path, void* buf, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info* info, enum fuse_readdir_flags);
 static int s3fs_access(const char* path, int mask);
 static void* s3fs_init(struct fuse_conn_info* conn, fuse_config* config);
@@ -186,6 +213,52 @@ static int s3fs_removexattr(const char* path, const char* name);
 // The flag is accessed from child threads, so std::atomic is used for exclusive control of flags.
 static std::atomic<bool> has_mp_stat;
 
+//
+// The state of listing objects which is carried over to the next page
+//
+struct list_bucket_state
+{
+    std::string next_continuation_token;
+    std::string next_marker;
+    bool        truncated = true;
+};
+
+//
+// Directory cursor for streaming_readdir option
+//
+// [NOTE]
+// This object is created in opendir and set to fuse_file_info::fh, and
+// is released in releasedir.
+// Only the entries of one page of the listing are buffered with the state
+// (continuation token or marker) for the next page.
+// The offset of each entry is made from the page number and the index in
+// the listing order of the page(page 0 is "." and ".."), so that the
+// entries have the same offsets every time the directory is listed.
+//
+static constexpr int   READDIR_PAGE_SHIFT = 32;
+static constexpr off_t READDIR_INDEX_MASK = (static_cast<off_t>(1) << READDIR_PAGE_SHIFT) - 1;
+
+struct readdir_entry
+{
+    std::string         name;
+    bool                is_filled = false;      // the entry is filled by readdir_multi_head
+    bool                has_stat  = false;
+    struct stat         stbuf     = {};
+    fuse_fill_dir_flags flags     = S3FS_FUSE_FILL_DIR_DEFAULTS;
+};
+
+struct readdir_cursor
+{
+    bool                          started   = false;    // listing is started
+    bool                          finished  = false;    // the buffered page is the last page
+    list_bucket_state             list_state;           // state for the next page
+    off_t                         page_no   = 0;        // page number of the buffered entries
+    off_t                         prev_last = 0;        // offset of the last filled entry before the buffered page
+    std::vector<readdir_entry>    entries;              // buffered entries in listing order
+    std::map<std::string, size_t> indexes;              // name to index of the buffered entries
+    s3obj_type_map_t              cached;               // children in the stat cache which are not listed yet
+};
+
 //-------------------------------------------------------------------
 // Functions
 //-------------------------------------------------------------------
@@ -423,19 +496,15 @@ static int get_object_attribute(const char* path, struct stat* pstbuf, headers_t
         // As a result, the caller may unintentionally overwrite the existing object and create
         // a new one (see #2581).
         //
-        if(overcheck && !is_bucket_mountpoint){
-            // when support_compat_dir is disabled, strpath maybe have "_$folder$".
-            if('/' != *strpath.rbegin() && std::string::npos == strpath.find("_$folder$", 0)){
-                // now path is "object", do check "object/" for over checking
-                strpath += "/";
-
-                // re-get headers
-                if(0 == (result = head_request(strpath, *pmeta))){
-                    // found "dir/"
-                    *pObjType = objtype_t::DIR_NORMAL;
-                }
+        // when support_compat_dir is disabled, strpath maybe have "_$folder$".
+        if(overcheck && !is_bucket_mountpoint && '/' != *strpath.rbegin() && std::string::npos == strpath.find("_$folder$", 0)){
+            // now path is "object", do check "object/", "object_$folder$" and "no dir object" at once for over checking
+            std::string objpath;
+            if(0 == (result = check_directory_objects(strpath, *pmeta, *pObjType, objpath))){
+                strpath = objpath;
             }
-            if(support_compat_dir && 0 != result){
+        }else{
+            if(overcheck && !is_bucket_mountpoint && support_compat_dir){
                 // now path is "object/", do check "object_$folder$" for over checking
                 strpath.erase(strpath.length() - 1);
                 strpath += "_$folder$";
@@ -455,21 +524,22 @@ static int get_object_attribute(const char* path, struct stat* pstbuf, headers_t
                     }
                 }
             }
-        }
-        if(0 != result && std::string::npos == strpath.find("_$folder$", 0)){
-            // now path is "object" or "object/", do check "no dir object" which is not object but has only children.
-            //
-            // [NOTE]
-            // If the path is mount point and there is no Stat information file for it, we need this process.
-            //
-            if('/' == *strpath.rbegin()){
-                strpath.erase(strpath.length() - 1);
-            }
-            if(-ENOTEMPTY == directory_empty(strpath.c_str())){
-                // found "non-existed directory object".
-                strpath  += "/";
-                *pObjType = objtype_t::DIR_NOT_EXIST_OBJECT;
-                result    = 0;
+
+            if(0 != result && std::string::npos == strpath.find("_$folder$", 0)){
+                // now path is "object" or "object/", do check "no dir object" which is not object but has only children.
+                //
+                // [NOTE]
+                // If the path is mount point and there is no Stat information file for it, we need this process.
+                //
+                if('/' == *strpath.rbegin()){
+                    strpath.erase(strpath.length() - 1);
+                }
+                if(-ENOTEMPTY == directory_empty(strpath.c_str())){
+                    // found "non-existed directory object".
+                    strpath  += "/";
+                    *pObjType = objtype_t::DIR_NOT_EXIST_OBJECT;
+                    result    = 0;
+                }
             }
         }
 
@@ -889,6 +959,8 @@ int put_headers(const char* path, const headers_t& meta, bool is_copy, bool use_
 
 static int s3fs_getattr(const char* _path, struct stat* stbuf, struct fuse_file_info* info)
 {
+    const S3fsForeground foreground;
+
     // [NOTE]
     // FUSE passes a null path for file handle based operations(fstat)
     // on a file which was unlinked while it is still open.  The object
@@ -958,6 +1030,8 @@ static int s3fs_getattr(const char* _path, struct stat* stbuf, struct fuse_file_
 
 static int s3fs_readlink(const char* _path, char* buf, size_t size)
 {
+    const S3fsForeground foreground;
+
     if(!_path || !buf || 0 == size){
         return 0;
     }
@@ -1347,17 +1421,22 @@ static int s3fs_unlink(const char* _path)
 
 static int directory_empty(const char* path)
 {
-    int       result = 0;
-    S3ObjList head;
+    int               result = 0;
+    S3ObjList         head;
+    list_bucket_state list_state;
 
     // check s3objlist in cache
     if(!StatCache::getStatCacheData()->GetS3ObjList(path, head)){
-        if((result = list_bucket(path, head, "/", true)) != 0){
+        if((result = list_bucket_page(path, head, "/", true, list_state)) != 0){
             S3FS_PRN_ERR("list_bucket returns error.");
             return result;
         }
         if(!head.IsEmpty()){
-            if(!StatCache::getStatCacheData()->AddS3ObjList(path, head)){
+            // [NOTE]
+            // Only up to 2 objects are listed, so the listing is cached
+            // only if it has all objects in the directory.
+            //
+            if(!list_state.truncated && !StatCache::getStatCacheData()->AddS3ObjList(path, head)){
                 S3FS_PRN_WARN("failed to add s3objlist for %s, but continue...", path);
             }
             result = -ENOTEMPTY;
@@ -1848,15 +1927,13 @@ static int rename_directory(const char* from, const char* to)
     // No delimiter is specified, the result(head) is all object keys.
     // (CommonPrefixes is empty, but all object is listed in Key.)
     //
-    if(!StatCache::getStatCacheData()->GetS3ObjList(basepath, head)){
-        // get a list of all the objects
-        if(0 != (result = list_bucket(basepath.c_str(), head, nullptr))){
-            S3FS_PRN_ERR("list_bucket returns error.");
-            return result;
-        }
-        if(!StatCache::getStatCacheData()->AddS3ObjList(basepath, head)){
-            S3FS_PRN_WARN("failed to add s3objlist for %s, but continue...", basepath.c_str());
-        }
+    // [NOTE]
+    // The listing in the stat cache is the listing with delimiter, so it
+    // is not used here, and this listing is not cached either.
+    //
+    if(0 != (result = list_bucket(basepath.c_str(), head, nullptr))){
+        S3FS_PRN_ERR("list_bucket returns error.");
+        return result;
     }
     head.GetNameList(headlist);                                             // get name without "/".
 
@@ -3065,6 +3142,8 @@ static int s3fs_truncate(const char* _path, off_t size, struct fuse_file_info* i
 
 static int s3fs_open(const char* _path, struct fuse_file_info* fi)
 {
+    const S3fsForeground foreground;
+
     if(!_path || '\0' == _path[0]){
         return -ESTALE;
     }
@@ -3085,8 +3164,11 @@ static int s3fs_open(const char* _path, struct fuse_file_info* fi)
     // If the file is open, the stats cache will not be deleted as
     // there are cases where the object does not exist on the server
     // and only the Stats cache exists.
+    // In immutable mode, the object is never changed, so the stats cache
+    // is used as it is. Then the file which is fully cached is opened
+    // without any request.
     //
-    if(StatCache::getStatCacheData()->HasStat(path)){
+    if(!is_immutable && StatCache::getStatCacheData()->HasStat(path)){
         if(!FdManager::HasOpenEntityFd(path)){
             // remove stat cache
             StatCache::getStatCacheData()->DelStat(path);
@@ -3168,11 +3250,18 @@ static int s3fs_open(const char* _path, struct fuse_file_info* fi)
     }
     fi->fh = autoent.Detach();       // KEEP fdentity open;
 
+    if(is_immutable){
+        // keep the page cache of the kernel from the previous open
+        fi->keep_cache = 1;
+    }
+
     return 0;
 }
 
 static int s3fs_read(const char* _path, char* buf, size_t size, off_t offset, struct fuse_file_info* fi)
 {
+    const S3fsForeground foreground;
+
     WTF8_ENCODE(path)
     std::string unlinked_path;
     ssize_t res;
@@ -3370,13 +3459,19 @@ static int s3fs_flush(const char* _path, struct fuse_file_info* fi)
         //
         // Cache only stat structures to stat cache
         //
-        std::string strpath = path;
-        struct stat stbuf   = {};
-        if(!nocopyapi && ent->GetStatsFromMeta(stbuf) && StatCache::getStatCacheData()->AddStat(strpath, stbuf, objtype_t::FILE)){
-            S3FS_PRN_DBG("Updated stats(without meta) cache(path=%s) from internal meta header in fdentity.", path);
-        }else{
-            S3FS_PRN_DBG("Could not cache only stat structures, so the stat cache(path=%s) will be deleted.", path);
-            StatCache::getStatCacheData()->DelStat(strpath);
+        // [NOTE]
+        // In immutable mode, the object is never modified, so the stat cache
+        // with meta headers is kept for the next open.
+        //
+        if(!is_immutable){
+            std::string strpath = path;
+            struct stat stbuf   = {};
+            if(!nocopyapi && ent->GetStatsFromMeta(stbuf) && StatCache::getStatCacheData()->AddStat(strpath, stbuf, objtype_t::FILE)){
+                S3FS_PRN_DBG("Updated stats(without meta) cache(path=%s) from internal meta header in fdentity.", path);
+            }else{
+                S3FS_PRN_DBG("Could not cache only stat structures, so the stat cache(path=%s) will be deleted.", path);
+                StatCache::getStatCacheData()->DelStat(strpath);
+            }
         }
 
         if(is_new_file && 0 == result){
@@ -3563,6 +3658,8 @@ static int s3fs_release(const char* _path, struct fuse_file_info* fi)
 
 static int s3fs_opendir(const char* _path, struct fuse_file_info* fi)
 {
+    const S3fsForeground foreground;
+
     if(!_path || '\0' == _path[0]){
         return -ESTALE;
     }
@@ -3577,32 +3674,89 @@ static int s3fs_opendir(const char* _path, struct fuse_file_info* fi)
         result = check_parent_object_access(path, X_OK);
     }
 
+    // set directory cursor for streaming readdir
+    if(0 == result && use_streaming_readdir){
+        fi->fh = reinterpret_cast<uint64_t>(new readdir_cursor);
+    }
+
     return result;
 }
 
+static int s3fs_releasedir(const char* _path, struct fuse_file_info* fi)
+{
+    FUSE_CTX_INFO("[path=%s]", SAFESTRPTR(_path));
+
+    if(fi && 0 != fi->fh){
+        delete reinterpret_cast<readdir_cursor*>(fi->fh);
+        fi->fh = 0;
+    }
+    return 0;
+}
+
 // [NOTE]
-// strpath must end with '/'.
+// Makes the stat structure of the object from the ListObjects response
+// data(for list_only_stat option).
+// Since the ListObjects response does not have any meta headers, the
+// mode, uid and gid are the default values, and mtime is LastModified.
+// If the object does not have a size(ex. only in CommonPrefixes), this
+// function returns false.
 //
-static int readdir_multi_head(const std::string& strpath, const S3ObjList& head, void* buf, fuse_fill_dir_t filler)
+static bool convert_list_object_to_stat(const std::string& strpath, const S3ObjList& head, const std::string& name, struct stat& stbuf)
 {
-    S3FS_PRN_INFO1("[path=%s][head=<%s>][filler=%p]", strpath.c_str(), head.IsEmpty() ? "empty" : "not empty", filler);
+    off_t size = head.GetSize(name.c_str());
+    if(size < 0){
+        return false;
+    }
 
-    // Make base path list.
-    s3obj_type_map_t headmap;
-    head.GetNameMap(headmap, true, false);                                          // get name with "/".
+    headers_t listmeta;
+    listmeta["Content-Length"] = std::to_string(size);
+    if(!convert_header_to_stat(strpath, listmeta, stbuf, false)){
+        return false;
+    }
+    stbuf.st_blocks = get_blocks(stbuf.st_size);
 
-    // [NOTE]
-    // If there are leaf paths that only exist in the Stat Cache,
-    // they will be merged here.
-    // This means that for newly created file, the Stat Cache(NoTruncate)
-    // will exist before the actual file is uploaded.
-    //
-    if(!StatCache::getStatCacheData()->GetChildStatMap(strpath, headmap)){
-        S3FS_PRN_ERR("failed get child leaf list[path=%s], but continue...", strpath.c_str());
+    struct timespec mtime = {0, 0};
+    if(time_t lastmodified = head.GetLastModified(name.c_str()); 0 <= lastmodified){
+        mtime.tv_sec = lastmodified;
     }
+    set_timespec_to_stat(stbuf, stat_time_type::MTIME, mtime);
+    set_timespec_to_stat(stbuf, stat_time_type::CTIME, mtime);
+    set_timespec_to_stat(stbuf, stat_time_type::ATIME, mtime);
+
+    return true;
+}
+
+//
+// Makes the header of the directory which does not have meta headers.
+//
+static headers_t make_dummy_dir_header(time_t mtime)
+{
+    mode_t dirmask = umask(0);      // macos does not have getumask()
+    umask(dirmask);
+
+    headers_t dummy_header;
+    dummy_header["Content-Type"]     = "application/x-directory";          // directory
+    dummy_header["x-amz-meta-uid"]   = std::to_string(is_s3fs_uid ? s3fs_uid : geteuid());
+    dummy_header["x-amz-meta-gid"]   = std::to_string(is_s3fs_gid ? s3fs_gid : getegid());
+    dummy_header["x-amz-meta-mode"]  = std::to_string(S_IFDIR | (~dirmask & (S_IRWXU | S_IRWXG | S_IRWXO)));
+    dummy_header["x-amz-meta-atime"] = std::to_string(mtime);
+    dummy_header["x-amz-meta-ctime"] = std::to_string(mtime);
+    dummy_header["x-amz-meta-mtime"] = std::to_string(mtime);
+    return dummy_header;
+}
+
+// [NOTE]
+// strpath must end with '/'.
+// headviews is the names of the objects to fill, and head is used to get
+// the information(ETag, etc) of the objects in the listing.
+// The names in headviews must be valid until this function returns.
+//
+static int readdir_multi_head(const std::string& strpath, const S3ObjList& head, const s3obj_view_list_t& headviews, void* buf, fuse_fill_dir_t filler, bool is_plus)
+{
+    S3FS_PRN_INFO1("[path=%s][head=<%s>][filler=%p][plus=%s]", strpath.c_str(), head.IsEmpty() ? "empty" : "not empty", filler, is_plus ? "yes" : "no");
 
     // Initialize SyncFiller object
-    SyncFiller syncfiller(buf, filler);
+    SyncFiller syncfiller(buf, filler, is_plus);
 
     // common variables
     Semaphore    multi_head_sem(0);
@@ -3614,9 +3768,10 @@ static int readdir_multi_head(const std::string& strpath, const S3ObjList& head,
     s3obj_list_t notfound_list;
 
     // Make single head request(with max).
-    for(auto iter = headmap.cbegin(); headmap.cend() != iter; ++iter){
-        std::string disppath = strpath + iter->first;
-        std::string etag     = head.GetETag(iter->first.c_str());
+    for(auto iter = headviews.cbegin(); headviews.cend() != iter; ++iter){
+        std::string name(iter->name);
+        std::string disppath = strpath + name;
+        std::string etag     = head.GetETag(name.c_str());
         struct stat st;
 
         // [NOTE]
@@ -3627,13 +3782,32 @@ static int readdir_multi_head(const std::string& strpath, const S3ObjList& head,
             if(use_wtf8){
                 bpath = s3fs_wtf8_decode(bpath);
             }
-            syncfiller.Fill(bpath, &st, 0);
+            syncfiller.Fill(bpath, &st, 0, disppath.c_str());
+            continue;
+        }
+
+        // [NOTE]
+        // If list_only_stat is specified, the stat of the file object
+        // is made from the ListObjects data without HEAD request.
+        // This cache is marked as listed, and the HEAD request will be
+        // sent when the meta headers are needed.
+        // Directories still use HEAD requests to determine their type.
+        //
+        if(use_list_only_stat && '/' != name.back() && convert_list_object_to_stat(disppath, head, name, st)){
+            if(!StatCache::getStatCacheData()->AddListedStat(disppath, st, etag, objtype_t::FILE)){
+                S3FS_PRN_WARN("failed adding listed stat cache [path=%s], but continue...", disppath.c_str());
+            }
+            std::string bpath = mybasename(disppath);
+            if(use_wtf8){
+                bpath = s3fs_wtf8_decode(bpath);
+            }
+            syncfiller.Fill(bpath, &st, 0, disppath.c_str());
             continue;
         }
 
         // set one head request
         int result;
-        if(0 != (result = multi_head_request(disppath, syncfiller, thparam_lock, retrycount, notfound_list, use_wtf8, iter->second, req_result, multi_head_sem))){
+        if(0 != (result = multi_head_request(disppath, syncfiller, thparam_lock, retrycount, notfound_list, use_wtf8, iter->type, req_result, multi_head_sem))){
             // [NOTE]
             // Must drain already-scheduled workers before returning, since they
             // hold pointers to stack-local multi_head_sem/thparam_lock/
@@ -3669,17 +3843,7 @@ static int readdir_multi_head(const std::string& strpath, const S3ObjList& head,
     }
     if(support_compat_dir && !notfound_list.empty()){      // [NOTE] not need to lock to access this here.
         // dummy header
-        mode_t dirmask = umask(0);      // macos does not have getumask()
-        umask(dirmask);
-
-        headers_t   dummy_header;
-        dummy_header["Content-Type"]     = "application/x-directory";          // directory
-        dummy_header["x-amz-meta-uid"]   = std::to_string(is_s3fs_uid ? s3fs_uid : geteuid());
-        dummy_header["x-amz-meta-gid"]   = std::to_string(is_s3fs_gid ? s3fs_gid : getegid());
-        dummy_header["x-amz-meta-mode"]  = std::to_string(S_IFDIR | (~dirmask & (S_IRWXU | S_IRWXG | S_IRWXO)));
-        dummy_header["x-amz-meta-atime"] = "0";
-        dummy_header["x-amz-meta-ctime"] = "0";
-        dummy_header["x-amz-meta-mtime"] = "0";
+        headers_t dummy_header = make_dummy_dir_header(0);
 
         for(auto reiter = notfound_list.cbegin(); reiter != notfound_list.cend(); ++reiter){
             int dir_result;
@@ -3713,197 +3877,1055 @@ static int readdir_multi_head(const std::string& strpath, const S3ObjList& head,
     return 0;
 }
 
-static int s3fs_readdir(const char* _path, void* buf, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info* info, enum fuse_readdir_flags)
+//
+// fuse_fill_dir_t function for buffering entries in readdir_cursor
+//
+// [NOTE]
+// readdir_multi_head calls this in the order the HEAD requests complete,
+// so the stat is set to the entry which was added in the listing order.
+// The name which is not in the listing(ex. a directory which only has
+// children) is added after the entries of the page.
+//
+static int readdir_cursor_filler(void* buf, const char* name, const struct stat* stbuf, off_t off, enum fuse_fill_dir_flags flags)
 {
-    // [NOTE]
-    // FUSE passes a null path for a directory which was removed while
-    // it is still open.  s3fs does not keep a directory handle, so this
-    // cannot be served and returns ESTALE.
-    //
-    if(!_path || '\0' == _path[0]){
-        return -ESTALE;
+    auto* pcursor = static_cast<readdir_cursor*>(buf);
+    if(!pcursor || !name){
+        return 1;
     }
 
-    WTF8_ENCODE(path)
-    S3ObjList head;
-    int result;
+    std::string strname = name;
+    if(1 < strname.size() && '/' == strname.back()){
+        strname.pop_back();
+    }
+    auto iter = pcursor->indexes.find(strname);
+    if(iter == pcursor->indexes.cend()){
+        iter = pcursor->indexes.emplace(strname, pcursor->entries.size()).first;
+        pcursor->entries.emplace_back();
+        pcursor->entries.back().name = strname;
+    }
 
-    FUSE_CTX_INFO("[path=%s]", path);
+    readdir_entry& entry = pcursor->entries[iter->second];
+    if(entry.is_filled){
+        // already filled
+        return 0;
+    }
+    entry.is_filled = true;
+    entry.flags     = flags;
+    if(stbuf){
+        entry.has_stat = true;
+        entry.stbuf    = *stbuf;
+    }
+    return 0;
+}
 
+//
+// Starts the listing of the directory cursor from the beginning
+//
+static int readdir_cursor_start(const char* path, const std::string& strpath, readdir_cursor& cursor)
+{
+    int result;
     if(0 != (result = check_object_access(path, R_OK, nullptr))){
         return result;
     }
+    cursor         = readdir_cursor();
+    cursor.started = true;
 
-    // check s3objlist in cache
-    if(!StatCache::getStatCacheData()->GetS3ObjList(path, head)){
-        // get a list of all the objects
-        if((result = list_bucket(path, head, "/")) != 0){
-            S3FS_PRN_ERR("list_bucket returns error(%d).", result);
+    // page 0 has only "." and ".."
+    readdir_cursor_filler(&cursor, ".", nullptr, 0, S3FS_FUSE_FILL_DIR_DEFAULTS);
+    readdir_cursor_filler(&cursor, "..", nullptr, 0, S3FS_FUSE_FILL_DIR_DEFAULTS);
+
+    // [NOTE]
+    // The leaf paths that only exist in the Stat Cache are buffered after
+    // the last page as same as s3fs_readdir. The names in each page are
+    // removed from this map, so it only has the names which are not listed
+    // at the end.
+    //
+    if(!StatCache::getStatCacheData()->GetChildStatMap(strpath, cursor.cached)){
+        S3FS_PRN_ERR("failed get child leaf list[path=%s], but continue...", strpath.c_str());
+    }
+    return 0;
+}
+
+//
+// Buffers the entries of the next page in the directory cursor.
+//
+// [NOTE]
+// If there is s3objlist in cache, it is used as the only page.
+// After the last page of the listing, the leaf paths that only exist in
+// the Stat Cache are buffered as the last page.
+// If is_fill is false, only the names are buffered without the HEAD
+// requests(for skipping pages to the offset).
+//
+static int readdir_cursor_next_page(const char* path, const std::string& strpath, readdir_cursor& cursor, bool is_fill, bool is_plus)
+{
+    int               result;
+    S3ObjList         head;
+    s3obj_view_list_t headviews;
+
+    if(0 == cursor.page_no && StatCache::getStatCacheData()->GetS3ObjList(path, head)){
+        cursor.list_state.truncated = false;
+        head.GetNameViews(headviews, true);                                         // get name with "/".
+    }else if(cursor.list_state.truncated){
+        if(0 != (result = list_bucket_page(path, head, "/", false, cursor.list_state))){
+            S3FS_PRN_ERR("list_bucket_page returns error(%d).", result);
             return result;
         }
+        head.GetNameViews(headviews, true);                                         // get name with "/".
+    }else{
+        for(auto iter = cursor.cached.cbegin(); iter != cursor.cached.cend(); ++iter){
+            headviews.push_back({iter->first, iter->second});
+        }
+        cursor.finished = true;
+    }
 
-        if(!StatCache::getStatCacheData()->AddS3ObjList(path, head)){
-            S3FS_PRN_WARN("failed to add s3objlist for %s, but continue...", path);
+    // remember the last filled entry of the current page
+    for(auto riter = cursor.entries.crbegin(); riter != cursor.entries.crend(); ++riter){
+        if(riter->is_filled){
+            cursor.prev_last = (cursor.page_no << READDIR_PAGE_SHIFT) + static_cast<off_t>(cursor.entries.crend() - riter);
+            break;
         }
     }
 
-    // force to add "." and ".." name.
-    filler(buf, ".", nullptr, 0, S3FS_FUSE_FILL_DIR_DEFAULTS);
-    filler(buf, "..", nullptr, 0, S3FS_FUSE_FILL_DIR_DEFAULTS);
-    if(head.IsEmpty()){
-        return 0;
+    // buffer the names in the listing order
+    ++cursor.page_no;
+    cursor.entries.clear();
+    cursor.indexes.clear();
+    for(const auto& view: headviews){
+        std::string bpath = mybasename(strpath + std::string(view.name));
+        if(use_wtf8){
+            bpath = s3fs_wtf8_decode(bpath);
+        }
+        if(cursor.indexes.emplace(bpath, cursor.entries.size()).second){
+            cursor.entries.emplace_back();
+            cursor.entries.back().name = bpath;
+        }
+        if(!cursor.finished){
+            std::string name(view.name);
+            cursor.cached.erase(name);
+            if(1 < name.size() && '/' == name.back()){
+                name.pop_back();
+                cursor.cached.erase(name);
+            }
+        }
     }
 
-    // Send multi head request for stats caching.
-    std::string strpath = path;
-    if(strcmp(path, "/") != 0){
-        strpath += "/";
+    if(!is_fill || headviews.empty()){
+        return 0;
     }
-    if(0 != (result = readdir_multi_head(strpath, head, buf, filler))){
+    if(0 != (result = readdir_multi_head(strpath, head, headviews, &cursor, readdir_cursor_filler, is_plus))){
         S3FS_PRN_ERR("readdir_multi_head returns error(%d).", result);
     }
-
     return result;
 }
 
-static int list_bucket(const char* path, S3ObjList& head, const char* delimiter, bool check_content_only)
+//
+// readdir for streaming_readdir option
+//
+// [NOTE]
+// This fills the buffered entries after the offset, and lists the next
+// page only when all the buffered entries have been filled.
+// Then it stops when the buffer of FUSE is full(filler returns 1), and
+// the next readdir call resumes from the offset of the last entry.
+// If the offset is in a page before the buffered page(ex. seekdir), the
+// listing starts over, and the pages before the offset are skipped
+// without HEAD requests.
+//
+static int readdir_streaming(const char* path, readdir_cursor& cursor, void* buf, fuse_fill_dir_t filler, off_t offset, bool is_plus)
 {
-    std::string s3_realpath;
-    std::string query_delimiter;
-    std::string query_prefix;
-    std::string query_maxkey;
-    std::string next_continuation_token;
-    std::string next_marker;
-    bool truncated = true;
-
-    S3FS_PRN_INFO1("[path=%s]", path);
-
-    if(delimiter && 0 < strlen(delimiter)){
-        query_delimiter += "delimiter=";
-        query_delimiter += delimiter;
-        query_delimiter += "&";
-    }
+    int result;
 
-    query_prefix += "&prefix=";
-    s3_realpath = get_realpath(path);
-    if(s3_realpath.empty() || '/' != *s3_realpath.rbegin()){
-        // last word must be "/"
-        query_prefix += urlEncodePath(s3_realpath.substr(1) + "/");
-    }else{
-        query_prefix += urlEncodePath(s3_realpath.substr(1));
-    }
-    if (check_content_only){
-        // Just need to know if there are child objects in dir
-        // For dir with children, expect "dir/" and "dir/child"
-        query_maxkey += "max-keys=2";
-    }else{
-        query_maxkey += "max-keys=" + std::to_string(max_keys_list_object);
+    std::string strpath = path;
+    if(strcmp(path, "/") != 0){
+        strpath += "/";
     }
 
-    while(truncated){
-        int         result;
-        std::string each_query;
-        std::string responseBody;
+    off_t  page_no = offset >> READDIR_PAGE_SHIFT;
+    size_t start   = static_cast<size_t>(offset & READDIR_INDEX_MASK);     // offset is the index + 1 of the last read entry
 
-        // append parameters to query in alphabetical order
-        if(!next_continuation_token.empty()){
-            each_query             += "continuation-token=" + urlEncodePath(next_continuation_token) + "&";
-            next_continuation_token = "";
-        }
-        each_query += query_delimiter;
-        if(S3fsCurl::IsListObjectsV2()){
-            each_query += "list-type=2&";
+    if(!cursor.started || 0 == offset || (page_no < cursor.page_no && offset < cursor.prev_last)){
+        if(0 != (result = readdir_cursor_start(path, strpath, cursor))){
+            return result;
         }
-        if(!next_marker.empty()){
-            each_query += "marker=" + urlEncodePath(next_marker) + "&";
-            next_marker = "";
+    }
+    if(page_no < cursor.page_no){
+        // all entries before the buffered page have been read
+        start = 0;
+    }
+    while(cursor.page_no < page_no){
+        if(cursor.finished){
+            return 0;
         }
-        each_query += query_maxkey;
-        each_query += query_prefix;
-
-        // send request
-        if(0 != (result = list_bucket_request(SAFESTRPTR(path), each_query, responseBody))){
+        if(0 != (result = readdir_cursor_next_page(path, strpath, cursor, (cursor.page_no + 1 == page_no), is_plus))){
             return result;
         }
+    }
 
-        // [NOTE]
-        // CR code(\r) is replaced with LF(\n) by xmlReadMemory() function.
-        // To prevent that, only CR code is encoded by following function.
-        // The encoded CR code is decoded with append_objects_from_xml(_ex).
-        //
-        std::string encbody = get_encoded_cr_code(responseBody.c_str());
-
-        // [NOTE]
-        // If encbody is empty, xmlReadMemory will output the message
-        // ":1: parser error : Document is empty" to stderr.
-        // Make sure encbody is not empty beforehand.
-        //
-        if(encbody.empty()){
-            S3FS_PRN_ERR("The data length passed to xmlReadMemory is 0.");
-            return -EIO;
-        }
-
-        // xmlDocPtr
-        s3fsXmlBufferParserError parserError;
-        parserError.SetXmlParseError();
-
-        std::unique_ptr<xmlDoc, decltype(&xmlFreeDoc)> doc(xmlReadMemory(encbody.c_str(), static_cast<int>(encbody.size()), "", nullptr, S3FS_XML_PARSE_FLAGS), xmlFreeDoc);
-        if(nullptr == doc){
-            if(parserError.IsXmlParseError()){
-                S3FS_PRN_ERR("xmlReadMemory returns with error: %s", parserError.GetXmlParseError().c_str());
-            }else{
-                S3FS_PRN_ERR("xmlReadMemory returns with error.");
-            }
-            return -EIO;
-        }
-        if(0 != append_objects_from_xml(path, doc.get(), head)){
-            S3FS_PRN_ERR("append_objects_from_xml returns with error.");
-            return -EIO;
-        }
-        if(true == (truncated = is_truncated(doc.get()))){
-            auto tmpch = get_next_continuation_token(doc.get());
-            if(nullptr != tmpch){
-                next_continuation_token = reinterpret_cast<const char*>(tmpch.get());
-            }else if(nullptr != (tmpch = get_next_marker(doc.get()))){
-                next_marker = reinterpret_cast<const char*>(tmpch.get());
+    while(true){
+        for(size_t pos = start; pos < cursor.entries.size(); ++pos){
+            const readdir_entry& entry = cursor.entries[pos];
+            if(!entry.is_filled){
+                continue;
             }
-
-            if(next_continuation_token.empty() && next_marker.empty()){
-                // If did not specify "delimiter", s3 did not return "NextMarker".
-                // On this case, can use last name for next marker.
-                //
-                auto lastname = head.GetLastName();
-                if(!lastname){
-                    S3FS_PRN_WARN("Could not find next marker, thus break loop.");
-                    truncated = false;
-                }else{
-                    next_marker = s3_realpath.substr(1);
-                    if(s3_realpath.empty() || '/' != *s3_realpath.rbegin()){
-                        next_marker += "/";
-                    }
-                    next_marker += *lastname;
-                }
+            if(0 != filler(buf, entry.name.c_str(), (entry.has_stat ? &entry.stbuf : nullptr), (cursor.page_no << READDIR_PAGE_SHIFT) + static_cast<off_t>(pos) + 1, entry.flags)){
+                // buffer is full
+                return 0;
             }
         }
-
-        if(check_content_only){
+        if(cursor.finished){
             break;
         }
+        if(0 != (result = readdir_cursor_next_page(path, strpath, cursor, true, is_plus))){
+            return result;
+        }
+        start = 0;
     }
-
     return 0;
 }
 
-static int remote_mountpath_exists(const char* path, bool compat_dir)
+//
+// Directory in the listing without delimiter(readdir_bulk_list_keys option)
+//
+struct bulk_list_dir
 {
-    struct stat stbuf;
-    int result;
-
-    S3FS_PRN_INFO1("[path=%s]", path);
+    objtype_t type      = objtype_t::DIR_NOT_EXIST_OBJECT;  // DIR_NOT_EXIST_OBJECT if there is no directory object
+    time_t    mtime     = -1;
+    bool      is_prefix = false;                            // added to the parent as CommonPrefixes
+    S3ObjList list;                                         // same as the listing with delimiter
+};
 
-    // getattr will prefix the path with the remote mountpoint
-    if(0 != (result = get_object_attribute(path, &stbuf, nullptr))){
-        return result;
+//
+// Lists all objects under the path without delimiter, and caches the
+// listings and stats of the path and all directories under it.
+//
+// [NOTE]
+// A request without delimiter returns the max keys regardless of the
+// depth, so this is much cheaper than listing each directory for deep
+// trees.
+// If the objects are over readdir_bulk_list_keys, the listing is stopped,
+// and only the directories whose all objects have been listed are cached.
+// In this case(or any error), completed is false and the caller lists the
+// path with delimiter as usual.
+// The stats are made from the listing as same as list_only_stat option,
+// and they are marked as listed. The directories without objects are
+// cached only if compat_dir is specified, as same as readdir.
+//
+static int bulk_list_tree(const char* path, S3ObjList& head, bool& completed)
+{
+    int               result;
+    S3ObjList         flat;
+    list_bucket_state list_state;
+
+    completed = false;
+    for(int keys = 0; list_state.truncated && keys < bulk_list_max_keys; keys += max_keys_list_object){
+        if(0 != (result = list_bucket_page(path, flat, nullptr, false, list_state))){
+            return result;
+        }
+    }
+    std::string lastname;
+    if(list_state.truncated){
+        auto name = flat.GetLastName();
+        if(!name){
+            return 0;
+        }
+        lastname = *name;
+    }
+
+    // make the listings of all directories(relative path with slash, "" is the path)
+    std::map<std::string, bulk_list_dir> dirs;
+    dirs[""];
+
+    s3obj_view_list_t flatviews;
+    flat.GetNameViews(flatviews, true);
+    for(auto iter = flatviews.cbegin(); iter != flatviews.cend(); ++iter){
+        std::string            name(iter->name);
+        std::string::size_type start = 0;
+        std::string::size_type pos;
+        for(pos = name.find('/'); std::string::npos != pos; pos = name.find('/', start)){
+            auto dirres = dirs.emplace(name.substr(0, pos + 1), bulk_list_dir());
+            bulk_list_dir& dir = dirres.first->second;
+            if(dirres.second && flat.HasNormalizedName(name.substr(0, pos))){
+                // found "dir" object
+                dir.type  = objtype_t::DIR_NOT_TERMINATE_SLASH;
+                dir.mtime = flat.GetLastModified(name.substr(0, pos).c_str());
+            }
+            if(!dir.is_prefix && (pos + 1 != name.size() || objtype_t::DIR_FOLDER_SUFFIX != iter->type)){
+                // same as CommonPrefixes("dir_$folder$" without children is not)
+                std::string    leafname = name.substr(start, pos - start);
+                bulk_list_dir& parent   = dirs[name.substr(0, start)];
+                parent.list.AddCommonPrefix(leafname);
+                parent.list.insert(leafname.c_str(), nullptr, true);
+                dir.is_prefix = true;
+            }
+            if(pos + 1 == name.size()){
+                break;
+            }
+            start = pos + 1;
+        }
+
+        bulk_list_dir& parent = dirs[name.substr(0, start)];
+        std::string    etag   = flat.GetETag(name.c_str());
+        off_t          size   = flat.GetSize(name.c_str());
+        time_t         mtime  = flat.GetLastModified(name.c_str());
+        if(IS_DIR_OBJ(iter->type)){
+            // "dir/" or "dir_$folder$" object
+            bulk_list_dir& dir = dirs[name];
+            dir.type           = iter->type;
+            dir.mtime          = mtime;
+            if(objtype_t::DIR_FOLDER_SUFFIX == iter->type){
+                std::string orgname = flat.GetOrgName(name.c_str());
+                parent.list.insert(orgname.substr(start).c_str(), (etag.empty() ? nullptr : etag.c_str()), false, size, mtime);
+            }
+        }else{
+            parent.list.insert(name.substr(start).c_str(), (etag.empty() ? nullptr : etag.c_str()), false, size, mtime);
+        }
+    }
+
+    // check the directories which can be cached
+    std::vector<std::string> cachedirs;
+    for(auto iter = dirs.cbegin(); iter != dirs.cend(); ++iter){
+        const std::string& dirname = iter->first;
+        if(!lastname.empty() && (dirname.empty() || lastname <= dirname || 0 == lastname.compare(0, dirname.size(), dirname))){
+            // not all objects in this directory have been listed
+            continue;
+        }
+        bool is_cacheable = true;
+        for(std::string::size_type pos = dirname.find('/'); !support_compat_dir && is_cacheable && std::string::npos != pos; pos = dirname.find('/', pos + 1)){
+            is_cacheable = (objtype_t::DIR_NOT_EXIST_OBJECT != dirs[dirname.substr(0, pos + 1)].type);
+        }
+        if(is_cacheable){
+            cachedirs.push_back(dirname);
+        }
+    }
+
+    // [NOTE]
+    // Adding the stat of the directory clears its listing, so all stats
+    // are added before adding the listings.
+    //
+    std::string strpath = path;
+    if(strcmp(path, "/") != 0){
+        strpath += "/";
+    }
+    for(auto iter = cachedirs.cbegin(); iter != cachedirs.cend(); ++iter){
+        const bulk_list_dir& dir     = dirs[*iter];
+        std::string          dirpath = strpath + *iter;
+        struct stat          st;
+
+        if(!iter->empty()){
+            if(!convert_header_to_stat(dirpath, make_dummy_dir_header(0 <= dir.mtime ? dir.mtime : 0), st, true) || !StatCache::getStatCacheData()->AddListedStat(dirpath, st, "", dir.type)){
+                S3FS_PRN_DBG("failed adding listed stat cache [path=%s], but continue...", dirpath.c_str());
+            }
+        }
+
+        s3obj_view_list_t views;
+        dir.list.GetNameViews(views, true);
+        for(auto viter = views.cbegin(); viter != views.cend(); ++viter){
+            std::string name(viter->name);
+            if(IS_DIR_OBJ(viter->type) || !convert_list_object_to_stat(dirpath + name, dir.list, name, st)){
+                continue;
+            }
+            if(!StatCache::getStatCacheData()->AddListedStat(dirpath + name, st, dir.list.GetETag(name.c_str()), objtype_t::FILE)){
+                S3FS_PRN_DBG("failed adding listed stat cache [path=%s], but continue...", (dirpath + name).c_str());
+            }
+        }
+    }
+    for(auto iter = cachedirs.cbegin(); iter != cachedirs.cend(); ++iter){
+        std::string dirpath = strpath + *iter;
+        if(!StatCache::getStatCacheData()->AddS3ObjList(dirpath, dirs[*iter].list)){
+            S3FS_PRN_DBG("failed to add s3objlist for %s, but continue...", dirpath.c_str());
+        }
+    }
+    S3FS_PRN_INFO("listed %zu directories under %s without delimiter(%s).", cachedirs.size(), path, (lastname.empty() ? "completed" : "stopped"));
+
+    if(lastname.empty()){
+        head      = std::move(dirs[""].list);
+        completed = true;
+    }
+    return 0;
+}
+
+//
+// Filler for prefetching directories, the entries are not filled anywhere.
+//
+static int prefetch_dir_filler(void* /*buf*/, const char* /*name*/, const struct stat* /*stbuf*/, off_t /*off*/, enum fuse_fill_dir_flags /*flags*/)
+{
+    return 0;
+}
+
+static void get_sub_directories(const std::string& strpath, const S3ObjList& head, s3obj_list_t& subdirs)
+{
+    s3obj_view_list_t headviews;
+    head.GetNameViews(headviews, true);
+    for(auto iter = headviews.cbegin(); iter != headviews.cend(); ++iter){
+        if(IS_DIR_OBJ(iter->type)){
+            std::string subdir = strpath;
+            subdir.append(iter->name);
+            if('/' == subdir.back()){
+                subdir.pop_back();
+            }
+            subdirs.push_back(std::move(subdir));
+        }
+    }
+}
+
+//
+// Prefetch function for DirPrefetcher
+//
+// [NOTE]
+// This lists the directory and sends HEAD requests for the objects in it
+// as same as s3fs_readdir, then caches the results in the Stat Cache.
+// The stats of sub directories are required for caching their listing,
+// so the sub directories are prefetched after this directory.
+//
+static int prefetch_directory(const std::string& path, s3obj_list_t& subdirs)
+{
+    int       result;
+    S3ObjList head;
+
+    std::string strpath = path;
+    if(path != "/"){
+        strpath += "/";
+    }
+
+    if(!StatCache::getStatCacheData()->GetS3ObjList(path, head)){
+        if(0 != (result = list_bucket(path.c_str(), head, "/"))){
+            return result;
+        }
+        if(!StatCache::getStatCacheData()->AddS3ObjList(path, head)){
+            S3FS_PRN_DBG("failed to add s3objlist for %s, but continue...", path.c_str());
+        }
+        if(!head.IsEmpty()){
+            s3obj_view_list_t headviews;
+            head.GetNameViews(headviews, true);
+            if(0 != (result = readdir_multi_head(strpath, head, headviews, &subdirs, prefetch_dir_filler, false))){
+                return result;
+            }
+        }
+    }
+    get_sub_directories(strpath, head, subdirs);
+    return 0;
+}
+
+static int s3fs_readdir(const char* _path, void* buf, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info* info, enum fuse_readdir_flags flags)
+{
+    const S3fsForeground foreground;
+
+    // [NOTE]
+    // FUSE passes a null path for a directory which was removed while
+    // it is still open.  s3fs does not keep a directory handle, so this
+    // cannot be served and returns ESTALE.
+    //
+    if(!_path || '\0' == _path[0]){
+        return -ESTALE;
+    }
+
+    WTF8_ENCODE(path)
+    S3ObjList head;
+    int result;
+
+    FUSE_CTX_INFO("[path=%s][offset=%lld][flags=0x%x]", path, static_cast<long long int>(offset), static_cast<unsigned int>(flags));
+
+    // [NOTE]
+    // If readdirplus option is specified and the kernel requests
+    // readdirplus, the stats are filled with the entries.
+    //
+    bool is_plus = use_readdirplus && (0 != (flags & FUSE_READDIR_PLUS));
+
+    if(info && 0 != info->fh){
+        return readdir_streaming(path, *reinterpret_cast<readdir_cursor*>(info->fh), buf, filler, offset, is_plus);
+    }
+
+    if(0 != (result = check_object_access(path, R_OK, nullptr))){
+        return result;
+    }
+
+    // check s3objlist in cache
+    if(!StatCache::getStatCacheData()->GetS3ObjList(path, head)){
+        // [NOTE]
+        // If readdir_bulk_list_keys is specified, the directories under the
+        // path are listed and cached at once.
+        //
+        bool completed = false;
+        if(0 < bulk_list_max_keys && 0 != (result = bulk_list_tree(path, head, completed))){
+            S3FS_PRN_WARN("bulk_list_tree returns error(%d), but continue...", result);
+        }
+        if(!completed){
+            // get a list of all the objects
+            if((result = list_bucket(path, head, "/")) != 0){
+                S3FS_PRN_ERR("list_bucket returns error(%d).", result);
+                return result;
+            }
+
+            if(!StatCache::getStatCacheData()->AddS3ObjList(path, head)){
+                S3FS_PRN_WARN("failed to add s3objlist for %s, but continue...", path);
+            }
+        }
+    }
+
+    // force to add "." and ".." name.
+    filler(buf, ".", nullptr, 0, S3FS_FUSE_FILL_DIR_DEFAULTS);
+    filler(buf, "..", nullptr, 0, S3FS_FUSE_FILL_DIR_DEFAULTS);
+    if(head.IsEmpty()){
+        if(DirPrefetcher::IsEnabled()){
+            // keep the prefetcher alive while the tree is walked
+            DirPrefetcher::Request(path, s3obj_list_t());
+        }
+        return 0;
+    }
+
+    // Send multi head request for stats caching.
+    std::string strpath = path;
+    if(strcmp(path, "/") != 0){
+        strpath += "/";
+    }
+
+    // Make base path list.
+    s3obj_view_list_t headviews;
+    head.GetNameViews(headviews, true);                                             // get name with "/".
+
+    // [NOTE]
+    // If there are leaf paths that only exist in the Stat Cache,
+    // they will be merged here.
+    // This means that for newly created file, the Stat Cache(NoTruncate)
+    // will exist before the actual file is uploaded.
+    // The names in head are excluded, and childmap must be alive while
+    // headviews is used.
+    //
+    s3obj_type_map_t childmap;
+    if(!StatCache::getStatCacheData()->GetChildStatMap(strpath, childmap, &head)){
+        S3FS_PRN_ERR("failed get child leaf list[path=%s], but continue...", strpath.c_str());
+    }
+    for(auto iter = childmap.cbegin(); iter != childmap.cend(); ++iter){
+        headviews.push_back({iter->first, iter->second});
+    }
+
+    if(0 != (result = readdir_multi_head(strpath, head, headviews, buf, filler, is_plus))){
+        S3FS_PRN_ERR("readdir_multi_head returns error(%d).", result);
+        return result;
+    }
+
+    // prefetch sub directories in background
+    if(DirPrefetcher::IsEnabled()){
+        s3obj_list_t subdirs;
+        get_sub_directories(strpath, head, subdirs);
+        DirPrefetcher::Request(path, subdirs);
+    }
+
+    return result;
+}
+
+//
+// Lists one page of objects under the path, and the state for the next
+// page is set in list_state.
+// If list_state.truncated is false after calling, there are no more pages.
+//
+//
+// Make the query for listing one page of objects
+//
+// [NOTE]
+// The next continuation token and the next marker in list_state are
+// consumed by this function.
+//
+static std::string make_list_bucket_query(const char* path, const char* delimiter, bool check_content_only, list_bucket_state& list_state)
+{
+    std::string s3_realpath;
+    std::string query_delimiter;
+    std::string query_prefix;
+    std::string query_maxkey;
+
+    if(delimiter && 0 < strlen(delimiter)){
+        query_delimiter += "delimiter=";
+        query_delimiter += delimiter;
+        query_delimiter += "&";
+    }
+
+    query_prefix += "&prefix=";
+    s3_realpath = get_realpath(path);
+    if(s3_realpath.empty() || '/' != *s3_realpath.rbegin()){
+        // last word must be "/"
+        query_prefix += urlEncodePath(s3_realpath.substr(1) + "/");
+    }else{
+        query_prefix += urlEncodePath(s3_realpath.substr(1));
+    }
+    if (check_content_only){
+        // Just need to know if there are child objects in dir
+        // For dir with children, expect "dir/" and "dir/child"
+        query_maxkey += "max-keys=2";
+    }else{
+        query_maxkey += "max-keys=" + std::to_string(max_keys_list_object);
+    }
+
+    std::string each_query;
+
+    // append parameters to query in alphabetical order
+    if(!list_state.next_continuation_token.empty()){
+        each_query                        += "continuation-token=" + urlEncodePath(list_state.next_continuation_token) + "&";
+        list_state.next_continuation_token = "";
+    }
+    each_query += query_delimiter;
+    if(S3fsCurl::IsListObjectsV2()){
+        each_query += "list-type=2&";
+    }
+    if(!list_state.next_marker.empty()){
+        each_query            += "marker=" + urlEncodePath(list_state.next_marker) + "&";
+        list_state.next_marker = "";
+    }
+    each_query += query_maxkey;
+    each_query += query_prefix;
+
+    return each_query;
+}
+
+//
+// Parse one page of listing objects and set the state for the next page
+//
+static int parse_list_bucket_page(const char* path, const std::string& responseBody, S3ObjList& head, list_bucket_state& list_state)
+{
+    int result;
+    if(0 != (result = parse_list_bucket_result(path, responseBody, head, list_state.truncated, list_state.next_continuation_token, list_state.next_marker))){
+        return result;
+    }
+    if(list_state.truncated){
+        if(list_state.next_continuation_token.empty() && list_state.next_marker.empty()){
+            // If did not specify "delimiter", s3 did not return "NextMarker".
+            // On this case, can use last name for next marker.
+            //
+            auto lastname = head.GetLastName();
+            if(!lastname){
+                S3FS_PRN_WARN("Could not find next marker, thus break loop.");
+                list_state.truncated = false;
+            }else{
+                std::string s3_realpath = get_realpath(path);
+                list_state.next_marker  = s3_realpath.substr(1);
+                if(s3_realpath.empty() || '/' != *s3_realpath.rbegin()){
+                    list_state.next_marker += "/";
+                }
+                list_state.next_marker += *lastname;
+            }
+        }
+    }
+    return 0;
+}
+
+static int list_bucket_page(const char* path, S3ObjList& head, const char* delimiter, bool check_content_only, list_bucket_state& list_state)
+{
+    S3FS_PRN_INFO1("[path=%s]", path);
+
+    int         result;
+    std::string responseBody;
+
+    // send request
+    if(0 != (result = list_bucket_request(SAFESTRPTR(path), make_list_bucket_query(path, delimiter, check_content_only, list_state), responseBody))){
+        return result;
+    }
+    return parse_list_bucket_page(path, responseBody, head, list_state);
+}
+
+//
+// The greatest character(U+10FFFF in UTF-8) which is appended to the names
+// for starting the listing after all names which have the same prefix.
+//
+static constexpr char LIST_RANGE_MAX_SUFFIX[] = "\xf4\x8f\xbf\xbf";
+
+//
+// Get the first name(relative to prefix) after start_after in the listing
+//
+// [NOTE]
+// This requests only one object(max-keys=1) for sampling the key space
+// to make the ranges. If there is no object after start_after, name is
+// set to nullopt.
+//
+static int list_bucket_first_after(const list_bucket_range_req_thparam& param, const std::string& start_after, std::optional<std::string>& name)
+{
+    // append parameters to query in alphabetical order
+    std::string query = param.query_delimiter;
+    if(S3fsCurl::IsListObjectsV2()){
+        query += "list-type=2&";
+    }else{
+        query += "marker=" + urlEncodePath(start_after) + "&";
+    }
+    query += "max-keys=1";
+    query += "&prefix=" + urlEncodePath(param.prefix);
+    if(S3fsCurl::IsListObjectsV2()){
+        query += "&start-after=" + urlEncodePath(start_after);
+    }
+
+    int         result;
+    std::string responseBody;
+    if(0 != (result = list_bucket_request(param.path, query, responseBody))){
+        return result;
+    }
+
+    S3ObjList   list;
+    bool        truncated = false;
+    std::string next_continuation_token;
+    std::string next_marker;
+    if(0 != (result = parse_list_bucket_result(param.path.c_str(), responseBody, list, truncated, next_continuation_token, next_marker))){
+        return result;
+    }
+    name = list.GetLastName();
+    return 0;
+}
+
+static constexpr int list_range_char_class(unsigned char ch)
+{
+    if('0' <= ch && ch <= '9'){
+        return 0;
+    }else if('A' <= ch && ch <= 'Z'){
+        return 1;
+    }else if('a' <= ch && ch <= 'z'){
+        return 2;
+    }
+    return 3;
+}
+
+//
+// Make the ranges for listing the rest of objects after the first page in parallel
+//
+// [NOTE]
+// The key space after the first page is sampled by listing one object
+// after some names, and it is split at the most significant position
+// where the names of the rest of objects differ:
+//   1) The position is the longest part of the last name(L) of the first
+//      page which all the rest of objects have, it is found by binary
+//      search of the listings after L[0..i) + U+10FFFF.
+//   2) The greatest character at that position is found by binary search
+//      in the same way.
+//   3) The characters from L[pos] to the greatest character are split
+//      equally into the ranges. If both ends are alphanumeric, only the
+//      alphanumeric classes(digit, upper case, lower case) which appear at
+//      that position are used.
+// The first range continues from the first page and the last range
+// continues until the end of listing, so the ranges always cover all
+// objects even if the sampling is not accurate.
+//
+static bool make_list_bucket_ranges(const char* path, const S3ObjList& head, const char* delimiter, const list_bucket_state& list_state, std::vector<list_bucket_range_req_thparam>& ranges)
+{
+    auto lastname = head.GetLastName();
+    if(!lastname || lastname->empty()){
+        return false;
+    }
+
+    // common parameters
+    list_bucket_range_req_thparam param;
+    param.path = path;
+
+    std::string s3_realpath = get_realpath(path);
+    param.prefix = s3_realpath.substr(1);
+    if(s3_realpath.empty() || '/' != *s3_realpath.rbegin()){
+        param.prefix += "/";
+    }
+    if(delimiter && 0 < strlen(delimiter)){
+        param.query_delimiter  = "delimiter=";
+        param.query_delimiter += delimiter;
+        param.query_delimiter += "&";
+    }
+    param.query_maxkey = "max-keys=" + std::to_string(max_keys_list_object);
+
+    // 1) the position which the rest of objects differ
+    std::optional<std::string> name;
+    std::string::size_type     low  = 0;
+    std::string::size_type     high = lastname->size();
+    while(low < high){
+        std::string::size_type mid = low + (high - low + 1) / 2;
+        if(0 != list_bucket_first_after(param, param.prefix + lastname->substr(0, mid) + LIST_RANGE_MAX_SUFFIX, name)){
+            return false;
+        }
+        if(!name){
+            low  = mid;             // all of the rest have L[0..mid)
+        }else{
+            high = mid - 1;
+        }
+    }
+    // [NOTE]
+    // If all of the rest have L(pos is the length of L), the names are
+    // split from '0' after L. Otherwise, there are objects after
+    // L[0..pos] + U+10FFFF by 1), so the greatest character is greater
+    // than L[pos].
+    //
+    std::string::size_type pos      = low;
+    std::string            base     = lastname->substr(0, pos);
+    unsigned char          lowch    = '0';
+    unsigned char          lowbound = '0';
+    if(pos < lastname->size()){
+        lowch    = static_cast<unsigned char>((*lastname)[pos]);
+        lowbound = static_cast<unsigned char>(lowch + 1);
+    }
+    if(0x7e < lowbound){
+        return false;
+    }
+
+    // 2) the greatest character at the position
+    unsigned char highbound = 0x7e;
+    while(lowbound < highbound){
+        auto mid = static_cast<unsigned char>(lowbound + (highbound - lowbound) / 2);
+        if(0 != list_bucket_first_after(param, param.prefix + base + static_cast<char>(mid) + LIST_RANGE_MAX_SUFFIX, name)){
+            return false;
+        }
+        if(!name){
+            highbound = mid;        // no object has a character greater than mid
+        }else{
+            lowbound  = mid + 1;
+        }
+    }
+    unsigned char highch = highbound;
+    if(highch <= lowch){
+        return false;
+    }
+
+    // 3) characters for splitting
+    bool has_class[4] = {false, false, false, false};
+    has_class[list_range_char_class(lowch)]  = true;
+    has_class[list_range_char_class(highch)] = true;
+    bool is_alnum = (3 != list_range_char_class(lowch) && 3 != list_range_char_class(highch));
+    if(is_alnum){
+        const unsigned char class_firsts[] = {'0', 'A', 'a'};
+        for(int cls = list_range_char_class(lowch) + 1; cls < list_range_char_class(highch); ++cls){
+            if(0 != list_bucket_first_after(param, param.prefix + base + static_cast<char>(class_firsts[cls] - 1) + LIST_RANGE_MAX_SUFFIX, name)){
+                return false;
+            }
+            has_class[cls] = (name && pos < name->size() && list_range_char_class(static_cast<unsigned char>((*name)[pos])) == cls);
+        }
+    }
+    std::string chars;
+    for(unsigned int ch = lowch; ch <= highch; ++ch){
+        if(!is_alnum || (3 != list_range_char_class(static_cast<unsigned char>(ch)) && has_class[list_range_char_class(static_cast<unsigned char>(ch))])){
+            chars += static_cast<char>(ch);
+        }
+    }
+
+    // boundary names of ranges
+    std::vector<std::string> bounds;
+    std::string::size_type   lastidx = 0;
+    for(int cnt = 1; cnt < list_parallel_count; ++cnt){
+        std::string::size_type idx = (chars.size() * static_cast<std::string::size_type>(cnt)) / static_cast<std::string::size_type>(list_parallel_count);
+        if(lastidx < idx && idx < chars.size()){
+            bounds.push_back(base + chars[idx]);
+            lastidx = idx;
+        }
+    }
+    if(bounds.empty()){
+        return false;
+    }
+    S3FS_PRN_DBG("split the listing at the position %zu of the names from %c to %c [path=%s]", pos, lowch, highch, path);
+
+    // the first range continues from the first page
+    param.start_after             = list_state.next_marker;
+    param.next_continuation_token = list_state.next_continuation_token;
+    param.end_name                = bounds.front();
+    ranges.push_back(param);
+    param.next_continuation_token.clear();
+
+    for(auto iter = bounds.cbegin(); iter != bounds.cend(); ++iter){
+        auto next           = std::next(iter);
+        param.start_after   = param.prefix + *iter;
+        param.end_name      = (next != bounds.cend() ? *next : "");
+        ranges.push_back(param);
+    }
+    return true;
+}
+
+static int list_bucket(const char* path, S3ObjList& head, const char* delimiter, bool check_content_only)
+{
+    S3FS_PRN_INFO1("[path=%s]", path);
+
+    list_bucket_state list_state;
+    std::string       responseBody;
+    std::string       nextBody;             // buffer for the next page, reused across pages
+    bool              is_first = true;
+    int               result;
+
+    // send request for the first page
+    if(0 != (result = list_bucket_request(SAFESTRPTR(path), make_list_bucket_query(path, delimiter, check_content_only, list_state), responseBody))){
+        return result;
+    }
+
+    while(true){
+        // [NOTE]
+        // The next page request is started as soon as the next continuation
+        // token(or marker) is found by scanning the response body, so that
+        // parsing the current page overlaps with fetching the next page.
+        // If it is not found by scanning, the next page is requested after
+        // parsing the current page.
+        // When listing in parallel, the first page is needed to make the
+        // ranges, so the next page is not requested for the first page.
+        //
+        list_bucket_state       next_state;
+        list_bucket_req_thparam next_thargs;
+        Semaphore               next_sem(0);
+        bool                    is_prefetch = false;
+
+        if(!check_content_only && !(is_first && 1 < list_parallel_count) && scan_list_bucket_next(responseBody, (!delimiter || '\0' == delimiter[0]), next_state.truncated, next_state.next_continuation_token, next_state.next_marker) && next_state.truncated){
+            next_thargs.path          = SAFESTRPTR(path);
+            next_thargs.query         = make_list_bucket_query(path, delimiter, check_content_only, next_state);
+            next_thargs.presponseBody = &nextBody;
+            is_prefetch               = (0 == list_bucket_request(next_thargs, next_sem));
+        }
+
+        result = parse_list_bucket_page(path, responseBody, head, list_state);
+
+        if(is_prefetch){
+            // [NOTE] next_thargs must be kept until the request is finished.
+            next_sem.acquire();
+        }
+        if(0 != result){
+            return result;
+        }
+        if(check_content_only){
+            break;
+        }
+        if(is_prefetch){
+            if(0 != next_thargs.result){
+                S3FS_PRN_ERR("List Bucket Request by error(%d) [path=%s][query=%s]", next_thargs.result, next_thargs.path.c_str(), next_thargs.query.c_str());
+                return next_thargs.result;
+            }
+            responseBody.swap(nextBody);
+            is_first     = false;
+            continue;
+        }
+        if(!list_state.truncated){
+            break;
+        }
+
+        // [NOTE]
+        // If the first page is truncated, the rest of objects are listed
+        // in parallel by splitting into ranges, and the results are merged
+        // into head in ascending order of the ranges.
+        //
+        std::vector<list_bucket_range_req_thparam> ranges;
+        if(is_first && 1 < list_parallel_count && make_list_bucket_ranges(path, head, delimiter, list_state, ranges)){
+            S3FS_PRN_INFO3("list objects in %zu ranges in parallel [path=%s]", ranges.size(), path);
+
+            if(0 != (result = parallel_list_bucket_request(ranges))){
+                return result;
+            }
+            for(const auto& range: ranges){
+                head.Append(range.list);
+            }
+            break;
+        }
+        is_first = false;
+
+        // send request for the next page
+        if(0 != (result = list_bucket_request(SAFESTRPTR(path), make_list_bucket_query(path, delimiter, check_content_only, list_state), responseBody))){
+            return result;
+        }
+    }
+    return 0;
+}
+
+//
+// Check the directory objects of the path which is not found as "object"
+//
+// [NOTE]
+// The "object/" and "object_$folder$"(only with compat_dir) objects and
+// the children of the path("no dir object") are checked concurrently
+// instead of one by one, so that the lookup of an implicit directory
+// or a non-existent object takes one round-trip instead of three.
+// The result is decided in the same order as checking one by one, that
+// is, "object/" first, then "object_$folder$", then "no dir object".
+// The path is "object" without a trailing slash, and objpath is set to
+// the found object path.
+//
+static int check_directory_objects(const std::string& path, headers_t& meta, objtype_t& ObjType, std::string& objpath)
+{
+    head_req_thparam        slash_thargs;
+    head_req_thparam        folder_thargs;
+    headers_t               slash_meta;
+    headers_t               folder_meta;
+    list_bucket_req_thparam list_thargs;
+    list_bucket_state       list_state;
+    std::string             responseBody;
+    S3ObjList               head;
+    Semaphore               probe_sem(0);
+    int                     req_count    = 0;
+    int                     sched_result;
+    bool                    is_cached    = StatCache::getStatCacheData()->GetS3ObjList(path, head);
+
+    // "object/"
+    slash_thargs.path  = path + "/";
+    slash_thargs.pmeta = &slash_meta;
+    if(0 == (sched_result = head_request(slash_thargs, probe_sem))){
+        ++req_count;
+    }
+    // "object_$folder$"
+    if(0 == sched_result && support_compat_dir){
+        folder_thargs.path  = path + "_$folder$";
+        folder_thargs.pmeta = &folder_meta;
+        if(0 == (sched_result = head_request(folder_thargs, probe_sem))){
+            ++req_count;
+        }
+    }
+    // "no dir object"(same as directory_empty)
+    if(0 == sched_result && !is_cached){
+        list_thargs.path          = path;
+        list_thargs.query         = make_list_bucket_query(path.c_str(), "/", true, list_state);
+        list_thargs.presponseBody = &responseBody;
+        if(0 == (sched_result = list_bucket_request(list_thargs, probe_sem))){
+            ++req_count;
+        }
+    }
+
+    // wait for finish all requests
+    while(req_count > 0){
+        probe_sem.acquire();
+        --req_count;
+    }
+    if(0 != sched_result){
+        return sched_result;
+    }
+
+    if(0 == slash_thargs.result){
+        // found "object/"
+        meta    = std::move(slash_meta);
+        ObjType = objtype_t::DIR_NORMAL;
+        objpath = slash_thargs.path;
+        return 0;
+    }
+    int result = slash_thargs.result;
+
+    if(support_compat_dir){
+        if(0 == folder_thargs.result){
+            // found "object_$folder$"
+            meta    = std::move(folder_meta);
+            ObjType = objtype_t::DIR_FOLDER_SUFFIX;
+            objpath = folder_thargs.path;
+            return 0;
+        }
+        result = folder_thargs.result;
+    }
+
+    if(!is_cached){
+        if(0 != list_thargs.result || 0 != parse_list_bucket_page(path.c_str(), responseBody, head, list_state)){
+            S3FS_PRN_ERR("list_bucket returns error.");
+            return result;
+        }
+        if(!head.IsEmpty() && !list_state.truncated){
+            // cache only if all objects are listed(same as directory_empty)
+            if(!StatCache::getStatCacheData()->AddS3ObjList(path, head)){
+                S3FS_PRN_WARN("failed to add s3objlist for %s, but continue...", path.c_str());
+            }
+        }
+    }
+    if(!head.IsEmpty()){
+        // found "non-existed directory object".
+        meta.clear();
+        ObjType = objtype_t::DIR_NOT_EXIST_OBJECT;
+        objpath = path + "/";
+        return 0;
+    }
+    return result;
+}
+
+static int remote_mountpath_exists(const char* path, bool compat_dir)
+{
+    struct stat stbuf;
+    int result;
+
+    S3FS_PRN_INFO1("[path=%s]", path);
+
+    // getattr will prefix the path with the remote mountpoint
+    if(0 != (result = get_object_attribute(path, &stbuf, nullptr))){
+        return result;
     }
 
     // [NOTE]
@@ -4239,6 +5261,8 @@ static int s3fs_setxattr(const char* _path, const char* name, const char* value,
 
 static int s3fs_getxattr(const char* path, const char* name, char* value, size_t size)
 {
+    const S3fsForeground foreground;
+
     FUSE_CTX_DBG("[path=%s][name=%s][value=%p][size=%zu]", path, name, value, size);
 
     if(!path || !name){
@@ -4296,6 +5320,8 @@ static int s3fs_getxattr(const char* path, const char* name, char* value, size_t
 
 static int s3fs_listxattr(const char* path, char* list, size_t size)
 {
+    const S3fsForeground foreground;
+
     S3FS_PRN_INFO("[path=%s][list=%p][size=%zu]", path, list, size);
 
     if(!path){
@@ -4586,6 +5612,15 @@ static void* s3fs_init(struct fuse_conn_info* conn, fuse_config* config)
         config->hard_remove = 1;
     }
 
+    // immutable: the objects are never changed, so the kernel keeps the
+    // page cache across opens and caches the entries and attributes for
+    // a long time.
+    if(is_immutable){
+        config->kernel_cache  = 1;
+        config->entry_timeout = std::max(config->entry_timeout, IMMUTABLE_KERNEL_TIMEOUT);
+        config->attr_timeout  = std::max(config->attr_timeout, IMMUTABLE_KERNEL_TIMEOUT);
+    }
+
     // cache(remove cache dirs at first)
     if(is_remove_cache && (!CacheFileStat::DeleteCacheFileStatDirectory() || !FdManager::DeleteCacheDirectory())){
         S3FS_PRN_DBG("Could not initialize cache directory.");
@@ -4595,6 +5630,10 @@ static void* s3fs_init(struct fuse_conn_info* conn, fuse_config* config)
         S3FS_PRN_CRIT("Could not create thread pool(%d)", ThreadPoolMan::GetWorkerCount());
         s3fs_exit_fuseloop(EXIT_FAILURE);
     }
+    if(!DirPrefetcher::Initialize(prefetch_directory)){
+        S3FS_PRN_CRIT("Could not initialize directory prefetcher.");
+        s3fs_exit_fuseloop(EXIT_FAILURE);
+    }
 
     // check loading IAM role name
     if(!S3fsCred::get()->LoadIAMRoleFromMetaData()){
@@ -4618,6 +5657,20 @@ static void* s3fs_init(struct fuse_conn_info* conn, fuse_config* config)
          conn->want |= FUSE_CAP_ATOMIC_O_TRUNC;
     }
     #endif
+    #ifdef FUSE_CAP_CACHE_SYMLINKS
+    if(is_immutable && (conn->capable & FUSE_CAP_CACHE_SYMLINKS)){
+        conn->want |= FUSE_CAP_CACHE_SYMLINKS;
+    }
+    #endif
+    #ifdef FUSE_CAP_READDIRPLUS
+    if(use_readdirplus){
+        if(conn->capable & FUSE_CAP_READDIRPLUS){
+            conn->want |= FUSE_CAP_READDIRPLUS;
+        }else{
+            S3FS_PRN_WARN("readdirplus option is specified, but the kernel does not support readdirplus.");
+        }
+    }
+    #endif
 
 
     // Signal object(always true)
@@ -4630,6 +5683,7 @@ static void s3fs_destroy(void*)
 {
     S3FS_PRN_INFO("destroy");
 
+    DirPrefetcher::Destroy();
     ThreadPoolMan::Destroy();
 
     // cache(remove at last)
@@ -4640,6 +5694,8 @@ static void s3fs_destroy(void*)
 
 static int s3fs_access(const char* path, int mask)
 {
+    const S3fsForeground foreground;
+
     if(!path || '\0' == path[0]){
         return -ESTALE;
     }
@@ -5233,6 +6289,36 @@ static int my_fuse_opt_proc(void* data, const char* arg, int key, struct fuse_ar
             S3fsCurl::SetRetries(static_cast<int>(retries));
             return 0;
         }
+        else if(is_prefix(arg, "retry_backoff_throttle=")){
+            if(!S3fsRetryPolicy::SetBackoff(retry_class::THROTTLE, strchr(arg, '=') + sizeof(char))){
+                S3FS_PRN_EXIT("failed to set retry_backoff_throttle option(%s).", arg);
+                return -1;
+            }
+            return 0;
+        }
+        else if(is_prefix(arg, "retry_backoff_server=")){
+            if(!S3fsRetryPolicy::SetBackoff(retry_class::SERVER, strchr(arg, '=') + sizeof(char))){
+                S3FS_PRN_EXIT("failed to set retry_backoff_server option(%s).", arg);
+                return -1;
+            }
+            return 0;
+        }
+        else if(is_prefix(arg, "retry_backoff_network=")){
+            if(!S3fsRetryPolicy::SetBackoff(retry_class::NETWORK, strchr(arg, '=') + sizeof(char))){
+                S3FS_PRN_EXIT("failed to set retry_backoff_network option(%s).", arg);
+                return -1;
+            }
+            return 0;
+        }
+        else if(is_prefix(arg, "retry_budget=")){
+            off_t budget = cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10);
+            if(budget < 0){
+                S3FS_PRN_EXIT("argument should be 0 or over: retry_budget");
+                return -1;
+            }
+            S3fsRetryPolicy::SetBudget(static_cast<long>(budget));
+            return 0;
+        }
         else if(is_prefix(arg, "tmpdir=")){
             FdManager::SetTmpDir(strchr(arg, '=') + sizeof(char));
             return 0;
@@ -5456,6 +6542,40 @@ static int my_fuse_opt_proc(void* data, const char* arg, int key, struct fuse_ar
             max_keys_list_object = max_keys;
             return 0;
         }
+        else if(is_prefix(arg, "list_object_parallel_count=")){
+            int count = static_cast<int>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            if(0 >= count){
+                S3FS_PRN_EXIT("argument should be over 1: list_object_parallel_count");
+                return -1;
+            }
+            list_parallel_count = count;
+            return 0;
+        }
+        else if(is_prefix(arg, "readdir_bulk_list_keys=")){
+            int max_keys = static_cast<int>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            if(max_keys < 0){
+                S3FS_PRN_EXIT("argument should be 0 or more: readdir_bulk_list_keys");
+                return -1;
+            }
+            bulk_list_max_keys = max_keys;
+            return 0;
+        }
+        else if(is_prefix(arg, "readdir_prefetch_depth=")){
+            int depth = static_cast<int>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            if(!DirPrefetcher::SetMaxDepth(depth)){
+                S3FS_PRN_EXIT("argument should be 0 or more: readdir_prefetch_depth");
+                return -1;
+            }
+            return 0;
+        }
+        else if(is_prefix(arg, "readdir_prefetch_dirs=")){
+            int count = static_cast<int>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            if(!DirPrefetcher::SetMaxQueue(count)){
+                S3FS_PRN_EXIT("argument should be over 1: readdir_prefetch_dirs");
+                return -1;
+            }
+            return 0;
+        }
         else if(is_prefix(arg, "max_stat_cache_size=")){
             auto cache_size = static_cast<unsigned long>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), 10));
             StatCache::getStatCacheData()->SetCacheSize(cache_size);
@@ -5473,6 +6593,15 @@ static int my_fuse_opt_proc(void* data, const char* arg, int key, struct fuse_ar
             StatCacheNode::SetExpireTime(expr_time, true);
             return 0;
         }
+        else if(is_prefix(arg, "stat_cache_policy_file=")){
+            std::string policy_file = strchr(arg, '=') + sizeof(char);
+            if(!StatCachePolicy::get()->Load(policy_file.c_str())){
+                S3FS_PRN_EXIT("failed to load stat_cache_policy_file file(%s).", policy_file.c_str());
+                return -1;
+            }
+            StatCachePolicy::get()->Dump();
+            return 0;
+        }
         else if(0 == strcmp(arg, "enable_negative_cache") || 0 == strcmp(arg, "enable_noobj_cache")){
             S3FS_PRN_WARN("enable_negative_cache(enable_noobj_cache) is enabled by default and a future version will remove this option.");
             StatCacheNode::EnableNegativeCache();
@@ -5490,6 +6619,39 @@ static int my_fuse_opt_proc(void* data, const char* arg, int key, struct fuse_ar
             S3fsCurlShare::SetSslSessionCache(false);
             return 0;
         }
+        else if(0 == strcmp(arg, "conncache")){
+            S3fsCurlShare::SetConnectionCache(true);
+            return 0;
+        }
+        else if(0 == strcmp(arg, "http2")){
+            S3fsCurl::SetHttp2(true);
+            return 0;
+        }
+        else if(is_prefix(arg, "http2_max_streams=")){
+            long streams = static_cast<long>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            if(0 >= streams){
+                S3FS_PRN_EXIT("argument should be over 1: http2_max_streams");
+                return -1;
+            }
+            S3fsCurlMulti::SetMaxConcurrentStreams(streams);
+            return 0;
+        }
+        else if(is_prefix(arg, "hedge_percentile=")){
+            int percentile = static_cast<int>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            if(!S3fsHedgePolicy::SetPercentile(percentile)){
+                S3FS_PRN_EXIT("argument should be 0 to 99: hedge_percentile");
+                return -1;
+            }
+            return 0;
+        }
+        else if(is_prefix(arg, "hedge_budget=")){
+            int percent = static_cast<int>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            if(!S3fsHedgePolicy::SetBudget(percent)){
+                S3FS_PRN_EXIT("argument should be 0 to 100: hedge_budget");
+                return -1;
+            }
+            return 0;
+        }
         else if(is_prefix(arg, "multireq_max=") || is_prefix(arg, "parallel_count=") || is_prefix(arg, "parallel_upload=")){
             S3FS_PRN_WARN("The multireq_max, parallel_count and parallel_upload options have been deprecated and merged with max_thread_count. In the near future, these options will no longer be available. For compatibility, the values you specify for these options will be treated as max_thread_count.");
 
@@ -5510,6 +6672,50 @@ static int my_fuse_opt_proc(void* data, const char* arg, int key, struct fuse_ar
             ThreadPoolMan::SetWorkerCount(max_thcount);
             return 0;
         }
+        else if(is_prefix(arg, "curl_multi_streams=")){
+            int streams = static_cast<int>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            if(0 > streams){
+                S3FS_PRN_EXIT("argument should be 0 or over: curl_multi_streams");
+                return -1;
+            }
+            S3fsCurlMulti::SetMaxStreams(streams);
+            return 0;
+        }
+        else if(is_prefix(arg, "adaptive_concurrency=")){
+            int max_limit = static_cast<int>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            if(!AdaptiveConcurrency::SetMaxLimit(max_limit)){
+                S3FS_PRN_EXIT("argument should be 0 or over: adaptive_concurrency");
+                return -1;
+            }
+            return 0;
+        }
+        else if(is_prefix(arg, "upload_rate_limit=")){
+            off_t rate = cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10);
+            if(0 > rate){
+                S3FS_PRN_EXIT("argument should be 0 or over: upload_rate_limit");
+                return -1;
+            }
+            S3fsRateLimiter::SetUploadRate(rate * 1024);
+            return 0;
+        }
+        else if(is_prefix(arg, "download_rate_limit=")){
+            off_t rate = cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10);
+            if(0 > rate){
+                S3FS_PRN_EXIT("argument should be 0 or over: download_rate_limit");
+                return -1;
+            }
+            S3fsRateLimiter::SetDownloadRate(rate * 1024);
+            return 0;
+        }
+        else if(is_prefix(arg, "request_rate_limit=")){
+            int rate = static_cast<int>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            if(0 > rate){
+                S3FS_PRN_EXIT("argument should be 0 or over: request_rate_limit");
+                return -1;
+            }
+            S3fsRateLimiter::SetRequestRate(rate);
+            return 0;
+        }
         else if(is_prefix(arg, "fd_page_size=")){
             S3FS_PRN_ERR("option fd_page_size is no longer supported, so skip this option.");
             return 0;
@@ -5669,10 +6875,46 @@ static int my_fuse_opt_proc(void* data, const char* arg, int key, struct fuse_ar
             S3fsCurl::SetUnsignedPayload(true);
             return 0;
         }
+        else if(is_prefix(arg, "checksum_algorithm=")){
+            const char* strtype = strchr(arg, '=') + sizeof(char);
+            checksum_type_t type;
+            if(!parse_checksum_type(strtype, type)){
+                S3FS_PRN_EXIT("unknown value for checksum_algorithm: %s", strtype);
+                return -1;
+            }
+            S3fsCurl::SetChecksumType(type);
+            S3FS_PRN_INFO("checksum_algorithm is %s(%s).", strtype, s3fs_crc_impl_name());
+            return 0;
+        }
         else if(0 == strcmp(arg, "update_parent_dir_stat")){
             update_parent_dir_stat = true;
             return 0;
         }
+        else if(0 == strcmp(arg, "list_only_stat")){
+            use_list_only_stat = true;
+            return 0;
+        }
+        else if(0 == strcmp(arg, "immutable")){
+            // [NOTE]
+            // The immutable mode is always read-only, so "ro" is passed
+            // to FUSE instead of this option.
+            //
+            if(0 != fuse_opt_add_arg(outargs, "-oro")){
+                S3FS_PRN_EXIT("failed to add ro option for immutable option.");
+                return -1;
+            }
+            is_immutable = true;
+            StatCacheNode::SetImmutable(true);
+            return 0;
+        }
+        else if(0 == strcmp(arg, "readdirplus")){
+            use_readdirplus = true;
+            return 0;
+        }
+        else if(0 == strcmp(arg, "streaming_readdir")){
+            use_streaming_readdir = true;
+            return 0;
+        }
         else if(is_prefix(arg, "host=")){
             s3host = strchr(arg, '=') + sizeof(char);
             return 0;
@@ -6229,6 +7471,7 @@ int main(int argc, char* argv[])
     s3fs_oper.release     = s3fs_release;
     s3fs_oper.opendir     = s3fs_opendir;
     s3fs_oper.readdir     = s3fs_readdir;
+    s3fs_oper.releasedir  = s3fs_releasedir;
     s3fs_oper.init        = s3fs_init;
     s3fs_oper.destroy     = s3fs_destroy;
     s3fs_oper.access      = s3fs_access;
@@ -22,6 +22,7 @@
 #define S3FS_AUTH_H_
 
 #include <array>
+#include <functional>
 #include <memory>
 #include <string>
 #include <sys/types.h>
@@ -29,6 +30,11 @@
 using md5_t    = std::array<unsigned char, 16>;
 using sha256_t = std::array<unsigned char, 32>;
 
+// The block size to read a file for the digests
+inline constexpr size_t DIGEST_READ_SIZE = 1024 * 1024;
+
+using digest_update_func = std::function<bool(const unsigned char* data, size_t length)>;
+
 //-------------------------------------------------------------------
 // Utility functions for Authentication
 //-------------------------------------------------------------------
@@ -37,6 +43,7 @@ using sha256_t = std::array<unsigned char, 32>;
 //
 std::string s3fs_get_content_md5(int fd);
 std::string s3fs_sha256_hex_fd(int fd, off_t start, off_t size);
+bool s3fs_read_fd_blocks(int fd, off_t start, off_t size, const digest_update_func& func);
 
 //
 // in xxxxxx_auth.cpp
@@ -52,6 +59,8 @@ bool s3fs_md5(const unsigned char* data, size_t datalen, md5_t* result);
 bool s3fs_md5_fd(int fd, off_t start, off_t size, md5_t* result);
 bool s3fs_sha256(const unsigned char* data, size_t datalen, sha256_t* digest);
 bool s3fs_sha256_fd(int fd, off_t start, off_t size, sha256_t* result);
+// extra_func is called with the same blocks in the same pass(ex. for the additional checksum)
+bool s3fs_md5_sha256_fd(int fd, off_t start, off_t size, md5_t* md5, sha256_t* sha256, const digest_update_func& extra_func = nullptr);
 
 #endif // S3FS_AUTH_H_
 
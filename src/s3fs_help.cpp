@@ -68,6 +68,29 @@ static constexpr char help_string[] =
     "   retries (default=\"5\")\n"
     "      - number of times to retry a failed S3 transaction\n"
     "\n"
+    "   retry_backoff_throttle (default=\"200:20000\")\n"
+    "      - the minimum and maximum wait, in milliseconds, before retrying\n"
+    "      a S3 transaction which failed with HTTP response code 429 or\n"
+    "      503, specified as \"<base ms>:<cap ms>\". The wait grows\n"
+    "      exponentially with random jitter between these values.\n"
+    "      While a worker thread waits for retrying, a helper thread\n"
+    "      sends the other requests instead of it.\n"
+    "\n"
+    "   retry_backoff_server (default=\"100:10000\")\n"
+    "      - same as retry_backoff_throttle, for HTTP response code 500,\n"
+    "      502 and 504.\n"
+    "\n"
+    "   retry_backoff_network (default=\"100:5000\")\n"
+    "      - same as retry_backoff_throttle, for the communication errors.\n"
+    "\n"
+    "   retry_budget (default=\"500\")\n"
+    "      - the size of the token bucket which limits the retries of all\n"
+    "      S3 transactions. Each retry takes 5 tokens and each successful\n"
+    "      transaction returns 1 token. The tokens are also refilled over\n"
+    "      time, the whole budget in 10 seconds. When the tokens run out,\n"
+    "      the failed transactions are not retried until the tokens are\n"
+    "      returned. 0 means that the retries are not limited.\n"
+    "\n"
     "   tmpdir (default=\"/tmp\")\n"
     "      - local folder for temporary files.\n"
     "\n"
@@ -188,6 +211,40 @@ static constexpr char help_string[] =
     "      - specify the maximum number of keys returned by S3 list object\n"
     "        API. The default is 1000. you can set this value to 1000 or more.\n"
     "\n"
+    "   list_object_parallel_count (default=\"1\")\n"
+    "      - specify the number of ranges to list objects in parallel.\n"
+    "        If the first page of listing objects is truncated, the rest of\n"
+    "        the key space is sampled by a few listing requests for one\n"
+    "        object, split into this number of ranges at the position where\n"
+    "        the rest of the names differ, and the ranges are listed\n"
+    "        concurrently.\n"
+    "        This is effective for directories with very many objects.\n"
+    "        The default is 1, which lists the pages sequentially.\n"
+    "\n"
+    "   readdir_bulk_list_keys (default=\"0\")\n"
+    "      - specify the maximum number of objects to list without\n"
+    "        delimiter on readdir of a directory which is not cached.\n"
+    "        The listings of all directories under it and the stats of\n"
+    "        the objects are made from one listing and cached in the stat\n"
+    "        cache, as same as list_only_stat option. If the objects are\n"
+    "        over this number, only the completely listed directories are\n"
+    "        cached. This number should be less than max_stat_cache_size.\n"
+    "        The default is 0, which does not list without delimiter.\n"
+    "\n"
+    "   readdir_prefetch_depth (default=\"0\")\n"
+    "      - specify the depth of sub directories to list in background\n"
+    "        after readdir. The listings and the stats of the objects in\n"
+    "        them are cached in the stat cache ahead of the tree walkers\n"
+    "        such as find, du and rsync. The prefetch is stopped when\n"
+    "        readdir is not called for a while. The directories are\n"
+    "        listed by one of the threads of max_thread_count, so this\n"
+    "        option is ignored if max_thread_count is less than 2.\n"
+    "        The default is 0, which does not prefetch.\n"
+    "\n"
+    "   readdir_prefetch_dirs (default=\"1000\")\n"
+    "      - specify the maximum number of directories waiting for\n"
+    "        prefetching by readdir_prefetch_depth option.\n"
+    "\n"
     "   max_stat_cache_size (default=\"100,000\" entries (about 40MB))\n"
     "      - maximum number of entries in the stat cache, and this maximum is\n"
     "        also treated as the number of symbolic link cache.\n"
@@ -202,11 +259,30 @@ static constexpr char help_string[] =
     "      of the stat cache. This option is exclusive with stat_cache_expire,\n"
     "      and is left for compatibility with older versions.\n"
     "\n"
+    "   stat_cache_policy_file (default is no rule)\n"
+    "      - specify the file which has the rules of the stat cache for each\n"
+    "        path prefix. Each line of the file has a path prefix(absolute\n"
+    "        path from the mount point) and options separated by spaces or\n"
+    "        commas. Each component of the path can be a glob pattern, and\n"
+    "        the rule of the deepest matched prefix is applied.\n"
+    "        The options are:\n"
+    "          expire=<sec>     : expire time instead of stat_cache_expire\n"
+    "          negative=yes|no  : enable or disable the negative cache\n"
+    "          immutable        : the stat cache is never expired(but the\n"
+    "                             least recently used file entries are\n"
+    "                             removed over max_stat_cache_size)\n"
+    "        The lines starting with '#' are comments, for example:\n"
+    "          /releases        immutable\n"
+    "          /data/dt=*       expire=86400,negative=no\n"
+    "          /data/hot        expire=5\n"
+    "\n"
     "   enable_negative_cache (default is enabled negative cache)\n"
     "      - This option will keep non-existence of objects in a stat cache.\n"
     "        When this negative cache is enabled, it will not process extra\n"
     "        HeadObject requests to search for non-existent objects, improving\n"
     "        performance.\n"
+    "        The objects which are not in the cached listing of the directory\n"
+    "        are also treated as non-existent without HeadObject requests.\n"
     "        This feature is enabled by default, so there is no need to specify\n"
     "        it.\n"
     "\n"
@@ -248,6 +324,38 @@ static constexpr char help_string[] =
     "      - s3fs is always using SSL session cache, this option make SSL \n"
     "      session cache disable.\n"
     "\n"
+    "   conncache (enable connection cache)\n"
+    "      - Keep the connections alive across the requests which are sent\n"
+    "      by the same thread, so the following requests do not need to\n"
+    "      connect(and TLS handshake) to the server again.\n"
+    "\n"
+    "   http2 (use HTTP/2)\n"
+    "      - Use HTTP/2 if the server supports it over TLS, otherwise\n"
+    "      HTTP/1.1 is used. With the curl_multi_streams option, the\n"
+    "      streams of a parallel download or a multipart upload are\n"
+    "      multiplexed on the same connection.\n"
+    "\n"
+    "   http2_max_streams (default is \"100\")\n"
+    "      - The maximum number of streams which are multiplexed on one\n"
+    "      HTTP/2 connection. This is used with the http2 and\n"
+    "      curl_multi_streams options.\n"
+    "\n"
+    "   hedge_percentile (default is \"0\")\n"
+    "      - If a HEAD request or a GET request of a parallel download\n"
+    "      does not receive the first byte within this percentile of the\n"
+    "      time to the first byte of recent requests, the same request is\n"
+    "      sent again, and the first response is used and the other\n"
+    "      request is cancelled. e.g. 95 means p95 latency. The latency\n"
+    "      is estimated separately for the HEAD and GET requests.\n"
+    "      The GET requests are hedged only with the curl_multi_streams\n"
+    "      option. 0 means that the requests are not hedged.\n"
+    "\n"
+    "   hedge_budget (default is \"5\")\n"
+    "      - The maximum percentage of the hedged requests to the HEAD\n"
+    "      and GET requests which can be hedged. Each request adds this\n"
+    "      percentage of a hedged request to the budget, which holds up\n"
+    "      to 10 hedged requests, so the limit follows recent requests.\n"
+    "\n"
     "   multipart_size (default=\"10\")\n"
     "      - part size, in MB, for each multipart request.\n"
     "      The minimum value is 5 MB and the maximum value is 5 GB.\n"
@@ -369,6 +477,56 @@ static constexpr char help_string[] =
     "      Worker threads will be started to process requests according to\n"
     "      this value.\n"
     "\n"
+    "   curl_multi_streams (default is \"0\")\n"
+    "      - The maximum number of streams which are transferred at the same\n"
+    "      time by one worker thread for parallel downloads and multipart\n"
+    "      uploads of a file.\n"
+    "      If this value is greater than 0, all ranges of a parallel\n"
+    "      download and all parts of a multipart upload are sent by one\n"
+    "      worker thread with the curl multi interface instead of a worker\n"
+    "      thread for each range or part, so many streams can be used\n"
+    "      regardless of max_thread_count.\n"
+    "      0 means sending each range or part by a worker thread.\n"
+    "      Only the range GET requests of parallel downloads and the part\n"
+    "      uploads of multipart uploads are sent with the curl multi\n"
+    "      interface. The HEAD, PUT, list, delete, copy and the other\n"
+    "      requests are still sent by a worker thread for each request.\n"
+    "\n"
+    "   adaptive_concurrency (default is \"0\")\n"
+    "      - The maximum number of requests which are sent at the same\n"
+    "      time with the adaptive concurrency control.\n"
+    "      If this value is greater than 0, the limit of the concurrency\n"
+    "      starts from max_thread_count, increases additively while the\n"
+    "      requests succeed and decreases multiplicatively when the server\n"
+    "      throttles the requests(HTTP response code 429 or 503) or the\n"
+    "      latency of GET or HEAD requests increases. The worker threads\n"
+    "      are started up to this value, and the streams of\n"
+    "      curl_multi_streams are also limited to the current limit.\n"
+    "      The changes of the limit are logged at the info level.\n"
+    "      0 means that the concurrency is fixed to max_thread_count.\n"
+    "\n"
+    "   upload_rate_limit (default is \"0\")\n"
+    "      - The maximum upload bandwidth of the object data in KB per\n"
+    "      second for this mount. The limit is shared by all requests.\n"
+    "      The foreground requests have priority(see request_rate_limit).\n"
+    "      0 means no limit.\n"
+    "\n"
+    "   download_rate_limit (default is \"0\")\n"
+    "      - The maximum download bandwidth of the object data in KB per\n"
+    "      second for this mount. The limit is shared by all requests.\n"
+    "      The foreground requests have priority(see request_rate_limit).\n"
+    "      0 means no limit.\n"
+    "\n"
+    "   request_rate_limit (default is \"0\")\n"
+    "      - The maximum number of requests per second for this mount,\n"
+    "      including the retries. The foreground requests, which are\n"
+    "      sent for reading the files, the directories and the attributes,\n"
+    "      and the requests for the credentials have priority. They wait\n"
+    "      only when they exceed the limit by more than one second, and\n"
+    "      the other requests(directory prefetch, hedged requests, uploads,\n"
+    "      etc) wait for them.\n"
+    "      0 means no limit.\n"
+    "\n"
     "   enable_content_md5 (default is disable)\n"
     "      - Allow S3 server to check data integrity of uploads via the\n"
     "      Content-MD5 header. This can add CPU overhead to transfers.\n"
@@ -377,6 +535,17 @@ static constexpr char help_string[] =
     "      - Do not calculate Content-SHA256 for PutObject and UploadPart\n"
     "      payloads. This can reduce CPU overhead to transfers.\n"
     "\n"
+    "   checksum_algorithm (default is \"none\")\n"
+    "      - Allow S3 server to check data integrity of uploads via the\n"
+    "      additional checksum(x-amz-checksum-*) header, the value is\n"
+    "      \"crc32c\", \"crc64nvme\" or \"none\". The checksum of the multipart\n"
+    "      upload is the full object checksum which is combined from the\n"
+    "      parts by S3 server. The checksum is also verified when the whole\n"
+    "      object is downloaded by one request. The CRC is computed with\n"
+    "      SSE4.2/PCLMUL instructions if the CPU supports them, so it is\n"
+    "      cheaper than Content-MD5 and Content-SHA256. Use it with\n"
+    "      enable_unsigned_payload for reducing CPU overhead to uploads.\n"
+    "\n"
     "   ecs (default is disable)\n"
     "      - This option instructs s3fs to query the ECS container credential\n"
     "      metadata address instead of the instance metadata address.\n"
@@ -610,6 +779,47 @@ static constexpr char help_string[] =
     "        updated).\n"
     "        By default, parent directory statistics are not updated.\n"
     "\n"
+    "   list_only_stat (default is disable)\n"
+    "        When listing a directory, the stats of file objects are made from\n"
+    "        the ListObjects response (size and LastModified) instead of\n"
+    "        sending a HeadObject request for each object. The mode, uid and\n"
+    "        gid are the default values, as for objects without meta headers.\n"
+    "        HeadObject is sent later only when the meta headers are needed\n"
+    "        (ex. open, xattr operations).\n"
+    "        This is useful for buckets whose objects are uploaded by other\n"
+    "        tools. Note that objects that are symbolic links or special files\n"
+    "        created by s3fs are listed as regular files.\n"
+    "\n"
+    "   readdirplus (default is disable)\n"
+    "        When the kernel requests readdirplus, the stats of the entries\n"
+    "        are returned together with the directory listing, so the kernel\n"
+    "        does not need to call getattr for each entry afterwards.\n"
+    "        The kernel keeps these stats for the period of the attr_timeout\n"
+    "        and entry_timeout FUSE options(default is 1 second), so specify\n"
+    "        them according to how often the objects are updated by others.\n"
+    "        Stats of files opened by s3fs are not returned in this way.\n"
+    "\n"
+    "   streaming_readdir (default is disable)\n"
+    "        Reads the directory entries incrementally. Each readdir lists\n"
+    "        only the pages of ListObjects needed to fill the buffer of FUSE,\n"
+    "        and keeps the position of the listing for each opened directory\n"
+    "        to continue from it on the next readdir.\n"
+    "        This returns the first entries of a huge directory quickly and\n"
+    "        does not keep the whole object list in memory, but the object\n"
+    "        list of the directory is not cached in the stat cache.\n"
+    "\n"
+    "   immutable (default is disable)\n"
+    "        Mounts the bucket as read-only and treats the objects as never\n"
+    "        changing. The stat cache entries (except the negative cache) are\n"
+    "        not expired and not revalidated, and an opened file which is\n"
+    "        fully cached in use_cache directory is served without any\n"
+    "        request. The kernel keeps the page cache across opens\n"
+    "        (kernel_cache), and the entry_timeout and attr_timeout FUSE\n"
+    "        options are extended to 1 day if they are shorter.\n"
+    "        When the number of the stat cache entries exceeds\n"
+    "        max_stat_cache_size, the least recently used file entries are\n"
+    "        removed.\n"
+    "\n"
     "FUSE/mount Options:\n"
     "\n"
     "   Most of the generic mount options described in 'man mount' are\n"
@@ -22,6 +22,9 @@
 
 #include "s3fs_threadreqs.h"
 #include "threadpoolman.h"
+#include "curl_hedge.h"
+#include "curl_multi.h"
+#include "headflight.h"
 #include "curl_util.h"
 #include "s3fs_logger.h"
 #include "s3fs_util.h"
@@ -32,6 +35,42 @@
 //-------------------------------------------------------------------
 // Thread Worker functions for MultiThread Request
 //-------------------------------------------------------------------
+//
+// Sends the head request which can be hedged with the curl multi interface.
+//
+// [NOTE]
+// This is used only when there are no SSE-C keys, because the request
+// with SSE-C keys is retried with each key in S3fsCurl::HeadRequest.
+// The request is sent by the S3fsCurl object of the worker thread, and
+// the curl multi handle is kept for each thread, so the connections are
+// reused by the following head requests of the same thread.
+//
+static int hedged_head_request(S3fsCurl& s3fscurl, const std::string& path, headers_t& meta)
+{
+    static thread_local S3fsCurlMulti curlmulti;
+
+    auto make_request = [path]() -> std::unique_ptr<S3fsCurl> {
+        auto s3fscurl_hedge = std::make_unique<S3fsCurl>(false);
+        if(!s3fscurl_hedge->PreHeadRequest(path)){
+            return nullptr;
+        }
+        return s3fscurl_hedge;
+    };
+
+    curlmulti.Clear();
+    if(!s3fscurl.PreHeadRequest(path) || !curlmulti.Add(s3fscurl, make_request)){
+        curlmulti.Clear();
+        return -EIO;
+    }
+    int result;
+    if(0 == (result = curlmulti.Perform())){
+        curlmulti.GetRequest(0)->GetHeadResponseMeta(meta);
+    }
+    curlmulti.Clear();
+
+    return result;
+}
+
 //
 // Thread Worker function for head request
 //
@@ -43,13 +82,75 @@ void* head_req_threadworker(S3fsCurl& s3fscurl, void* arg)
     }
     S3FS_PRN_INFO3("Head Request [path=%s][pmeta=%p]", pthparam->path.c_str(), pthparam->pmeta);
 
+    // share the result if the same path is being requested
+    HeadFlight flight(pthparam->path);
+    if(!flight.IsLeader()){
+        pthparam->result = flight.Wait(*(pthparam->pmeta));
+        return reinterpret_cast<void*>(pthparam->result);
+    }
+
     s3fscurl.SetUseAhbe(false);
 
-    pthparam->result = s3fscurl.HeadRequest(pthparam->path.c_str(), *(pthparam->pmeta));
+    if(S3fsHedgePolicy::IsEnabled() && 0 == S3fsCurl::GetSseKeyCount()){
+        pthparam->result = hedged_head_request(s3fscurl, pthparam->path, *(pthparam->pmeta));
+    }else{
+        pthparam->result = s3fscurl.HeadRequest(pthparam->path.c_str(), *(pthparam->pmeta));
+    }
+    flight.Finish(pthparam->result, *(pthparam->pmeta));
 
     return reinterpret_cast<void*>(pthparam->result);
 }
 
+//
+// Fill the stat of the found object and add it to the stat cache for multi head request
+//
+static int fill_multi_head_result(const multi_head_req_thparam& thparam, const headers_t& meta)
+{
+    std::string bpath = mybasename(thparam.path);
+    if(thparam.use_wtf8){
+         bpath = s3fs_wtf8_decode(bpath);
+    }
+
+    // set stat structure
+    struct stat stbuf;
+    if(!convert_header_to_stat(thparam.path, meta, stbuf, false)){
+        S3FS_PRN_INFO2("Could not convert headers to stat[path=%s]", thparam.path.c_str());
+        thparam.psyncfiller->Fill(bpath, nullptr, 0);
+        return 0;
+    }
+
+    // fill stat
+    thparam.psyncfiller->Fill(bpath, &stbuf, 0, thparam.path.c_str());
+
+    // objet type
+    objtype_t ObjType = thparam.objtype;
+    if(objtype_t::UNKNOWN == ObjType){
+        if(is_reg_fmt(meta)){
+            ObjType = objtype_t::FILE;
+        }else if(is_symlink_fmt(meta)){
+            ObjType = objtype_t::SYMLINK;
+        }else if(is_dir_fmt(meta)){
+            S3FS_PRN_WARN("The path(%s) has a directory type headers, so we determine the precise directory type here. But it might not be the exact directory type.", thparam.path.c_str());
+            if('/' != *(thparam.path.rbegin())){
+                ObjType = objtype_t::DIR_NOT_TERMINATE_SLASH;
+            }else if(std::string::npos != thparam.path.find("_$folder$", 0)){
+                ObjType = objtype_t::DIR_FOLDER_SUFFIX;
+            }else{
+                ObjType = objtype_t::DIR_NORMAL;
+            }
+        }else{
+            S3FS_PRN_WARN("The objtype of the path(%s) could not be determined, and the type is re-checked again after AddStat is called.", thparam.path.c_str());
+        }
+    }
+
+    // add stat cache
+    if(!StatCache::getStatCacheData()->AddStat(thparam.path, stbuf, meta, ObjType, false)){
+        S3FS_PRN_ERR("failed add new stat cache[path=%s]", thparam.path.c_str());
+        return -EIO;
+    }
+    return 0;
+}
+
 //
 // Thread Worker function for multi head request
 //
@@ -60,14 +161,45 @@ void* multi_head_req_threadworker(S3fsCurl& s3fscurl, void* arg)
         return reinterpret_cast<void*>(-EIO);
     }
 
+    // [NOTE]
+    // If the same path is being requested(ex. by getattr), its result is
+    // shared. Only if it is an error other than not found, the request is
+    // sent by this thread(as a follower, the result is not shared).
+    // If this thread is the leader, the result of the request is shared
+    // with the followers which join while it is sent.
+    //
+    int        result = 0;
+    headers_t  meta;
+    HeadFlight flight(pthparam->path);
+    if(!flight.IsLeader()){
+        int flight_result = flight.Wait(meta);
+        if(0 == flight_result || -ENOENT == flight_result){
+            if(0 == flight_result){
+                result = fill_multi_head_result(*pthparam, meta);
+            }else{
+                S3FS_PRN_INFO("Head Request(%s) got NotFound(404), it maybe only the path exists and the object does not exist.", pthparam->path.c_str());
+            }
+            const std::lock_guard<std::mutex> lock(*(pthparam->pthparam_lock));
+            if(0 != flight_result){
+                pthparam->pnotfound_list->push_back(pthparam->path);
+            }
+            if(0 == *(pthparam->presult) && 0 != result){
+                // keep first error
+                *(pthparam->presult) = result;
+            }
+            return nullptr;
+        }
+        meta.clear();
+    }
+
     s3fscurl.SetUseAhbe(false);
 
     // loop for head request
-    int       result = 0;
-    headers_t meta;         // this value is not used
+    int head_result = -EIO;
     while(true){
         // Request
-        result = s3fscurl.HeadRequest(pthparam->path.c_str(), meta);
+        result      = s3fscurl.HeadRequest(pthparam->path.c_str(), meta);
+        head_result = result;
 
         // Check result
         bool     isResetOffset= true;
@@ -82,48 +214,8 @@ void* multi_head_req_threadworker(S3fsCurl& s3fscurl, void* arg)
 
         if(CURLE_OK == curlCode){
             if(responseCode < 400){
-                std::string bpath = mybasename(pthparam->path);
-                if(pthparam->use_wtf8){
-                     bpath = s3fs_wtf8_decode(bpath);
-                }
-
-                // set stat structure
-                struct stat stbuf;
-                if(convert_header_to_stat(pthparam->path, *(s3fscurl.GetResponseHeaders()), stbuf, false)){
-                    // fill stat
-                    pthparam->psyncfiller->Fill(bpath, &stbuf, 0);
-
-                    // objet type
-                    objtype_t ObjType = pthparam->objtype;
-                    if(objtype_t::UNKNOWN == ObjType){
-                        if(is_reg_fmt(*(s3fscurl.GetResponseHeaders()))){
-                            ObjType = objtype_t::FILE;
-                        }else if(is_symlink_fmt(*(s3fscurl.GetResponseHeaders()))){
-                            ObjType = objtype_t::SYMLINK;
-                        }else if(is_dir_fmt(*(s3fscurl.GetResponseHeaders()))){
-                            S3FS_PRN_WARN("The path(%s) has a directory type headers, so we determine the precise directory type here. But it might not be the exact directory type.", pthparam->path.c_str());
-                            if('/' != *(pthparam->path.rbegin())){
-                                ObjType = objtype_t::DIR_NOT_TERMINATE_SLASH;
-                            }else if(std::string::npos != pthparam->path.find("_$folder$", 0)){
-                                ObjType = objtype_t::DIR_FOLDER_SUFFIX;
-                            }else{
-                                ObjType = objtype_t::DIR_NORMAL;
-                            }
-                        }else{
-                            S3FS_PRN_WARN("The objtype of the path(%s) could not be determined, and the type is re-checked again after AddStat is called.", pthparam->path.c_str());
-                        }
-                    }
-
-                    // add stat cache
-                    if(!StatCache::getStatCacheData()->AddStat(pthparam->path, stbuf, *(s3fscurl.GetResponseHeaders()), ObjType, false)){
-                        S3FS_PRN_ERR("failed add new stat cache[path=%s]", pthparam->path.c_str());
-                        if(0 == result){
-                            result = -EIO;
-                        }
-                    }
-                }else{
-                    S3FS_PRN_INFO2("Could not convert headers to stat[path=%s]", pthparam->path.c_str());
-                    pthparam->psyncfiller->Fill(bpath, nullptr, 0);
+                if(0 != fill_multi_head_result(*pthparam, *(s3fscurl.GetResponseHeaders())) && 0 == result){
+                    result = -EIO;
                 }
                 break;
 
@@ -188,6 +280,7 @@ void* multi_head_req_threadworker(S3fsCurl& s3fscurl, void* arg)
             S3fsCurl::ResetOffset(&s3fscurl);
         }
     }
+    flight.Finish(head_result, meta);
 
     // Set result code
     {
@@ -277,7 +370,90 @@ void* list_bucket_req_threadworker(S3fsCurl& s3fscurl, void* arg)
     s3fscurl.SetUseAhbe(false);
 
     if(0 == (pthparam->result = s3fscurl.ListBucketRequest(pthparam->path.c_str(), pthparam->query.c_str()))){
-        *(pthparam->presponseBody) = s3fscurl.GetBodyData();
+        // [NOTE]
+        // The response body is swapped instead of copying, and the buffer
+        // of the caller is reused for the next response of this handle.
+        //
+        s3fscurl.SwapBodyData(*(pthparam->presponseBody));
+    }
+    return reinterpret_cast<void*>(pthparam->result);
+}
+
+//
+// Thread Worker function for list bucket range request
+//
+void* list_bucket_range_req_threadworker(S3fsCurl& s3fscurl, void* arg)
+{
+    auto* pthparam = static_cast<list_bucket_range_req_thparam*>(arg);
+    if(!pthparam){
+        return reinterpret_cast<void*>(-EIO);
+    }
+    S3FS_PRN_INFO3("List Bucket Range Request [path=%s][start after=%s][end name=%s]", pthparam->path.c_str(), pthparam->start_after.c_str(), pthparam->end_name.c_str());
+
+    s3fscurl.SetUseAhbe(false);
+
+    std::string start_after             = pthparam->start_after;
+    std::string next_continuation_token = pthparam->next_continuation_token;
+    pthparam->result                    = 0;
+
+    while(true){
+        // append parameters to query in alphabetical order
+        std::string query;
+        if(!next_continuation_token.empty()){
+            query += "continuation-token=" + urlEncodePath(next_continuation_token) + "&";
+        }
+        query += pthparam->query_delimiter;
+        if(S3fsCurl::IsListObjectsV2()){
+            query += "list-type=2&";
+        }else if(!start_after.empty()){
+            query += "marker=" + urlEncodePath(start_after) + "&";
+        }
+        query += pthparam->query_maxkey;
+        query += "&prefix=" + urlEncodePath(pthparam->prefix);
+        if(S3fsCurl::IsListObjectsV2() && next_continuation_token.empty() && !start_after.empty()){
+            query += "&start-after=" + urlEncodePath(start_after);
+        }
+
+        if(0 != (pthparam->result = s3fscurl.ListBucketRequest(pthparam->path.c_str(), query.c_str()))){
+            break;
+        }
+
+        // [NOTE]
+        // Each page is parsed into its own list, and the last name of the
+        // page is used for the end of the range and the next marker.
+        //
+        S3ObjList   page;
+        bool        truncated = false;
+        std::string next_marker;
+        if(0 != (pthparam->result = parse_list_bucket_result(pthparam->path.c_str(), s3fscurl.GetBodyData(), page, truncated, next_continuation_token, next_marker))){
+            break;
+        }
+
+        // [NOTE]
+        // The objects are returned in ascending order, so if the last name
+        // exceeds the end of the range, the following pages are not needed.
+        //
+        auto lastname = page.GetLastName();
+        if(!pthparam->end_name.empty() && lastname && 0 < lastname->compare(pthparam->end_name)){
+            page.RemoveAfter(pthparam->end_name);
+            pthparam->list.Append(page);
+            break;
+        }
+        pthparam->list.Append(page);
+        if(!truncated){
+            break;
+        }
+        if(next_continuation_token.empty()){
+            if(!next_marker.empty()){
+                start_after = next_marker;
+            }else if(lastname){
+                // If did not specify "delimiter", s3 did not return "NextMarker".
+                start_after = pthparam->prefix + *lastname;
+            }else{
+                S3FS_PRN_WARN("Could not find next marker, thus break loop.");
+                break;
+            }
+        }
     }
     return reinterpret_cast<void*>(pthparam->result);
 }
@@ -377,6 +553,62 @@ void* multipart_upload_part_req_threadworker(S3fsCurl& s3fscurl, void* arg)
     return reinterpret_cast<void*>(result);
 }
 
+//
+// Thread Worker function for multipart upload parts by curl multi interface
+//
+// [NOTE]
+// This worker uploads all parts of the file with S3fsCurlMulti, so one
+// thread keeps up to max streams requests without a thread for each
+// part. The S3fsCurl object of this worker is not used.
+//
+void* multi_upload_part_req_threadworker(S3fsCurl& /*s3fscurl*/, void* arg)
+{
+    auto* pthparam = static_cast<multi_upload_part_req_thparam*>(arg);
+    if(!pthparam || !pthparam->plist){
+        return reinterpret_cast<void*>(-EIO);
+    }
+    S3FS_PRN_INFO3("Multi Upload Part Request [path=%s][upload_id=%s][upload_fd=%d][size=%lld]", pthparam->path.c_str(), pthparam->upload_id.c_str(), pthparam->upload_fd, static_cast<long long int>(pthparam->size));
+
+    S3fsCurlMulti curlmulti;
+
+    // cycle through open upload_fd, pulling off chunks of multipart size
+    int part_num = 1;
+    for(off_t remaining_bytes = pthparam->size; 0 < remaining_bytes; ++part_num){
+        off_t start = pthparam->size - remaining_bytes;
+        off_t chunk = std::min(remaining_bytes, S3fsCurl::GetMultipartSize());
+
+        pthparam->plist->emplace_back(nullptr, part_num);
+        etagpair* petag = &pthparam->plist->back();
+
+        auto s3fscurl_part = std::make_unique<S3fsCurl>(true);
+        int  result;
+        if(0 != (result = s3fscurl_part->MultipartUploadPartSetup(pthparam->path.c_str(), pthparam->upload_fd, start, chunk, part_num, pthparam->upload_id, petag, false))){
+            S3FS_PRN_ERR("Failed pre-setup for Multipart Upload Part [path=%s][start=%lld][size=%lld][part_num=%d]", pthparam->path.c_str(), static_cast<long long int>(start), static_cast<long long int>(chunk), part_num);
+            pthparam->result = result;
+            return reinterpret_cast<void*>(pthparam->result);
+        }
+        if(!curlmulti.Add(std::move(s3fscurl_part))){
+            pthparam->result = -EIO;
+            return reinterpret_cast<void*>(pthparam->result);
+        }
+        remaining_bytes -= chunk;
+    }
+    if(0 != (pthparam->result = curlmulti.Perform())){
+        return reinterpret_cast<void*>(pthparam->result);
+    }
+
+    // completion of each part(etag)
+    S3fsCurl* s3fscurl_part;
+    for(size_t pos = 0; nullptr != (s3fscurl_part = curlmulti.GetRequest(pos)); ++pos){
+        if(!s3fscurl_part->MultipartUploadPartComplete()){
+            S3FS_PRN_ERR("Failed completion for Multipart Upload Part [path=%s][part_num=%zu]", pthparam->path.c_str(), pos + 1);
+            pthparam->result = -EIO;
+            break;
+        }
+    }
+    return reinterpret_cast<void*>(pthparam->result);
+}
+
 //
 // Worker function for complete multipart upload request
 //
@@ -432,7 +664,7 @@ void* get_object_req_threadworker(S3fsCurl& s3fscurl, void* arg)
 
     s3fscurl.SetUseAhbe(false);
 
-    pthparam->result = s3fscurl.GetObjectRequest(pthparam->path.c_str(), pthparam->fd, pthparam->start, pthparam->size, ssetype, ssevalue);
+    pthparam->result = s3fscurl.GetObjectRequest(pthparam->path.c_str(), pthparam->fd, pthparam->start, pthparam->size, ssetype, ssevalue, pthparam->whole_object);
 
     return reinterpret_cast<void*>(pthparam->result);
 }
@@ -476,6 +708,9 @@ void* multipart_put_head_req_threadworker(S3fsCurl& s3fscurl, void* arg)
                         S3FS_PRN_WARN("Put Head Request(%s->%s) could not parse ETag in response body.", pthparam->from.c_str(), pthparam->to.c_str());
                     }
                     pthparam->petag->etag = peeloff(std::move(etag).value_or(""));
+                    if(checksum_type_t::NONE != S3fsCurl::GetChecksumType()){
+                        pthparam->petag->checksum = simple_parse_xml(s3fscurl.GetBodyData().c_str(), s3fscurl.GetBodyData().size(), get_checksum_xml_tag(S3fsCurl::GetChecksumType()).c_str()).value_or("");
+                    }
                 }
                 result = 0;
                 break;
@@ -666,6 +901,63 @@ void* parallel_get_object_req_threadworker(S3fsCurl& s3fscurl, void* arg)
     return reinterpret_cast<void*>(result);
 }
 
+//
+// Thread Worker function for get object request by curl multi interface
+//
+// [NOTE]
+// This worker performs all chunks of the range with S3fsCurlMulti, so
+// one thread keeps up to max streams requests without a thread for each
+// chunk. The S3fsCurl object of this worker is not used.
+// If the requests can be hedged, both of the request and the hedged
+// request have If-Match header with the ETag of the object, so that they
+// do not write the data of the different objects to the same area.
+//
+void* multi_get_object_req_threadworker(S3fsCurl& /*s3fscurl*/, void* arg)
+{
+    auto* pthparam = static_cast<multi_get_object_req_thparam*>(arg);
+    if(!pthparam){
+        return reinterpret_cast<void*>(-EIO);
+    }
+    S3FS_PRN_INFO3("Multi Get Object Request [path=%s][fd=%d][start=%lld][size=%lld][ssetype=%u][ssevalue=%s]", pthparam->path.c_str(), pthparam->fd, static_cast<long long int>(pthparam->start), static_cast<long long int>(pthparam->size), static_cast<uint8_t>(pthparam->ssetype), pthparam->ssevalue.c_str());
+
+    S3fsCurlMulti curlmulti;
+    bool          is_hedge = (S3fsHedgePolicy::IsEnabled() && !pthparam->etag.empty());
+
+    // cycle through open fd, pulling off chunks of multipart size
+    for(off_t remaining_bytes = pthparam->size, chunk = 0; 0 < remaining_bytes; remaining_bytes -= chunk){
+        chunk = remaining_bytes > S3fsCurl::GetMultipartSize() ? S3fsCurl::GetMultipartSize() : remaining_bytes;
+
+        off_t chunk_start  = pthparam->start + pthparam->size - remaining_bytes;
+        auto  make_request = [pthparam, chunk_start, chunk, is_hedge]() -> std::unique_ptr<S3fsCurl> {
+            auto s3fscurl_chunk = std::make_unique<S3fsCurl>(true);
+            if(0 != s3fscurl_chunk->PreGetObjectRequest(pthparam->path.c_str(), pthparam->fd, chunk_start, chunk, pthparam->ssetype, pthparam->ssevalue)){
+                return nullptr;
+            }
+            if(is_hedge){
+                s3fscurl_chunk->AddIfMatchHeader(pthparam->etag);
+            }
+            return s3fscurl_chunk;
+        };
+
+        auto s3fscurl_chunk = make_request();
+        if(!s3fscurl_chunk){
+            pthparam->result = -EIO;
+            return reinterpret_cast<void*>(pthparam->result);
+        }
+        s3fscurl_hedge_factory fpHedge;
+        if(is_hedge){
+            fpHedge = make_request;
+        }
+        if(!curlmulti.Add(std::move(s3fscurl_chunk), std::move(fpHedge))){
+            pthparam->result = -EIO;
+            return reinterpret_cast<void*>(pthparam->result);
+        }
+    }
+    pthparam->result = curlmulti.Perform();
+
+    return reinterpret_cast<void*>(pthparam->result);
+}
+
 //-------------------------------------------------------------------
 // Utility functions
 //-------------------------------------------------------------------
@@ -699,6 +991,31 @@ int head_request(const std::string& strpath, headers_t& header)
     return 0;
 }
 
+//
+// Calls S3fsCurl::HeadRequest via head_req_threadworker without waiting
+//
+// [NOTE]
+// thargs is owned by the caller, and it must be kept until sem is released.
+// The result of the request is set in the result member of thargs.
+//
+int head_request(head_req_thparam& thargs, Semaphore& sem)
+{
+    thargs.result = 0;
+
+    // make parameter for thread pool
+    thpoolman_param  ppoolparam;
+    ppoolparam.args  = &thargs;
+    ppoolparam.psem  = &sem;
+    ppoolparam.pfunc = head_req_threadworker;
+
+    // setup instruction
+    if(!ThreadPoolMan::Instruct(ppoolparam)){
+        S3FS_PRN_ERR("failed to setup Head Request Thread Worker [path=%s]", thargs.path.c_str());
+        return -EIO;
+    }
+    return 0;
+}
+
 //
 // Calls S3fsCurl::HeadRequest via multi_head_req_threadworker
 //
@@ -853,6 +1170,78 @@ int list_bucket_request(const std::string& strpath, const std::string& query, st
     return 0;
 }
 
+//
+// Calls S3fsCurl::ListBucketRequest via list_bucket_req_threadworker without waiting
+//
+// [NOTE]
+// thargs is owned by the caller, and it must be kept until sem is released.
+// The result of the request is set in the result member of thargs.
+//
+int list_bucket_request(list_bucket_req_thparam& thargs, Semaphore& sem)
+{
+    thargs.result = 0;
+
+    // make parameter for thread pool
+    thpoolman_param  ppoolparam;
+    ppoolparam.args  = &thargs;
+    ppoolparam.psem  = &sem;
+    ppoolparam.pfunc = list_bucket_req_threadworker;
+
+    // setup instruction
+    if(!ThreadPoolMan::Instruct(ppoolparam)){
+        S3FS_PRN_ERR("failed to setup List Bucket Request Thread Worker [path=%s][query=%s]", thargs.path.c_str(), thargs.query.c_str());
+        return -EIO;
+    }
+    return 0;
+}
+
+//
+// Calls S3fsCurl::ListBucketRequest for each range via list_bucket_range_req_threadworker
+//
+// [NOTE]
+// The ranges are listed concurrently, and this function waits for all of
+// them. The result of each range is stored in its list member.
+//
+int parallel_list_bucket_request(std::vector<list_bucket_range_req_thparam>& ranges)
+{
+    Semaphore list_sem(0);
+    int       req_count    = 0;
+    int       sched_result = 0;
+
+    for(auto& range: ranges){
+        // make parameter for thread pool
+        thpoolman_param  ppoolparam;
+        ppoolparam.args  = &range;
+        ppoolparam.psem  = &list_sem;
+        ppoolparam.pfunc = list_bucket_range_req_threadworker;
+
+        // setup instruction
+        if(!ThreadPoolMan::Instruct(ppoolparam)){
+            S3FS_PRN_ERR("failed to setup List Bucket Range Request Thread Worker [path=%s][start after=%s]", range.path.c_str(), range.start_after.c_str());
+            sched_result = -EIO;
+            break;
+        }
+        ++req_count;
+    }
+
+    // wait for finish all requests
+    while(req_count > 0){
+        list_sem.acquire();
+        --req_count;
+    }
+
+    if(0 != sched_result){
+        return sched_result;
+    }
+    for(const auto& range: ranges){
+        if(0 != range.result){
+            S3FS_PRN_ERR("List Bucket Range Request by error(%d) [path=%s][start after=%s]", range.result, range.path.c_str(), range.start_after.c_str());
+            return range.result;
+        }
+    }
+    return 0;
+}
+
 //
 // Calls S3fsCurl::CheckBucket via check_service_req_threadworker
 //
@@ -997,6 +1386,39 @@ int await_multipart_upload_part_request(const std::string& path, int upload_fd,
     return 0;
 }
 
+//
+// Calls S3fsCurl::MultipartUploadPartSetup for each part via multi_upload_part_req_threadworker
+// The etagpair of each part is added to the list.
+//
+static int multi_upload_part_request(const std::string& path, int upload_fd, off_t size, const std::string& upload_id, etaglist_t& list)
+{
+    // parameter for thread worker
+    multi_upload_part_req_thparam thargs;
+    thargs.path      = path;
+    thargs.upload_id = upload_id;
+    thargs.upload_fd = upload_fd;
+    thargs.size      = size;
+    thargs.plist     = &list;
+    thargs.result    = 0;
+
+    // make parameter for thread pool
+    thpoolman_param  ppoolparam;
+    ppoolparam.args  = &thargs;
+    ppoolparam.psem  = nullptr;         // case await
+    ppoolparam.pfunc = multi_upload_part_req_threadworker;
+
+    // send request by thread
+    if(!ThreadPoolMan::AwaitInstruct(ppoolparam)){
+        S3FS_PRN_ERR("failed to setup Await Multi Upload Part Request Thread Worker [path=%s][upload_id=%s][upload_fd=%d][size=%lld]", path.c_str(), upload_id.c_str(), upload_fd, static_cast<long long int>(size));
+        return -EIO;
+    }
+    if(0 != thargs.result){
+        S3FS_PRN_ERR("error occurred in multi upload part request(errno=%d) [path=%s][upload_id=%s][upload_fd=%d][size=%lld]", thargs.result, path.c_str(), upload_id.c_str(), upload_fd, static_cast<long long int>(size));
+        return thargs.result;
+    }
+    return 0;
+}
+
 //
 // Complete sequence of Multipart Upload Requests processing
 //
@@ -1030,26 +1452,31 @@ int multipart_upload_request(const std::string& path, const headers_t& meta, int
     int        req_count   = 0;     // request count(the part number will be this value +1.)
     etaglist_t list;
 
-    // cycle through open upload_fd, pulling off 10MB chunks at a time
-    for(off_t remaining_bytes = st.st_size; 0 < remaining_bytes; ++req_count){
-        // add new etagpair to etaglist_t list
-        list.emplace_back(nullptr, (req_count + 1));
-        etagpair* petag = &list.back();
+    if(S3fsCurlMulti::IsEnabled()){
+        // all parts are uploaded by one worker thread with curl multi interface
+        result = multi_upload_part_request(path, upload_fd, st.st_size, upload_id, list);
+    }else{
+        // cycle through open upload_fd, pulling off 10MB chunks at a time
+        for(off_t remaining_bytes = st.st_size; 0 < remaining_bytes; ++req_count){
+            // add new etagpair to etaglist_t list
+            list.emplace_back(nullptr, (req_count + 1));
+            etagpair* petag = &list.back();
 
-        off_t     start = st.st_size - remaining_bytes;
-        off_t     chunk = std::min(remaining_bytes, S3fsCurl::GetMultipartSize());
+            off_t     start = st.st_size - remaining_bytes;
+            off_t     chunk = std::min(remaining_bytes, S3fsCurl::GetMultipartSize());
 
-        S3FS_PRN_INFO3("Multipart Upload Part [path=%s][start=%lld][size=%lld][part_num=%d]", path.c_str(), static_cast<long long int>(start), static_cast<long long int>(chunk), (req_count + 1));
+            S3FS_PRN_INFO3("Multipart Upload Part [path=%s][start=%lld][size=%lld][part_num=%d]", path.c_str(), static_cast<long long int>(start), static_cast<long long int>(chunk), (req_count + 1));
 
-        // setup instruction and request on another thread
-        if(0 != (result = multipart_upload_part_request(path, upload_fd, start, chunk, (req_count + 1), upload_id, petag, false, &upload_sem, &result_lock, &last_result))){
-            S3FS_PRN_ERR("failed setup instruction for Multipart Upload Part Request by error(%d) [path=%s][start=%lld][size=%lld][part_num=%d]", result, path.c_str(), static_cast<long long int>(start), static_cast<long long int>(chunk), (req_count + 1));
+            // setup instruction and request on another thread
+            if(0 != (result = multipart_upload_part_request(path, upload_fd, start, chunk, (req_count + 1), upload_id, petag, false, &upload_sem, &result_lock, &last_result))){
+                S3FS_PRN_ERR("failed setup instruction for Multipart Upload Part Request by error(%d) [path=%s][start=%lld][size=%lld][part_num=%d]", result, path.c_str(), static_cast<long long int>(start), static_cast<long long int>(chunk), (req_count + 1));
 
-            // [NOTE]
-            // Hold onto result until all request finish.
-            break;
+                // [NOTE]
+                // Hold onto result until all request finish.
+                break;
+            }
+            remaining_bytes -= chunk;
         }
-        remaining_bytes -= chunk;
     }
 
     // wait for finish all requests
@@ -1393,10 +1820,46 @@ int multipart_put_head_request(const std::string& strfrom, const std::string& st
     return 0;
 }
 
+//
+// Calls S3fsCurl::PreGetObjectRequest for each chunk via multi_get_object_req_threadworker
+//
+static int multi_get_object_request(const std::string& path, int fd, off_t start, off_t size, sse_type_t ssetype, const std::string& ssevalue, const std::string& etag)
+{
+    // parameter for thread worker
+    multi_get_object_req_thparam thargs;
+    thargs.path     = path;
+    thargs.fd       = fd;
+    thargs.start    = start;
+    thargs.size     = size;
+    thargs.ssetype  = ssetype;
+    thargs.ssevalue = ssevalue;
+    thargs.etag     = etag;
+    thargs.result   = 0;
+
+    // make parameter for thread pool
+    thpoolman_param  ppoolparam;
+    ppoolparam.args  = &thargs;
+    ppoolparam.psem  = nullptr;         // case await
+    ppoolparam.pfunc = multi_get_object_req_threadworker;
+
+    // send request by thread
+    if(!ThreadPoolMan::AwaitInstruct(ppoolparam)){
+        S3FS_PRN_ERR("failed to setup Await Multi Get Object Request Thread Worker [path=%s][fd=%d][start=%lld][size=%lld]", path.c_str(), fd, static_cast<long long int>(start), static_cast<long long int>(size));
+        return -EIO;
+    }
+    if(0 != thargs.result){
+        S3FS_PRN_ERR("error occurred in multi get object request(errno=%d) [path=%s][fd=%d][start=%lld][size=%lld]", thargs.result, path.c_str(), fd, static_cast<long long int>(start), static_cast<long long int>(size));
+        return thargs.result;
+    }
+    return 0;
+}
+
 //
 // Calls S3fsCurl::ParallelGetObjectRequest via parallel_get_object_req_threadworker
+// The etag is the ETag of the object which is being loaded, it is used
+// for the hedged requests with curl multi interface.
 //
-int parallel_get_object_request(const std::string& path, int fd, off_t start, off_t size)
+int parallel_get_object_request(const std::string& path, int fd, off_t start, off_t size, const std::string& etag)
 {
     S3FS_PRN_INFO3("[path=%s][fd=%d][start=%lld][size=%lld]", path.c_str(), fd, static_cast<long long int>(start), static_cast<long long int>(size));
 
@@ -1406,6 +1869,10 @@ int parallel_get_object_request(const std::string& path, int fd, off_t start, of
         S3FS_PRN_WARN("Failed to get SSE type for file(%s).", path.c_str());
     }
 
+    if(S3fsCurlMulti::IsEnabled()){
+        return multi_get_object_request(path, fd, start, size, ssetype, ssevalue, etag);
+    }
+
     Semaphore    para_getobj_sem(0);
     std::mutex   thparam_lock;
     int          req_count    = 0;
@@ -1469,15 +1936,16 @@ int parallel_get_object_request(const std::string& path, int fd, off_t start, of
 //
 // Calls S3fsCurl::GetObjectRequest via get_object_req_threadworker
 //
-int get_object_request(const std::string& path, int fd, off_t start, off_t size)
+int get_object_request(const std::string& path, int fd, off_t start, off_t size, bool is_whole_object)
 {
     // parameter for thread worker
     get_object_req_thparam thargs;
-    thargs.path   = path;
-    thargs.fd     = fd;
-    thargs.start  = start;
-    thargs.size   = size;
-    thargs.result = 0;
+    thargs.path         = path;
+    thargs.fd           = fd;
+    thargs.start        = start;
+    thargs.size         = size;
+    thargs.whole_object = is_whole_object;
+    thargs.result       = 0;
 
     // make parameter for thread pool
     thpoolman_param  ppoolparam;
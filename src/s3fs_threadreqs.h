@@ -22,6 +22,7 @@
 #define S3FS_THREADREQS_H_
 
 #include <string>
+#include <vector>
 
 #include "metaheader.h"
 #include "curl.h"
@@ -103,6 +104,28 @@ struct list_bucket_req_thparam
     int          result        = 0;
 };
 
+//
+// List Bucket Range Request parameter structure for Thread Pool.
+//
+// [NOTE]
+// Lists the objects whose names are in the range from start_after(not
+// included) to end_name(included) with following the next pages.
+// start_after is an object key, and end_name is a name relative to the
+// prefix. If end_name is empty, the range continues until the end.
+//
+struct list_bucket_range_req_thparam
+{
+    std::string path;
+    std::string prefix;
+    std::string query_delimiter;
+    std::string query_maxkey;
+    std::string start_after;
+    std::string next_continuation_token;
+    std::string end_name;
+    S3ObjList   list;
+    int         result = 0;
+};
+
 //
 // Check Service Request parameter structure for Thread Pool.
 //
@@ -144,6 +167,19 @@ struct multipart_upload_part_req_thparam
     int*          presult        = nullptr;
 };
 
+//
+// Multipart Upload Part Request by curl multi interface parameter structure for Thread Pool.
+//
+struct multi_upload_part_req_thparam
+{
+    std::string path;
+    std::string upload_id;
+    int         upload_fd = -1;
+    off_t       size      = 0;
+    etaglist_t* plist     = nullptr;
+    int         result    = 0;
+};
+
 //
 // Complete Multipart Upload Request parameter structure for Thread Pool.
 //
@@ -197,6 +233,21 @@ struct parallel_get_object_req_thparam
     int*        presult       = nullptr;
 };
 
+//
+// Get Object Request by curl multi interface parameter structure for Thread Pool.
+//
+struct multi_get_object_req_thparam
+{
+    std::string path;
+    int         fd      = -1;
+    off_t       start   = 0;
+    off_t       size    = 0;
+    sse_type_t  ssetype = sse_type_t::SSE_DISABLE;
+    std::string ssevalue;
+    std::string etag;
+    int         result  = 0;
+};
+
 //
 // Get Object Request parameter structure for Thread Pool.
 //
@@ -204,9 +255,10 @@ struct get_object_req_thparam
 {
     std::string path;
     int         fd     = -1;
-    off_t       start  = 0;
-    off_t       size   = 0;
-    int         result = 0;
+    off_t       start        = 0;
+    off_t       size         = 0;
+    bool        whole_object = false;
+    int         result       = 0;
 };
 
 //-------------------------------------------------------------------
@@ -218,24 +270,30 @@ void* delete_req_threadworker(S3fsCurl& s3fscurl, void* arg);
 void* put_head_req_threadworker(S3fsCurl& s3fscurl, void* arg);
 void* put_req_threadworker(S3fsCurl& s3fscurl, void* arg);
 void* list_bucket_req_threadworker(S3fsCurl& s3fscurl, void* arg);
+void* list_bucket_range_req_threadworker(S3fsCurl& s3fscurl, void* arg);
 void* check_service_req_threadworker(S3fsCurl& s3fscurl, void* arg);
 void* pre_multipart_upload_req_threadworker(S3fsCurl& s3fscurl, void* arg);
 void* multipart_upload_part_req_threadworker(S3fsCurl& s3fscurl, void* arg);
+void* multi_upload_part_req_threadworker(S3fsCurl& s3fscurl, void* arg);
 void* complete_multipart_upload_threadworker(S3fsCurl& s3fscurl, void* arg);
 void* abort_multipart_upload_req_threadworker(S3fsCurl& s3fscurl, void* arg);
 void* multipart_put_head_req_threadworker(S3fsCurl& s3fscurl, void* arg);
 void* parallel_get_object_req_threadworker(S3fsCurl& s3fscurl, void* arg);
+void* multi_get_object_req_threadworker(S3fsCurl& s3fscurl, void* arg);
 void* get_object_req_threadworker(S3fsCurl& s3fscurl, void* arg);
 
 //-------------------------------------------------------------------
 // Utility functions
 //-------------------------------------------------------------------
 int head_request(const std::string& strpath, headers_t& header);
+int head_request(head_req_thparam& thargs, Semaphore& sem);
 int multi_head_request(const std::string& strpath, SyncFiller& syncfiller, std::mutex& thparam_lock, int& retrycount, s3obj_list_t& notfound_list, bool use_wtf8, objtype_t objtype, int& result, Semaphore& sem);
 int delete_request(const std::string& strpath);
 int put_head_request(const std::string& strpath, const headers_t& meta, bool is_copy);
 int put_request(const std::string& strpath, const headers_t& meta, int fd, bool ahbe);
 int list_bucket_request(const std::string& strpath, const std::string& query, std::string& responseBody);
+int list_bucket_request(list_bucket_req_thparam& thargs, Semaphore& sem);
+int parallel_list_bucket_request(std::vector<list_bucket_range_req_thparam>& ranges);
 int check_service_request(const std::string& strpath, bool forceNoSSE, bool support_compat_dir, long& responseCode, std::string& responseBody);
 int pre_multipart_upload_request(const std::string& path, const headers_t& meta, std::string& upload_id);
 int multipart_upload_part_request(const std::string& path, int upload_fd, off_t start, off_t size, int part_num, const std::string& upload_id, etagpair* petag, bool is_copy, Semaphore* psem, std::mutex* pthparam_lock, int* req_result);
@@ -245,8 +303,8 @@ int mix_multipart_upload_request(const std::string& path, headers_t& meta, int u
 int complete_multipart_upload_request(const std::string& path, const std::string& upload_id, const etaglist_t& parts);
 int abort_multipart_upload_request(const std::string& path, const std::string& upload_id);
 int multipart_put_head_request(const std::string& strfrom, const std::string& strto, off_t size, const headers_t& meta);
-int parallel_get_object_request(const std::string& path, int fd, off_t start, off_t size);
-int get_object_request(const std::string& path, int fd, off_t start, off_t size);
+int parallel_get_object_request(const std::string& path, int fd, off_t start, off_t size, const std::string& etag = std::string());
+int get_object_request(const std::string& path, int fd, off_t start, off_t size, bool is_whole_object = false);
 
 //-------------------------------------------------------------------
 // Direct Call Utility Functions
@@ -18,11 +18,14 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <libxml/xpathInternals.h>
+#include <libxml/xmlreader.h>
 #include <mutex>
 #include <string>
+#include <vector>
 
 #include "common.h"
 #include "s3fs_logger.h"
@@ -40,6 +43,16 @@ enum class get_object_name_result : std::uint8_t {
     FILE_OR_SUBDIR_IN_DIR
 };
 
+// Entry of <Contents> or <CommonPrefixes> for parse_list_bucket_xml
+struct list_bucket_xml_entry
+{
+    std::string key;
+    std::string etag;
+    std::string size;
+    std::string lastmod;
+    bool        is_cprefix = false;
+};
+
 //-------------------------------------------------------------------
 // Variables
 //-------------------------------------------------------------------
@@ -140,22 +153,20 @@ unique_ptr_xmlChar get_next_marker(xmlDocPtr doc)
     return get_base_exp(doc, "NextMarker");
 }
 
-static std::pair<get_object_name_result, std::string> get_object_name(xmlDocPtr doc, xmlNodePtr node, const char* path)
+static std::pair<get_object_name_result, std::string> get_object_name(const char* fullpath, const char* path)
 {
-    // Get full path
-    unique_ptr_xmlChar fullpath(xmlNodeListGetString(doc, node, 1), xmlFree);
     if(!fullpath){
         S3FS_PRN_ERR("could not get object full path name..");
         return {get_object_name_result::FAILURE, ""};
     }
     // basepath(path) is as same as fullpath.
-    if(0 == strcmp(reinterpret_cast<char*>(fullpath.get()), path)){
+    if(0 == strcmp(fullpath, path)){
         return {get_object_name_result::FILE_OR_SUBDIR_IN_DIR, ""};
     }
 
     // Make dir path and filename
-    std::string strdirpath = mydirname(reinterpret_cast<const char*>(fullpath.get()));
-    std::string strmybpath = mybasename(reinterpret_cast<const char*>(fullpath.get()));
+    std::string strdirpath = mydirname(fullpath);
+    std::string strmybpath = mybasename(fullpath);
     const char* dirpath = strdirpath.c_str();
     const char* mybname = strmybpath.c_str();
     const char* basepath= (path && '/' == path[0]) ? &path[1] : path;
@@ -353,7 +364,8 @@ int append_objects_from_xml_ex(const char* path, xmlDocPtr doc, xmlXPathContextP
             continue;
         }
         xmlNodeSetPtr key_nodes = key->nodesetval;
-        auto result = get_object_name(doc, key_nodes->nodeTab[0]->xmlChildrenNode, path);
+        unique_ptr_xmlChar fullpath(xmlNodeListGetString(doc, key_nodes->nodeTab[0]->xmlChildrenNode, 1), xmlFree);
+        auto result = get_object_name(reinterpret_cast<const char*>(fullpath.get()), path);
 
         switch(result.first){
         case get_object_name_result::FAILURE:
@@ -486,6 +498,317 @@ int append_objects_from_xml(const char* path, xmlDocPtr doc, S3ObjList& head)
     return 0;
 }
 
+//
+// Parse ListBucketResult XML in one pass with xmlTextReader(pull parser)
+//
+// [NOTE]
+// This does not build the DOM and does not use XPath. The elements are
+// matched by the local name, so the XML with or without the name space
+// (noxmlns option) can be parsed in the same way.
+// The entries are kept until the end of the document because <Prefix>
+// is needed for making the object names, and the objects in <Contents>
+// are inserted before the ones in <CommonPrefixes> as same as
+// append_objects_from_xml.
+// If is_cr_encoded is true, the data passed to this function is CR code
+// (\r) encoded, and the encoded CR code is decoded in the object names.
+//
+int parse_list_bucket_xml(const char* path, const char* data, size_t len, bool is_cr_encoded, S3ObjList& head, bool& truncated, std::string& next_continuation_token, std::string& next_marker)
+{
+    truncated = false;
+    next_continuation_token.clear();
+    next_marker.clear();
+
+    if(!data || 0 == len){
+        S3FS_PRN_ERR("The data length passed to xmlReaderForMemory is 0.");
+        return -EIO;
+    }
+
+    s3fsXmlBufferParserError parserError;
+    parserError.SetXmlParseError();
+
+    std::unique_ptr<xmlTextReader, decltype(&xmlFreeTextReader)> reader(xmlReaderForMemory(data, static_cast<int>(len), "", nullptr, S3FS_XML_PARSE_FLAGS), xmlFreeTextReader);
+    if(nullptr == reader){
+        S3FS_PRN_ERR("xmlReaderForMemory returns with error.");
+        return -EIO;
+    }
+
+    std::vector<list_bucket_xml_entry> entries;
+    list_bucket_xml_entry              entry;
+    bool                               in_entry = false;
+    std::string                        prefix;
+    std::string                        strtruncated;
+    std::string*                       ptext    = nullptr;      // the destination of the text in current element
+    int                                result;
+
+    while(1 == (result = xmlTextReaderRead(reader.get()))){
+        int type  = xmlTextReaderNodeType(reader.get());
+        int depth = xmlTextReaderDepth(reader.get());
+
+        if(XML_READER_TYPE_ELEMENT == type){
+            const auto* name = reinterpret_cast<const char*>(xmlTextReaderConstLocalName(reader.get()));
+            ptext = nullptr;
+            if(!name){
+                continue;
+            }
+            if(1 == depth){
+                if(0 == strcmp(name, "Contents") || 0 == strcmp(name, "CommonPrefixes")){
+                    entry            = list_bucket_xml_entry();
+                    entry.is_cprefix = (0 == strcmp(name, "CommonPrefixes"));
+                    in_entry         = (0 == xmlTextReaderIsEmptyElement(reader.get()));
+                }else if(0 == strcmp(name, "Prefix")){
+                    ptext = &prefix;
+                }else if(0 == strcmp(name, "IsTruncated")){
+                    ptext = &strtruncated;
+                }else if(0 == strcmp(name, "NextContinuationToken")){
+                    ptext = &next_continuation_token;
+                }else if(0 == strcmp(name, "NextMarker")){
+                    ptext = &next_marker;
+                }
+            }else if(2 == depth && in_entry){
+                if(0 == strcmp(name, (entry.is_cprefix ? "Prefix" : "Key"))){
+                    ptext = &entry.key;
+                }else if(!entry.is_cprefix && 0 == strcmp(name, "ETag")){
+                    ptext = &entry.etag;
+                }else if(!entry.is_cprefix && 0 == strcmp(name, "Size")){
+                    ptext = &entry.size;
+                }else if(!entry.is_cprefix && 0 == strcmp(name, "LastModified")){
+                    ptext = &entry.lastmod;
+                }
+            }
+            if(ptext){
+                ptext->clear();
+                if(0 != xmlTextReaderIsEmptyElement(reader.get())){
+                    ptext = nullptr;
+                }
+            }
+        }else if(XML_READER_TYPE_TEXT == type || XML_READER_TYPE_CDATA == type){
+            if(ptext){
+                const auto* value = reinterpret_cast<const char*>(xmlTextReaderConstValue(reader.get()));
+                if(value){
+                    ptext->append(value);
+                }
+            }
+        }else if(XML_READER_TYPE_END_ELEMENT == type){
+            ptext = nullptr;
+            if(1 == depth && in_entry){
+                entries.push_back(std::move(entry));
+                in_entry = false;
+            }
+        }
+    }
+    if(0 != result){
+        if(parserError.IsXmlParseError()){
+            S3FS_PRN_ERR("xmlTextReaderRead returns with error: %s", parserError.GetXmlParseError().c_str());
+        }else{
+            S3FS_PRN_ERR("xmlTextReaderRead returns with error.");
+        }
+        return -EIO;
+    }
+
+    // If there is not <Prefix>, use path instead of it.
+    const char* basepath = (!prefix.empty() ? prefix.c_str() : path ? path : "");
+
+    for(int cnt = 0; cnt < 2; ++cnt){
+        bool is_cprefix = (1 == cnt);
+        for(const auto& ent: entries){
+            if(ent.is_cprefix != is_cprefix){
+                continue;
+            }
+            auto nameres = get_object_name((!ent.key.empty() ? ent.key.c_str() : nullptr), basepath);
+
+            switch(nameres.first){
+            case get_object_name_result::FAILURE:
+                S3FS_PRN_WARN("name is something wrong. but continue.");
+                break;
+            case get_object_name_result::SUCCESS: {
+                // [NOTE]
+                // If the XML data passed to this function is CR code(\r) encoded,
+                // the function below decodes that encoded CR code.
+                //
+                std::string decname = (is_cr_encoded ? get_decoded_cr_code(nameres.second.c_str()) : std::move(nameres.second));
+                off_t       objsize = (!ent.size.empty() ? cvt_strtoofft(ent.size.c_str(), /*base=*/ 10) : -1);
+
+                // [NOTE]
+                // The directory object("dir/") in Contents appears only in
+                // the listing without delimiter, keep the terminating slash
+                // so that it is not treated as a file.
+                //
+                if(!is_cprefix && '/' == ent.key.back() && '/' != decname.back()){
+                    decname += '/';
+                }
+
+                if(is_cprefix){
+                    head.AddCommonPrefix(decname);
+                }
+                if(!head.insert(decname.c_str(), (!ent.etag.empty() ? ent.etag.c_str() : nullptr), is_cprefix, objsize, (!ent.lastmod.empty() ? ent.lastmod.c_str() : nullptr))){
+                    S3FS_PRN_ERR("insert_object returns with error.");
+                    return -EIO;
+                }
+                break;
+            }
+            case get_object_name_result::FILE_OR_SUBDIR_IN_DIR:
+                S3FS_PRN_DBG("name is file or subdir in dir. but continue.");
+                break;
+            }
+        }
+    }
+
+    if(0 == strcasecmp(strtruncated.c_str(), "true")){
+        truncated = true;
+        if(!next_continuation_token.empty()){
+            next_marker.clear();
+        }
+    }else{
+        next_continuation_token.clear();
+        next_marker.clear();
+    }
+    return 0;
+}
+
+//
+// Parse the response body of ListObjects(V1/V2) and append objects to head.
+//
+// [NOTE]
+// The next continuation token or the next marker is set only when the
+// result is truncated. If both are not in the response(ex. V1 without
+// delimiter), both are left empty and the caller decides the next marker.
+//
+int parse_list_bucket_result(const char* path, const std::string& body, S3ObjList& head, bool& truncated, std::string& next_continuation_token, std::string& next_marker)
+{
+    // [NOTE]
+    // If body is empty, the xml parser will output the message
+    // ":1: parser error : Document is empty" to stderr.
+    // Make sure body is not empty beforehand.
+    //
+    if(body.empty()){
+        truncated = false;
+        next_continuation_token.clear();
+        next_marker.clear();
+        S3FS_PRN_ERR("The data length passed to xml parser is 0.");
+        return -EIO;
+    }
+
+    // [NOTE]
+    // CR code(\r) is replaced with LF(\n) by the xml parser.
+    // To prevent that, only CR code is encoded by get_encoded_cr_code and
+    // the encoded CR code is decoded with parse_list_bucket_xml.
+    // The body rarely contains raw CR code(S3 returns it as a character
+    // reference), so the body is parsed in place without copying if there
+    // is no CR code.
+    //
+    if(nullptr == memchr(body.data(), '\r', body.size())){
+        return parse_list_bucket_xml(path, body.data(), body.size(), false, head, truncated, next_continuation_token, next_marker);
+    }
+    std::string encbody = get_encoded_cr_code(body.c_str());
+    return parse_list_bucket_xml(path, encbody.c_str(), encbody.size(), true, head, truncated, next_continuation_token, next_marker);
+}
+
+//
+// Get the text of the element by searching the tag in the body without parsing.
+//
+// [NOTE]
+// The text in S3 responses is escaped, so the tags never appear in the text.
+// Only the predefined entities and the character references for ASCII are
+// decoded, and returns false for others so that the caller can parse the
+// body instead of this.
+//
+static bool scan_element_value(const std::string& body, const char* element, bool is_last, std::string& value)
+{
+    std::string starttag = std::string("<") + element + ">";
+    std::string endtag   = std::string("</") + element + ">";
+
+    std::string::size_type spos = (is_last ? body.rfind(starttag) : body.find(starttag));
+    if(std::string::npos == spos){
+        return false;
+    }
+    spos += starttag.size();
+    std::string::size_type epos = body.find(endtag, spos);
+    if(std::string::npos == epos){
+        return false;
+    }
+
+    value.clear();
+    for(std::string::size_type pos = spos; pos < epos; ++pos){
+        if('&' != body[pos]){
+            value += body[pos];
+            continue;
+        }
+        std::string::size_type endpos = body.find(';', pos);
+        if(std::string::npos == endpos || epos < endpos){
+            return false;
+        }
+        std::string entity = body.substr(pos + 1, endpos - pos - 1);
+        if(entity == "amp"){
+            value += '&';
+        }else if(entity == "lt"){
+            value += '<';
+        }else if(entity == "gt"){
+            value += '>';
+        }else if(entity == "quot"){
+            value += '"';
+        }else if(entity == "apos"){
+            value += '\'';
+        }else if(1 < entity.size() && '#' == entity[0]){
+            char*         endptr = nullptr;
+            unsigned long code;
+            if('x' == entity[1] || 'X' == entity[1]){
+                code = strtoul(entity.c_str() + 2, &endptr, 16);
+            }else{
+                code = strtoul(entity.c_str() + 1, &endptr, 10);
+            }
+            if(!endptr || '\0' != *endptr || 0 == code || 0x7f < code){
+                return false;
+            }
+            value += static_cast<char>(code);
+        }else{
+            return false;
+        }
+        pos = endpos;
+    }
+    return true;
+}
+
+//
+// Find the values for requesting the next page in the response body of
+// ListObjects(V1/V2) without parsing the whole XML document.
+//
+// If the result is truncated and there are neither NextContinuationToken
+// nor NextMarker, the last Key is used as the next marker only when
+// use_last_key is true(that is, delimiter is not specified).
+// Returns false if the values could not be found, in which case the
+// caller must parse the body to decide the next page.
+//
+bool scan_list_bucket_next(const std::string& body, bool use_last_key, bool& truncated, std::string& next_continuation_token, std::string& next_marker)
+{
+    std::string value;
+
+    truncated = false;
+    next_continuation_token.clear();
+    next_marker.clear();
+
+    if(!scan_element_value(body, "IsTruncated", false, value)){
+        return false;
+    }
+    if(0 != strcasecmp(value.c_str(), "true")){
+        return true;
+    }
+    truncated = true;
+
+    if(scan_element_value(body, "NextContinuationToken", false, next_continuation_token) && !next_continuation_token.empty()){
+        return true;
+    }
+    next_continuation_token.clear();
+    if(scan_element_value(body, "NextMarker", false, next_marker) && !next_marker.empty()){
+        return true;
+    }
+    next_marker.clear();
+    if(use_last_key && scan_element_value(body, "Key", true, next_marker) && !next_marker.empty()){
+        return true;
+    }
+    next_marker.clear();
+    return false;
+}
+
 //-------------------------------------------------------------------
 // Utility functions
 //-------------------------------------------------------------------
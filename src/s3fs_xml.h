@@ -89,6 +89,9 @@ class s3fsXmlBufferParserError
 bool is_truncated(xmlDocPtr doc);
 int append_objects_from_xml_ex(const char* path, xmlDocPtr doc, xmlXPathContextPtr ctx, const char* ex_contents, const char* ex_key, const char* ex_etag, const char* ex_size, const char* ex_lastmod, int isCPrefix, S3ObjList& head, bool prefix);
 int append_objects_from_xml(const char* path, xmlDocPtr doc, S3ObjList& head);
+int parse_list_bucket_xml(const char* path, const char* data, size_t len, bool is_cr_encoded, S3ObjList& head, bool& truncated, std::string& next_continuation_token, std::string& next_marker);
+int parse_list_bucket_result(const char* path, const std::string& body, S3ObjList& head, bool& truncated, std::string& next_continuation_token, std::string& next_marker);
+bool scan_list_bucket_next(const std::string& body, bool use_last_key, bool& truncated, std::string& next_continuation_token, std::string& next_marker);
 unique_ptr_xmlChar get_next_continuation_token(xmlDocPtr doc);
 unique_ptr_xmlChar get_next_marker(xmlDocPtr doc);
 bool get_incomp_mpu_list(xmlDocPtr doc, incomp_mpu_list_t& list);
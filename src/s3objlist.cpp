@@ -19,10 +19,93 @@
  */
 
 #include <cstring>
+#include <limits>
 #include <string>
 #include <algorithm>
 
 #include "s3objlist.h"
+#include "s3fs_logger.h"
+#include "string_util.h"
+
+//-------------------------------------------------------------------
+// Utility functions
+//-------------------------------------------------------------------
+static int hex_to_nibble(char ch)
+{
+    if('0' <= ch && ch <= '9'){
+        return ch - '0';
+    }else if('a' <= ch && ch <= 'f'){
+        return ch - 'a' + 10;
+    }
+    return -1;
+}
+
+//
+// Pack the ETag("<32 lower hex characters>") into 16 bytes binary.
+// Returns false if the ETag is not this format(ex. multipart upload).
+//
+static bool pack_md5_etag(const char* etag, std::array<unsigned char, 16>& md5)
+{
+    if(!etag || '"' != etag[0] || 34 != strlen(etag) || '"' != etag[33]){
+        return false;
+    }
+    for(size_t pos = 0; pos < md5.size(); ++pos){
+        int high = hex_to_nibble(etag[1 + pos * 2]);
+        int low  = hex_to_nibble(etag[2 + pos * 2]);
+        if(high < 0 || low < 0){
+            return false;
+        }
+        md5[pos] = static_cast<unsigned char>((high << 4) | low);
+    }
+    return true;
+}
+
+//
+// Convert LastModified("YYYY-MM-DDThh:mm:ss[.sssZ]") to unixtime.
+//
+// [NOTE]
+// Since strptime is slow for parsing all objects in the listing, the
+// fixed format of ListObjects is parsed here, and other formats are
+// parsed by get_unixtime_from_iso8601.
+//
+static time_t get_last_modified_time(const char* pdate)
+{
+    static constexpr char format[] = "0000-00-00T00:00:00";
+
+    int  fields[6] = {0, 0, 0, 0, 0, 0};      // year, month, day, hour, min, sec
+    int  index     = 0;
+    bool is_fixed  = true;
+    for(size_t pos = 0; pos < sizeof(format) - 1; ++pos){
+        if('0' == format[pos]){
+            if(pdate[pos] < '0' || '9' < pdate[pos]){
+                is_fixed = false;
+                break;
+            }
+            fields[index] = fields[index] * 10 + (pdate[pos] - '0');
+        }else if(format[pos] == pdate[pos]){
+            ++index;
+        }else{
+            is_fixed = false;
+            break;
+        }
+    }
+    if(!is_fixed || fields[1] < 1 || 12 < fields[1] || fields[2] < 1 || 31 < fields[2]){
+        if(auto mtime = get_unixtime_from_iso8601(pdate)){
+            return *mtime;
+        }
+        return -1;
+    }
+
+    // days from 1970-01-01 in the proleptic Gregorian calendar
+    int      year  = fields[1] <= 2 ? fields[0] - 1 : fields[0];
+    int      era   = year / 400;
+    int      yoe   = year - era * 400;
+    int      doy   = (153 * (fields[1] + (2 < fields[1] ? -3 : 9)) + 2) / 5 + fields[2] - 1;
+    int      doe   = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int64_t  days  = static_cast<int64_t>(era) * 146097 + doe - 719468;
+
+    return static_cast<time_t>(days * 86400 + fields[3] * 3600 + fields[4] * 60 + fields[5]);
+}
 
 //-------------------------------------------------------------------
 // Class S3ObjList
@@ -38,13 +121,29 @@
 // will be set to type. If it is not a directory(file, symbolic link), type will
 // be set to objtype_t::UNKNOWN.
 //
+// [NOTE]
+// The objects are kept in a vector sorted by the key name, and all names
+// are stored in the string arena. Since the ListObjects response is sorted
+// by the key name, inserting the objects is usually appending them to the
+// end of the vector.
+// When the object is updated, the old strings are left in the arena until
+// this object is destroyed.
+//
 bool S3ObjList::insert(const char* name, const char* etag, bool is_dir, off_t size, const char* last_modified)
+{
+    return insert(name, etag, is_dir, size, (last_modified ? get_last_modified_time(last_modified) : -1));
+}
+
+//
+// mtime is the unixtime of LastModified, -1 means unknown.
+//
+bool S3ObjList::insert(const char* name, const char* etag, bool is_dir, off_t size, time_t mtime)
 {
     if(!name || '\0' == name[0]){
         return false;
     }
 
-    s3obj_t::iterator iter;
+    s3obj_entries_t::iterator iter;
     std::string newname;
     std::string orgname = name;
     objtype_t   type    = objtype_t::UNKNOWN;
@@ -72,50 +171,52 @@ bool S3ObjList::insert(const char* name, const char* etag, bool is_dir, off_t si
 
     // Check derived name object.
     if(is_dir || IS_DIR_OBJ(type)){
-        std::string chkname = newname.substr(0, newname.length() - 1);
-        if(objects.cend() != (iter = objects.find(chkname))){
+        std::string_view chkname = std::string_view(newname).substr(0, newname.length() - 1);
+        if(objects.end() != (iter = Find(chkname))){
             // found "dir" object --> remove it.
             objects.erase(iter);
         }
     }else{
         std::string chkname = newname + "/";
-        if(objects.cend() != (iter = objects.find(chkname))){
+        if(objects.end() != Find(chkname)){
             // found "dir/" object --> not add new object.
             // and add normalization
             return insert_normalized(orgname.c_str(), chkname.c_str(), type);
         }
     }
 
-    // Add object
-    if(objects.cend() != (iter = objects.find(newname))){
-        // Found same object --> update information.
-        iter->second.normalname.clear();
-        iter->second.orgname = orgname;
-        iter->second.type    = type;
-        if(etag){
-            iter->second.etag = etag;  // over write
-        }
-        if(0 <= size){
-            iter->second.size = size;
-        }
-        if(last_modified){
-            iter->second.last_modified = last_modified;
-        }
+    // Add object(or update information if the same object exists)
+    if(objects.end() == (iter = Emplace(newname))){
+        return false;
+    }
+    bool was_last = (GetEntryName(*iter) == last_name);
+    if(iter->is_alias){
+        // The alias entry does not have the ETag.
+        iter->etag_pos    = 0;
+        iter->etag_len    = 0;
+        iter->etag_packed = false;
+    }
+    iter->is_alias = false;
+    iter->type     = type;
+    if(newname == orgname){
+        iter->alt_pos = 0;
+        iter->alt_len = 0;
+    }else if(!AddArenaString(orgname, iter->alt_pos, iter->alt_len)){
+        return false;
+    }
+    if(etag && !SetETag(*iter, etag)){
+        return false;
+    }
+    if(0 <= size){
+        iter->size = size;
+    }
+    if(0 <= mtime){
+        iter->mtime = mtime;
+    }
+    if(was_last && GetEntryName(*iter) < last_name){
+        ResetLastName();
     }else{
-        // add new object
-        s3obj_entry newobject;
-        newobject.orgname = orgname;
-        newobject.type    = type;
-        if(etag){
-            newobject.etag = etag;
-        }
-        if(0 <= size){
-            newobject.size = size;
-        }
-        if(last_modified){
-            newobject.last_modified = last_modified;
-        }
-        objects[newname] = std::move(newobject);
+        UpdateLastName(GetEntryName(*iter));
     }
 
     // add normalization
@@ -131,34 +232,125 @@ bool S3ObjList::insert_normalized(const char* name, const char* normalized, objt
         return true;
     }
 
-    s3obj_t::iterator iter;
-    if(objects.cend() != (iter = objects.find(name))){
-        // found name --> over write
-        iter->second.orgname.clear();
-        iter->second.etag.clear();
-        iter->second.normalname = normalized;
-        iter->second.type       = type;
+    // found name --> over write, not found --> add new object
+    s3obj_entries_t::iterator iter;
+    if(objects.end() == (iter = Emplace(name))){
+        return false;
+    }
+    bool was_last = (GetEntryName(*iter) == last_name);
+    if(!AddArenaString(normalized, iter->alt_pos, iter->alt_len)){
+        return false;
+    }
+    iter->etag_pos    = 0;
+    iter->etag_len    = 0;
+    iter->etag_packed = false;
+    iter->is_alias    = true;
+    iter->type        = type;
+    if(was_last && GetEntryName(*iter) < last_name){
+        ResetLastName();
     }else{
-        // not found --> add new object
-        s3obj_entry newobject;
-        newobject.normalname = normalized;
-        newobject.type       = type;
-        objects[name]        = std::move(newobject);
+        UpdateLastName(GetEntryName(*iter));
     }
     return true;
 }
 
-const s3obj_entry* S3ObjList::GetS3Obj(const char* name) const
+bool S3ObjList::AddArenaString(std::string_view str, uint32_t& pos, uint32_t& len)
+{
+    if(std::numeric_limits<uint32_t>::max() < (arena.size() + str.size())){
+        S3FS_PRN_ERR("The total length of names in the list is over the limit.");
+        return false;
+    }
+    pos = static_cast<uint32_t>(arena.size());
+    len = static_cast<uint32_t>(str.size());
+    arena.append(str);
+    return true;
+}
+
+bool S3ObjList::SetETag(s3obj_entry& entry, const char* etag)
+{
+    if(pack_md5_etag(etag, entry.etag_md5)){
+        entry.etag_pos    = 0;
+        entry.etag_len    = 0;
+        entry.etag_packed = true;
+        return true;
+    }
+    entry.etag_packed = false;
+    return AddArenaString(etag, entry.etag_pos, entry.etag_len);
+}
+
+std::string S3ObjList::GetETag(const s3obj_entry& entry) const
+{
+    if(entry.etag_packed){
+        return "\"" + s3fs_hex_lower(entry.etag_md5.data(), entry.etag_md5.size()) + "\"";
+    }
+    return std::string(GetArenaString(entry.etag_pos, entry.etag_len));
+}
+
+//
+// Returns the original name of normal object, or the normalized name of
+// alias object.
+//
+std::string_view S3ObjList::GetEntryName(const s3obj_entry& entry) const
+{
+    if(!entry.is_alias && 0 == entry.alt_len){
+        return GetKeyName(entry);
+    }
+    return GetArenaString(entry.alt_pos, entry.alt_len);
+}
+
+s3obj_entries_t::iterator S3ObjList::LowerBound(std::string_view name)
+{
+    return std::lower_bound(objects.begin(), objects.end(), name, [this](const s3obj_entry& entry, std::string_view value){ return GetKeyName(entry) < value; });
+}
+
+s3obj_entries_t::const_iterator S3ObjList::LowerBound(std::string_view name) const
 {
-    s3obj_t::const_iterator iter;
+    return std::lower_bound(objects.cbegin(), objects.cend(), name, [this](const s3obj_entry& entry, std::string_view value){ return GetKeyName(entry) < value; });
+}
+
+s3obj_entries_t::iterator S3ObjList::Find(std::string_view name)
+{
+    auto iter = LowerBound(name);
+    if(objects.end() != iter && GetKeyName(*iter) == name){
+        return iter;
+    }
+    return objects.end();
+}
+
+//
+// Returns the entry of name, and adds new entry if it does not exist.
+// Returns end() if failed to add.
+//
+s3obj_entries_t::iterator S3ObjList::Emplace(std::string_view name)
+{
+    // fast path: the names come in sorted order from ListObjects
+    s3obj_entries_t::iterator iter;
+    if(objects.empty() || GetKeyName(objects.back()) < name){
+        iter = objects.end();
+    }else{
+        iter = LowerBound(name);
+        if(objects.end() != iter && GetKeyName(*iter) == name){
+            return iter;
+        }
+    }
+
+    s3obj_entry newobject;
+    if(!AddArenaString(name, newobject.name_pos, newobject.name_len)){
+        return objects.end();
+    }
+    return objects.insert(iter, newobject);
+}
 
+const s3obj_entry* S3ObjList::GetS3Obj(const char* name) const
+{
     if(!name || '\0' == name[0]){
         return nullptr;
     }
-    if(objects.cend() == (iter = objects.find(name))){
+    auto iter = LowerBound(name);
+    if(objects.cend() == iter || GetKeyName(*iter) != name){
         return nullptr;
     }
-    return &(iter->second);
+    return &(*iter);
 }
 
 std::string S3ObjList::GetOrgName(const char* name) const
@@ -168,10 +360,10 @@ std::string S3ObjList::GetOrgName(const char* name) const
     if(!name || '\0' == name[0]){
         return "";
     }
-    if(nullptr == (ps3obj = GetS3Obj(name))){
+    if(nullptr == (ps3obj = GetS3Obj(name)) || ps3obj->is_alias){
         return "";
     }
-    return ps3obj->orgname;
+    return std::string(GetEntryName(*ps3obj));
 }
 
 std::string S3ObjList::GetNormalizedName(const char* name) const
@@ -184,10 +376,10 @@ std::string S3ObjList::GetNormalizedName(const char* name) const
     if(nullptr == (ps3obj = GetS3Obj(name))){
         return "";
     }
-    if(ps3obj->normalname.empty()){
+    if(!ps3obj->is_alias){
         return name;
     }
-    return ps3obj->normalname;
+    return std::string(GetEntryName(*ps3obj));
 }
 
 std::string S3ObjList::GetETag(const char* name) const
@@ -200,7 +392,7 @@ std::string S3ObjList::GetETag(const char* name) const
     if(nullptr == (ps3obj = GetS3Obj(name))){
         return "";
     }
-    return ps3obj->etag;
+    return GetETag(*ps3obj);
 }
 
 off_t S3ObjList::GetSize(const char* name) const
@@ -216,17 +408,17 @@ off_t S3ObjList::GetSize(const char* name) const
     return ps3obj->size;
 }
 
-std::string S3ObjList::GetLastModified(const char* name) const
+time_t S3ObjList::GetLastModified(const char* name) const
 {
     const s3obj_entry* ps3obj;
 
     if(!name || '\0' == name[0]){
-        return "";
+        return -1;
     }
     if(nullptr == (ps3obj = GetS3Obj(name))){
-        return "";
+        return -1;
     }
-    return ps3obj->last_modified;
+    return ps3obj->mtime;
 }
 
 bool S3ObjList::IsDir(const char* name) const
@@ -239,27 +431,36 @@ bool S3ObjList::IsDir(const char* name) const
     return IS_DIR_OBJ(ps3obj->type);
 }
 
+//
+// Returns the greatest name of the objects(the original name, or the
+// normalized name for the alias entry).
+//
+// [NOTE]
+// This is called for each page of the listing to make the next marker,
+// so the name is kept up to date by the insert methods instead of
+// scanning the objects.
+//
 std::optional<std::string> S3ObjList::GetLastName() const
 {
-    bool result = false;
-    std::string lastname;
-    for(auto iter = objects.cbegin(); iter != objects.cend(); ++iter){
-        if(!iter->second.orgname.empty()){
-            if(lastname.compare(iter->second.orgname) < 0){
-                lastname = iter->second.orgname;
-                result = true;
-            }
-        }else{
-            if(lastname.compare(iter->second.normalname) < 0){
-                lastname = iter->second.normalname;
-                result = true;
-            }
-        }
-    }
-    if(!result){
+    if(last_name.empty()){
         return std::nullopt;
     }
-    return lastname;
+    return last_name;
+}
+
+void S3ObjList::UpdateLastName(std::string_view name)
+{
+    if(last_name < name){
+        last_name = name;
+    }
+}
+
+void S3ObjList::ResetLastName()
+{
+    last_name.clear();
+    for(auto iter = objects.cbegin(); iter != objects.cend(); ++iter){
+        UpdateLastName(GetEntryName(*iter));
+    }
 }
 
 bool S3ObjList::RawGetNames(s3obj_list_t* plist, s3obj_type_map_t* pobjmap, bool OnlyNormalized, bool CutSlash) const
@@ -268,10 +469,10 @@ bool S3ObjList::RawGetNames(s3obj_list_t* plist, s3obj_type_map_t* pobjmap, bool
         return false;
     }
     for(auto iter = objects.cbegin(); objects.cend() != iter; ++iter){
-        if(OnlyNormalized && !iter->second.normalname.empty()){
+        if(OnlyNormalized && iter->is_alias){
             continue;
         }
-        std::string name = iter->first;
+        std::string name(GetKeyName(*iter));
         if(CutSlash && 1 < name.length() && '/' == *name.rbegin()){
             // only "/" std::string is skipped this.
             name.erase(name.length() - 1);
@@ -280,7 +481,7 @@ bool S3ObjList::RawGetNames(s3obj_list_t* plist, s3obj_type_map_t* pobjmap, bool
             plist->push_back(name);
         }
         if(pobjmap){
-            (*pobjmap)[name] = iter->second.type;
+            (*pobjmap)[name] = iter->type;
         }
     }
     return true;
@@ -296,19 +497,41 @@ bool S3ObjList::GetNameMap(s3obj_type_map_t& objmap, bool OnlyNormalized, bool C
     return RawGetNames(nullptr, &objmap, OnlyNormalized, CutSlash);
 }
 
+//
+// Appends the views of the key names(with "/" for directories) in sorted
+// order to list, without copying the names.
+//
+bool S3ObjList::GetNameViews(s3obj_view_list_t& list, bool OnlyNormalized) const
+{
+    list.reserve(list.size() + objects.size());
+    for(auto iter = objects.cbegin(); objects.cend() != iter; ++iter){
+        if(OnlyNormalized && iter->is_alias){
+            continue;
+        }
+        list.push_back({GetKeyName(*iter), iter->type});
+    }
+    return true;
+}
+
+bool S3ObjList::HasNormalizedName(std::string_view name) const
+{
+    auto iter = LowerBound(name);
+    return (objects.cend() != iter && GetKeyName(*iter) == name && !iter->is_alias);
+}
+
 bool S3ObjList::HasName(const std::string& strName) const
 {
     std::string strWitoutSlash;
     std::string strWithSlash;
 
     if('/' == strName.back()){
-        strWitoutSlash = strName.substr(strName.size() - 1);
+        strWitoutSlash = strName.substr(0, strName.size() - 1);
         strWithSlash   = strName;
     }else{
         strWitoutSlash = strName;
         strWithSlash   = strName + '/';
     }
-    if(objects.end() != objects.find(strWitoutSlash) || objects.end() != objects.find(strWithSlash)){
+    if(nullptr != GetS3Obj(strWitoutSlash.c_str()) || nullptr != GetS3Obj(strWithSlash.c_str())){
         return true;
     }
     return false;
@@ -320,20 +543,72 @@ bool S3ObjList::Remove(const std::string& strName)
     std::string strWithSlash;
 
     if('/' == strName.back()){
-        strWitoutSlash = strName.substr(strName.size() - 1);
+        strWitoutSlash = strName.substr(0, strName.size() - 1);
         strWithSlash   = strName;
     }else{
         strWitoutSlash = strName;
         strWithSlash   = strName + '/';
     }
-    objects.erase(strWitoutSlash);
-    objects.erase(strWithSlash);
+    s3obj_entries_t::iterator iter;
+    if(objects.end() != (iter = Find(strWitoutSlash))){
+        objects.erase(iter);
+    }
+    if(objects.end() != (iter = Find(strWithSlash))){
+        objects.erase(iter);
+    }
     common_prefixes.erase(std::remove(common_prefixes.begin(), common_prefixes.end(), strWitoutSlash), common_prefixes.end());
     common_prefixes.erase(std::remove(common_prefixes.begin(), common_prefixes.end(), strWithSlash), common_prefixes.end());
+    ResetLastName();
 
     return true;
 }
 
+//
+// Remove all objects whose names are greater than strName.
+//
+void S3ObjList::RemoveAfter(const std::string& strName)
+{
+    auto iter = std::upper_bound(objects.begin(), objects.end(), std::string_view(strName), [this](std::string_view value, const s3obj_entry& entry){ return value < GetKeyName(entry); });
+    objects.erase(iter, objects.end());
+    common_prefixes.erase(std::remove_if(common_prefixes.begin(), common_prefixes.end(), [&strName](const std::string& prefix){ return (0 < prefix.compare(strName)); }), common_prefixes.end());
+    ResetLastName();
+}
+
+//
+// Merge all objects in list into this list.
+//
+// [NOTE]
+// The same name object in list overwrites the object in this list, this
+// is the same as inserting the objects of list after this list.
+// The common prefixes are deduplicated, because the prefix which straddles
+// the split key of the range listing is returned by both ranges.
+//
+void S3ObjList::Append(const S3ObjList& list)
+{
+    for(auto iter = list.objects.cbegin(); iter != list.objects.cend(); ++iter){
+        s3obj_entries_t::iterator dest;
+        if(objects.end() == (dest = Emplace(list.GetKeyName(*iter)))){
+            continue;
+        }
+        uint32_t name_pos = dest->name_pos;
+        uint32_t name_len = dest->name_len;
+        *dest             = *iter;
+        dest->name_pos    = name_pos;
+        dest->name_len    = name_len;
+
+        if(0 < iter->alt_len && !AddArenaString(list.GetArenaString(iter->alt_pos, iter->alt_len), dest->alt_pos, dest->alt_len)){
+            dest->alt_len = 0;
+        }
+        if(0 < iter->etag_len && !AddArenaString(list.GetArenaString(iter->etag_pos, iter->etag_len), dest->etag_pos, dest->etag_len)){
+            dest->etag_len = 0;
+        }
+    }
+    UpdateLastName(list.last_name);
+    common_prefixes.insert(common_prefixes.end(), list.common_prefixes.cbegin(), list.common_prefixes.cend());
+    std::sort(common_prefixes.begin(), common_prefixes.end());
+    common_prefixes.erase(std::unique(common_prefixes.begin(), common_prefixes.end()), common_prefixes.end());
+}
+
 void S3ObjList::Dump(const std::string& indent, std::ostringstream& oss) const
 {
     std::string child_indent        = indent + "  ";
@@ -341,13 +616,13 @@ void S3ObjList::Dump(const std::string& indent, std::ostringstream& oss) const
 
     oss << indent << "S3ObjList::objects = {" << std::endl;
     for(auto oiter = objects.cbegin(); objects.cend() != oiter; ++oiter){
-        oss << child_indent << "[" << oiter->first << "] = {" << std::endl;
-        oss << child_member_indent << "normalname    = " << oiter->second.normalname        << std::endl;
-        oss << child_member_indent << "orgname       = " << oiter->second.orgname           << std::endl;
-        oss << child_member_indent << "etag          = " << oiter->second.etag              << std::endl;
-        oss << child_member_indent << "size          = " << oiter->second.size              << std::endl;
-        oss << child_member_indent << "last_modified = " << oiter->second.last_modified     << std::endl;
-        oss << child_member_indent << "type          = " << STR_OBJTYPE(oiter->second.type) << std::endl;
+        oss << child_indent << "[" << GetKeyName(*oiter) << "] = {" << std::endl;
+        oss << child_member_indent << "normalname    = " << (oiter->is_alias ? GetEntryName(*oiter) : std::string_view()) << std::endl;
+        oss << child_member_indent << "orgname       = " << (oiter->is_alias ? std::string_view() : GetEntryName(*oiter)) << std::endl;
+        oss << child_member_indent << "etag          = " << GetETag(*oiter)       << std::endl;
+        oss << child_member_indent << "size          = " << oiter->size           << std::endl;
+        oss << child_member_indent << "last_modified = " << oiter->mtime          << std::endl;
+        oss << child_member_indent << "type          = " << STR_OBJTYPE(oiter->type) << std::endl;
         oss << child_indent << "}" << std::endl;
     }
     oss << indent << "}" << std::endl;
@@ -21,9 +21,13 @@
 #ifndef S3FS_S3OBJLIST_H_
 #define S3FS_S3OBJLIST_H_
 
+#include <array>
+#include <cstdint>
+#include <ctime>
 #include <map>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <sys/types.h>
 #include <utility>
 #include <vector>
@@ -34,18 +38,43 @@
 //-------------------------------------------------------------------
 // Structure / Typedef
 //-------------------------------------------------------------------
+// [NOTE]
+// The strings of all objects are stored in one string arena of S3ObjList,
+// and s3obj_entry only has their positions in the arena.
+// The ETag which is a quoted MD5 hex string(single part upload) is packed
+// into 16 bytes binary instead of storing the string.
+//
 struct s3obj_entry{
-    std::string normalname;                 // normalized name: if empty, object is normalized name.
-    std::string orgname;                    // original name: if empty, object is original name.
-    std::string etag;
-    off_t       size = -1;                  // Size from ListObjects <Contents>; -1 if unknown (e.g. CommonPrefix).
-    std::string last_modified;              // LastModified from ListObjects <Contents>, raw ISO 8601 string; empty if unknown.
-    objtype_t   type = objtype_t::UNKNOWN;  // only set for directories, UNKNOWN for non-directories.
+    uint32_t    name_pos    = 0;                    // key name
+    uint32_t    name_len    = 0;
+    uint32_t    alt_pos     = 0;                    // normalized name if is_alias, otherwise original name(empty if it is same as key name)
+    uint32_t    alt_len     = 0;
+    uint32_t    etag_pos    = 0;                    // ETag if it is not packed
+    uint32_t    etag_len    = 0;
+    off_t       size        = -1;                   // Size from ListObjects <Contents>; -1 if unknown (e.g. CommonPrefix).
+    time_t      mtime       = -1;                   // LastModified from ListObjects <Contents>; -1 if unknown.
+    std::array<unsigned char, 16> etag_md5 = {};    // packed ETag if etag_packed
+    objtype_t   type        = objtype_t::UNKNOWN;   // only set for directories, UNKNOWN for non-directories.
+    bool        is_alias    = false;                // this entry is only for normalization
+    bool        etag_packed = false;
 };
 
-using s3obj_t          = std::map<std::string, struct s3obj_entry>;
-using s3obj_list_t     = std::vector<std::string>;
-using s3obj_type_map_t = std::map<std::string, objtype_t>;
+//
+// Non-owning view of an object name in S3ObjList
+//
+// [NOTE]
+// The name refers to the string arena of S3ObjList, so it is valid only
+// while the S3ObjList is not modified or destroyed.
+//
+struct s3obj_name_view{
+    std::string_view name;
+    objtype_t        type = objtype_t::UNKNOWN;
+};
+
+using s3obj_entries_t   = std::vector<s3obj_entry>;
+using s3obj_list_t      = std::vector<std::string>;
+using s3obj_type_map_t  = std::map<std::string, objtype_t>;
+using s3obj_view_list_t = std::vector<s3obj_name_view>;
 
 //-------------------------------------------------------------------
 // Class S3ObjList
@@ -53,32 +82,50 @@ using s3obj_type_map_t = std::map<std::string, objtype_t>;
 class S3ObjList
 {
     private:
-        s3obj_t objects;
+        std::string     arena;                      // strings of all objects
+        s3obj_entries_t objects;                    // sorted by key name
         std::vector<std::string> common_prefixes;
+        std::string     last_name;                  // greatest name of objects(see. GetLastName)
+
+        std::string_view GetArenaString(uint32_t pos, uint32_t len) const { return std::string_view(arena).substr(pos, len); }
+        std::string_view GetKeyName(const s3obj_entry& entry) const { return GetArenaString(entry.name_pos, entry.name_len); }
+        bool AddArenaString(std::string_view str, uint32_t& pos, uint32_t& len);
+        bool SetETag(s3obj_entry& entry, const char* etag);
+        std::string GetETag(const s3obj_entry& entry) const;
+        std::string_view GetEntryName(const s3obj_entry& entry) const;
+        void UpdateLastName(std::string_view name);
+        void ResetLastName();
+
+        s3obj_entries_t::iterator LowerBound(std::string_view name);
+        s3obj_entries_t::const_iterator LowerBound(std::string_view name) const;
+        s3obj_entries_t::iterator Find(std::string_view name);
+        s3obj_entries_t::iterator Emplace(std::string_view name);
 
         bool insert_normalized(const char* name, const char* normalized, objtype_t type);
         const s3obj_entry* GetS3Obj(const char* name) const;
         bool RawGetNames(s3obj_list_t* plist, s3obj_type_map_t* pobjmap, bool OnlyNormalized, bool CutSlash) const;
 
-        s3obj_t::const_iterator cbegin() const { return objects.cbegin(); }
-        s3obj_t::const_iterator cend() const { return objects.cend(); }
-
     public:
         bool IsEmpty() const { return objects.empty(); }
         bool insert(const char* name, const char* etag = nullptr, bool is_dir = false, off_t size = -1, const char* last_modified = nullptr);
+        bool insert(const char* name, const char* etag, bool is_dir, off_t size, time_t mtime);
         std::string GetOrgName(const char* name) const;
         std::string GetNormalizedName(const char* name) const;
         std::string GetETag(const char* name) const;
         off_t GetSize(const char* name) const;
-        std::string GetLastModified(const char* name) const;
+        time_t GetLastModified(const char* name) const;
         const std::vector<std::string>& GetCommonPrefixes() const { return common_prefixes; }
         void AddCommonPrefix(std::string prefix) { common_prefixes.push_back(std::move(prefix)); }
         bool IsDir(const char* name) const;
         bool GetNameList(s3obj_list_t& list, bool OnlyNormalized = true, bool CutSlash = true) const;
         bool GetNameMap(s3obj_type_map_t& objmap, bool OnlyNormalized = true, bool CutSlash = true) const;
+        bool GetNameViews(s3obj_view_list_t& list, bool OnlyNormalized = true) const;
+        bool HasNormalizedName(std::string_view name) const;
         std::optional<std::string> GetLastName() const;
         bool HasName(const std::string& strName) const;
         bool Remove(const std::string& strName);
+        void RemoveAfter(const std::string& strName);
+        void Append(const S3ObjList& list);
         void Dump(const std::string& indent, std::ostringstream& oss) const;
 
         static bool MakeHierarchizedList(s3obj_list_t& list, bool haveSlash);
@@ -20,11 +20,13 @@
 
 #include "s3fs_logger.h"
 #include "syncfiller.h"
+#include "fdcache.h"
+#include "metaheader.h"
 
 //-------------------------------------------------------------------
 // Class SyncFiller
 //-------------------------------------------------------------------
-SyncFiller::SyncFiller(void* buff, fuse_fill_dir_t filler) : filler_buff(buff), filler_func(filler)
+SyncFiller::SyncFiller(void* buff, fuse_fill_dir_t filler, bool use_plus) : filler_buff(buff), filler_func(filler), is_plus(use_plus)
 {
     if(!filler_buff || !filler_func){
         S3FS_PRN_CRIT("Internal error: SyncFiller constructor parameter is critical value.");
@@ -35,13 +37,32 @@ SyncFiller::SyncFiller(void* buff, fuse_fill_dir_t filler) : filler_buff(buff),
 //
 // See. prototype fuse_fill_dir_t in fuse.h
 //
-int SyncFiller::Fill(const std::string& name, const struct stat *stbuf, off_t off)
+// [NOTE]
+// For readdirplus, the stat is passed with FUSE_FILL_DIR_PLUS, and the
+// kernel caches it as the attributes of the entry without calling
+// getattr.
+// However, the stat of an opened file(path) may be older than the file
+// being written, so it is filled without FUSE_FILL_DIR_PLUS and the
+// attributes are got by getattr later.
+//
+int SyncFiller::Fill(const std::string& name, const struct stat *stbuf, off_t off, const char* path)
 {
+    fuse_fill_dir_flags flags = S3FS_FUSE_FILL_DIR_DEFAULTS;
+    struct stat         plusstbuf;
+    if(is_plus && stbuf && (!path || !FdManager::HasOpenEntityFd(path))){
+        // same as the stat returned by getattr
+        plusstbuf            = *stbuf;
+        plusstbuf.st_blksize = 4096;
+        plusstbuf.st_blocks  = get_blocks(plusstbuf.st_size);
+        stbuf                = &plusstbuf;
+        flags                = FUSE_FILL_DIR_PLUS;
+    }
+
     const std::lock_guard<std::mutex> lock(filler_lock);
 
     int result = 0;
     if(filled.insert(name).second){
-        result = filler_func(filler_buff, name.c_str(), stbuf, off, S3FS_FUSE_FILL_DIR_DEFAULTS);
+        result = filler_func(filler_buff, name.c_str(), stbuf, off, flags);
     }
     return result;
 }
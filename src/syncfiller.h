@@ -41,17 +41,18 @@ class SyncFiller
         mutable std::mutex      filler_lock;
         void*                   filler_buff;
         fuse_fill_dir_t         filler_func;
+        bool                    is_plus;            // fill with FUSE_FILL_DIR_PLUS(readdirplus)
         std::set<std::string>   filled;
 
     public:
-        explicit SyncFiller(void* buff = nullptr, fuse_fill_dir_t filler = nullptr);
+        explicit SyncFiller(void* buff = nullptr, fuse_fill_dir_t filler = nullptr, bool use_plus = false);
         ~SyncFiller() = default;
         SyncFiller(const SyncFiller&) = delete;
         SyncFiller(SyncFiller&&) = delete;
         SyncFiller& operator=(const SyncFiller&) = delete;
         SyncFiller& operator=(SyncFiller&&) = delete;
 
-        int Fill(const std::string& name, const struct stat *stbuf, off_t off);
+        int Fill(const std::string& name, const struct stat *stbuf, off_t off, const char* path = nullptr);
         int SufficiencyFill(const std::vector<std::string>& pathlist);
 };
 
@@ -0,0 +1,94 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cstdlib>
+#include <string>
+#include <sys/stat.h>
+
+#include "cache.h"
+#include "s3fs_logger.h"
+#include "s3objlist.h"
+#include "test_util.h"
+
+//-------------------------------------------------------------------
+// Global variables for test_cache
+//-------------------------------------------------------------------
+bool foreground                   = false;
+std::string instance_name;
+
+static constexpr int TEST_FILE_COUNT = 100;
+
+// Overfills max_stat_cache_size with the immutable caches.
+void test_immutable_eviction()
+{
+    StatCache* pcache = StatCache::getStatCacheData();
+    pcache->SetCacheSize(20);
+    StatCacheNode::SetImmutable(true);
+
+    struct stat st = {};
+    st.st_mode     = S_IFDIR | 0755;
+    ASSERT_TRUE(pcache->AddStat("/dir/", st, objtype_t::DIR_NORMAL));
+
+    // listing of the directory(as same as readdir)
+    S3ObjList list;
+    for(int cnt = 0; cnt < TEST_FILE_COUNT; ++cnt){
+        ASSERT_TRUE(list.insert(("file" + std::to_string(cnt)).c_str()));
+    }
+    ASSERT_TRUE(pcache->AddS3ObjList("/dir/", list));
+
+    // stat of each file in the listing
+    st.st_mode = S_IFREG | 0644;
+    for(int cnt = 0; cnt < TEST_FILE_COUNT; ++cnt){
+        ASSERT_TRUE(pcache->AddStat("/dir/file" + std::to_string(cnt), st, objtype_t::FILE));
+        ASSERT_TRUE(StatCacheNode::GetCacheCount() <= pcache->GetCacheSize());
+    }
+
+    // the least recently used files are evicted
+    ASSERT_FALSE(pcache->HasStat("/dir/file0"));
+    ASSERT_TRUE(pcache->HasStat("/dir/file" + std::to_string(TEST_FILE_COUNT - 1)));
+    ASSERT_TRUE(pcache->HasStat("/dir/"));
+
+    // the evicted files are still listed
+    S3ObjList cached;
+    ASSERT_TRUE(pcache->GetS3ObjList("/dir/", cached));
+    s3obj_list_t names;
+    ASSERT_TRUE(cached.GetNameList(names));
+    ASSERT_EQUALS(static_cast<size_t>(TEST_FILE_COUNT), names.size());
+
+    StatCacheNode::SetImmutable(false);
+}
+
+int main(int argc, const char *argv[])
+{
+    S3fsLog singletonLog;
+
+    test_immutable_eviction();
+
+    return 0;
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
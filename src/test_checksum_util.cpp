@@ -0,0 +1,101 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2014 Andrew Gaul <andrew@gaul.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "checksum_util.h"
+#include "s3fs_logger.h"
+#include "test_util.h"
+
+//-------------------------------------------------------------------
+// Global variables for test_checksum_util
+//-------------------------------------------------------------------
+bool foreground                   = false;
+std::string instance_name;
+
+void test_checksum()
+{
+    // check values of the algorithms
+    const auto* check = reinterpret_cast<const unsigned char*>("123456789");
+    ASSERT_EQUALS(static_cast<uint32_t>(0xE3069283U), s3fs_crc32c(0, check, 9));
+    ASSERT_EQUALS(static_cast<uint32_t>(0xE3069283U), s3fs_crc32c_sw(0, check, 9));
+    ASSERT_EQUALS(static_cast<uint64_t>(0xAE8B14860A799888ULL), s3fs_crc64nvme(0, check, 9));
+    ASSERT_EQUALS(static_cast<uint64_t>(0xAE8B14860A799888ULL), s3fs_crc64nvme_sw(0, check, 9));
+
+    // the accelerated implementations with any alignment, length and split
+    std::vector<unsigned char> data(1024 + 16);
+    for(size_t pos = 0; pos < data.size(); ++pos){
+        data[pos] = static_cast<unsigned char>((pos * 131 + 7) ^ (pos >> 3));
+    }
+    for(size_t offset = 0; offset < 16; ++offset){
+        for(size_t length = 0; length <= 1024; ++length){
+            const unsigned char* ptr   = &data[offset];
+            size_t               split = length / 3;
+            uint32_t             crc32 = s3fs_crc32c_sw(0, ptr, length);
+            uint64_t             crc64 = s3fs_crc64nvme_sw(0, ptr, length);
+            ASSERT_EQUALS(crc32, s3fs_crc32c(0, ptr, length));
+            ASSERT_EQUALS(crc64, s3fs_crc64nvme(0, ptr, length));
+            ASSERT_EQUALS(crc32, s3fs_crc32c(s3fs_crc32c(0, ptr, split), ptr + split, length - split));
+            ASSERT_EQUALS(crc64, s3fs_crc64nvme(s3fs_crc64nvme(0, ptr, split), ptr + split, length - split));
+        }
+    }
+
+    // the value of x-amz-checksum-* headers
+    ChecksumCalculator calculator;
+    calculator.Reset(checksum_type_t::CRC32C);
+    calculator.Update(check, 4);
+    calculator.Update(check + 4, 5);
+    ASSERT_STREQUALS("4waSgw==", calculator.GetBase64().c_str());
+    calculator.Reset(checksum_type_t::CRC64NVME);
+    calculator.Update(check, 9);
+    ASSERT_STREQUALS("rosUhgp5mIg=", calculator.GetBase64().c_str());
+
+    ASSERT_STREQUALS("x-amz-checksum-crc64nvme", get_checksum_header_name(checksum_type_t::CRC64NVME).c_str());
+    ASSERT_STREQUALS("ChecksumCRC32C", get_checksum_xml_tag(checksum_type_t::CRC32C).c_str());
+
+    // the checksum of the multipart object which is not full object type is ignored
+    headers_t   headers;
+    std::string value;
+    headers["x-amz-checksum-crc32c"] = "AAAAAA==-3";
+    ASSERT_TRUE(checksum_type_t::NONE == find_checksum_header(headers, value));
+    headers["x-amz-checksum-crc64nvme"] = "rosUhgp5mIg=";
+    ASSERT_TRUE(checksum_type_t::CRC64NVME == find_checksum_header(headers, value));
+    ASSERT_STREQUALS("rosUhgp5mIg=", value.c_str());
+}
+
+int main(int argc, const char *argv[])
+{
+    S3fsLog singletonLog;
+
+    test_checksum();
+
+    return 0;
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -0,0 +1,121 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <chrono>
+#include <cmath>
+
+#include "curl_ratelimit.h"
+#include "test_util.h"
+
+//-------------------------------------------------------------------
+// Simulated clock for TokenBucket
+//-------------------------------------------------------------------
+// The sleep function does not sleep, it only advances the clock and
+// accumulates the slept time.
+//
+struct sim_clock
+{
+    std::chrono::steady_clock::time_point now{};
+    std::chrono::duration<double>         slept{0.0};
+
+    TokenBucket MakeBucket()
+    {
+        return TokenBucket(
+            [this](){ return now; },
+            [this](std::chrono::duration<double> wait){ now += std::chrono::duration_cast<std::chrono::steady_clock::duration>(wait); slept += wait; });
+    }
+
+    long SleptMs() const { return std::lround(slept.count() * 1000.0); }
+};
+
+void test_unlimited()
+{
+    sim_clock clock;
+    TokenBucket bucket = clock.MakeBucket();
+
+    bucket.Consume(1000000.0);
+    bucket.Consume(1000000.0, true);
+    ASSERT_EQUALS(0L, clock.SleptMs());
+}
+
+void test_priority()
+{
+    sim_clock clock;
+    TokenBucket bucket = clock.MakeBucket();
+    bucket.SetRate(1000.0);
+
+    // the bucket is full, and the priority caller does not wait for the debt up to one second
+    bucket.Consume(1000.0);
+    ASSERT_EQUALS(0L, clock.SleptMs());
+    bucket.Consume(1000.0, true);
+    ASSERT_EQUALS(0L, clock.SleptMs());
+
+    // the others wait for all debt including the priority caller
+    bucket.Consume(100.0);
+    ASSERT_EQUALS(1100L, clock.SleptMs());
+
+    // the priority callers are also limited over one second of the debt
+    bucket.SetRate(1000.0);
+    clock.slept = std::chrono::duration<double>(0.0);
+    bucket.Consume(2000.0, true);
+    ASSERT_EQUALS(0L, clock.SleptMs());
+    bucket.Consume(200.0, true);
+    ASSERT_EQUALS(200L, clock.SleptMs());
+}
+
+void test_refill()
+{
+    sim_clock clock;
+    TokenBucket bucket = clock.MakeBucket();
+    bucket.SetRate(100.0);
+
+    // drain the bucket, then half of the rate is filled in 500ms
+    bucket.Consume(100.0);
+    clock.now += std::chrono::milliseconds(500);
+    bucket.Consume(50.0);
+    ASSERT_EQUALS(0L, clock.SleptMs());
+    bucket.Consume(10.0);
+    ASSERT_EQUALS(100L, clock.SleptMs());
+
+    // the bucket is not filled over the rate(one second of burst)
+    clock.slept = std::chrono::duration<double>(0.0);
+    clock.now += std::chrono::seconds(10);
+    bucket.Consume(100.0);
+    ASSERT_EQUALS(0L, clock.SleptMs());
+    bucket.Consume(100.0);
+    ASSERT_EQUALS(1000L, clock.SleptMs());
+}
+
+int main(int argc, const char *argv[])
+{
+    test_unlimited();
+    test_priority();
+    test_refill();
+    return 0;
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -18,10 +18,14 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <chrono>
+#include <cstdio>
 #include <string>
 #include <cstring>
 
 #include "curl_util.h"
+#include "s3fs_auth.h"
+#include "string_util.h"
 #include "test_util.h"
 
 //---------------------------------------------------------
@@ -150,10 +154,120 @@ void test_slist_remove()
     curl_slist_free_all(list);
 }
 
+void test_canonical_headers()
+{
+    struct curl_slist* list = nullptr;
+    ASSERT_STREQUALS("\n", get_canonical_headers(list).c_str());
+    ASSERT_STREQUALS("", get_sorted_header_keys(list).c_str());
+
+    list = curl_slist_append(list, "Content-Type: text/plain ");
+    list = curl_slist_append(list, "Empty:  ");
+    list = curl_slist_append(list, "Host:bucket.s3.amazonaws.com");
+    list = curl_slist_append(list, "X-Amz-Date:  20130524T000000Z");
+    list = curl_slist_append(list, "x-amz-meta-Key: Value");
+    ASSERT_STREQUALS("content-type:text/plain\nhost:bucket.s3.amazonaws.com\nx-amz-date:20130524T000000Z\nx-amz-meta-key:Value\n", get_canonical_headers(list).c_str());
+    ASSERT_STREQUALS("x-amz-date:20130524T000000Z\nx-amz-meta-key:Value\n", get_canonical_headers(list, true).c_str());
+    ASSERT_STREQUALS("content-type;host;x-amz-date;x-amz-meta-key", get_sorted_header_keys(list).c_str());
+
+    // append to the existing buffer
+    std::string buffer = "GET\n";
+    append_sorted_header_keys(buffer, list);
+    ASSERT_STREQUALS("GET\ncontent-type;host;x-amz-date;x-amz-meta-key", buffer.c_str());
+    curl_slist_free_all(list);
+}
+
+void test_sigv4_signing_key()
+{
+    // The example of "Deriving the signing key" in the AWS documentation
+    const std::string secret = "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY";
+    sha256_t          key;
+    ASSERT_TRUE(make_sigv4_signing_key(secret, "20120215", "us-east-1", "iam", key));
+    ASSERT_STREQUALS("f4780e2d9f65fa895f9c67b32ce1baf0b0d8a43505a000a1a9e090d414db404d", s3fs_hex_lower(key.data(), key.size()).c_str());
+
+    // cached key
+    sha256_t cached;
+    ASSERT_TRUE(get_sigv4_signing_key(secret, "20120215", "us-east-1", "iam", cached));
+    ASSERT_TRUE(key == cached);
+    ASSERT_TRUE(get_sigv4_signing_key(secret, "20120215", "us-east-1", "iam", cached));
+    ASSERT_TRUE(key == cached);
+
+    // the cache is replaced when the date changes
+    ASSERT_TRUE(make_sigv4_signing_key(secret, "20120216", "us-east-1", "iam", key));
+    ASSERT_TRUE(get_sigv4_signing_key(secret, "20120216", "us-east-1", "iam", cached));
+    ASSERT_TRUE(key == cached);
+    ASSERT_TRUE(get_sigv4_signing_key(secret, "20120216", "us-east-1", "s3", cached));
+    ASSERT_FALSE(key == cached);
+}
+
+//
+// Micro benchmark for signing, this only prints the result.
+//
+void bench_sigv4_signing()
+{
+    const int         loop   = 10000;
+    const std::string secret = "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY";
+    sha256_t          key;
+
+    auto start = std::chrono::steady_clock::now();
+    for(int cnt = 0; cnt < loop; ++cnt){
+        make_sigv4_signing_key(secret, "20120215", "us-east-1", "s3", key);
+    }
+    auto derive = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for(int cnt = 0; cnt < loop; ++cnt){
+        get_sigv4_signing_key(secret, "20120215", "us-east-1", "s3", key);
+    }
+    auto cached = std::chrono::steady_clock::now() - start;
+
+    struct curl_slist* list = nullptr;
+    list = curl_slist_sort_insert(list, "host", "bucket.s3.amazonaws.com");
+    list = curl_slist_sort_insert(list, "x-amz-content-sha256", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    list = curl_slist_sort_insert(list, "x-amz-date", "20130524T000000Z");
+    list = curl_slist_sort_insert(list, "Range", "bytes=0-9");
+    list = curl_slist_sort_insert(list, "User-Agent", "s3fs/1.0");
+
+    start = std::chrono::steady_clock::now();
+    size_t total = 0;
+    for(int cnt = 0; cnt < loop; ++cnt){
+        std::string canonical = get_canonical_headers(list) + "\n" + get_sorted_header_keys(list);
+        total += canonical.size();
+    }
+    auto concat = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    std::string buffer;
+    for(int cnt = 0; cnt < loop; ++cnt){
+        buffer.clear();
+        append_canonical_headers(buffer, list);
+        buffer += '\n';
+        append_sorted_header_keys(buffer, list);
+        total -= buffer.size();
+    }
+    auto append = std::chrono::steady_clock::now() - start;
+    curl_slist_free_all(list);
+    ASSERT_EQUALS(static_cast<size_t>(0), total);
+
+    auto usec = [](std::chrono::steady_clock::duration elapsed){ return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / 1000.0 / loop; };
+    printf("signing key      : derive %8.3f us, cached %8.3f us\n", usec(derive), usec(cached));
+    printf("canonical headers: concat %8.3f us, append %8.3f us\n", usec(concat), usec(append));
+}
+
 int main(int argc, const char *argv[])
 {
+    // the signing key is computed by the crypt library(NSS needs it)
+    if(!s3fs_init_global_ssl()){
+        fprintf(stderr, "could not initialize the crypt library\n");
+        return 1;
+    }
+
     test_sort_insert();
     test_slist_remove();
+    test_canonical_headers();
+    test_sigv4_signing_key();
+    bench_sigv4_signing();
+
+    s3fs_destroy_global_ssl();
     return 0;
 }
 
@@ -0,0 +1,194 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2014 Andrew Gaul <andrew@gaul.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cstdlib>
+#include <string>
+
+#include "s3fs_logger.h"
+#include "s3objlist.h"
+#include "string_util.h"
+#include "test_util.h"
+
+using namespace std::string_literals;
+
+//-------------------------------------------------------------------
+// Global variables for test_s3objlist
+//-------------------------------------------------------------------
+bool foreground                   = false;
+std::string instance_name;
+
+void test_insert_and_get()
+{
+    S3ObjList list;
+
+    ASSERT_TRUE(list.IsEmpty());
+    ASSERT_TRUE(list.insert("file", "\"0123456789abcdef0123456789abcdef\"", false, 1024, "2024-01-02T03:04:05.000Z"));
+    ASSERT_TRUE(list.insert("multipart", "\"0123456789abcdef0123456789abcdef-2\"", false, 2048));
+    ASSERT_TRUE(list.insert("upper", "\"0123456789ABCDEF0123456789ABCDEF\""));
+    ASSERT_FALSE(list.IsEmpty());
+
+    ASSERT_EQUALS("file"s, list.GetOrgName("file"));
+    ASSERT_EQUALS("file"s, list.GetNormalizedName("file"));
+    ASSERT_EQUALS("\"0123456789abcdef0123456789abcdef\""s, list.GetETag("file"));
+    ASSERT_EQUALS(static_cast<off_t>(1024), list.GetSize("file"));
+    ASSERT_EQUALS(static_cast<time_t>(1704164645), list.GetLastModified("file"));
+    ASSERT_FALSE(list.IsDir("file"));
+
+    ASSERT_EQUALS("\"0123456789abcdef0123456789abcdef-2\""s, list.GetETag("multipart"));
+    ASSERT_EQUALS(static_cast<time_t>(-1), list.GetLastModified("multipart"));
+    ASSERT_EQUALS("\"0123456789ABCDEF0123456789ABCDEF\""s, list.GetETag("upper"));
+    ASSERT_EQUALS(static_cast<off_t>(-1), list.GetSize("upper"));
+
+    // LastModified
+    const char* dates[] = {"1970-01-01T00:00:00.000Z", "2000-02-29T23:59:59.000Z", "2024-12-31T12:00:00Z", "2100-03-01T00:00:01.123Z"};
+    for(const char* date : dates){
+        ASSERT_TRUE(list.insert("date", nullptr, false, -1, date));
+        ASSERT_EQUALS(*get_unixtime_from_iso8601(date), list.GetLastModified("date"));
+    }
+
+    ASSERT_EQUALS(""s, list.GetETag("notfound"));
+    ASSERT_EQUALS(static_cast<off_t>(-1), list.GetSize("notfound"));
+}
+
+void test_directory_normalization()
+{
+    S3ObjList list;
+
+    // inserted in unsorted order
+    ASSERT_TRUE(list.insert("dir2_$folder$"));
+    ASSERT_TRUE(list.insert("dir1", "\"etag\"", true));
+    ASSERT_TRUE(list.insert("dir0/"));
+    ASSERT_TRUE(list.insert("dir1"));
+
+    ASSERT_TRUE(list.IsDir("dir0/"));
+    ASSERT_TRUE(list.IsDir("dir1/"));
+    ASSERT_TRUE(list.IsDir("dir2/"));
+    ASSERT_EQUALS("dir1"s, list.GetOrgName("dir1/"));
+    ASSERT_EQUALS("dir2_$folder$"s, list.GetOrgName("dir2/"));
+
+    // alias objects
+    ASSERT_EQUALS(""s, list.GetOrgName("dir1"));
+    ASSERT_EQUALS("dir1/"s, list.GetNormalizedName("dir1"));
+    ASSERT_EQUALS("dir2/"s, list.GetNormalizedName("dir2_$folder$"));
+
+    s3obj_list_t names;
+    ASSERT_TRUE(list.GetNameList(names, true, false));
+    ASSERT_EQUALS(static_cast<size_t>(3), names.size());
+    ASSERT_EQUALS("dir0/"s, names[0]);
+    ASSERT_EQUALS("dir1/"s, names[1]);
+    ASSERT_EQUALS("dir2/"s, names[2]);
+
+    s3obj_view_list_t views;
+    ASSERT_TRUE(list.GetNameViews(views, true));
+    ASSERT_EQUALS(static_cast<size_t>(3), views.size());
+    ASSERT_EQUALS("dir1/"s, std::string(views[1].name));
+    ASSERT_TRUE(objtype_t::DIR_NOT_TERMINATE_SLASH == views[1].type);
+    ASSERT_TRUE(objtype_t::DIR_FOLDER_SUFFIX == views[2].type);
+
+    ASSERT_TRUE(list.HasNormalizedName("dir1/"));
+    ASSERT_FALSE(list.HasNormalizedName("dir1"));
+
+    ASSERT_EQUALS("dir2_$folder$"s, *list.GetLastName());
+}
+
+void test_remove()
+{
+    S3ObjList list;
+
+    ASSERT_TRUE(list.insert("a"));
+    ASSERT_TRUE(list.insert("b/"));
+    ASSERT_TRUE(list.insert("c"));
+    ASSERT_TRUE(list.insert("d"));
+    ASSERT_EQUALS("d"s, *list.GetLastName());
+
+    ASSERT_TRUE(list.HasName("a/"));
+    ASSERT_TRUE(list.HasName("b"));
+    ASSERT_FALSE(list.HasName("e"));
+
+    ASSERT_TRUE(list.Remove("a/"));
+    ASSERT_FALSE(list.HasName("a"));
+    ASSERT_TRUE(list.Remove("b"));
+    ASSERT_FALSE(list.HasName("b/"));
+
+    list.RemoveAfter("c");
+    ASSERT_TRUE(list.HasName("c"));
+    ASSERT_FALSE(list.HasName("d"));
+    ASSERT_EQUALS("c"s, *list.GetLastName());
+
+    ASSERT_TRUE(list.Remove("c"));
+    ASSERT_FALSE(list.GetLastName().has_value());
+}
+
+void test_append()
+{
+    S3ObjList list1;
+    S3ObjList list2;
+
+    ASSERT_TRUE(list1.insert("a", "\"etag-a\"", false, 1));
+    ASSERT_TRUE(list1.insert("c", "\"etag-c\"", false, 3));
+    ASSERT_TRUE(list2.insert("b", "\"etag-b\"", false, 2));
+    ASSERT_TRUE(list2.insert("c", "\"0123456789abcdef0123456789abcdef\"", false, 30));
+    ASSERT_TRUE(list2.insert("d_$folder$"));
+    list2.AddCommonPrefix("e/");
+
+    list1.Append(list2);
+
+    s3obj_list_t names;
+    ASSERT_TRUE(list1.GetNameList(names, false, false));
+    ASSERT_EQUALS(static_cast<size_t>(5), names.size());
+    ASSERT_EQUALS("\"etag-a\""s, list1.GetETag("a"));
+    ASSERT_EQUALS("\"etag-b\""s, list1.GetETag("b"));
+    ASSERT_EQUALS("\"0123456789abcdef0123456789abcdef\""s, list1.GetETag("c"));
+    ASSERT_EQUALS(static_cast<off_t>(30), list1.GetSize("c"));
+    ASSERT_EQUALS("d_$folder$"s, list1.GetOrgName("d/"));
+    ASSERT_EQUALS("d/"s, list1.GetNormalizedName("d_$folder$"));
+    ASSERT_EQUALS(static_cast<size_t>(1), list1.GetCommonPrefixes().size());
+    ASSERT_EQUALS("d_$folder$"s, *list1.GetLastName());
+
+    // the prefix which straddles the split key is listed by both ranges
+    S3ObjList list3;
+    list3.AddCommonPrefix("e/");
+    list3.AddCommonPrefix("f/");
+    list1.Append(list3);
+    ASSERT_EQUALS(static_cast<size_t>(2), list1.GetCommonPrefixes().size());
+    ASSERT_EQUALS("e/"s, list1.GetCommonPrefixes()[0]);
+    ASSERT_EQUALS("f/"s, list1.GetCommonPrefixes()[1]);
+}
+
+int main(int argc, const char *argv[])
+{
+    S3fsLog singletonLog;
+
+    test_insert_and_get();
+    test_directory_normalization();
+    test_remove();
+    test_append();
+
+    return 0;
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -18,6 +18,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <algorithm>
 #include <cerrno>
 #include <cstdio>
 #include <cstdlib>
@@ -28,13 +29,16 @@
 
 #include "s3fs_logger.h"
 #include "threadpoolman.h"
+#include "adaptive_concurrency.h"
 #include "curl.h"
+#include "curl_ratelimit.h"
 #include "curl_share.h"
 
 //------------------------------------------------
 // ThreadPoolMan class variables
 //------------------------------------------------
 int  ThreadPoolMan::worker_count   = 10;        // default
+thread_local ThreadPoolMan* ThreadPoolMan::thread_pool = nullptr;
 
 //------------------------------------------------
 // ThreadPoolMan class methods
@@ -49,7 +53,18 @@ bool ThreadPoolMan::Initialize(int count)
     if(-1 != count){
         ThreadPoolMan::SetWorkerCount(count);
     }
-    singleton = std::make_unique<ThreadPoolMan>(ThreadPoolMan::worker_count);
+
+    // [NOTE]
+    // If the adaptive concurrency is enabled, threads are started up to
+    // its maximum limit, and the number of the requests in transfer is
+    // limited by it starting from worker_count.
+    //
+    int thread_count = ThreadPoolMan::worker_count;
+    if(AdaptiveConcurrency::IsEnabled()){
+        AdaptiveConcurrency::Initialize(ThreadPoolMan::worker_count);
+        thread_count = std::max(thread_count, AdaptiveConcurrency::GetMaxLimit());
+    }
+    singleton = std::make_unique<ThreadPoolMan>(thread_count);
     return true;
 }
 
@@ -120,6 +135,37 @@ bool ThreadPoolMan::AwaitInstruct(const thpoolman_param& param)
     return true;
 }
 
+//
+// Waits before retrying the request.
+// If the current thread is a thread of the pool, a helper thread runs
+// the queued instructions instead of this thread while waiting.
+//
+void ThreadPoolMan::RetryWait(long wait_ms)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(wait_ms);
+    if(ThreadPoolMan::thread_pool){
+        ThreadPoolMan::thread_pool->StartHelper(deadline);
+    }
+    std::this_thread::sleep_until(deadline);
+}
+
+//
+// Runs the instruction, and posts its semaphore.
+//
+void ThreadPoolMan::RunInstruction(S3fsCurl& s3fscurl, const thpoolman_param& param)
+{
+    void* retval;
+    {
+        const S3fsForeground foreground(param.is_foreground);
+        if(nullptr != (retval = param.pfunc(s3fscurl, param.args))){
+            S3FS_PRN_DBG("The instruction function returned with something error code(%ld).", reinterpret_cast<long>(retval));
+        }
+    }
+    if(param.psem){
+        param.psem->release();
+    }
+}
+
 //
 // Thread worker
 //
@@ -131,6 +177,7 @@ void ThreadPoolMan::Worker(ThreadPoolMan* psingleton, std::promise<int> promise)
         return;
     }
     S3FS_PRN_INFO3("Start worker thread in ThreadPoolMan.");
+    ThreadPoolMan::thread_pool = psingleton;
 
     // The only object in this thread worker
     S3fsCurl s3fscurl(true);
@@ -164,13 +211,60 @@ void ThreadPoolMan::Worker(ThreadPoolMan* psingleton, std::promise<int> promise)
         }
 
         // run function
-        void* retval;
-        if(nullptr != (retval = param.pfunc(s3fscurl, param.args))){
-            S3FS_PRN_DBG("The instruction function returned with something error code(%ld).", reinterpret_cast<long>(retval));
+        ThreadPoolMan::RunInstruction(s3fscurl, param);
+    }
+
+    if(!S3fsCurlShare::DestroyCurlShareHandleForThread()){
+        S3FS_PRN_WARN("Failed to destroy curl share handle for this thread, but continue...");
+    }
+
+    promise.set_value(0);
+}
+
+//
+// Helper thread
+//
+// [NOTE]
+// This thread runs the queued instructions until the deadline instead of
+// the worker thread which is waiting for retrying. It does not acquire
+// the semaphore, so the semaphore count for the instruction taken here is
+// left, and a worker thread will get it later and find the instruction
+// list empty.
+//
+void ThreadPoolMan::Helper(ThreadPoolMan* psingleton, std::chrono::steady_clock::time_point deadline, std::promise<int> promise)
+{
+    S3FS_PRN_INFO3("Start helper thread in ThreadPoolMan.");
+    ThreadPoolMan::thread_pool = psingleton;
+
+    S3fsCurl s3fscurl(true);
+
+    while(!psingleton->IsExit() && std::chrono::steady_clock::now() < deadline){
+        // get instruction
+        thpoolman_param param;
+        {
+            std::unique_lock<std::mutex> lock(psingleton->thread_list_lock);
+            if(!psingleton->instruction_cond.wait_until(lock, deadline, [psingleton]() NO_THREAD_SAFETY_ANALYSIS { return psingleton->IsExit() || !psingleton->instruction_list.empty(); })){
+                break;
+            }
+            if(psingleton->IsExit()){
+                break;
+            }
+            param = psingleton->instruction_list.front();
+            psingleton->instruction_list.pop_front();
         }
-        if(param.psem){
-            param.psem->release();
+
+        // reset curl handle
+        if(!s3fscurl.CreateCurlHandle(true)){
+            S3FS_PRN_ERR("Failed to re-create curl handle.");
+
+            // return the instruction to the worker threads
+            const std::lock_guard<std::mutex> lock(psingleton->thread_list_lock);
+            psingleton->instruction_list.push_front(param);
+            break;
         }
+
+        // run function
+        ThreadPoolMan::RunInstruction(s3fscurl, param);
     }
 
     if(!S3fsCurlShare::DestroyCurlShareHandleForThread()){
@@ -214,6 +308,16 @@ void ThreadPoolMan::SetExitFlag(bool exit_flag)
 
 void ThreadPoolMan::StopThreads()
 {
+    // all threads to exit
+    {
+        const std::lock_guard<std::mutex> lock(thread_list_lock);
+        SetExitFlag(true);
+    }
+    instruction_cond.notify_all();
+
+    // wait for helper threads exiting
+    JoinHelpers(true);
+
     const std::lock_guard<std::mutex> lock(thread_list_lock);
 
     if(thread_list.empty()){
@@ -221,8 +325,6 @@ void ThreadPoolMan::StopThreads()
         return;
     }
 
-    // all threads to exit
-    SetExitFlag(true);
     for(size_t waitcnt = thread_list.size(); 0 < waitcnt; --waitcnt){
         thpoolman_sem.release();
     }
@@ -264,16 +366,64 @@ bool ThreadPoolMan::StartThreads(int count)
     return true;
 }
 
+//
+// Starts a helper thread which runs the instructions until the deadline.
+// If the helper threads are already up to the number of the worker
+// threads, nothing is started.
+//
+void ThreadPoolMan::StartHelper(std::chrono::steady_clock::time_point deadline)
+{
+    // join the helper threads which have finished
+    JoinHelpers(false);
+
+    const std::lock_guard<std::mutex> lock(thread_list_lock);
+    if(IsExit() || thread_list.size() <= helper_list.size()){
+        return;
+    }
+    std::promise<int> promise;
+    std::future<int> future = promise.get_future();
+    std::thread thread(ThreadPoolMan::Helper, this, deadline, std::move(promise));
+    helper_list.emplace_back(std::move(thread), std::move(future));
+}
+
+//
+// Joins the helper threads which have finished, or all of them if is_all
+// is true.
+//
+void ThreadPoolMan::JoinHelpers(bool is_all)
+{
+    std::vector<std::pair<std::thread, std::future<int>>> finished;
+    {
+        const std::lock_guard<std::mutex> lock(thread_list_lock);
+        for(auto iter = helper_list.begin(); iter != helper_list.end(); ){
+            if(is_all || std::future_status::ready == iter->second.wait_for(std::chrono::seconds(0))){
+                finished.push_back(std::move(*iter));
+                iter = helper_list.erase(iter);
+            }else{
+                ++iter;
+            }
+        }
+    }
+    // [NOTE]
+    // The helper threads need the lock for exiting, so they are joined
+    // without the lock.
+    for(auto& pair : finished){
+        pair.first.join();
+    }
+}
+
 void ThreadPoolMan::SetInstruction(const thpoolman_param& param)
 {
     // set parameter to list
     {
         const std::lock_guard<std::mutex> lock(thread_list_lock);
         instruction_list.push_back(param);
+        instruction_list.back().is_foreground = S3fsForeground::IsForeground();
     }
 
     // run thread
     thpoolman_sem.release();
+    instruction_cond.notify_one();
 }
 
 /*
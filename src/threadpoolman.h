@@ -22,6 +22,8 @@
 #define S3FS_THREADPOOLMAN_H_
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <future>
 #include <list>
 #include <mutex>
@@ -53,6 +55,7 @@ struct thpoolman_param
     void*            args = nullptr;
     Semaphore*       psem = nullptr;
     thpoolman_worker pfunc = nullptr;
+    bool             is_foreground = false;     // set by SetInstruction from the calling thread
 };
 
 using thpoolman_params_t = std::list<thpoolman_param>;
@@ -60,16 +63,26 @@ using thpoolman_params_t = std::list<thpoolman_param>;
 //------------------------------------------------
 // Class ThreadPoolMan
 //------------------------------------------------
+// [NOTE]
+// When a worker thread waits before retrying its request(RetryWait),
+// a helper thread is started to run the queued instructions until the
+// wait is over, so the waiting thread does not reduce the number of the
+// instructions which are running.
+// The helper threads are up to the number of the worker threads.
+//
 class ThreadPoolMan
 {
     private:
         static int            worker_count;
+        static thread_local ThreadPoolMan* thread_pool;    // the pool of the current thread(nullptr if not a pool thread)
 
         std::atomic<bool>     is_exit;
         Semaphore             thpoolman_sem;
 
         std::mutex            thread_list_lock;
+        std::condition_variable instruction_cond;
         std::vector<std::pair<std::thread, std::future<int>>> thread_list GUARDED_BY(thread_list_lock);
+        std::vector<std::pair<std::thread, std::future<int>>> helper_list GUARDED_BY(thread_list_lock);
         thpoolman_params_t    instruction_list GUARDED_BY(thread_list_lock);
 
     private:
@@ -79,12 +92,16 @@ class ThreadPoolMan
             return singleton;
         }
         static void Worker(ThreadPoolMan* psingleton, std::promise<int> promise);
+        static void Helper(ThreadPoolMan* psingleton, std::chrono::steady_clock::time_point deadline, std::promise<int> promise);
+        static void RunInstruction(S3fsCurl& s3fscurl, const thpoolman_param& param);
 
         bool IsExit() const;
         void SetExitFlag(bool exit_flag);
 
         void StopThreads();
         bool StartThreads(int count);
+        void StartHelper(std::chrono::steady_clock::time_point deadline);
+        void JoinHelpers(bool is_all);
         void SetInstruction(const thpoolman_param& pparam);
 
     public:
@@ -101,6 +118,7 @@ class ThreadPoolMan
         static int GetWorkerCount() { return ThreadPoolMan::worker_count; }
         static bool Instruct(const thpoolman_param& pparam);
         static bool AwaitInstruct(const thpoolman_param& param);
+        static void RetryWait(long wait_ms);
 };
 
 #endif // S3FS_THREADPOOLMAN_H_
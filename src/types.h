@@ -139,6 +139,7 @@ struct etagpair
 {
     std::string  etag;        // expected etag value
     int          part_num;    // part number
+    std::string  checksum;    // additional checksum(base64) of the part
 
     explicit etagpair(const char* petag = nullptr, int part = -1) : etag(petag ? petag : ""), part_num(part) {}
 
@@ -151,6 +152,7 @@ struct etagpair
     {
         etag.clear();
         part_num = -1;
+        checksum.clear();
     }
 };
 